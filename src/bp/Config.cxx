@@ -42,16 +42,28 @@ BpConfig::HandleSet(std::string_view name, const char *value)
 		remote_was_stock_max_idle = ParseUnsignedLong(value);
 	} else if (name == "http_cache_size"sv) {
 		http_cache_size = ParseSize(value);
+	} else if (name == "http_cache_disk_path"sv) {
+		http_cache_disk_path = value;
+	} else if (name == "http_cache_disk_size"sv) {
+		http_cache_disk_size = ParseSize(value);
 	} else if (name == "http_cache_obey_no_cache"sv) {
 		http_cache_obey_no_cache = ParseBool(value);
+	} else if (name == "cache_policy"sv) {
+		cache_policy = ParseCachePolicy(value);
 	} else if (name == "filter_cache_size"sv) {
 		filter_cache_size = ParseSize(value);
 	} else if (name == "encoding_cache_size"sv) {
 		encoding_cache_size = ParseSize(value);
+	} else if (name == "gzip_level"sv) {
+		gzip_level = ParsePositiveLong(value, 9);
+	} else if (name == "brotli_quality"sv) {
+		brotli_quality = ParsePositiveLong(value, 11);
 	} else if (name == "nfs_cache_size"sv) {
 		/* deprecated */
 	} else if (name == "translate_cache_size"sv) {
 		translate_cache_size = ParseUnsignedLong(value);
+	} else if (name == "translate_cache_inotify"sv) {
+		translate_cache_inotify = ParseBool(value);
 	} else if (name == "translate_stock_limit"sv) {
 		translate_stock_limit = ParseUnsignedLong(value);
 	} else if (name == "stopwatch"sv) {
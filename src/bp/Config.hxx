@@ -6,6 +6,7 @@
 
 #include "LConfig.hxx"
 #include "access_log/Config.hxx"
+#include "cache/Policy.hxx"
 #include "ssl/Config.hxx"
 #include "http/CookieSameSite.hxx"
 #include "net/LocalSocketAddress.hxx"
@@ -36,6 +37,12 @@ struct BpConfig {
 
 	std::string session_save_path;
 
+	/**
+	 * A directory for the persistent disk tier of the HTTP cache;
+	 * empty to disable it.
+	 */
+	std::string http_cache_disk_path;
+
 	struct ControlListener : SocketConfig {
 		ControlListener()
 			:SocketConfig{
@@ -62,13 +69,32 @@ struct BpConfig {
 
 	size_t http_cache_size = 512 * 1024 * 1024;
 
+	size_t http_cache_disk_size = 4ULL * 1024 * 1024 * 1024;
+
 	size_t filter_cache_size = 128 * 1024 * 1024;
 
+	/**
+	 * The eviction policy of the HTTP cache (memory tier) and the
+	 * filter cache.
+	 */
+	CachePolicy cache_policy = CachePolicy::LRU;
+
 	std::size_t encoding_cache_size = 0;
 
+	/**
+	 * The compression levels used by AUTO_GZIP and AUTO_BROTLI.
+	 */
+	unsigned gzip_level = 6, brotli_quality = 5;
+
 	unsigned translate_cache_size = 131072;
 	unsigned translate_stock_limit = 32;
 
+	/**
+	 * Watch VALIDATE_MTIME files with inotify instead of calling
+	 * statx() on each translation cache hit?
+	 */
+	bool translate_cache_inotify = false;
+
 	unsigned tcp_stock_limit = 0;
 	static constexpr std::size_t tcp_stock_max_idle = 16;
 
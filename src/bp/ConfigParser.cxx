@@ -10,6 +10,7 @@
 #include "net/Parser.hxx"
 #include "net/control/Protocol.hxx"
 #include "util/StringAPI.hxx"
+#include "util/StringParser.hxx"
 
 #ifdef HAVE_AVAHI
 #include "lib/avahi/Check.hxx"
@@ -92,6 +93,9 @@ SslClientConfigParser::ParseLine(FileLineParser &line)
 		line.ExpectEnd();
 
 		config.cert_key.emplace_back(std::move(name), cert_file, key_file);
+	} else if (StringIsEqual(word, "ktls")) {
+		config.ktls = line.NextBool();
+		line.ExpectEnd();
 	} else
 		throw LineParser::Error("Unknown option");
 }
@@ -178,6 +182,10 @@ BpConfigParser::Listener::ParseLine(FileLineParser &line)
 	} else if (strcmp(word, "auth_alt_host") == 0) {
 		config.auth_alt_host = line.NextBool();
 		line.ExpectEnd();
+	} else if (strcmp(word, "http2_max_window") == 0) {
+		config.http2_max_window = ParseSize(line.ExpectValueAndEnd());
+		if (config.http2_max_window > 0x7fffffff)
+			throw LineParser::Error("Window too large");
 	} else if (strcmp(word, "ssl") == 0) {
 		bool value = line.NextBool();
 
@@ -217,6 +225,12 @@ BpConfigParser::Listener::ParseLine(FileLineParser &line)
 			config.ssl_config.verify = SslVerify::OPTIONAL;
 		else
 			throw LineParser::Error("yes/no expected");
+	} else if (StringIsEqual(word, "ssl_ktls")) {
+		if (!config.ssl)
+			throw LineParser::Error("SSL is not enabled");
+
+		config.ssl_config.ktls = line.NextBool();
+		line.ExpectEnd();
 	} else if (StringIsEqual(word, "translation_socket")) {
 		config.translation_sockets.emplace_front(line.ExpectValueAndEnd());
 	} else if (strcmp(word, "handler") == 0) {
@@ -164,7 +164,8 @@ new_connection(PoolPtr pool, BpInstance &instance, BpListener &listener,
 										   address,
 										   instance.request_slice_pool,
 										   *connection,
-										   *request_handler);
+										   *request_handler,
+										   listener.GetHttp2MaxWindow());
 	else
 #endif
 		connection->http =
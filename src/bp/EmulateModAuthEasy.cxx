@@ -272,7 +272,7 @@ Request::EmulateModAuthEasy(const FileAddress &address,
 	file_response_headers(headers2,
 			      instance.event_loop.GetSystemClockCache(),
 			      override_content_type,
-			      fd, st,
+			      fd, st, nullptr,
 			      tr.GetExpiresRelative(HasQueryString()),
 			      IsProcessorFirst(),
 			      instance.config.use_xattr);
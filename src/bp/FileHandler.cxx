@@ -20,6 +20,7 @@
 #include "lib/fmt/SystemError.hxx"
 #include "io/uring/config.h" // for HAVE_URING
 #include "io/FileAt.hxx"
+#include "io/FileMetadata.hxx"
 #include "io/SharedFd.hxx"
 #include "io/Open.hxx"
 #include "util/StringCompare.hxx"
@@ -36,6 +37,16 @@
 
 using std::string_view_literals::operator""sv;
 
+static constexpr struct open_how open_read_only{
+	.flags = O_RDONLY|O_NOCTTY|O_CLOEXEC|O_NONBLOCK,
+	.resolve = RESOLVE_NO_MAGICLINKS,
+};
+
+static constexpr struct open_how open_read_only_beneath{
+	.flags = O_RDONLY|O_NOCTTY|O_CLOEXEC|O_NONBLOCK,
+	.resolve = RESOLVE_BENEATH|RESOLVE_NO_MAGICLINKS,
+};
+
 inline bool
 Request::CheckFilePath(std::string_view path, bool relative) noexcept
 {
@@ -100,12 +111,14 @@ Request::Handler::File::Close() noexcept
 	open_address = nullptr;
 	error = 0;
 	fd = FileDescriptor::Undefined();
+	metadata = nullptr;
 	fd_lease = {};
 }
 
 void
 Request::DispatchFile(const char *path, FileDescriptor fd,
-		      const struct statx &st, SharedLease &&lease,
+		      const struct statx &st, FileMetadata *metadata,
+		      SharedLease &&lease,
 		      const struct file_request &file_request) noexcept
 {
 	const TranslateResponse &tr = *translate.response;
@@ -120,7 +133,7 @@ Request::DispatchFile(const char *path, FileDescriptor fd,
 	file_response_headers(headers2,
 			      instance.event_loop.GetSystemClockCache(),
 			      override_content_type,
-			      fd, st,
+			      fd, st, metadata,
 			      tr.GetExpiresRelative(HasQueryString()),
 			      IsProcessorFirst(),
 			      instance.config.use_xattr);
@@ -193,9 +206,11 @@ Request::DispatchFile(const char *path, FileDescriptor fd,
 inline bool
 Request::DispatchCompressedFile(const char *path, FileDescriptor fd,
 				const struct statx &st,
+				FileMetadata *metadata,
 				std::string_view encoding,
-				UniqueFileDescriptor compressed_fd,
-				off_t compressed_size) noexcept
+				FileDescriptor compressed_fd,
+				off_t compressed_size,
+				SharedLease &&compressed_lease) noexcept
 {
 	const TranslateResponse &tr = *translate.response;
 	const auto &address = *handler.file.address;
@@ -211,7 +226,7 @@ Request::DispatchCompressedFile(const char *path, FileDescriptor fd,
 	file_response_headers(headers2,
 			      instance.event_loop.GetSystemClockCache(),
 			      override_content_type,
-			      fd, st,
+			      fd, st, metadata,
 			      tr.GetExpiresRelative(HasQueryString()),
 			      IsProcessorFirst(),
 			      instance.config.use_xattr);
@@ -223,8 +238,6 @@ Request::DispatchCompressedFile(const char *path, FileDescriptor fd,
 
 	/* finished, dispatch this response */
 
-	auto *shared_fd = NewFromPool<SharedFd>(pool, std::move(compressed_fd));
-
 	HttpStatus status = tr.status == HttpStatus{}
 		? HttpStatus::OK
 		: tr.status;
@@ -232,12 +245,12 @@ Request::DispatchCompressedFile(const char *path, FileDescriptor fd,
 #ifdef HAVE_URING
 			 instance.uring
 			 ? NewUringIstream(*instance.uring, pool, path,
-					   shared_fd->Get(), *shared_fd,
+					   compressed_fd, std::move(compressed_lease),
 					   0, compressed_size)
 			 :
 #endif
 			 istream_file_fd_new(instance.event_loop, pool,
-					     path, shared_fd->Get(), *shared_fd,
+					     path, compressed_fd, std::move(compressed_lease),
 					     0, compressed_size));
 	return true;
 }
@@ -265,28 +278,84 @@ Request::CheckCompressedFile(const char *path, std::string_view encoding) noexce
 
 inline bool
 Request::CheckAutoCompressedFile(const char *path, std::string_view encoding,
-				 std::string_view suffix) noexcept
+				 std::string_view suffix,
+				 bool &no_sibling) noexcept
 {
 	assert(path != nullptr);
 	assert(suffix.size() >= 2);
 	assert(suffix.front() == '.');
 
+	if (no_sibling)
+		/* a previous request has already found that this
+		   file does not exist */
+		return false;
+
 	if (!http_client_accepts_encoding(request.headers, encoding))
 		return false;
 
+	const auto &address = *handler.file.address;
 	auto &p = *handler.file.precompressed;
 
 	const AllocatorPtr alloc(pool);
 	p.compressed_path = alloc.Concat(path, suffix);
 	p.encoding = encoding;
-	instance.uring.OpenStat(alloc,
-				{handler.file.base, StripBase(p.compressed_path)},
-				BIND_THIS_METHOD(OnPrecompressedOpenStat),
-				BIND_THIS_METHOD(OnPrecompressedOpenStatError),
-				cancel_ptr);
+	p.no_sibling = &no_sibling;
+
+	/* look up the sibling in the FdCache, just like
+	   HandleFileAddressAfterBase() does with the original file,
+	   so a warm cache doesn't need any system call */
+
+	std::string_view absolute_path{p.compressed_path};
+	if (address.base != nullptr)
+		absolute_path = alloc.ConcatView(address.base, absolute_path);
+
+	const char *strip_base = address.beneath != nullptr
+		? address.beneath
+		: address.base;
+
+	const FileDescriptor base = handler.file.base;
+
+	instance.fd_cache.Get(base,
+			      strip_base != nullptr ? std::string_view{strip_base} : std::string_view{},
+			      absolute_path,
+			      base.IsDefined() ? open_read_only_beneath : open_read_only,
+			      STATX_TYPE|STATX_MTIME|STATX_INO|STATX_SIZE,
+			      BIND_THIS_METHOD(OnPrecompressedSibling),
+			      BIND_THIS_METHOD(OnPrecompressedSiblingError),
+			      cancel_ptr);
 	return true;
 }
 
+inline void
+Request::OnPrecompressedSibling(FileDescriptor fd, const struct statx &st,
+				FileMetadata &, SharedLease &&lease) noexcept
+{
+	auto &p = *handler.file.precompressed;
+
+	if (!S_ISREG(st.stx_mode)) {
+		*p.no_sibling = true;
+		ProbeNextPrecompressed();
+		return;
+	}
+
+	DispatchCompressedFile(p.compressed_path, p.original_fd, p.original_st,
+			       &p.original_metadata, p.encoding,
+			       fd, st.stx_size, std::move(lease));
+}
+
+inline void
+Request::OnPrecompressedSiblingError(int error) noexcept
+{
+	auto &p = *handler.file.precompressed;
+
+	if (error == ENOENT)
+		/* remember this in the original file's metadata; the
+		   FdCache item of the sibling expires much sooner */
+		*p.no_sibling = true;
+
+	ProbeNextPrecompressed();
+}
+
 inline void
 Request::OnPrecompressedOpenStat(UniqueFileDescriptor fd,
 				 struct statx &st) noexcept
@@ -296,11 +365,13 @@ Request::OnPrecompressedOpenStat(UniqueFileDescriptor fd,
 		return;
 	}
 
-	const auto &p = *handler.file.precompressed;
+	auto &p = *handler.file.precompressed;
+
+	auto *shared_fd = NewFromPool<SharedFd>(pool, std::move(fd));
 
 	DispatchCompressedFile(p.compressed_path, p.original_fd, p.original_st,
-			       p.encoding,
-			       std::move(fd), st.stx_size);
+			       &p.original_metadata, p.encoding,
+			       shared_fd->Get(), st.stx_size, *shared_fd);
 }
 
 inline void
@@ -321,7 +392,8 @@ Request::ProbeNextPrecompressed() noexcept
 		p.state = Handler::File::Precompressed::AUTO_GZIPPED;
 
 		if ((address.auto_brotli_path || translate.auto_brotli_path) &&
-		    CheckAutoCompressedFile(address.path, "br"sv, ".br"sv))
+		    CheckAutoCompressedFile(address.path, "br"sv, ".br"sv,
+					    p.original_metadata.no_brotli_sibling))
 			return;
 #endif // HAVE_BROTLI
 
@@ -331,7 +403,8 @@ Request::ProbeNextPrecompressed() noexcept
 		p.state = Handler::File::Precompressed::GZIPPED;
 
 		if ((address.auto_gzipped || translate.auto_gzipped) &&
-		    CheckAutoCompressedFile(address.path, "gzip"sv, ".gz"sv))
+		    CheckAutoCompressedFile(address.path, "gzip"sv, ".gz"sv,
+					    p.original_metadata.no_gzip_sibling))
 			return;
 
 		// fall through
@@ -349,15 +422,17 @@ Request::ProbeNextPrecompressed() noexcept
 	}
 
 	const struct file_request file_request(p.original_st.stx_size);
-	DispatchFile(address.path, p.original_fd, p.original_st, std::move(p.original_lease),
+	DispatchFile(address.path, p.original_fd, p.original_st,
+		     &p.original_metadata, std::move(p.original_lease),
 		     file_request);
 }
 
 inline void
 Request::ProbePrecompressed(FileDescriptor fd, const struct statx &st,
+			    FileMetadata &metadata,
 			    SharedLease &&lease) noexcept
 {
-	handler.file.precompressed = UniquePoolPtr<Request::Handler::File::Precompressed>::Make(pool, fd, st, std::move(lease));
+	handler.file.precompressed = UniquePoolPtr<Request::Handler::File::Precompressed>::Make(pool, fd, st, metadata, std::move(lease));
 	ProbeNextPrecompressed();
 }
 
@@ -389,9 +464,10 @@ Request::MaybeEmulateModAuthEasy(const FileAddress &address,
 }
 
 inline void
-Request::OnOpenStat(FileDescriptor fd, const struct statx &st, SharedLease &&_lease) noexcept
+Request::OnOpenStat(FileDescriptor fd, const struct statx &st,
+		    FileMetadata &metadata, SharedLease &&_lease) noexcept
 {
-	HandleFileAddress(*handler.file.address, fd, st, std::move(_lease));
+	HandleFileAddress(*handler.file.address, fd, st, metadata, std::move(_lease));
 }
 
 inline void
@@ -416,7 +492,8 @@ Request::HandleFileAddress(const FileAddress &address) noexcept
 		if (handler.file.fd.IsDefined())
 			/* file has already been opened */
 			HandleFileAddress(address, handler.file.fd,
-					  handler.file.stx, std::move(handler.file.fd_lease));
+					  handler.file.stx, *handler.file.metadata,
+					  std::move(handler.file.fd_lease));
 		else
 			OnOpenStatError(handler.file.error);
 	} else
@@ -432,16 +509,6 @@ Request::HandleFileAddressAfterBase(FileDescriptor base, std::string_view strip_
 	if (address.base != nullptr)
 		path = AllocatorPtr{pool}.ConcatView(address.base, path);
 
-	static constexpr struct open_how open_read_only{
-		.flags = O_RDONLY|O_NOCTTY|O_CLOEXEC|O_NONBLOCK,
-		.resolve = RESOLVE_NO_MAGICLINKS,
-	};
-
-	static constexpr struct open_how open_read_only_beneath{
-		.flags = O_RDONLY|O_NOCTTY|O_CLOEXEC|O_NONBLOCK,
-		.resolve = RESOLVE_BENEATH|RESOLVE_NO_MAGICLINKS,
-	};
-
 	instance.fd_cache.Get(base, strip_base, path,
 			      base.IsDefined() ? open_read_only_beneath : open_read_only,
 			      STATX_TYPE|STATX_MTIME|STATX_INO|STATX_SIZE,
@@ -454,6 +521,7 @@ void
 Request::HandleFileAddress(const FileAddress &address,
 			   FileDescriptor fd,
 			   const struct statx &st,
+			   FileMetadata &metadata,
 			   SharedLease &&lease) noexcept
 {
 	/* check request method */
@@ -490,7 +558,7 @@ Request::HandleFileAddress(const FileAddress &address,
 
 	/* request options */
 
-	if (!EvaluateFileRequest(fd, st, file_request)) {
+	if (!EvaluateFileRequest(fd, st, &metadata, file_request)) {
 		return;
 	}
 
@@ -498,17 +566,20 @@ Request::HandleFileAddress(const FileAddress &address,
 
 	if (file_request.range.type == HttpRangeRequest::Type::NONE &&
 	    !IsTransformationEnabled()) {
-		ProbePrecompressed(fd, st, std::move(lease));
+		ProbePrecompressed(fd, st, metadata, std::move(lease));
 		return;
 	}
 
 	/* build the response */
 
-	DispatchFile(address.path, fd, st, std::move(lease), file_request);
+	DispatchFile(address.path, fd, st, &metadata, std::move(lease),
+		     file_request);
 }
 
 void
-Request::OnStatOpenStatSuccess(FileDescriptor fd, const struct statx &st, SharedLease &&lease) noexcept
+Request::OnStatOpenStatSuccess(FileDescriptor fd, const struct statx &st,
+			       FileMetadata &metadata,
+			       SharedLease &&lease) noexcept
 {
 	assert(!handler.file.fd.IsDefined());
 	assert(handler.file.error == 0);
@@ -516,6 +587,7 @@ Request::OnStatOpenStatSuccess(FileDescriptor fd, const struct statx &st, Shared
 	handler.file.fd_lease = std::move(lease);
 	handler.file.fd = fd;
 	handler.file.stx = st;
+	handler.file.metadata = &metadata;
 	handler.file.open_address = handler.file.address;
 
 	(this->*handler.file.on_stat_success)(st);
@@ -552,16 +624,6 @@ Request::StatFileAddressAfterBase(FileDescriptor base, std::string_view strip_ba
 	if (address.base != nullptr)
 		path = AllocatorPtr{pool}.ConcatView(address.base, path);
 
-	static constexpr struct open_how open_read_only{
-		.flags = O_RDONLY|O_NOCTTY|O_CLOEXEC|O_NONBLOCK,
-		.resolve = RESOLVE_NO_MAGICLINKS,
-	};
-
-	static constexpr struct open_how open_read_only_beneath{
-		.flags = O_RDONLY|O_NOCTTY|O_CLOEXEC|O_NONBLOCK,
-		.resolve = RESOLVE_BENEATH|RESOLVE_NO_MAGICLINKS,
-	};
-
 	instance.fd_cache.Get(base, strip_base, path,
 			      base.IsDefined() ? open_read_only_beneath : open_read_only,
 			      STATX_TYPE|STATX_MTIME|STATX_INO|STATX_SIZE,
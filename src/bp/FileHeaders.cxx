@@ -16,6 +16,7 @@
 #include "http/Method.hxx"
 #include "event/Loop.hxx"
 #include "io/FileDescriptor.hxx"
+#include "io/FileMetadata.hxx"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -44,6 +45,22 @@ read_xattr_max_age(FileDescriptor fd) noexcept
 	return std::chrono::seconds(max_age);
 }
 
+/**
+ * Like read_xattr_max_age(), but use the #FileMetadata cache (if
+ * one was given).
+ */
+static std::chrono::seconds
+GetXattrMaxAge(FileDescriptor fd, FileMetadata *metadata) noexcept
+{
+	if (metadata == nullptr)
+		return read_xattr_max_age(fd);
+
+	if (!metadata->max_age)
+		metadata->max_age = read_xattr_max_age(fd);
+
+	return *metadata->max_age;
+}
+
 static void
 generate_expires(GrowingBuffer &headers,
 		 std::chrono::system_clock::time_point now,
@@ -60,10 +77,9 @@ generate_expires(GrowingBuffer &headers,
 		     http_date_format(now + max_age));
 }
 
-[[gnu::pure]]
 static bool
 CheckETagList(const char *list, FileDescriptor fd,
-	      const struct statx &st,
+	      const struct statx &st, FileMetadata *metadata,
 	      bool use_xattr) noexcept
 {
 	assert(list != nullptr);
@@ -72,16 +88,16 @@ CheckETagList(const char *list, FileDescriptor fd,
 		return true;
 
 	char buffer[256];
-	GetAnyETag(buffer, sizeof(buffer), fd, st, use_xattr);
+	GetAnyETag(buffer, sizeof(buffer), fd, st, use_xattr, metadata);
 	return http_list_contains(list, buffer);
 }
 
 static void
 MakeETag(GrowingBuffer &headers, FileDescriptor fd, const struct statx &st,
-	bool use_xattr) noexcept
+	 FileMetadata *metadata, bool use_xattr) noexcept
 {
 	char buffer[512];
-	GetAnyETag(buffer, sizeof(buffer), fd, st, use_xattr);
+	GetAnyETag(buffer, sizeof(buffer), fd, st, use_xattr, metadata);
 
 	header_write(headers, "etag", buffer);
 }
@@ -90,16 +106,17 @@ static void
 file_cache_headers(GrowingBuffer &headers,
 		   const ClockCache<std::chrono::system_clock> &system_clock,
 		   FileDescriptor fd, const struct statx &st,
+		   FileMetadata *metadata,
 		   std::chrono::seconds max_age,
 		   bool use_xattr) noexcept
 {
 	header_write(headers, "last-modified",
 		     http_date_format(std::chrono::system_clock::from_time_t(st.stx_mtime.tv_sec)));
 
-	MakeETag(headers, fd, st, use_xattr);
+	MakeETag(headers, fd, st, metadata, use_xattr);
 
 	if (use_xattr && max_age == std::chrono::seconds::zero() && fd.IsDefined())
-		max_age = read_xattr_max_age(fd);
+		max_age = GetXattrMaxAge(fd, metadata);
 
 	if (max_age > std::chrono::seconds::zero())
 		generate_expires(headers, system_clock.now(), max_age);
@@ -111,6 +128,7 @@ file_cache_headers(GrowingBuffer &headers,
 static bool
 check_if_range(const char *if_range,
 	       FileDescriptor fd, const struct statx &st,
+	       FileMetadata *metadata,
 	       bool use_xattr) noexcept
 {
 	if (if_range == nullptr)
@@ -121,7 +139,7 @@ check_if_range(const char *if_range,
 		return std::chrono::system_clock::from_time_t(st.stx_mtime.tv_sec) == t;
 
 	char etag[256];
-	GetAnyETag(etag, sizeof(etag), fd, st, use_xattr);
+	GetAnyETag(etag, sizeof(etag), fd, st, use_xattr, metadata);
 	return strcmp(if_range, etag) == 0;
 }
 
@@ -131,6 +149,7 @@ check_if_range(const char *if_range,
 static void
 DispatchNotModified(Request &request2, const TranslateResponse &tr,
 		    FileDescriptor fd, const struct statx &st,
+		    FileMetadata *metadata,
 		    bool use_xattr) noexcept
 {
 	HttpHeaders headers;
@@ -138,7 +157,8 @@ DispatchNotModified(Request &request2, const TranslateResponse &tr,
 
 	file_cache_headers(headers2,
 			   request2.instance.event_loop.GetSystemClockCache(),
-			   fd, st, tr.GetExpiresRelative(request2.HasQueryString()),
+			   fd, st, metadata,
+			   tr.GetExpiresRelative(request2.HasQueryString()),
 			   use_xattr);
 
 	write_translation_vary_header(headers2, tr);
@@ -149,6 +169,7 @@ DispatchNotModified(Request &request2, const TranslateResponse &tr,
 
 bool
 Request::EvaluateFileRequest(FileDescriptor fd, const struct statx &st,
+			     FileMetadata *metadata,
 			     struct file_request &file_request) noexcept
 {
 	const auto &request_headers = request.headers;
@@ -163,13 +184,13 @@ Request::EvaluateFileRequest(FileDescriptor fd, const struct statx &st,
 
 		if (p != nullptr &&
 		    check_if_range(request_headers.Get(if_range_header), fd, st,
-				   use_xattr))
+				   metadata, use_xattr))
 			file_request.range.ParseRangeHeader(p);
 	}
 
 	if (!IsTransformationEnabled()) {
 		const char *p = request_headers.Get(if_match_header);
-		if (p != nullptr && !CheckETagList(p, fd, st, use_xattr)) {
+		if (p != nullptr && !CheckETagList(p, fd, st, metadata, use_xattr)) {
 			DispatchError(HttpStatus::PRECONDITION_FAILED,
 				      {}, nullptr);
 			return false;
@@ -177,8 +198,8 @@ Request::EvaluateFileRequest(FileDescriptor fd, const struct statx &st,
 
 		p = request_headers.Get(if_none_match_header);
 		if (p != nullptr) {
-			if (CheckETagList(p, fd, st, use_xattr)) {
-				DispatchNotModified(*this, tr, fd, st,
+			if (CheckETagList(p, fd, st, metadata, use_xattr)) {
+				DispatchNotModified(*this, tr, fd, st, metadata,
 						    use_xattr);
 				return false;
 			}
@@ -200,7 +221,8 @@ Request::EvaluateFileRequest(FileDescriptor fd, const struct statx &st,
 			const auto t = http_date_parse(p);
 			if (t != std::chrono::system_clock::from_time_t(-1) &&
 			    std::chrono::system_clock::from_time_t(st.stx_mtime.tv_sec) <= t) {
-				DispatchNotModified(*this, tr, fd, st, use_xattr);
+				DispatchNotModified(*this, tr, fd, st, metadata,
+						    use_xattr);
 				return false;
 			}
 		}
@@ -225,12 +247,13 @@ file_response_headers(GrowingBuffer &headers,
 		      const ClockCache<std::chrono::system_clock> &system_clock,
 		      const char *override_content_type,
 		      FileDescriptor fd, const struct statx &st,
+		      FileMetadata *metadata,
 		      std::chrono::seconds expires_relative,
 		      bool processor_first, bool use_xattr) noexcept
 {
 	if (!processor_first)
 		file_cache_headers(headers, system_clock,
-				   fd, st, expires_relative,
+				   fd, st, metadata, expires_relative,
 				   use_xattr);
 
 	if (override_content_type != nullptr) {
@@ -238,7 +261,8 @@ file_response_headers(GrowingBuffer &headers,
 		header_write(headers, "content-type", override_content_type);
 	} else {
 		char content_type[256];
-		if (use_xattr && load_xattr_content_type(content_type, sizeof(content_type), fd)) {
+		if (use_xattr && load_xattr_content_type(content_type, sizeof(content_type),
+							fd, metadata)) {
 			header_write(headers, "content-type", content_type);
 		} else {
 			header_write(headers, "content-type", "application/octet-stream");
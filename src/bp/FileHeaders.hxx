@@ -18,6 +18,7 @@ template<typename Clock> class ClockCache;
 class FileDescriptor;
 class GrowingBuffer;
 struct statx;
+struct FileMetadata;
 
 struct file_request {
 	HttpRangeRequest range;
@@ -25,10 +26,15 @@ struct file_request {
 	explicit constexpr file_request(off_t _size) noexcept:range(_size) {}
 };
 
+/**
+ * @param metadata an optional cache for attributes loaded from
+ * xattrs (see #FdCache)
+ */
 void
 file_response_headers(GrowingBuffer &headers,
 		      const ClockCache<std::chrono::system_clock> &system_clock,
 		      const char *override_content_type,
 		      FileDescriptor fd, const struct statx &st,
+		      FileMetadata *metadata,
 		      std::chrono::seconds expires_relative,
 		      bool processor_first, bool use_xattr) noexcept;
@@ -4,6 +4,7 @@
 
 #include "ForwardHeaders.hxx"
 #include "http/CommonHeaders.hxx"
+#include "http/HeaderToken.hxx"
 #include "http/Upgrade.hxx"
 #include "strmap.hxx"
 #include "session/Session.hxx"
@@ -18,17 +19,41 @@
 
 using namespace BengProxy;
 
+static constexpr bool
+IsIfCacheHeader(HeaderToken token) noexcept
+{
+	switch (token) {
+	case HeaderToken::IF_MODIFIED_SINCE:
+	case HeaderToken::IF_UNMODIFIED_SINCE:
+	case HeaderToken::IF_MATCH:
+	case HeaderToken::IF_NONE_MATCH:
+	case HeaderToken::IF_RANGE:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+/**
+ * Classify a header which has no special #HeaderToken handling
+ * (including all unknown headers).
+ */
 [[gnu::pure]]
-static bool
-IsIfCacheHeader(const char *name) noexcept
+static HeaderGroup
+ClassifyOtherHeader(const char *name, const bool is_upgrade) noexcept
 {
-	const char *i = StringAfterPrefix(name, "if-");
-	return i != nullptr &&
-		(StringIsEqual(i, "modified-since") ||
-		 StringIsEqual(i, "unmodified-since") ||
-		 StringIsEqual(i, "match") ||
-		 StringIsEqual(i, "none-match") ||
-		 StringIsEqual(i, "range"));
+	if (StringStartsWith(name, "x-cm4all-beng-"))
+		return HeaderGroup::SECURE;
+
+	if (is_upgrade && StringStartsWith(name, "sec-websocket-"))
+		/* "upgrade" */
+		return HeaderGroup::ALL;
+
+	if (http_header_is_hop_by_hop(name))
+		return HeaderGroup::MAX;
+
+	return HeaderGroup::OTHER;
 }
 
 /**
@@ -39,138 +64,102 @@ IsIfCacheHeader(const char *name) noexcept
  */
 [[gnu::pure]]
 static HeaderGroup
-ClassifyRequestHeader(const char *name, const bool with_body,
-		      const bool is_upgrade) noexcept
+ClassifyRequestHeader(const char *name, HeaderToken token,
+		      const bool with_body, const bool is_upgrade) noexcept
 {
-	switch (*name) {
-	case 'a':
-		if (auto accept = StringAfterPrefix(name, "accept")) {
-			if (StringIsEmpty(accept))
-				/* "basic" */
-				return HeaderGroup::ALL;
-
-			if (StringIsEqual(accept, "-language") ||
-			    StringIsEqual(accept, "-charset") ||
-			    StringIsEqual(accept, "-encoding"))
-				/* special handling */
-				return HeaderGroup::MAX;
-		}
-
-		if (auto acr = StringAfterPrefix(name, "access-control-request-")) {
-			if (StringIsEqual(acr, "method") || StringIsEqual(acr, "headers"))
-				/* see http://www.w3.org/TR/cors/#syntax */
-				return HeaderGroup::CORS;
-		}
-
-		if (StringIsEqual(name, "authorization"))
-			return HeaderGroup::AUTH;
-
-		break;
-
-	case 'c':
-		if (StringIsEqual(name, "cache-control"))
-			/* "basic" */
-			return HeaderGroup::ALL;
-
-		if (StringIsEqual(name, "cookie") || StringIsEqual(name, "cookie2"))
-			return HeaderGroup::COOKIE;
-
-		if (auto content = StringAfterPrefix(name, "content-")) {
-			if (StringIsEqual(content, "encoding") ||
-			    StringIsEqual(content, "language") ||
-			    StringIsEqual(content, "md5") ||
-			    StringIsEqual(content, "range") ||
-			    StringIsEqual(content, "type") ||
-			    StringIsEqual(content, "disposition"))
-				/* "body" */
-				return with_body ? HeaderGroup::ALL : HeaderGroup::MAX;
-		}
-
-		break;
-
-	case 'f':
-		if (StringIsEqual(name, "from"))
-			/* "basic" */
-			return HeaderGroup::ALL;
+	switch (token) {
+	case HeaderToken::ACCEPT:
+	case HeaderToken::CACHE_CONTROL:
+	case HeaderToken::FROM:
+		/* "basic" */
+		return HeaderGroup::ALL;
+
+	case HeaderToken::ACCEPT_CHARSET:
+	case HeaderToken::ACCEPT_ENCODING:
+	case HeaderToken::ACCEPT_LANGUAGE:
+		/* special handling */
+		return HeaderGroup::MAX;
 
-		break;
+	case HeaderToken::ACCESS_CONTROL_REQUEST_METHOD:
+	case HeaderToken::ACCESS_CONTROL_REQUEST_HEADERS:
+		/* see http://www.w3.org/TR/cors/#syntax */
+		return HeaderGroup::CORS;
+
+	case HeaderToken::AUTHORIZATION:
+		return HeaderGroup::AUTH;
+
+	case HeaderToken::COOKIE:
+	case HeaderToken::COOKIE2:
+		return HeaderGroup::COOKIE;
+
+	case HeaderToken::CONTENT_ENCODING:
+	case HeaderToken::CONTENT_LANGUAGE:
+	case HeaderToken::CONTENT_MD5:
+	case HeaderToken::CONTENT_RANGE:
+	case HeaderToken::CONTENT_TYPE:
+	case HeaderToken::CONTENT_DISPOSITION:
+		/* "body" */
+		return with_body ? HeaderGroup::ALL : HeaderGroup::MAX;
+
+	case HeaderToken::IF_MODIFIED_SINCE:
+	case HeaderToken::IF_UNMODIFIED_SINCE:
+	case HeaderToken::IF_MATCH:
+	case HeaderToken::IF_NONE_MATCH:
+	case HeaderToken::IF_RANGE:
+		/* "cache" */
+		return HeaderGroup::MAX;
 
-	case 'i':
-		if (IsIfCacheHeader(name))
-			/* "cache" */
-			return HeaderGroup::MAX;
+	case HeaderToken::HOST:
+		return HeaderGroup::MAX;
 
-		break;
+	case HeaderToken::ORIGIN:
+		/* see http://www.w3.org/TR/cors/#syntax */
+		return is_upgrade
+			/* always forward for "Upgrade" requests */
+			? HeaderGroup::ALL
+			/* only forward if CORS forwarding is enabled */
+			: HeaderGroup::CORS;
 
-	case 'h':
-		if (StringIsEqual(name, "host"))
-			return HeaderGroup::MAX;
-		break;
+	case HeaderToken::REFERER:
+		return HeaderGroup::LINK;
 
-	case 'o':
-		if (StringIsEqual(name, "origin"))
-			/* see http://www.w3.org/TR/cors/#syntax */
-			return is_upgrade
-				/* always forward for "Upgrade" requests */
-				? HeaderGroup::ALL
-				/* only forward if CORS forwarding is enabled */
-				: HeaderGroup::CORS;
-				break;
-
-	case 'r':
-		if (StringIsEqual(name, "referer"))
-			return HeaderGroup::LINK;
-		if (StringIsEqual(name, "range"))
-			/* special handling */
-			return HeaderGroup::MAX;
-		break;
+	case HeaderToken::RANGE:
+		/* special handling */
+		return HeaderGroup::MAX;
 
-	case 's':
-		if (is_upgrade && StringStartsWith(name, "sec-websocket-"))
+	case HeaderToken::UPGRADE:
+		if (is_upgrade)
 			/* "upgrade" */
 			return HeaderGroup::ALL;
 		break;
 
-	case 'u':
-		if (is_upgrade && StringIsEqual(name, "upgrade"))
-			/* "upgrade" */
-			return HeaderGroup::ALL;
+	case HeaderToken::USER_AGENT:
+		return HeaderGroup::MAX;
 
-		if (StringIsEqual(name, "user-agent"))
-			return HeaderGroup::MAX;
-		break;
+	case HeaderToken::VIA:
+		/* TODO: use HeaderGroup::IDENTITY */
+		return HeaderGroup::MAX;
 
-	case 'v':
-		if (StringIsEqual(name, "via"))
-			/* TODO: use HeaderGroup::IDENTITY */
-			return HeaderGroup::MAX;
-		break;
+	case HeaderToken::X_CM4ALL_BENG_PEER_SUBJECT:
+	case HeaderToken::X_CM4ALL_BENG_PEER_ISSUER_SUBJECT:
+	case HeaderToken::X_CM4ALL_HTTPS:
+		return HeaderGroup::SSL;
 
-	case 'x':
-		if (auto c4 = StringAfterPrefix(name, "x-cm4all-")) {
-			if (auto b = StringAfterPrefix(c4, "beng-")) {
-				return StringIsEqual(b, "peer-subject") ||
-					StringIsEqual(b, "peer-issuer-subject")
-					? HeaderGroup::SSL
-					: HeaderGroup::SECURE;
-			} else if (StringIsEqual(c4, "https"))
-				return HeaderGroup::SSL;
-			else if (StringIsEqual(c4, "docroot"))
-				/* this header is used by apache-lhttpd to set the
-				   per-request DocumentRoot, and should never be forwarded
-				   from the outside to apache-lhttpd */
-				return HeaderGroup::MAX;
-		} else if (StringIsEqual(name, "x-forwarded-for"))
-			/* TODO: use HeaderGroup::IDENTITY */
-			return HeaderGroup::MAX;
+	case HeaderToken::X_CM4ALL_DOCROOT:
+		/* this header is used by apache-lhttpd to set the
+		   per-request DocumentRoot, and should never be forwarded
+		   from the outside to apache-lhttpd */
+		return HeaderGroup::MAX;
 
+	case HeaderToken::X_FORWARDED_FOR:
+		/* TODO: use HeaderGroup::IDENTITY */
+		return HeaderGroup::MAX;
+
+	default:
 		break;
 	}
 
-	if (http_header_is_hop_by_hop(name))
-		return HeaderGroup::MAX;
-
-	return HeaderGroup::OTHER;
+	return ClassifyOtherHeader(name, is_upgrade);
 }
 
 static void
@@ -265,30 +254,32 @@ forward_request_headers(AllocatorPtr alloc, const StringMap &src,
 		const char *const key = i.key;
 		const char *value = i.value;
 
-		const auto group = ClassifyRequestHeader(key, with_body, is_upgrade);
+		const auto token = LookupHeaderToken(key);
+		const auto group = ClassifyRequestHeader(key, token,
+							 with_body, is_upgrade);
 		if (group == HeaderGroup::ALL) {
 			dest.Add(alloc, key, value);
 			continue;
 		} else if (group == HeaderGroup::MAX) {
-			if (StringIsEqual(key, "host")) {
+			if (token == HeaderToken::HOST) {
 				if (!exclude_host)
 					dest.Add(alloc, key, value);
 				if (settings[HeaderGroup::FORWARD] == HeaderForwardMode::MANGLE)
 					dest.Add(alloc, x_forwarded_host_header, value);
 			} else if (forward_charset &&
-				   StringIsEqual(key, "accept-charset")) {
+				   token == HeaderToken::ACCEPT_CHARSET) {
 				dest.Add(alloc, key, value);
 			} else if (forward_encoding &&
-				   StringIsEqual(key, "accept-encoding")) {
+				   token == HeaderToken::ACCEPT_ENCODING) {
 				dest.Add(alloc, key, value);
 			} else if ((session == nullptr ||
 				    session->parent.language == nullptr) &&
-				   StringIsEqual(key, "accept-language")) {
+				   token == HeaderToken::ACCEPT_LANGUAGE) {
 				dest.Add(alloc, key, value);
 			} else if (forward_range &&
-				   (StringIsEqual(key, "range") ||
+				   (token == HeaderToken::RANGE ||
 				    // TODO: separate parameter for cache headers
-				    IsIfCacheHeader(key))) {
+				    IsIfCacheHeader(token))) {
 				dest.Add(alloc, key, value);
 			}
 
@@ -305,10 +296,10 @@ forward_request_headers(AllocatorPtr alloc, const StringMap &src,
 
 		case HeaderForwardMode::BOTH:
 			if (group == HeaderGroup::COOKIE) {
-				if (StringIsEqual(key, "cookie2"))
+				if (token == HeaderToken::COOKIE2)
 					break;
 
-				if (StringIsEqual(key, "cookie")) {
+				if (token == HeaderToken::COOKIE) {
 					value = cookie_exclude(i.value, session_cookie, alloc);
 					if (value != nullptr)
 						break;
@@ -375,153 +366,103 @@ forward_request_headers(AllocatorPtr alloc, const StringMap &src,
  */
 [[gnu::pure]]
 static HeaderGroup
-ClassifyResponseHeader(const char *name, const bool is_upgrade) noexcept
+ClassifyResponseHeader(const char *name, HeaderToken token,
+		       const bool is_upgrade) noexcept
 {
-	switch (*name) {
-	case 'a':
-		if (StringIsEqual(name, "accept-ranges") ||
-		    StringIsEqual(name, "age") ||
-		    StringIsEqual(name, "allow"))
-			/* "basic" */
-			return HeaderGroup::ALL;
-
-		if (auto acr = StringAfterPrefix(name, "access-control-")) {
-			if (StringIsEqual(acr, "allow-origin") ||
-			    StringIsEqual(acr, "allow-credentials") ||
-			    StringIsEqual(acr, "expose-headers") ||
-			    StringIsEqual(acr, "max-age") ||
-			    StringIsEqual(acr, "allow-methods") ||
-			    StringIsEqual(acr, "allow-headers"))
-				/* see http://www.w3.org/TR/cors/#syntax */
-				return HeaderGroup::CORS;
-		}
-
-		if (StringIsEqual(name, "authentication-info"))
-			return HeaderGroup::AUTH;
-
-		break;
-
-	case 'c':
-		if (auto content = StringAfterPrefix(name, "content-")) {
-			if (StringIsEqual(content, "encoding") ||
-			    StringIsEqual(content, "language") ||
-			    StringIsEqual(content, "md5") ||
-			    StringIsEqual(content, "range") ||
-			    StringIsEqual(content, "security-policy") ||
-			    StringIsEqual(content, "type") ||
-			    StringIsEqual(content, "disposition"))
-				/* "body" */
-				return HeaderGroup::ALL;
-
-			if (StringIsEqual(content, "location"))
-				/* "link" */
-				return HeaderGroup::LINK;
-		} else if (StringIsEqual(name, "cache-control"))
-			/* "basic" */
-			return HeaderGroup::ALL;
-
-		break;
-
-	case 'd':
-		if (StringIsEqual(name, "date"))
-			/* "exclude" */
-			return HeaderGroup::MAX;
-
-		if (StringIsEqual(name, "digest"))
-			return HeaderGroup::ALL;
-
-		break;
-
-	case 'e':
-		if (StringIsEqual(name, "etag") || StringIsEqual(name, "expires"))
-			/* "basic" */
-			return HeaderGroup::ALL;
-		break;
-
-	case 'l':
-		if (StringIsEqual(name, "last-modified"))
-			/* "basic" */
-			return HeaderGroup::ALL;
+	switch (token) {
+	case HeaderToken::ACCEPT_RANGES:
+	case HeaderToken::AGE:
+	case HeaderToken::ALLOW:
+	case HeaderToken::CACHE_CONTROL:
+	case HeaderToken::ETAG:
+	case HeaderToken::EXPIRES:
+	case HeaderToken::LAST_MODIFIED:
+	case HeaderToken::RETRY_AFTER:
+	case HeaderToken::VARY:
+		/* "basic" */
+		return HeaderGroup::ALL;
+
+	case HeaderToken::ACCESS_CONTROL_ALLOW_ORIGIN:
+	case HeaderToken::ACCESS_CONTROL_ALLOW_CREDENTIALS:
+	case HeaderToken::ACCESS_CONTROL_EXPOSE_HEADERS:
+	case HeaderToken::ACCESS_CONTROL_MAX_AGE:
+	case HeaderToken::ACCESS_CONTROL_ALLOW_METHODS:
+	case HeaderToken::ACCESS_CONTROL_ALLOW_HEADERS:
+		/* see http://www.w3.org/TR/cors/#syntax */
+		return HeaderGroup::CORS;
+
+	case HeaderToken::AUTHENTICATION_INFO:
+	case HeaderToken::WWW_AUTHENTICATE:
+		return HeaderGroup::AUTH;
+
+	case HeaderToken::CONTENT_ENCODING:
+	case HeaderToken::CONTENT_LANGUAGE:
+	case HeaderToken::CONTENT_MD5:
+	case HeaderToken::CONTENT_RANGE:
+	case HeaderToken::CONTENT_SECURITY_POLICY:
+	case HeaderToken::CONTENT_TYPE:
+	case HeaderToken::CONTENT_DISPOSITION:
+		/* "body" */
+		return HeaderGroup::ALL;
+
+	case HeaderToken::CONTENT_LOCATION:
+	case HeaderToken::LOCATION:
+		/* "link" */
+		return HeaderGroup::LINK;
+
+	case HeaderToken::DATE:
+		/* "exclude" */
+		return HeaderGroup::MAX;
 
-		if (StringIsEqual(name, "location"))
-			/* "link" */
-			return HeaderGroup::LINK;
+	case HeaderToken::DIGEST:
+		return HeaderGroup::ALL;
 
-		break;
+	case HeaderToken::SERVER:
+		/* RFC 2616 3.8: Product Tokens */
+		return HeaderGroup::CAPABILITIES;
 
-	case 'r':
-		if (StringIsEqual(name, "retry-after"))
-			/* "basic" */
-			return HeaderGroup::ALL;
-		break;
+	case HeaderToken::SET_COOKIE:
+	case HeaderToken::SET_COOKIE2:
+		return HeaderGroup::COOKIE;
 
-	case 's':
-		if (is_upgrade && StringStartsWith(name, "sec-websocket-"))
+	case HeaderToken::UPGRADE:
+		if (is_upgrade)
 			/* "upgrade" */
 			return HeaderGroup::ALL;
-
-		if (StringIsEqual(name, "server"))
-			/* RFC 2616 3.8: Product Tokens */
-			return HeaderGroup::CAPABILITIES;
-
-		if (StringIsEqual(name, "set-cookie") ||
-		    StringIsEqual(name, "set-cookie2"))
-			return HeaderGroup::COOKIE;
-
 		break;
 
-	case 'u':
-		if (is_upgrade && StringIsEqual(name, "upgrade"))
-			/* "upgrade" */
-			return HeaderGroup::ALL;
-		break;
+	case HeaderToken::VIA:
+		/* TODO: use HeaderGroup::IDENTITY */
+		return HeaderGroup::MAX;
 
-	case 'v':
-		if (StringIsEqual(name, "vary"))
-			/* "basic" */
-			return HeaderGroup::ALL;
+	case HeaderToken::X_CM4ALL_BENG_PEER_SUBJECT:
+	case HeaderToken::X_CM4ALL_BENG_PEER_ISSUER_SUBJECT:
+		/* note: HeaderGroup::SSL doesn't exist for response
+		   headers */
+		return HeaderGroup::OTHER;
 
-		if (StringIsEqual(name, "via"))
-			/* TODO: use HeaderGroup::IDENTITY */
-			return HeaderGroup::MAX;
+	case HeaderToken::X_CM4ALL_HTTPS:
+		return HeaderGroup::SSL;
 
-		break;
+	case HeaderToken::X_CM4ALL_GENERATOR:
+		return HeaderGroup::IDENTITY;
 
-	case 'w':
-		if (StringIsEqual(name, "www-authenticate"))
-			return HeaderGroup::AUTH;
+	case HeaderToken::X_CM4ALL_VIEW:
+		return HeaderGroup::TRANSFORMATION;
 
-		break;
+	case HeaderToken::X_CONTENT_TYPE_OPTIONS:
+		// https://developer.mozilla.org/en-US/docs/Web/HTTP/Headers/X-Content-Type-Options
+		return HeaderGroup::ALL;
 
-	case 'x':
-		if (auto c4 = StringAfterPrefix(name, "x-cm4all-")) {
-			if (auto b = StringAfterPrefix(c4, "beng-")) {
-				return StringIsEqual(b, "peer-subject") ||
-					StringIsEqual(b, "peer-issuer-subject")
-					/* note: HeaderGroup::SSL doesn't exist for response
-					   headers */
-					? HeaderGroup::OTHER
-					: HeaderGroup::SECURE;
-			} else if (StringIsEqual(c4, "https"))
-				return HeaderGroup::SSL;
-			else if (StringIsEqual(c4, "generator"))
-				return HeaderGroup::IDENTITY;
-			else if (StringIsEqual(c4, "view"))
-				return HeaderGroup::TRANSFORMATION;
-		} else if (StringIsEqual(name, "x-content-type-options"))
-			// https://developer.mozilla.org/en-US/docs/Web/HTTP/Headers/X-Content-Type-Options
-			return HeaderGroup::ALL;
-		else if (StringIsEqual(name, "x-frame-options"))
-			// https://developer.mozilla.org/en-US/docs/Web/HTTP/Headers/X-Frame-Options
-			return HeaderGroup::ALL;
+	case HeaderToken::X_FRAME_OPTIONS:
+		// https://developer.mozilla.org/en-US/docs/Web/HTTP/Headers/X-Frame-Options
+		return HeaderGroup::ALL;
 
+	default:
 		break;
 	}
 
-	if (http_header_is_hop_by_hop(name))
-		return HeaderGroup::MAX;
-
-	return HeaderGroup::OTHER;
+	return ClassifyOtherHeader(name, is_upgrade);
 }
 
 StringMap
@@ -541,7 +482,9 @@ forward_response_headers(AllocatorPtr alloc, HttpStatus status,
 		const char *const key = i.key;
 		const char *value = i.value;
 
-		const auto group = ClassifyResponseHeader(key, is_upgrade);
+		const auto group = ClassifyResponseHeader(key,
+							  LookupHeaderToken(key),
+							  is_upgrade);
 		if (group == HeaderGroup::ALL) {
 			dest.Add(alloc, key, value);
 			continue;
@@ -314,7 +314,7 @@ BpInstance::OnAvahiError(std::exception_ptr e) noexcept
 void
 BpInstance::SaveSessions() noexcept
 {
-	session_save(*session_manager);
+	session_save_background(event_loop, *session_manager);
 
 	ScheduleSaveSessions();
 }
@@ -19,6 +19,7 @@
 #include "event/SignalEvent.hxx"
 #include "event/ShutdownListener.hxx"
 #include "event/FarTimerEvent.hxx"
+#include "event/InotifyManager.hxx"
 #include "spawn/ZombieReaper.hxx"
 #include "event/net/control/Handler.hxx"
 #include "net/FailureManager.hxx"
@@ -168,6 +169,14 @@ struct BpInstance final : PInstance, BengControl::Handler,
 	std::unique_ptr<TranslationStockBuilder> translation_clients;
 	std::shared_ptr<MultiTranslationService> uncached_translation_service;
 
+	/**
+	 * The inotify instance for "translate_cache_inotify".  This
+	 * must not be shared with #fd_cache, because both use
+	 * IN_MASK_CREATE, which fails if the same inotify instance
+	 * already watches the inode.
+	 */
+	InotifyManager translation_inotify_manager{event_loop};
+
 	std::unique_ptr<TranslationCacheBuilder> translation_caches;
 	std::shared_ptr<MultiTranslationService> cached_translation_service;
 
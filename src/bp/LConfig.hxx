@@ -31,6 +31,12 @@ struct BpListenerConfig : SocketConfig {
 
 	SslConfig ssl_config;
 
+	/**
+	 * The upper limit for the HTTP/2 flow control window which
+	 * is chosen automatically for request bodies.
+	 */
+	std::size_t http2_max_window = 16 * 1024 * 1024;
+
 	enum class Handler {
 		TRANSLATION,
 		PROMETHEUS_EXPORTER,
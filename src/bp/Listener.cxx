@@ -74,6 +74,7 @@ BpListener::BpListener(BpInstance &_instance,
 	 tag(config.tag.empty() ? nullptr : config.tag.c_str()),
 	 auth_alt_host(config.auth_alt_host),
 	 access_logger_only_errors(config.access_logger_only_errors),
+	 http2_max_window(config.http2_max_window),
 	 listener(instance.root_pool, instance.event_loop,
 		  MakeSslFactory(config),
 #ifdef HAVE_URING
@@ -43,6 +43,8 @@ class BpListener final : FilteredSocketListenerHandler {
 
 	const bool access_logger_only_errors;
 
+	const std::size_t http2_max_window;
+
 	FilteredSocketListener listener;
 
 #ifdef HAVE_AVAHI
@@ -111,6 +113,10 @@ public:
 		return access_logger_only_errors;
 	}
 
+	std::size_t GetHttp2MaxWindow() const noexcept {
+		return http2_max_window;
+	}
+
 	TranslationService &GetTranslationService() const noexcept {
 		return *translation_service;
 	}
@@ -126,6 +126,13 @@ void
 BpInstance::ShutdownCallback() noexcept
 {
 	event_loop.SetVolatile();
+
+	if (translation_caches)
+		/* this releases all inotify watches (see
+		   "translate_cache_inotify") */
+		translation_caches->Flush();
+
+	translation_inotify_manager.BeginShutdown();
 	fd_cache.BeginShutdown();
 	file_cache.BeginShutdown();
 
@@ -403,7 +410,10 @@ try {
 		instance.translation_caches =
 			std::make_unique<TranslationCacheBuilder>(*instance.translation_clients,
 								  instance.root_pool,
-								  instance.config.translate_cache_size);
+								  instance.config.translate_cache_size,
+								  instance.config.translate_cache_inotify
+								  ? &instance.translation_inotify_manager
+								  : nullptr);
 		instance.cached_translation_service =
 			std::make_unique<MultiTranslationService>();
 	}
@@ -521,7 +531,12 @@ try {
 						     instance.config.http_cache_size,
 						     instance.config.http_cache_obey_no_cache,
 						     instance.event_loop,
-						     *instance.direct_resource_loader);
+						     *instance.direct_resource_loader,
+						     instance.config.http_cache_disk_path.empty()
+						     ? nullptr
+						     : instance.config.http_cache_disk_path.c_str(),
+						     instance.config.http_cache_disk_size,
+						     instance.config.cache_policy);
 
 		instance.cached_resource_loader =
 			new CachedResourceLoader(*instance.http_cache);
@@ -534,7 +549,8 @@ try {
 		instance.filter_cache = filter_cache_new(instance.root_pool,
 							 instance.config.filter_cache_size,
 							 instance.event_loop,
-							 *instance.direct_resource_loader);
+							 *instance.direct_resource_loader,
+							 instance.config.cache_policy);
 		instance.filter_resource_loader =
 			new FilterResourceLoader(*instance.filter_cache);
 	} else
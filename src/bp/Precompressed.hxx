@@ -14,12 +14,20 @@ struct Request::Handler::File::Precompressed {
 
 	std::string_view encoding;
 
+	/**
+	 * The #FileMetadata flag to be set if the sibling currently
+	 * being probed does not exist.
+	 */
+	bool *no_sibling = nullptr;
+
 	SharedLease original_lease;
 
 	const struct statx original_st;
 
 	FileDescriptor original_fd;
 
+	FileMetadata &original_metadata;
+
 	enum Stat {
 #ifdef HAVE_BROTLI
 		AUTO_BROTLI,
@@ -29,6 +37,8 @@ struct Request::Handler::File::Precompressed {
 		END
 	} state{};
 
-	Precompressed(FileDescriptor _fd, const struct statx &_st, SharedLease &&_lease) noexcept
-		:original_lease(std::move(_lease)), original_st(_st), original_fd(_fd) {}
+	Precompressed(FileDescriptor _fd, const struct statx &_st,
+		      FileMetadata &_metadata, SharedLease &&_lease) noexcept
+		:original_lease(std::move(_lease)), original_st(_st), original_fd(_fd),
+		 original_metadata(_metadata) {}
 };
@@ -32,6 +32,7 @@
 #include <sys/stat.h> // for struct statx
 
 struct FileAt;
+struct FileMetadata;
 class Istream;
 class HttpHeaders;
 class GrowingBuffer;
@@ -283,6 +284,13 @@ private:
 			 */
 			struct statx stx;
 
+			/**
+			 * If #fd is defined, then this is its
+			 * #FileMetadata (owned by #FdCache, valid as
+			 * long as #fd_lease is held).
+			 */
+			FileMetadata *metadata = nullptr;
+
 			/**
 			 * The absolute path of #base, remembered for
 			 * StripBase().
@@ -594,22 +602,32 @@ private:
 	bool CheckDirectoryPath(std::string_view path) noexcept;
 
 	bool EvaluateFileRequest(FileDescriptor fd, const struct statx &st,
+				 FileMetadata *metadata,
 				 struct file_request &file_request) noexcept;
 
 	void DispatchFile(const char *path, FileDescriptor fd,
-			  const struct statx &st, SharedLease &&lease,
+			  const struct statx &st, FileMetadata *metadata,
+			  SharedLease &&lease,
 			  const struct file_request &file_request) noexcept;
 
 	bool DispatchCompressedFile(const char *path, FileDescriptor fd,
 				    const struct statx &st,
+				    FileMetadata *metadata,
 				    std::string_view encoding,
-				    UniqueFileDescriptor compressed_fd,
-				    off_t compressed_size) noexcept;
+				    FileDescriptor compressed_fd,
+				    off_t compressed_size,
+				    SharedLease &&compressed_lease) noexcept;
 
 	bool CheckCompressedFile(const char *path, std::string_view encoding) noexcept;
 
+	/**
+	 * @param no_sibling a #FileMetadata flag which says that
+	 * this sibling is known not to exist; it will be set if the
+	 * lookup fails with ENOENT
+	 */
 	bool CheckAutoCompressedFile(const char *path, std::string_view encoding,
-				     std::string_view suffix) noexcept;
+				     std::string_view suffix,
+				     bool &no_sibling) noexcept;
 
 	bool EmulateModAuthEasy(const FileAddress &address,
 				FileDescriptor fd,
@@ -626,9 +644,12 @@ private:
 	void HandleFileAddress(const FileAddress &address,
 			       FileDescriptor fd,
 			       const struct statx &st,
+			       FileMetadata &metadata,
 			       SharedLease &&lease) noexcept;
 
-	void OnStatOpenStatSuccess(FileDescriptor fd, const struct statx &st, SharedLease &&lease) noexcept;
+	void OnStatOpenStatSuccess(FileDescriptor fd, const struct statx &st,
+				   FileMetadata &metadata,
+				   SharedLease &&lease) noexcept;
 	void OnStatOpenStatError(int error) noexcept;
 	void StatFileAddressAfterBase(FileDescriptor base, std::string_view strip_base) noexcept;
 	void StatFileAddress(const FileAddress &address,
@@ -996,12 +1017,14 @@ private:
 	 */
 	void ApplyFileEnotdir() noexcept;
 
-	void OnBaseOpen(FileDescriptor fd, const struct statx &stx, SharedLease &&_lease) noexcept;
+	void OnBaseOpen(FileDescriptor fd, const struct statx &stx,
+			FileMetadata &metadata, SharedLease &&_lease) noexcept;
 	void OnBaseOpenError(int error) noexcept {
 		LogDispatchErrno(error, "Failed to open file");
 	}
 
-	void OnBeneathOpen(FileDescriptor fd, const struct statx &stx, SharedLease &&_lease) noexcept;
+	void OnBeneathOpen(FileDescriptor fd, const struct statx &stx,
+			   FileMetadata &metadata, SharedLease &&_lease) noexcept;
 
 	void OpenBeneath(const FileAddress &address,
 			 Handler::File::OpenBaseCallback callback) noexcept;
@@ -1027,11 +1050,17 @@ private:
 	[[gnu::pure]]
 	const char *StripBase(const char *path) const noexcept;
 
-	void ProbePrecompressed(FileDescriptor fd, const struct statx &st, SharedLease &&lease) noexcept;
+	void ProbePrecompressed(FileDescriptor fd, const struct statx &st,
+				FileMetadata &metadata,
+				SharedLease &&lease) noexcept;
 	void ProbeNextPrecompressed() noexcept;
 	void OnPrecompressedOpenStat(UniqueFileDescriptor fd,
 				     struct statx &st) noexcept;
 	void OnPrecompressedOpenStatError(int error) noexcept;
+	void OnPrecompressedSibling(FileDescriptor fd, const struct statx &st,
+				    FileMetadata &metadata,
+				    SharedLease &&lease) noexcept;
+	void OnPrecompressedSiblingError(int error) noexcept;
 
 	/* virtual methods from class Cancellable */
 	void Cancel() noexcept override {
@@ -1056,8 +1085,9 @@ private:
 			    UnusedIstreamPtr body) noexcept override;
 	void OnHttpError(std::exception_ptr ep) noexcept override;
 
-	/* handler methods for UringOpenStat() */
-	void OnOpenStat(FileDescriptor fd, const struct statx &stx, SharedLease &&_lease) noexcept;
+	/* handler methods for FdCache::Get() */
+	void OnOpenStat(FileDescriptor fd, const struct statx &stx,
+			FileMetadata &metadata, SharedLease &&_lease) noexcept;
 	void OnOpenStatError(int error) noexcept;
 
 	/* virtual methods from class SuffixRegistryHandler */
@@ -172,6 +172,13 @@ IsShorterThan(const UnusedIstreamPtr &i, off_t length) noexcept
 	return available >= 0 && available < length;
 }
 
+/**
+ * Responses shorter than this are compressed with gzip in the main
+ * thread, because offloading them to a worker thread would cost
+ * more than it saves.
+ */
+static constexpr off_t THREAD_GZIP_THRESHOLD = 64 * 1024;
+
 static bool
 MaybeAutoCompress(EncodingCache *cache, AllocatorPtr alloc,
 		  const StringMap &request_headers,
@@ -210,7 +217,10 @@ Request::ApplyAutoCompress(HttpHeaders &response_headers,
 				      return NewBrotliEncoderIstream(pool,
 								     thread_pool_get_queue(instance.event_loop),
 								     std::move(i),
-								     {.text_mode = IsTextMimeType(response_headers)});
+								     {
+									     .quality = instance.config.brotli_quality,
+									     .text_mode = IsTextMimeType(response_headers),
+								     });
 			      }))
 		return;
 #endif
@@ -221,7 +231,22 @@ Request::ApplyAutoCompress(HttpHeaders &response_headers,
 				  resource_tag,
 				  response_headers, response_body, "gzip"sv,
 				  [this](auto &&i){
-					  return NewGzipIstream(pool, std::move(i));
+					  const GzipParams params{
+						  .level = instance.config.gzip_level,
+					  };
+
+					  /* small responses are compressed
+					     right here; for large ones (or
+					     unknown length), deflate() is
+					     moved to a worker thread so it
+					     doesn't block the event loop */
+					  if (IsShorterThan(i, THREAD_GZIP_THRESHOLD))
+						  return NewGzipIstream(pool, std::move(i),
+									params);
+
+					  return NewThreadGzipIstream(pool,
+								      thread_pool_get_queue(instance.event_loop),
+								      std::move(i), params);
 				  });
 }
 
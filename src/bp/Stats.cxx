@@ -33,6 +33,8 @@ BpInstance::GetStats() const noexcept
 		stats.incoming_connections += i.GetConnectionCount();
 
 	stats.outgoing_connections = tcp_stock_stats.busy + tcp_stock_stats.idle;
+	stats.idle_outgoing_connections = tcp_stock_stats.idle;
+	stats.prewarmed_connections = fs_stock->GetPrewarmCount();
 	stats.sessions = session_manager->Count();
 	stats.http_requests = http_stats.n_requests;
 	stats.http_traffic_received = http_stats.traffic_received;
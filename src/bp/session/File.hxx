@@ -8,6 +8,9 @@
 
 #pragma once
 
+#include "Id.hxx"
+#include "time/Expiry.hxx"
+
 #include <stdint.h>
 
 static constexpr uint32_t MAGIC_FILE = 2461362039;
@@ -18,3 +21,39 @@ static constexpr uint32_t MAGIC_WIDGET_SESSION = 983957472;
 static constexpr uint32_t MAGIC_COOKIE = 860919820;
 static constexpr uint32_t MAGIC_END_OF_RECORD = 1588449078;
 static constexpr uint32_t MAGIC_END_OF_LIST = 1556616445;
+
+/**
+ * The "snapshot" file format (since version 19.16) which allows
+ * skipping session records without parsing them, so sessions can be
+ * loaded lazily from a memory-mapped file.  The file begins with
+ * #MAGIC_SNAPSHOT and #SNAPSHOT_VERSION, followed by a list of
+ * records, each beginning with a #SessionRecordHeader, and is
+ * terminated with #MAGIC_END_OF_LIST.
+ */
+static constexpr uint32_t MAGIC_SNAPSHOT = 2461362040;
+static constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+struct SessionRecordHeader {
+	/**
+	 * #MAGIC_SESSION or #MAGIC_END_OF_LIST.
+	 */
+	uint32_t magic;
+
+	/**
+	 * The size of the payload following this header.
+	 */
+	uint32_t payload_size;
+
+	SessionId id;
+	Expiry expires;
+	uint32_t counter;
+	uint8_t cookie_received;
+
+	/**
+	 * Does the session have a user in any realm?  This allows
+	 * calculating the purge score without parsing the payload.
+	 */
+	uint8_t has_user;
+
+	uint8_t reserved[2];
+};
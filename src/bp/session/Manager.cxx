@@ -4,6 +4,8 @@
 
 #include "Manager.hxx"
 #include "Lease.hxx"
+#include "Read.hxx"
+#include "Snapshot.hxx"
 #include "io/Logger.hxx"
 #include "system/Seed.hxx"
 #include "util/DeleteDisposer.hxx"
@@ -46,18 +48,80 @@ SessionManager::EraseAndDispose(Session &session)
 {
 	assert(!sessions.empty());
 
+	if (session.pending_payload.data() != nullptr)
+		OnPendingDone(session);
+
 	auto i = sessions.iterator_to(session);
 	sessions.erase_and_dispose(i, DeleteDisposer{});
 }
 
+void
+SessionManager::OnPendingDone(Session &session) noexcept
+{
+	assert(session.pending_payload.data() != nullptr);
+	assert(n_pending > 0);
+	assert(snapshot);
+
+	session.pending_payload = {};
+
+	if (--n_pending == 0) {
+		/* all sessions have been materialized; the file
+		   mapping is no longer needed */
+		snapshot.reset();
+
+		LogConcat(5, "SessionManager", "session snapshot released");
+	}
+}
+
+void
+SessionManager::DoMaterialize(Session &session) noexcept
+{
+	assert(session.pending_payload.data() != nullptr);
+
+	try {
+		session_read_payload(session.pending_payload, session);
+	} catch (SessionDeserializerError) {
+		LogConcat(2, "SessionManager", "Session record is corrupt");
+	}
+
+	OnPendingDone(session);
+}
+
+inline void
+SessionManager::Expire(ExpiryList &list, const Expiry now) noexcept
+{
+	while (!list.empty() && list.front().expires.IsExpired(now))
+		EraseAndDispose(list.front());
+}
+
+void
+SessionManager::MoveToIdle(Session &session) noexcept
+{
+	if (session.expiry_hook.is_linked())
+		session.expiry_hook.unlink();
+
+	/* find the last session which expires no later than this
+	   one; usually, that is the last one */
+	auto i = idle_sessions.end();
+	while (i != idle_sessions.begin()) {
+		auto previous = i;
+		--previous;
+		if (!(previous->expires > session.expires))
+			break;
+
+		i = previous;
+	}
+
+	idle_sessions.insert(i, session);
+}
+
 void
 SessionManager::Cleanup() noexcept
 {
 	const Expiry now = Expiry::Now();
 
-	sessions.remove_and_dispose_if([now](const Session &session){
-		return session.expires.IsExpired(now);
-	}, DeleteDisposer{});
+	Expire(new_sessions, now);
+	Expire(idle_sessions, now);
 
 	if (!sessions.empty())
 		cleanup_timer.Schedule(cleanup_interval);
@@ -106,9 +170,8 @@ void
 SessionManager::Insert(Session &session) noexcept
 {
 	sessions.insert(session);
-
-	if (!cleanup_timer.IsPending())
-		cleanup_timer.Schedule(cleanup_interval);
+	MoveToIdle(session);
+	ScheduleCleanup();
 }
 
 bool
@@ -119,6 +182,9 @@ SessionManager::Purge() noexcept
 	unsigned highest_score = 0;
 
 	sessions.for_each([&purge_sessions, &highest_score](Session &session) {
+		/* this does not materialize the session;
+		   GetPurgeScore() uses the flags from the snapshot
+		   record header instead */
 		unsigned score = session.GetPurgeScore();
 		if (score > highest_score) {
 			purge_sessions.clear();
@@ -169,7 +235,9 @@ SessionManager::CreateSession() noexcept
 	csrf_salt.Generate(prng);
 
 	Session *session = new Session(GenerateSessionId(), csrf_salt);
-	Insert(*session);
+	sessions.insert(*session);
+	new_sessions.push_back(*session);
+	ScheduleCleanup();
 	return {*this, session};
 }
 
@@ -184,12 +252,24 @@ SessionManager::Find(SessionId id) noexcept
 		return nullptr;
 
 	Session &session = *i;
+	Materialize(session);
 
 	session.expires.Touch(idle_timeout);
+	MoveToIdle(session);
 	++session.counter;
 	return {*this, &session};
 }
 
+const Session *
+SessionManager::Peek(SessionId id) noexcept
+{
+	auto i = sessions.find(id);
+	if (i == sessions.end())
+		return nullptr;
+
+	return &*i;
+}
+
 RealmSessionLease
 SessionManager::Attach(RealmSessionLease lease, std::string_view realm,
 		       std::span<const std::byte> attach) noexcept
@@ -229,6 +309,7 @@ SessionManager::Attach(RealmSessionLease lease, std::string_view realm,
 		/* exists already */
 
 		auto &existing = *it;
+		Materialize(existing);
 
 		if (lease) {
 			auto &src = lease->parent;
@@ -239,6 +320,10 @@ SessionManager::Attach(RealmSessionLease lease, std::string_view realm,
 			existing.Attach(std::move(src));
 
 			EraseAndDispose(src);
+
+			/* the expiry may have been modified by
+			   Session::Attach() */
+			MoveToIdle(existing);
 		}
 
 		return {SessionLease{*this, &existing}, realm};
@@ -266,6 +351,8 @@ SessionManager::DiscardRealmSession(SessionId id, std::string_view realm_name) n
 	if (i == sessions.end())
 		return;
 
+	Materialize(*i);
+
 	if (!i->DiscardRealm(realm_name))
 		return;
 
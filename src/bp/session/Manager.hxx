@@ -8,17 +8,24 @@
 #include "Prng.hxx"
 #include "event/FarTimerEvent.hxx"
 #include "util/IntrusiveHashSet.hxx"
+#include "util/IntrusiveList.hxx"
 
 #include <chrono>
+#include <memory>
 #include <random>
 
 class SessionId;
 class SessionLease;
 class RealmSessionLease;
+class SessionSnapshot;
 class BufferedReader;
 
 class SessionManager {
-	/** clean up expired sessions every 60 seconds */
+	/**
+	 * Clean up expired sessions every 60 seconds.  This only
+	 * visits sessions which have actually expired, because the
+	 * expiry lists are ordered.
+	 */
 	static constexpr Event::Duration cleanup_interval = std::chrono::minutes(1);
 
 	const unsigned cluster_size, cluster_node;
@@ -57,6 +64,11 @@ class SessionManager {
 		bool operator()(std::span<const std::byte> a, std::span<const std::byte> b) const noexcept;
 	};
 
+	/**
+	 * The number of hash buckets.  This equals the maximum number
+	 * of sessions (see CreateSession()), so the average chain
+	 * length never exceeds 1.
+	 */
 	static constexpr unsigned N_BUCKETS = 65536;
 
 	using Set = IntrusiveHashSet<
@@ -81,8 +93,40 @@ class SessionManager {
 
 	ByAttach sessions_by_attach;
 
+	using ExpiryList =
+		IntrusiveList<Session,
+			      IntrusiveListMemberHookTraits<&Session::expiry_hook>>;
+
+	/**
+	 * Sessions which have never been used after their creation,
+	 * oldest first.  They all have the same (short) time to live,
+	 * so this list is ordered by Session::expires.
+	 */
+	ExpiryList new_sessions;
+
+	/**
+	 * Sessions which have been used at least once (or loaded from
+	 * a file), least recently used first.  They all have the
+	 * same #idle_timeout, so this list is ordered by
+	 * Session::expires.
+	 */
+	ExpiryList idle_sessions;
+
 	FarTimerEvent cleanup_timer;
 
+	/**
+	 * The snapshot file the sessions were loaded from.  It is
+	 * kept mapped until all sessions have been materialized (or
+	 * deleted).
+	 */
+	std::unique_ptr<SessionSnapshot> snapshot;
+
+	/**
+	 * The number of sessions which have a pending payload inside
+	 * #snapshot.
+	 */
+	unsigned n_pending = 0;
+
 public:
 	SessionManager(EventLoop &event_loop, std::chrono::seconds idle_timeout,
 		       unsigned _cluster_size, unsigned _cluster_node) noexcept;
@@ -124,6 +168,13 @@ public:
 	[[gnu::pure]]
 	SessionLease Find(SessionId id) noexcept;
 
+	/**
+	 * Look up a session without touching or materializing it.
+	 * This is meant for saving sessions.
+	 */
+	[[gnu::pure]]
+	const Session *Peek(SessionId id) noexcept;
+
 	/**
 	 * Attach the given session to an existing session with the
 	 * given #attach value.  If no such session exists already,
@@ -146,6 +197,9 @@ public:
 	 * expires.  After returning from this function, the session is
 	 * protected and the pointer must not be used, unless it is looked
 	 * up (and thus locked).
+	 *
+	 * This is meant for sessions loaded from a file; they are
+	 * inserted into #idle_sessions according to their expiry.
 	 */
 	void Insert(Session &session) noexcept;
 
@@ -164,11 +218,60 @@ public:
 
 	void DiscardAttachSession(std::span<const std::byte> attach) noexcept;
 
+	/**
+	 * Load sessions from a file in the legacy format.
+	 */
 	bool Load(BufferedReader &r);
 
+	/**
+	 * Load sessions from a snapshot file.  This only parses the
+	 * record headers; the payloads are parsed lazily by
+	 * Materialize().
+	 *
+	 * @return false if the file is corrupt (but the sessions
+	 * before the corruption have been loaded)
+	 */
+	bool LoadSnapshot(std::unique_ptr<SessionSnapshot> &&_snapshot) noexcept;
+
 private:
 	void SeedPrng();
 
 	SessionId GenerateSessionId() noexcept;
 	void EraseAndDispose(Session &session);
+
+	/**
+	 * Remove all expired sessions from the front of the given
+	 * list.
+	 */
+	void Expire(ExpiryList &list, Expiry now) noexcept;
+
+	/**
+	 * Move the session to the position in #idle_sessions
+	 * according to its (modified) expiry.  Since most sessions
+	 * are moved to the end, the list is searched backwards.
+	 */
+	void MoveToIdle(Session &session) noexcept;
+
+	/**
+	 * Parse the pending payload of a session loaded by
+	 * LoadSnapshot().  This must be called before anybody gets
+	 * to see the session's attributes.
+	 */
+	void Materialize(Session &session) noexcept {
+		if (session.pending_payload.data() != nullptr)
+			DoMaterialize(session);
+	}
+
+	void DoMaterialize(Session &session) noexcept;
+
+	/**
+	 * Called after a session's pending payload has been
+	 * consumed or discarded.
+	 */
+	void OnPendingDone(Session &session) noexcept;
+
+	void ScheduleCleanup() noexcept {
+		if (!cleanup_timer.IsPending())
+			cleanup_timer.Schedule(cleanup_interval);
+	}
 };
@@ -7,16 +7,39 @@
 #include "Session.hxx"
 #include "io/BufferedReader.hxx"
 
+#include <algorithm> // for std::copy_n()
+
 namespace {
 
 class FileReader {
-	BufferedReader &r;
+	BufferedReader *const r;
+
+	/**
+	 * The source buffer if #r is nullptr.
+	 */
+	std::span<const std::byte> src;
 
 public:
-	explicit FileReader(BufferedReader &_r) noexcept:r(_r) {}
+	explicit FileReader(BufferedReader &_r) noexcept:r(&_r) {}
+
+	explicit FileReader(std::span<const std::byte> _src) noexcept
+		:r(nullptr), src(_src) {}
+
+	bool IsEmpty() const noexcept {
+		return r == nullptr && src.empty();
+	}
 
 	void ReadBuffer(void *buffer, size_t size) {
-		r.ReadFull({static_cast<std::byte *>(buffer), size});
+		if (r != nullptr) {
+			r->ReadFull({static_cast<std::byte *>(buffer), size});
+			return;
+		}
+
+		if (src.size() < size)
+			throw SessionDeserializerError();
+
+		std::copy_n(src.begin(), size, static_cast<std::byte *>(buffer));
+		src = src.subspan(size);
 	}
 
 	template<typename T>
@@ -199,11 +222,8 @@ ReadRealmSession(FileReader &file, uint32_t magic, Session &parent)
 }
 
 static void
-DoReadSession(FileReader &file, Session &session)
+DoReadSessionPayload(FileReader &file, Session &session)
 {
-	file.Read(session.expires);
-	file.ReadT(session.counter);
-	session.cookie_received = file.ReadBool();
 	session.translate = file.ReadArray();
 	session.language = file.ReadString();
 
@@ -221,6 +241,15 @@ DoReadSession(FileReader &file, Session &session)
 	Expect32(file, MAGIC_END_OF_RECORD);
 }
 
+static void
+DoReadSession(FileReader &file, Session &session)
+{
+	file.Read(session.expires);
+	file.ReadT(session.counter);
+	session.cookie_received = file.ReadBool();
+	DoReadSessionPayload(file, session);
+}
+
 std::unique_ptr<Session>
 session_read(BufferedReader &r, SessionPrng &prng)
 {
@@ -235,3 +264,13 @@ session_read(BufferedReader &r, SessionPrng &prng)
 	DoReadSession(file, *session);
 	return session;
 }
+
+void
+session_read_payload(std::span<const std::byte> src, Session &session)
+{
+	FileReader file(src);
+	DoReadSessionPayload(file, session);
+
+	if (!file.IsEmpty())
+		throw SessionDeserializerError();
+}
@@ -10,7 +10,9 @@
 
 #include "Prng.hxx"
 
+#include <cstddef>
 #include <memory>
+#include <span>
 
 #include <stdint.h>
 
@@ -36,3 +38,12 @@ session_read_file_header(BufferedReader &r);
  */
 std::unique_ptr<Session>
 session_read(BufferedReader &r, SessionPrng &prng);
+
+/**
+ * Parse the payload of a snapshot record (see #SessionRecordHeader)
+ * into the given (empty) #Session.
+ *
+ * Throws on error.
+ */
+void
+session_read_payload(std::span<const std::byte> src, Session &session);
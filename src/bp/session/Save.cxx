@@ -8,31 +8,39 @@
 #include "File.hxx"
 #include "Manager.hxx"
 #include "Session.hxx"
+#include "Snapshot.hxx"
+#include "event/DeferEvent.hxx"
 #include "io/BufferedOutputStream.hxx"
 #include "io/BufferedReader.hxx"
 #include "io/FdReader.hxx"
 #include "io/FdOutputStream.hxx"
 #include "io/FileWriter.hxx"
 #include "io/Logger.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+
+#include <algorithm> // for std::stable_sort()
+#include <cstring> // for std::memcpy()
+#include <memory>
+#include <vector>
 
 #include <assert.h>
 
 static const char *session_save_path;
 
 static void
-session_save_callback(const Session *session, void *ctx)
+InsertSorted(SessionManager &manager,
+	     std::vector<std::unique_ptr<Session>> &loaded) noexcept
 {
-	auto &file = *(BufferedOutputStream *)ctx;
-	session_write_magic(file, MAGIC_SESSION);
-	session_write(file, session);
-}
+	/* sort the sessions by their expiry, so Insert() can append
+	   each one to the end of the expiry list instead of
+	   searching for its position */
+	std::stable_sort(loaded.begin(), loaded.end(),
+			 [](const auto &a, const auto &b){
+				 return b->expires > a->expires;
+			 });
 
-static void
-session_manager_save(SessionManager &manager, BufferedOutputStream &file)
-{
-	session_write_file_header(file);
-	manager.Visit(session_save_callback, &file);
-	session_write_file_tail(file);
+	for (auto &session : loaded)
+		manager.Insert(*session.release());
 }
 
 inline bool
@@ -42,13 +50,18 @@ SessionManager::Load(BufferedReader &r)
 
 	const Expiry now = Expiry::Now();
 
-	unsigned num_added = 0, num_expired = 0;
+	std::vector<std::unique_ptr<Session>> loaded;
+
+	bool success = true;
+	unsigned num_expired = 0;
 	while (true) {
 		uint32_t magic = session_read_magic(r);
 		if (magic == MAGIC_END_OF_LIST)
 			break;
-		else if (magic != MAGIC_SESSION)
-			return false;
+		else if (magic != MAGIC_SESSION) {
+			success = false;
+			break;
+		}
 
 		auto session = session_read(r, prng);
 		assert(session);
@@ -60,19 +73,240 @@ SessionManager::Load(BufferedReader &r)
 			continue;
 		}
 
-		Insert(*session.release());
-		++num_added;
+		loaded.emplace_back(std::move(session));
 	}
 
+	const std::size_t num_added = loaded.size();
+	InsertSorted(*this, loaded);
+
 	LogConcat(4, "SessionManager",
 		  "loaded ", num_added, " sessions, discarded ",
 		  num_expired, " expired sessions");
-	return true;
+	return success;
+}
+
+template<typename T>
+static T
+ConsumeT(std::span<const std::byte> &src) noexcept
+{
+	assert(src.size() >= sizeof(T));
+
+	T value;
+	std::memcpy(&value, src.data(), sizeof(value));
+	src = src.subspan(sizeof(value));
+	return value;
+}
+
+bool
+SessionManager::LoadSnapshot(std::unique_ptr<SessionSnapshot> &&_snapshot) noexcept
+{
+	assert(!snapshot);
+	assert(n_pending == 0);
+
+	auto src = _snapshot->GetData();
+	if (src.size() < 2 * sizeof(uint32_t) ||
+	    ConsumeT<uint32_t>(src) != MAGIC_SNAPSHOT ||
+	    ConsumeT<uint32_t>(src) != SNAPSHOT_VERSION)
+		return false;
+
+	const Expiry now = Expiry::Now();
+
+	std::vector<std::unique_ptr<Session>> loaded;
+
+	bool success = false;
+	unsigned num_expired = 0;
+	while (src.size() >= sizeof(uint32_t)) {
+		uint32_t magic;
+		std::memcpy(&magic, src.data(), sizeof(magic));
+		if (magic == MAGIC_END_OF_LIST) {
+			success = true;
+			break;
+		}
+
+		if (magic != MAGIC_SESSION ||
+		    src.size() < sizeof(SessionRecordHeader))
+			break;
+
+		const auto header = ConsumeT<SessionRecordHeader>(src);
+		if (src.size() < header.payload_size)
+			break;
+
+		const auto payload = src.first(header.payload_size);
+		src = src.subspan(header.payload_size);
+
+		if (header.expires.IsExpired(now)) {
+			++num_expired;
+			continue;
+		}
+
+		// TODO read salt from session file
+		SessionId csrf_salt;
+		csrf_salt.Generate(prng);
+
+		auto session = std::make_unique<Session>(header.id, csrf_salt);
+		session->expires = header.expires;
+		session->counter = header.counter;
+		session->cookie_received = header.cookie_received != 0;
+		session->pending_payload = payload;
+		session->pending_has_user = header.has_user != 0;
+		loaded.emplace_back(std::move(session));
+	}
+
+	n_pending = loaded.size();
+	if (n_pending > 0)
+		snapshot = std::move(_snapshot);
+
+	InsertSorted(*this, loaded);
+
+	LogConcat(4, "SessionManager",
+		  "loaded ", n_pending, " sessions, discarded ",
+		  num_expired, " expired sessions");
+	return success;
+}
+
+/**
+ * Writes all sessions to a new file in small batches from an idle
+ * callback, so the event loop is never blocked for long.  Sessions
+ * which have not been used since they were loaded from the snapshot
+ * are copied verbatim.
+ */
+class SessionSaver {
+	static constexpr std::size_t BATCH_SIZE = 1024;
+
+	SessionManager &manager;
+
+	DeferEvent defer_event;
+
+	/**
+	 * This writes to a temporary file which replaces the old
+	 * one only after everything has been written; therefore, a
+	 * mapped snapshot of the old file remains valid.
+	 */
+	FileWriter fw;
+	FdOutputStream fos;
+	BufferedOutputStream bos;
+
+	/**
+	 * The ids of the sessions which existed when saving was
+	 * started.  Sessions which were created after that are
+	 * skipped; they will be saved the next time.
+	 */
+	std::vector<SessionId> ids;
+	std::size_t position = 0;
+
+	std::vector<std::byte> buffer;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	SessionSaver(EventLoop &event_loop, SessionManager &_manager,
+		     const char *path)
+		:manager(_manager),
+		 defer_event(event_loop, BIND_THIS_METHOD(OnDeferred)),
+		 fw(path, 0600),
+		 fos(fw.GetFileDescriptor()),
+		 bos(fos)
+	{
+		ids.reserve(manager.Count());
+		manager.Visit([](const Session *session, void *ctx){
+			auto &_ids = *(std::vector<SessionId> *)ctx;
+			_ids.push_back(session->id);
+		}, &ids);
+
+		session_write_file_header(bos);
+	}
+
+	void Start() noexcept {
+		defer_event.ScheduleIdle();
+	}
+
+private:
+	/**
+	 * Throws on error.
+	 *
+	 * @return true if there are more sessions to be written
+	 */
+	bool WriteBatch() {
+		const Expiry now = Expiry::Now();
+
+		const std::size_t end = std::min(position + BATCH_SIZE,
+						 ids.size());
+		for (; position < end; ++position) {
+			const Session *session = manager.Peek(ids[position]);
+			if (session != nullptr &&
+			    !session->expires.IsExpired(now))
+				session_write(bos, *session, buffer);
+		}
+
+		return position < ids.size();
+	}
+
+	/**
+	 * Throws on error.
+	 */
+	void Commit() {
+		session_write_file_tail(bos);
+		bos.Flush();
+		fw.Commit();
+	}
+
+	void OnDeferred() noexcept;
+};
+
+static std::unique_ptr<SessionSaver> session_saver;
+
+void
+SessionSaver::OnDeferred() noexcept
+{
+	try {
+		if (WriteBatch()) {
+			defer_event.ScheduleIdle();
+			return;
+		}
+
+		Commit();
+		LogConcat(5, "SessionManager", "saved ",
+			  (unsigned)ids.size(), " sessions to ",
+			  session_save_path);
+	} catch (...) {
+		LogConcat(2, "SessionManager", "Failed to save sessions",
+			  std::current_exception());
+	}
+
+	/* this deletes "this" */
+	session_saver.reset();
+}
+
+struct SessionSaveContext {
+	BufferedOutputStream &bos;
+	std::vector<std::byte> buffer;
+};
+
+static void
+session_save_callback(const Session *session, void *_ctx)
+{
+	auto &ctx = *(SessionSaveContext *)_ctx;
+	session_write(ctx.bos, *session, ctx.buffer);
+}
+
+static void
+session_manager_save(SessionManager &manager, BufferedOutputStream &file)
+{
+	session_write_file_header(file);
+
+	SessionSaveContext ctx{file, {}};
+	manager.Visit(session_save_callback, &ctx);
+
+	session_write_file_tail(file);
 }
 
 void
 session_save(SessionManager &manager) noexcept
 try {
+	/* a full save supersedes the one running in background */
+	session_saver.reset();
+
 	LogConcat(5, "SessionManager", "saving sessions to ", session_save_path);
 
 	FileWriter fw(session_save_path, 0600);
@@ -89,6 +323,23 @@ try {
 	return;
 }
 
+void
+session_save_background(EventLoop &event_loop, SessionManager &manager) noexcept
+try {
+	if (session_saver)
+		/* still busy */
+		return;
+
+	LogConcat(5, "SessionManager", "saving sessions to ", session_save_path);
+
+	session_saver = std::make_unique<SessionSaver>(event_loop, manager,
+						       session_save_path);
+	session_saver->Start();
+} catch (...) {
+	LogConcat(2, "SessionManager", "Failed to save sessions",
+		  std::current_exception());
+}
+
 void
 session_save_init(SessionManager &manager, const char *path) noexcept
 {
@@ -104,6 +355,20 @@ session_save_init(SessionManager &manager, const char *path) noexcept
 		return;
 
 	try {
+		auto snapshot = std::make_unique<SessionSnapshot>(fd);
+
+		auto data = snapshot->GetData();
+		if (data.size() >= sizeof(uint32_t) &&
+		    ConsumeT<uint32_t>(data) == MAGIC_SNAPSHOT) {
+			if (!manager.LoadSnapshot(std::move(snapshot)))
+				LogConcat(1, "SessionManager",
+					  "Session file is corrupt");
+			return;
+		}
+
+		/* fall back to the legacy format */
+		snapshot.reset();
+
 		FdReader fr(fd);
 		BufferedReader br(fr);
 
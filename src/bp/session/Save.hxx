@@ -8,6 +8,7 @@
 
 #pragma once
 
+class EventLoop;
 class SessionManager;
 
 void
@@ -16,5 +17,17 @@ session_save_init(SessionManager &manager, const char *path) noexcept;
 void
 session_save_deinit(SessionManager &manager) noexcept;
 
+/**
+ * Save all sessions synchronously.
+ */
 void
 session_save(SessionManager &manager) noexcept;
+
+/**
+ * Start saving all sessions in the background, i.e. in small batches
+ * while the event loop is idle.  Does nothing if the previous
+ * background save is still running.
+ */
+void
+session_save_background(EventLoop &event_loop,
+			SessionManager &manager) noexcept;
@@ -72,7 +72,10 @@ Session::GetPurgeScore() const noexcept
 	if (!cookie_received)
 		return 50;
 
-	if (!HasUser())
+	/* sessions which have not yet been materialized use the
+	   flag from the snapshot file; parsing all of them just to
+	   purge some would be expensive */
+	if (pending_payload.data() != nullptr ? !pending_has_user : !HasUser())
 		return 20;
 
 	return 1;
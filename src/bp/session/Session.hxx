@@ -16,9 +16,11 @@
 #include "util/AllocatedArray.hxx"
 #include "util/AllocatedString.hxx"
 #include "util/IntrusiveHashSet.hxx"
+#include "util/IntrusiveList.hxx"
 
 #include <chrono>
 #include <map>
+#include <span>
 #include <string>
 
 struct RealmSession;
@@ -146,6 +148,12 @@ struct Session {
 
 	IntrusiveHashSetHook<IntrusiveHookMode::AUTO_UNLINK> by_attach_hook;
 
+	/**
+	 * For SessionManager's expiry lists, which are ordered by
+	 * #expires.
+	 */
+	IntrusiveListHook<IntrusiveHookMode::AUTO_UNLINK> expiry_hook;
+
 	/** identification number of this session */
 	const SessionId id;
 
@@ -194,6 +202,21 @@ struct Session {
 
 	RealmSessionSet realms;
 
+	/**
+	 * If this session was loaded from a snapshot file, then this
+	 * points to the not-yet-parsed remainder of its record
+	 * (inside the memory-mapped file), and the attributes above
+	 * (beginning with #translate) are still empty.  See
+	 * SessionManager::Materialize().
+	 */
+	std::span<const std::byte> pending_payload;
+
+	/**
+	 * The result of HasUser() from the snapshot record header;
+	 * only valid while #pending_payload is set.
+	 */
+	bool pending_has_user = false;
+
 	Session(SessionId _id, SessionId _csrf_salt) noexcept;
 	~Session() noexcept;
 
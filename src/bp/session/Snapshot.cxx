@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "Snapshot.hxx"
+#include "system/Error.hxx"
+#include "io/FileDescriptor.hxx"
+
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+SessionSnapshot::SessionSnapshot(FileDescriptor fd)
+{
+	struct stat st;
+	if (fstat(fd.Get(), &st) < 0)
+		throw MakeErrno("Failed to stat session file");
+
+	if (!S_ISREG(st.st_mode))
+		throw std::runtime_error("Session file is not a regular file");
+
+	if (st.st_size == 0)
+		/* mmap() fails on empty files */
+		return;
+
+	const std::size_t size = st.st_size;
+	void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.Get(), 0);
+	if (p == MAP_FAILED)
+		throw MakeErrno("Failed to map session file");
+
+	data = {static_cast<const std::byte *>(p), size};
+}
+
+SessionSnapshot::~SessionSnapshot() noexcept
+{
+	if (data.data() != nullptr)
+		munmap(const_cast<std::byte *>(data.data()), data.size());
+}
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+/*
+ * Memory-mapped session snapshot files.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+class FileDescriptor;
+
+/**
+ * A read-only mapping of a session snapshot file.  Unlike reading
+ * the file with read(), this does not copy the session payloads into
+ * private memory; pages are faulted in only when a session is
+ * actually used.
+ */
+class SessionSnapshot {
+	std::span<const std::byte> data;
+
+public:
+	/**
+	 * Map the whole file.
+	 *
+	 * Throws on error.
+	 */
+	explicit SessionSnapshot(FileDescriptor fd);
+
+	~SessionSnapshot() noexcept;
+
+	SessionSnapshot(const SessionSnapshot &) = delete;
+	SessionSnapshot &operator=(const SessionSnapshot &) = delete;
+
+	std::span<const std::byte> GetData() const noexcept {
+		return data;
+	}
+};
@@ -10,6 +10,7 @@
 
 #include <cstdint>
 #include <stdexcept>
+#include <vector>
 
 namespace {
 
@@ -19,19 +20,30 @@ public:
 };
 
 class FileWriter {
-	BufferedOutputStream &os;
+	BufferedOutputStream *const os;
+
+	/**
+	 * The destination buffer if #os is nullptr.
+	 */
+	std::vector<std::byte> *const buffer;
 
 public:
 	explicit FileWriter(BufferedOutputStream &_os) noexcept
-		:os(_os) {}
+		:os(&_os), buffer(nullptr) {}
+
+	explicit FileWriter(std::vector<std::byte> &_buffer) noexcept
+		:os(nullptr), buffer(&_buffer) {}
 
 	void WriteBuffer(std::span<const std::byte> src) {
-		os.Write(src);
+		if (os != nullptr)
+			os->Write(src);
+		else
+			buffer->insert(buffer->end(), src.begin(), src.end());
 	}
 
 	template<typename T>
 	void WriteT(T &value) {
-		os.WriteT<T>(value);
+		WriteBuffer(ReferenceAsBytes(value));
 	}
 
 	void WriteBool(const bool &value) {
@@ -99,8 +111,8 @@ void
 session_write_file_header(BufferedOutputStream &os)
 {
 	FileWriter file(os);
-	file.Write32(MAGIC_FILE);
-	file.Write32(sizeof(Session));
+	file.Write32(MAGIC_SNAPSHOT);
+	file.Write32(SNAPSHOT_VERSION);
 }
 
 void
@@ -168,19 +180,13 @@ WriteRealmSession(FileWriter &file, const RealmSession &session)
 	file.Write32(MAGIC_END_OF_RECORD);
 }
 
-void
-session_write(BufferedOutputStream &os, const Session *session)
+static void
+WriteSessionPayload(FileWriter &file, const Session &session)
 {
-	FileWriter file(os);
-
-	file.WriteT(session->id);
-	file.Write(session->expires);
-	file.WriteT(session->counter);
-	file.WriteBool(session->cookie_received);
-	file.Write(session->translate);
-	file.Write(session->language);
+	file.Write(session.translate);
+	file.Write(session.language);
 
-	for (const auto &[name, realm] : session->realms) {
+	for (const auto &[name, realm] : session.realms) {
 		file.Write32(MAGIC_REALM_SESSION);
 		file.Write(name);
 		WriteRealmSession(file, realm);
@@ -189,3 +195,34 @@ session_write(BufferedOutputStream &os, const Session *session)
 	file.Write32(MAGIC_END_OF_LIST);
 	file.Write32(MAGIC_END_OF_RECORD);
 }
+
+void
+session_write(BufferedOutputStream &os, const Session &session,
+	      std::vector<std::byte> &buffer)
+{
+	std::span<const std::byte> payload = session.pending_payload;
+	if (payload.data() == nullptr) {
+		buffer.clear();
+		FileWriter payload_writer(buffer);
+		WriteSessionPayload(payload_writer, session);
+		payload = buffer;
+	}
+
+	if (payload.size() > UINT32_MAX)
+		throw SessionSerializerError("Session is too large");
+
+	SessionRecordHeader header{};
+	header.magic = MAGIC_SESSION;
+	header.payload_size = payload.size();
+	header.id = session.id;
+	header.expires = session.expires;
+	header.counter = session.counter;
+	header.cookie_received = session.cookie_received;
+	header.has_user = session.pending_payload.data() != nullptr
+		? session.pending_has_user
+		: session.HasUser();
+
+	FileWriter file(os);
+	file.WriteT(header);
+	file.WriteBuffer(payload);
+}
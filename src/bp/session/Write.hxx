@@ -8,6 +8,9 @@
 
 #pragma once
 
+#include <cstddef>
+#include <vector>
+
 #include <stdint.h>
 
 struct Session;
@@ -32,7 +35,15 @@ void
 session_write_file_tail(BufferedOutputStream &os);
 
 /**
+ * Write a snapshot record (see #SessionRecordHeader).  If the session
+ * has not yet been materialized, its pending payload is copied
+ * verbatim.
+ *
  * Throws on error.
+ *
+ * @param buffer a scratch buffer which may be reused for all
+ * sessions
  */
 void
-session_write(BufferedOutputStream &os, const Session *session);
+session_write(BufferedOutputStream &os, const Session &session,
+	      std::vector<std::byte> &buffer);
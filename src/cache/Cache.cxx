@@ -7,13 +7,22 @@
 #include "Item.hxx"
 #include "event/Loop.hxx"
 
+#include <algorithm>
 #include <cassert>
 
 Cache::Cache(EventLoop &event_loop,
 	     size_t _max_size,
-	     CacheHandler *_handler) noexcept
+	     CacheHandler *_handler,
+	     CachePolicy policy) noexcept
 	:max_size(_max_size),
+	 /* 1% window, as suggested by the W-TinyLFU paper */
+	 max_window_size(policy == CachePolicy::TINY_LFU
+			 ? std::max<size_t>(_max_size / 100, 1)
+			 : 0),
 	 handler(_handler),
+	 sketch(policy == CachePolicy::TINY_LFU
+		? std::make_unique<FrequencySketch>()
+		: nullptr),
 	 cleanup_timer(event_loop, std::chrono::minutes(1),
 		       BIND_THIS_METHOD(ExpireCallback)) {}
 
@@ -25,7 +34,8 @@ Cache::~Cache() noexcept
 		size -= item->size;
 
 #ifndef NDEBUG
-		sorted_items.erase(sorted_items.iterator_to(*item));
+		auto &list = GetList(*item);
+		list.erase(list.iterator_to(*item));
 #endif
 
 		item->Destroy();
@@ -33,6 +43,7 @@ Cache::~Cache() noexcept
 
 	assert(size == 0);
 	assert(sorted_items.empty());
+	assert(window_items.empty());
 }
 
 std::chrono::steady_clock::time_point
@@ -55,7 +66,14 @@ Cache::ItemRemoved(CacheItem *item) noexcept
 	assert(!item->IsAbandoned() || !item->IsRemoved());
 	assert(size >= item->size);
 
-	sorted_items.erase(sorted_items.iterator_to(*item));
+	auto &list = GetList(*item);
+	list.erase(list.iterator_to(*item));
+
+	if (item->in_window) {
+		assert(window_size >= item->size);
+		window_size -= item->size;
+		item->in_window = false;
+	}
 
 	size -= item->size;
 
@@ -78,8 +96,25 @@ void
 Cache::RefreshItem(CacheItem &item) noexcept
 {
 	/* move to the front of the linked list */
-	sorted_items.erase(sorted_items.iterator_to(item));
-	sorted_items.push_back(item);
+	auto &list = GetList(item);
+	list.erase(list.iterator_to(item));
+	list.push_back(item);
+}
+
+inline void
+Cache::InsertItem(CacheItem &item) noexcept
+{
+	items.insert(item);
+	size += item.size;
+
+	if (sketch) {
+		window_items.push_back(item);
+		item.in_window = true;
+		window_size += item.size;
+
+		sketch->EnsureCapacity(items.size());
+	} else
+		sorted_items.push_back(item);
 }
 
 void
@@ -94,6 +129,9 @@ Cache::RemoveItem(CacheItem &item) noexcept
 CacheItem *
 Cache::Get(StringWithHash key) noexcept
 {
+	if (sketch)
+		sketch->Increment(key.hash);
+
 	auto i = items.find(key);
 	if (i == items.end())
 		return nullptr;
@@ -116,6 +154,9 @@ Cache::GetMatch(StringWithHash key,
 		bool (*match)(const CacheItem *, void *),
 		void *ctx) noexcept
 {
+	if (sketch)
+		sketch->Increment(key.hash);
+
 	const auto now = SteadyNow();
 
 	auto i = items.expire_find_if(key, [now](const auto &item){
@@ -135,21 +176,67 @@ Cache::GetMatch(StringWithHash key,
 }
 
 void
-Cache::DestroyOldestItem() noexcept
+Cache::EvictItem(CacheItem &item) noexcept
 {
-	if (sorted_items.empty())
-		return;
+	if (handler != nullptr)
+		handler->OnCacheItemEvicted(item);
 
-	CacheItem &item = sorted_items.front();
 	RemoveItem(item);
 }
 
+void
+Cache::DestroyOldestItem() noexcept
+{
+	if (!sorted_items.empty())
+		EvictItem(sorted_items.front());
+	else if (!window_items.empty())
+		EvictItem(window_items.front());
+}
+
+void
+Cache::AdmitOrEvict(CacheItem &candidate) noexcept
+{
+	assert(sketch);
+	assert(candidate.in_window);
+
+	const unsigned frequency = sketch->Estimate(candidate.GetKey().hash);
+	const size_t max_main_size = max_size - max_window_size;
+
+	if (size - window_size + candidate.size > max_main_size) {
+		if (candidate.size > max_main_size || sorted_items.empty() ||
+		    frequency <= sketch->Estimate(sorted_items.front().GetKey().hash)) {
+			/* not more popular than the victim: reject
+			   the candidate */
+			EvictItem(candidate);
+			return;
+		}
+
+		/* the candidate has won against the first victim;
+		   evict as many as it needs */
+		do {
+			EvictItem(sorted_items.front());
+		} while (size - window_size + candidate.size > max_main_size);
+	}
+
+	window_items.erase(window_items.iterator_to(candidate));
+	window_size -= candidate.size;
+	candidate.in_window = false;
+	sorted_items.push_back(candidate);
+}
+
 bool
 Cache::NeedRoom(size_t _size) noexcept
 {
 	if (_size > max_size)
 		return false;
 
+	if (sketch)
+		/* make room in the window by moving its oldest
+		   items to the main area */
+		while (!window_items.empty() &&
+		       window_size + _size > max_window_size)
+			AdmitOrEvict(window_items.front());
+
 	while (true) {
 		if (size + _size <= max_size)
 			return true;
@@ -167,10 +254,7 @@ Cache::Add(CacheItem &item) noexcept
 		return false;
 	}
 
-	items.insert(item);
-	sorted_items.push_back(item);
-
-	size += item.size;
+	InsertItem(item);
 
 	if (handler != nullptr)
 		handler->OnCacheItemAdded(item);
@@ -196,10 +280,7 @@ Cache::Put(CacheItem &item) noexcept
 	if (i != items.end())
 		RemoveItem(*i);
 
-	size += item.size;
-
-	items.insert(item);
-	sorted_items.push_back(item);
+	InsertItem(item);
 
 	if (handler != nullptr)
 		handler->OnCacheItemAdded(item);
@@ -247,16 +328,17 @@ Cache::RemoveAllMatch(bool (*match)(const CacheItem *, void *),
 {
 	unsigned removed = 0;
 
-	for (auto i = sorted_items.begin(), end = sorted_items.end();
-	     i != end;) {
-		CacheItem &item = *i++;
+	for (auto *list : {&window_items, &sorted_items}) {
+		for (auto i = list->begin(), end = list->end(); i != end;) {
+			CacheItem &item = *i++;
 
-		if (!match(&item, ctx))
-			continue;
+			if (!match(&item, ctx))
+				continue;
 
-		items.erase(items.iterator_to(item));
-		ItemRemoved(&item);
-		++removed;
+			items.erase(items.iterator_to(item));
+			ItemRemoved(&item);
+			++removed;
+		}
 	}
 
 	return removed;
@@ -268,14 +350,16 @@ Cache::ExpireCallback() noexcept
 {
 	const auto now = SteadyNow();
 
-	for (auto i = sorted_items.begin(), end = sorted_items.end(); i != end;) {
-		CacheItem &item = *i++;
+	for (auto *list : {&window_items, &sorted_items}) {
+		for (auto i = list->begin(), end = list->end(); i != end;) {
+			CacheItem &item = *i++;
 
-		if (item.expires > now)
-			/* not yet expired */
-			continue;
+			if (item.expires > now)
+				/* not yet expired */
+				continue;
 
-		RemoveItem(item);
+			RemoveItem(item);
+		}
 	}
 
 	return size > 0;
@@ -5,6 +5,8 @@
 #pragma once
 
 #include "Item.hxx"
+#include "FrequencySketch.hxx"
+#include "Policy.hxx"
 #include "event/CleanupTimer.hxx"
 #include "util/IntrusiveHashSet.hxx"
 #include "util/IntrusiveList.hxx"
@@ -22,8 +24,25 @@ class Cache {
 	const size_t max_size;
 	size_t size = 0;
 
+	/**
+	 * The maximum total size of #window_items (only used with
+	 * CachePolicy::TINY_LFU).
+	 */
+	const size_t max_window_size;
+
+	/**
+	 * The total size of #window_items.
+	 */
+	size_t window_size = 0;
+
 	CacheHandler *const handler;
 
+	/**
+	 * Counts how often each key has been looked up (only with
+	 * CachePolicy::TINY_LFU).
+	 */
+	const std::unique_ptr<FrequencySketch> sketch;
+
 	using ItemSet = IntrusiveHashSet<CacheItem, 65536,
 					 IntrusiveHashSetOperators<CacheItem,
 								   CacheItem::GetKeyFunction,
@@ -33,18 +52,30 @@ class Cache {
 
 	ItemSet items;
 
+	using SortedList =
+		IntrusiveList<CacheItem,
+			      IntrusiveListMemberHookTraits<&CacheItem::sorted_siblings>>;
+
 	/**
 	 * A linked list of all cache items, sorted by last access,
-	 * oldest first.
+	 * oldest first.  With CachePolicy::TINY_LFU, this is the
+	 * "main" area and does not include #window_items.
+	 */
+	SortedList sorted_items;
+
+	/**
+	 * New items which have not yet been admitted to
+	 * #sorted_items, sorted by last access, oldest first (only
+	 * used with CachePolicy::TINY_LFU).
 	 */
-	IntrusiveList<CacheItem,
-		      IntrusiveListMemberHookTraits<&CacheItem::sorted_siblings>> sorted_items;
+	SortedList window_items;
 
 	CleanupTimer cleanup_timer;
 
 public:
 	Cache(EventLoop &event_loop, size_t _max_size,
-	      CacheHandler *_handler=nullptr) noexcept;
+	      CacheHandler *_handler=nullptr,
+	      CachePolicy policy=CachePolicy::LRU) noexcept;
 
 	~Cache() noexcept;
 
@@ -127,6 +158,10 @@ private:
 
 	void ItemRemoved(CacheItem *item) noexcept;
 
+	SortedList &GetList(const CacheItem &item) noexcept {
+		return item.in_window ? window_items : sorted_items;
+	}
+
 	class ItemRemover {
 		Cache &cache;
 
@@ -143,7 +178,20 @@ private:
 
 	void RefreshItem(CacheItem &item) noexcept;
 
+	void InsertItem(CacheItem &item) noexcept;
+
+	/**
+	 * Remove an item because the cache is full.
+	 */
+	void EvictItem(CacheItem &item) noexcept;
+
 	void DestroyOldestItem() noexcept;
 
+	/**
+	 * Move the oldest item of the window to the main area if it
+	 * is popular enough, or else evict it.
+	 */
+	void AdmitOrEvict(CacheItem &candidate) noexcept;
+
 	bool NeedRoom(size_t _size) noexcept;
 };
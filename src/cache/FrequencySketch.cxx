@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "FrequencySketch.hxx"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+FrequencySketch::FrequencySketch(std::size_t min_capacity) noexcept
+{
+	Resize(std::bit_ceil(std::max<std::size_t>(min_capacity,
+						   COUNTERS_PER_WORD)));
+}
+
+void
+FrequencySketch::Resize(std::size_t new_width) noexcept
+{
+	assert(new_width > width);
+	assert(new_width % COUNTERS_PER_WORD == 0);
+
+	/* all rows are stored in one table, one after another */
+	const std::size_t old_row_words = width / COUNTERS_PER_WORD;
+	const std::size_t new_row_words = new_width / COUNTERS_PER_WORD;
+	auto new_table = std::make_unique<uint_least64_t[]>(DEPTH * new_row_words);
+
+	/* a counter's index within its row is the hash modulo the
+	   (power of two) width, so in the wider row, each old
+	   counter is found at all indices which are congruent
+	   modulo the old width: copy the old row to all of them */
+	if (old_row_words > 0)
+		for (unsigned row = 0; row < DEPTH; ++row)
+			for (std::size_t i = 0; i < new_row_words; ++i)
+				new_table[row * new_row_words + i] =
+					table[row * old_row_words + i % old_row_words];
+
+	table = std::move(new_table);
+	width = new_width;
+}
+
+void
+FrequencySketch::EnsureCapacity(std::size_t capacity) noexcept
+{
+	if (capacity > width)
+		Resize(std::bit_ceil(capacity));
+}
+
+inline std::size_t
+FrequencySketch::GetIndex(std::size_t hash, unsigned row) const noexcept
+{
+	/* derive independent hash values for each row */
+	static constexpr uint_least64_t seeds[DEPTH] = {
+		0xc3a5c85c97cb3127, 0xb492b66fbe98f273,
+		0x9ae16a3b2f90404f, 0xcbf29ce484222325,
+	};
+
+	uint_least64_t h = (static_cast<uint_least64_t>(hash) + seeds[row]) * 0x9e3779b97f4a7c15;
+	h ^= h >> 32;
+
+	return row * width + (h & (width - 1));
+}
+
+void
+FrequencySketch::Increment(std::size_t hash) noexcept
+{
+	bool incremented = false;
+
+	for (unsigned row = 0; row < DEPTH; ++row) {
+		const std::size_t index = GetIndex(hash, row);
+		if (GetCounter(index) < MAX_COUNT) {
+			const unsigned shift = (index % COUNTERS_PER_WORD) * 4;
+			table[index / COUNTERS_PER_WORD] += uint_least64_t{1} << shift;
+			incremented = true;
+		}
+	}
+
+	/* age the counters after a sample of 10 * width increments,
+	   as suggested by the TinyLFU paper */
+	if (incremented && ++n_increments >= 10 * width)
+		Reset();
+}
+
+unsigned
+FrequencySketch::Estimate(std::size_t hash) const noexcept
+{
+	unsigned result = MAX_COUNT;
+
+	for (unsigned row = 0; row < DEPTH; ++row)
+		result = std::min(result, GetCounter(GetIndex(hash, row)));
+
+	return result;
+}
+
+void
+FrequencySketch::Reset() noexcept
+{
+	const std::size_t n_words = DEPTH * width / COUNTERS_PER_WORD;
+	for (std::size_t i = 0; i < n_words; ++i)
+		/* shift each 4 bit counter right by one */
+		table[i] = (table[i] >> 1) & 0x7777777777777777;
+
+	n_increments /= 2;
+}
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * A count-min sketch with 4 bit counters which estimates how often a
+ * hash value has been seen recently.  Counters are halved
+ * periodically, so old popularity fades away.
+ *
+ * This is the frequency estimator of the "TinyLFU" admission policy.
+ */
+class FrequencySketch {
+	static constexpr unsigned DEPTH = 4;
+
+	/**
+	 * Each 64 bit word contains this many 4 bit counters.
+	 */
+	static constexpr unsigned COUNTERS_PER_WORD = 16;
+
+	static constexpr unsigned MAX_COUNT = 15;
+
+	std::unique_ptr<uint_least64_t[]> table;
+
+	/**
+	 * The number of counters per row (a power of two).
+	 */
+	std::size_t width = 0;
+
+	/**
+	 * The number of increments since the last Reset().
+	 */
+	std::size_t n_increments = 0;
+
+public:
+	/**
+	 * @param min_capacity the expected number of distinct
+	 * items; the sketch grows automatically if it is too small
+	 */
+	explicit FrequencySketch(std::size_t min_capacity=1024) noexcept;
+
+	/**
+	 * Make sure the sketch is large enough for this number of
+	 * items.  Growing keeps all estimates.
+	 */
+	void EnsureCapacity(std::size_t capacity) noexcept;
+
+	void Increment(std::size_t hash) noexcept;
+
+	/**
+	 * @return the estimated frequency (0..15)
+	 */
+	[[gnu::pure]]
+	unsigned Estimate(std::size_t hash) const noexcept;
+
+private:
+	void Resize(std::size_t new_width) noexcept;
+
+	/**
+	 * Halve all counters.
+	 */
+	void Reset() noexcept;
+
+	[[gnu::pure]]
+	std::size_t GetIndex(std::size_t hash, unsigned row) const noexcept;
+
+	[[gnu::pure]]
+	unsigned GetCounter(std::size_t index) const noexcept {
+		const auto word = table[index / COUNTERS_PER_WORD];
+		const unsigned shift = (index % COUNTERS_PER_WORD) * 4;
+		return (word >> shift) & 0xf;
+	}
+};
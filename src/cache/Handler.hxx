@@ -8,6 +8,14 @@ class CacheItem;
 
 class CacheHandler {
 public:
-	virtual void OnCacheItemAdded(const CacheItem &item) noexcept = 0;
-	virtual void OnCacheItemRemoved(const CacheItem &item) noexcept = 0;
+	virtual void OnCacheItemAdded(const CacheItem &) noexcept {}
+	virtual void OnCacheItemRemoved(const CacheItem &) noexcept {}
+
+	/**
+	 * The item is about to be removed because the cache is full.
+	 * This is called before OnCacheItemRemoved(), while the item
+	 * is still valid; the handler may copy it to a secondary
+	 * storage.
+	 */
+	virtual void OnCacheItemEvicted(const CacheItem &) noexcept {}
 };
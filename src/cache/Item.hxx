@@ -35,6 +35,12 @@ class CacheItem : public SharedAnchor {
 
 	const size_t size;
 
+	/**
+	 * Is this item in Cache::window_items (and not in
+	 * Cache::sorted_items)?
+	 */
+	bool in_window = false;
+
 public:
 	CacheItem(StringWithHash _key, std::size_t _size,
 		  std::chrono::steady_clock::time_point _expires) noexcept
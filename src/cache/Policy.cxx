@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "Policy.hxx"
+
+#include <stdexcept>
+
+using std::string_view_literals::operator""sv;
+
+CachePolicy
+ParseCachePolicy(std::string_view s)
+{
+	if (s == "lru"sv)
+		return CachePolicy::LRU;
+	else if (s == "tinylfu"sv)
+		return CachePolicy::TINY_LFU;
+	else
+		throw std::invalid_argument{"Invalid cache policy"};
+}
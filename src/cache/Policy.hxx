@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+enum class CachePolicy : uint_least8_t {
+	/**
+	 * Evict the least recently used item.
+	 */
+	LRU,
+
+	/**
+	 * "W-TinyLFU": new items are added to a small LRU "window".
+	 * When they fall out of it, they are admitted to the main
+	 * LRU only if they have been requested more often than the
+	 * item they would displace.  This prevents one-hit wonders
+	 * (e.g. a crawler sweeping the long tail) from evicting the
+	 * working set.
+	 */
+	TINY_LFU,
+};
+
+/**
+ * Parse a #CachePolicy name ("lru" or "tinylfu").
+ *
+ * Throws on error.
+ */
+CachePolicy
+ParseCachePolicy(std::string_view s);
@@ -7,6 +7,7 @@
 #include "StickyMode.hxx"
 #include "net/SocketAddress.hxx"
 
+#include <cassert>
 #include <vector>
 
 class AllocatorPtr;
@@ -30,7 +31,14 @@ public:
 		v.clear();
 	}
 
+	/**
+	 * Modes which pick by load (see IsLoadStickyMode()) are not
+	 * allowed here, because the clients which use
+	 * #AddressListBuilder do not track requests in flight.
+	 */
 	void SetStickyMode(StickyMode _sticky_mode) noexcept {
+		assert(!IsLoadStickyMode(_sticky_mode));
+
 		sticky_mode = _sticky_mode;
 	}
 
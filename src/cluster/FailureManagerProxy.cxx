@@ -13,6 +13,12 @@ FailureManagerProxy::MakeFailureInfo(SocketAddress address) const noexcept
 	return failure_manager.Make(address);
 }
 
+const FailureInfo *
+FailureManagerProxy::GetFailureInfo(SocketAddress address) const noexcept
+{
+	return failure_manager.Find(address);
+}
+
 bool
 FailureManagerProxy::Check(const Expiry now, SocketAddress address,
 			   bool allow_fade) const noexcept {
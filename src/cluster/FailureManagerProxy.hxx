@@ -7,6 +7,7 @@
 class Expiry;
 class SocketAddress;
 class FailureManager;
+class FailureInfo;
 class ReferencedFailureInfo;
 
 class FailureManagerProxy {
@@ -19,6 +20,13 @@ public:
 	[[gnu::pure]]
 	ReferencedFailureInfo &MakeFailureInfo(SocketAddress address) const noexcept;
 
+	/**
+	 * Look up the #FailureInfo for the given address without
+	 * creating one.  Returns nullptr if the address is unknown.
+	 */
+	[[gnu::pure]]
+	const FailureInfo *GetFailureInfo(SocketAddress address) const noexcept;
+
 	[[gnu::pure]]
 	bool Check(const Expiry now, SocketAddress address,
 		   bool allow_fade) const noexcept;
@@ -6,6 +6,7 @@
 
 #include "PickFailover.hxx"
 #include "PickModulo.hxx"
+#include "PickLoad.hxx"
 #include "StickyMode.hxx"
 #include "RoundRobinBalancer.cxx"
 #include "net/SocketAddress.hxx"
@@ -13,6 +14,11 @@
 
 /**
  * Pick an address using the given #StickyMode.
+ *
+ * The modes which pick by load (see IsLoadStickyMode()) work only if
+ * the caller reports all requests to the #FailureInfo; this is only
+ * done by beng-lb's HTTP forwarder (which is the only one whose
+ * configuration allows these modes).
  */
 template<typename List>
 [[gnu::pure]]
@@ -41,6 +47,16 @@ PickGeneric(Expiry now, StickyMode sticky_mode,
 					  sticky_hash);
 
 		break;
+
+	case StickyMode::LEAST_REQUESTS:
+		return PickLeastRequests(now, list,
+					 list.GetRoundRobinBalancer());
+
+	case StickyMode::PEAK_EWMA:
+		return PickPeakEwma(now, list, list.GetRoundRobinBalancer());
+
+	case StickyMode::POWER_OF_TWO_CHOICES:
+		return PickPowerOfTwoChoices(now, list);
 	}
 
 	return list.GetRoundRobinBalancer().Get(now, list,
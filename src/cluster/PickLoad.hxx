@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#pragma once
+
+#include "RoundRobinBalancer.cxx"
+#include "net/FailureInfo.hxx"
+#include "time/Expiry.hxx"
+
+#include <iterator>
+
+#include <assert.h>
+#include <stdlib.h> // for random()
+
+[[gnu::pure]]
+static inline unsigned
+GetRequestCount(const FailureInfo *info) noexcept
+{
+	return info != nullptr ? info->GetRequestCount() : 0U;
+}
+
+/**
+ * Pick the non-failing address with the lowest cost.  The
+ * #RoundRobinBalancer chooses the initial candidate which wins all
+ * ties; this spreads requests evenly among equally loaded addresses.
+ *
+ * The list must implement GetFailureInfo() which returns a pointer
+ * to the #FailureInfo of an item (or nullptr if there is none).
+ */
+template<typename List, typename F>
+const auto &
+PickLowestCost(Expiry now, const List &list,
+	       RoundRobinBalancer &round_robin_balancer,
+	       F &&get_cost) noexcept
+{
+	assert(list.size() >= 2);
+
+	/* like StickyMode::NONE, ignore the "fade" status */
+	constexpr bool allow_fade = true;
+
+	const auto &first = round_robin_balancer.Get(now, list, allow_fade);
+	if (!list.Check(now, first, allow_fade))
+		/* all addresses failed */
+		return first;
+
+	const auto *best = &first;
+	auto best_cost = get_cost(list.GetFailureInfo(first));
+
+	for (const auto &i : list) {
+		if (&i == best)
+			continue;
+
+		const auto cost = get_cost(list.GetFailureInfo(i));
+		if (cost < best_cost && list.Check(now, i, allow_fade)) {
+			best = &i;
+			best_cost = cost;
+		}
+	}
+
+	return *best;
+}
+
+/**
+ * Generic implementation of StickyMode::LEAST_REQUESTS.
+ */
+template<typename List>
+const auto &
+PickLeastRequests(Expiry now, const List &list,
+		  RoundRobinBalancer &round_robin_balancer) noexcept
+{
+	return PickLowestCost(now, list, round_robin_balancer,
+			      [](const FailureInfo *info) noexcept {
+				      return GetRequestCount(info);
+			      });
+}
+
+/**
+ * Generic implementation of StickyMode::PEAK_EWMA.
+ */
+template<typename List>
+const auto &
+PickPeakEwma(Expiry now, const List &list,
+	     RoundRobinBalancer &round_robin_balancer) noexcept
+{
+	return PickLowestCost(now, list, round_robin_balancer,
+			      [](const FailureInfo *info) noexcept {
+				      return info != nullptr
+					      ? info->GetPeakEwmaCost()
+					      : 0.;
+			      });
+}
+
+/**
+ * Generic implementation of StickyMode::POWER_OF_TWO_CHOICES: sample
+ * two distinct random addresses and pick the one with fewer requests
+ * in flight.  Unlike PickLeastRequests(), this does not need to look
+ * at all addresses; it is meant for very large lists.
+ *
+ * The list must implement operator[] with O(1) complexity.
+ */
+template<typename List>
+const auto &
+PickPowerOfTwoChoices(Expiry now, const List &list) noexcept
+{
+	const std::size_t n = list.size();
+	assert(n >= 2);
+
+	/* like StickyMode::NONE, ignore the "fade" status */
+	constexpr bool allow_fade = true;
+
+	const auto *fallback = &*std::begin(list);
+
+	for (unsigned round = 0; round < 4; ++round) {
+		const std::size_t i = random() % n;
+		std::size_t j = random() % (n - 1);
+		if (j >= i)
+			++j;
+
+		const auto &a = list[i];
+		const auto &b = list[j];
+
+		const bool a_ok = list.Check(now, a, allow_fade);
+		const bool b_ok = list.Check(now, b, allow_fade);
+		if (a_ok && b_ok)
+			return GetRequestCount(list.GetFailureInfo(b)) <
+				GetRequestCount(list.GetFailureInfo(a))
+				? b : a;
+		else if (a_ok)
+			return a;
+		else if (b_ok)
+			return b;
+
+		if (round == 0)
+			fallback = &a;
+
+		/* both have failed; try two others */
+	}
+
+	/* too many failures: look for any good one */
+	for (const auto &i : list)
+		if (list.Check(now, i, allow_fade))
+			return i;
+
+	/* all addresses failed */
+	return *fallback;
+}
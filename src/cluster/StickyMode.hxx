@@ -51,4 +51,39 @@ enum class StickyMode {
 	 * Tomcat with jvmRoute in cookie.
 	 */
 	JVM_ROUTE,
+
+	/**
+	 * Not really "sticky": select the node with the fewest
+	 * requests currently in flight.
+	 */
+	LEAST_REQUESTS,
+
+	/**
+	 * Not really "sticky": select the node with the lowest
+	 * product of its (peak-sensitive) moving average response
+	 * latency and the number of requests in flight.
+	 */
+	PEAK_EWMA,
+
+	/**
+	 * Not really "sticky": sample two random nodes and select
+	 * the one with fewer requests in flight.  Unlike
+	 * #LEAST_REQUESTS, the cost of this does not depend on the
+	 * number of nodes.
+	 */
+	POWER_OF_TWO_CHOICES,
 };
+
+/**
+ * Does this mode pick nodes based on the number of requests in
+ * flight?  These modes require the caller to report each request
+ * with FailureInfo::StartRequest() and FailureInfo::FinishRequest();
+ * only the HTTP forwarder of beng-lb does that.
+ */
+constexpr bool
+IsLoadStickyMode(StickyMode mode) noexcept
+{
+	return mode == StickyMode::LEAST_REQUESTS ||
+		mode == StickyMode::PEAK_EWMA ||
+		mode == StickyMode::POWER_OF_TWO_CHOICES;
+}
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "Child.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "io/Logger.hxx"
+
+FcgiChild::FcgiChild(CreateStockItem c, ChildStock &_child_stock,
+		     std::string_view _tag, bool want_multiplex) noexcept
+	:ListenChildStockItem(c, _child_stock, _tag),
+	 multiplex(want_multiplex ? Multiplex::UNKNOWN : Multiplex::NO)
+{
+}
+
+FcgiChild::~FcgiChild() noexcept = default;
+
+FcgiMuxConnection *
+FcgiChild::MakeMuxConnection() noexcept
+{
+	if (multiplex == Multiplex::NO)
+		return nullptr;
+
+	if (!mux) {
+		try {
+			mux = std::make_unique<FcgiMuxConnection>(GetEventLoop(),
+								  Connect(),
+								  multiplex == Multiplex::YES,
+								  *this);
+		} catch (...) {
+			/* ignore; the caller will try to connect
+			   again and report the error */
+			return nullptr;
+		}
+	}
+
+	auto *connection = GetMuxConnection();
+	if (connection != nullptr && connection->IsFull())
+		return nullptr;
+
+	return connection;
+}
+
+void
+FcgiChild::OnFcgiMuxReady() noexcept
+{
+	multiplex = Multiplex::YES;
+}
+
+void
+FcgiChild::OnFcgiMuxUnsupported() noexcept
+{
+	multiplex = Multiplex::NO;
+	mux.reset();
+}
+
+void
+FcgiChild::OnFcgiMuxError(std::exception_ptr error) noexcept
+{
+	LogConcat(2, GetStockNameView(), "FastCGI connection failed: ", error);
+
+	if (multiplex == Multiplex::UNKNOWN)
+		/* the application did not answer GET_VALUES
+		   properly; don't try again */
+		multiplex = Multiplex::NO;
+
+	mux.reset();
+}
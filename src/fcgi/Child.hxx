@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#pragma once
+
+#include "MuxConnection.hxx"
+#include "spawn/ListenChildStock.hxx"
+
+#include <memory>
+
+/**
+ * A FastCGI application process managed by #FcgiStock.  If the
+ * application supports it (FCGI_MPXS_CONNS), concurrent requests
+ * are sent over one shared #FcgiMuxConnection instead of one
+ * connection per request.
+ */
+class FcgiChild final : public ListenChildStockItem, FcgiMuxConnectionHandler {
+	std::unique_ptr<FcgiMuxConnection> mux;
+
+	enum class Multiplex : uint_least8_t {
+		/**
+		 * We don't know yet whether the application
+		 * supports multiplexing.
+		 */
+		UNKNOWN,
+
+		NO,
+		YES,
+	} multiplex;
+
+public:
+	/**
+	 * @param want_multiplex attempt to multiplex requests?  This
+	 * is only useful if the application handles concurrent
+	 * requests.
+	 */
+	FcgiChild(CreateStockItem c, ChildStock &_child_stock,
+		  std::string_view _tag, bool want_multiplex) noexcept;
+
+	~FcgiChild() noexcept override;
+
+	/**
+	 * Returns the multiplexed connection (if there is one and the
+	 * application has confirmed that it supports multiplexing).
+	 */
+	FcgiMuxConnection *GetMuxConnection() noexcept {
+		return mux && mux->IsReady() ? mux.get() : nullptr;
+	}
+
+	/**
+	 * Like GetMuxConnection(), but also returns nullptr if the
+	 * connection cannot accept another request.  If there is no
+	 * multiplexed connection yet, this method establishes one and
+	 * asks the application whether it supports multiplexing; until
+	 * the answer arrives, it returns nullptr.
+	 */
+	FcgiMuxConnection *MakeMuxConnection() noexcept;
+
+private:
+	/* virtual methods from class FcgiMuxConnectionHandler */
+	void OnFcgiMuxReady() noexcept override;
+	void OnFcgiMuxUnsupported() noexcept override;
+	void OnFcgiMuxError(std::exception_ptr error) noexcept override;
+};
@@ -20,7 +20,6 @@
 #include "http/Method.hxx"
 #include "http/HeaderParser.hxx"
 #include "strmap.hxx"
-#include "product.h"
 #include "pool/pool.hxx"
 #include "system/Error.hxx"
 #include "net/BufferedSocketLease.hxx"
@@ -37,8 +36,6 @@
 #include "AllocatorPtr.hxx"
 #include "stopwatch.hxx"
 
-#include <fmt/format.h>
-
 #include <string.h>
 #include <errno.h>
 #include <stdlib.h>
@@ -1281,71 +1278,21 @@ fcgi_client_request(struct pool *pool,
 	static unsigned next_request_id = 1;
 	++next_request_id;
 
+	GrowingBuffer buffer;
+	SerializeFcgiRequest(buffer, next_request_id,
+			     method, uri,
+			     script_filename, script_name, path_info,
+			     query_string, document_root, remote_addr,
+			     headers,
+			     body ? body.GetAvailable(false) : -1,
+			     params);
+
 	FcgiRecordHeader header{
 		.version = FCGI_VERSION_1,
-		.type = FcgiRecordType::BEGIN_REQUEST,
+		.type = FcgiRecordType::PARAMS,
 		.request_id = next_request_id,
 	};
-	static constexpr FcgiBeginRequest begin_request{
-		.role = static_cast<uint16_t>(FcgiRole::RESPONDER),
-		.flags = FCGI_FLAG_KEEP_CONN,
-	};
-
-	assert(http_method_is_valid(method));
-
-	GrowingBuffer buffer;
-	header.content_length = sizeof(begin_request);
-	buffer.WriteT(header);
-	buffer.WriteT(begin_request);
-
-	FcgiParamsSerializer ps(buffer, header.request_id);
-
-	ps("REQUEST_METHOD", http_method_to_string(method))
-		("REQUEST_URI", uri)
-		("SCRIPT_FILENAME", script_filename)
-		("SCRIPT_NAME", script_name)
-		("PATH_INFO", path_info)
-		("QUERY_STRING", query_string)
-		("DOCUMENT_ROOT", document_root)
-		("SERVER_SOFTWARE", PRODUCT_TOKEN);
-
-	if (remote_addr != nullptr)
-		ps("REMOTE_ADDR", remote_addr);
-
-	off_t available = body
-		? body.GetAvailable(false)
-		: -1;
-	if (available >= 0) {
-		const fmt::format_int value{available};
-
-		ps("HTTP_CONTENT_LENGTH", value.c_str())
-			/* PHP wants the parameter without
-			   "HTTP_" */
-			("CONTENT_LENGTH", value.c_str());
-	}
-
-	if (const char *content_type = headers.Get(content_type_header);
-	    content_type != nullptr)
-		/* same for the "Content-Type" request
-		   header */
-		ps("CONTENT_TYPE", content_type);
-
-	if (const char *https = headers.Get(x_cm4all_https_header);
-	    https != nullptr && strcmp(https, "on") == 0)
-		ps("HTTPS", https);
-
-	ps.Headers(headers);
-
-	for (const std::string_view param : params) {
-		const auto [name, value] = Split(param, '=');
-		if (!name.empty() && value.data() != nullptr)
-			ps(name, value);
-	}
-
-	ps.Commit();
 
-	header.type = FcgiRecordType::PARAMS;
-	header.content_length = 0;
 	buffer.WriteT(header);
 
 	UnusedIstreamPtr request;
@@ -0,0 +1,1032 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "MuxConnection.hxx"
+#include "Error.hxx"
+#include "Protocol.hxx"
+#include "Serialize.hxx"
+#include "http/CommonHeaders.hxx"
+#include "http/HeaderLimits.hxx"
+#include "http/HeaderParser.hxx"
+#include "http/Method.hxx"
+#include "http/ResponseHandler.hxx"
+#include "http/Status.hxx"
+#include "istream/LengthIstream.hxx"
+#include "istream/MultiFifoBufferIstream.hxx"
+#include "istream/New.hxx"
+#include "istream/Sink.hxx"
+#include "istream/UnusedPtr.hxx"
+#include "pool/pool.hxx"
+#include "net/SocketError.hxx"
+#include "net/SocketProtocolError.hxx"
+#include "net/TimeoutError.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "io/FdType.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "util/Cancellable.hxx"
+#include "util/Exception.hxx"
+#include "util/NumberParser.hxx"
+#include "util/SpanCast.hxx"
+#include "util/StringSplit.hxx"
+#include "util/StringStrip.hxx"
+#include "AllocatorPtr.hxx"
+#include "lease.hxx"
+#include "stopwatch.hxx"
+#include "strmap.hxx"
+
+#include <algorithm> // for std::min()
+#include <cassert>
+#include <string>
+#include <utility> // for std::unreachable()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using std::string_view_literals::operator""sv;
+
+/**
+ * How long to wait for the GET_VALUES_RESULT record?
+ */
+static constexpr Event::Duration fcgi_mux_probe_timeout = std::chrono::seconds{5};
+
+/**
+ * Abort all requests if the application doesn't send anything for
+ * this long while requests are pending.
+ */
+static constexpr Event::Duration fcgi_mux_timeout = std::chrono::minutes{1};
+
+/**
+ * Stop reading request bodies while the output buffer is larger
+ * than this.
+ */
+static constexpr std::size_t fcgi_mux_max_output = 64 * 1024;
+
+/**
+ * Stop reading from the socket while a response body buffer is
+ * larger than this, but only if there is no other request on the
+ * connection.
+ */
+static constexpr std::size_t fcgi_mux_max_buffered = 64 * 1024;
+
+/**
+ * FastCGI has no per-request flow control, and blocking the socket
+ * would stall all other requests on the connection.  Therefore, if
+ * there are other requests, response body data is buffered beyond
+ * #fcgi_mux_max_buffered until this limit is reached; after that,
+ * the request is aborted.
+ */
+static constexpr std::size_t fcgi_mux_max_buffered_shared = 4 * 1024 * 1024;
+
+/**
+ * The maximum payload of a STDIN record generated by this class.
+ */
+static constexpr std::size_t fcgi_mux_max_record = 16 * 1024;
+
+class FcgiMuxConnection::Request final
+	: Cancellable, IstreamSink, MultiFifoBufferIstreamHandler,
+	  public IntrusiveListHook<IntrusiveHookMode::NORMAL>
+{
+	struct pool &pool;
+
+	const StopwatchPtr stopwatch;
+
+	FcgiMuxConnection &connection;
+
+	Lease &lease;
+
+	HttpResponseHandler &handler;
+
+	UniqueFileDescriptor stderr_fd;
+
+	StringMap response_headers;
+
+	/**
+	 * Response header data which has not yet been parsed
+	 * because the line is incomplete.
+	 */
+	std::string header_buffer;
+
+	std::size_t total_header_size = 0;
+
+	MultiFifoBufferIstream *response_body_control = nullptr;
+
+	HttpStatus status = HttpStatus::OK;
+
+	const uint_least16_t id;
+
+	enum class State : uint_least8_t {
+		/**
+		 * Receiving response headers.
+		 */
+		HEADERS,
+
+		/**
+		 * The response has no body (HEAD request or a
+		 * status which must not have a body); waiting for
+		 * END_REQUEST before invoking the
+		 * #HttpResponseHandler.
+		 */
+		NO_BODY,
+
+		/**
+		 * Receiving the response body.  The
+		 * #HttpResponseHandler has been invoked already.
+		 */
+		BODY,
+	} state = State::HEADERS;
+
+	/**
+	 * This is a HEAD request; STDOUT payloads after the headers
+	 * are ignored.
+	 */
+	const bool no_body;
+
+	/**
+	 * Did OnData() refuse data because the output buffer was
+	 * full?
+	 */
+	bool write_blocked = false;
+
+public:
+	Request(struct pool &_pool, StopwatchPtr &&_stopwatch,
+		FcgiMuxConnection &_connection, Lease &_lease,
+		uint_least16_t _id, HttpMethod method,
+		UniqueFileDescriptor &&_stderr_fd,
+		HttpResponseHandler &_handler,
+		CancellablePointer &cancel_ptr) noexcept
+		:pool(_pool), stopwatch(std::move(_stopwatch)),
+		 connection(_connection), lease(_lease),
+		 handler(_handler),
+		 stderr_fd(std::move(_stderr_fd)),
+		 id(_id),
+		 no_body(http_method_is_empty(method))
+	{
+		cancel_ptr = *this;
+	}
+
+	~Request() noexcept {
+		connection.RemoveRequest(*this);
+		lease.ReleaseLease(PutAction::REUSE);
+	}
+
+	void Destroy() noexcept {
+		this->~Request();
+	}
+
+	void DestroyEof() noexcept {
+		auto *rbc = response_body_control;
+		Destroy();
+		rbc->SetEof();
+	}
+
+	uint_least16_t GetId() const noexcept {
+		return id;
+	}
+
+	void Start(UnusedIstreamPtr body) noexcept;
+
+	/**
+	 * Resume reading the request body after the output buffer
+	 * has been flushed.  This may destroy the object.
+	 */
+	void ResumeBody() noexcept {
+		if (write_blocked) {
+			write_blocked = false;
+			input.Read();
+		}
+	}
+
+	void AbortError(std::exception_ptr e) noexcept;
+
+	/**
+	 * Handle the payload of a STDOUT record.  This may destroy
+	 * the object.
+	 */
+	std::size_t OnStdout(std::span<const std::byte> src) noexcept;
+
+	void OnStderr(std::span<const std::byte> src) noexcept;
+
+	/**
+	 * The application has finished the request.  This destroys
+	 * the object.
+	 */
+	void OnEndRequest() noexcept;
+
+private:
+	void AbortResponseHeaders(std::exception_ptr e) noexcept {
+		auto &_handler = handler;
+		Destroy();
+		_handler.InvokeError(std::move(e));
+	}
+
+	void AbortResponseBody(std::exception_ptr e) noexcept {
+		auto *rbc = response_body_control;
+		Destroy();
+		rbc->DestroyError(std::move(e));
+	}
+
+	/**
+	 * Tell the application that we're not interested in the
+	 * response anymore.
+	 */
+	void SendAbort() noexcept {
+		connection.WriteRecord(FcgiRecordType::ABORT_REQUEST, id);
+	}
+
+	/**
+	 * Throws on error.
+	 *
+	 * @return true if the end of the headers has been reached
+	 */
+	bool HandleLine(std::string_view line);
+
+	/**
+	 * Parse and remove all complete lines from #header_buffer.
+	 *
+	 * Throws on error.
+	 *
+	 * @return true if the end of the headers has been reached;
+	 * the rest of #header_buffer is response body data
+	 */
+	bool ParseHeaders();
+
+	/**
+	 * Submit the response metadata to the #HttpResponseHandler.
+	 * This may destroy the object.
+	 */
+	void SubmitResponse() noexcept;
+
+	/* virtual methods from class Cancellable */
+	void Cancel() noexcept override {
+		stopwatch.RecordEvent("cancel");
+
+		SendAbort();
+		Destroy();
+	}
+
+	/* virtual methods from class MultiFifoBufferIstreamHandler */
+	void OnFifoBufferIstreamConsumed([[maybe_unused]] std::size_t nbytes) noexcept override {
+		if (connection.read_blocked)
+			connection.defer_read.Schedule();
+	}
+
+	void OnFifoBufferIstreamClosed() noexcept override {
+		stopwatch.RecordEvent("close");
+
+		response_body_control = nullptr;
+		SendAbort();
+		Destroy();
+	}
+
+	/* virtual methods from class IstreamHandler */
+	std::size_t OnData(std::span<const std::byte> src) noexcept override;
+	void OnEof() noexcept override;
+	void OnError(std::exception_ptr e) noexcept override;
+};
+
+inline void
+FcgiMuxConnection::Request::Start(UnusedIstreamPtr body) noexcept
+{
+	if (!body) {
+		/* no request body - send an empty STDIN record */
+		connection.WriteRecord(FcgiRecordType::STDIN, id);
+		return;
+	}
+
+	SetInput(std::move(body));
+	input.Read();
+}
+
+void
+FcgiMuxConnection::Request::AbortError(std::exception_ptr e) noexcept
+{
+	switch (state) {
+	case State::HEADERS:
+	case State::NO_BODY:
+		AbortResponseHeaders(std::move(e));
+		break;
+
+	case State::BODY:
+		AbortResponseBody(std::move(e));
+		break;
+	}
+}
+
+inline bool
+FcgiMuxConnection::Request::HandleLine(std::string_view line)
+{
+	assert(state == State::HEADERS);
+
+	if (line.empty()) {
+		stopwatch.RecordEvent("response_headers");
+		return true;
+	}
+
+	if (line.size() >= MAX_HTTP_HEADER_SIZE)
+		throw FcgiClientError{FcgiClientErrorCode::GARBAGE, "Response header is too long"};
+
+	total_header_size += line.size();
+	if (total_header_size >= MAX_TOTAL_HTTP_HEADER_SIZE)
+		throw FcgiClientError{FcgiClientErrorCode::GARBAGE, "Too many response headers"};
+
+	if (!header_parse_line(pool, response_headers, line))
+		throw FcgiClientError(FcgiClientErrorCode::GARBAGE, "Malformed FastCGI response header");
+
+	return false;
+}
+
+inline bool
+FcgiMuxConnection::Request::ParseHeaders()
+{
+	std::string_view src = header_buffer;
+	bool end = false;
+
+	while (true) {
+		const auto [line, rest] = Split(src, '\n');
+		if (rest.data() == nullptr)
+			/* incomplete line */
+			break;
+
+		src = rest;
+
+		if (HandleLine(StripRight(line))) {
+			end = true;
+			break;
+		}
+	}
+
+	header_buffer.erase(0, src.data() - header_buffer.data());
+
+	if (!end && header_buffer.size() >= MAX_HTTP_HEADER_SIZE)
+		throw FcgiClientError{FcgiClientErrorCode::GARBAGE, "Response header is too long"};
+
+	return end;
+}
+
+std::size_t
+FcgiMuxConnection::Request::OnStdout(std::span<const std::byte> src) noexcept
+{
+	switch (state) {
+	case State::HEADERS:
+		break;
+
+	case State::NO_BODY:
+		/* ignore all payloads until END_REQUEST */
+		return src.size();
+
+	case State::BODY:
+		if (const std::size_t available = response_body_control->GetAvailable();
+		    available >= fcgi_mux_max_buffered) {
+			if (connection.requests.size() == 1) {
+				/* the response body handler is too
+				   slow; stop reading from the socket
+				   until it has consumed some of the
+				   buffer (this doesn't delay other
+				   requests because there are none) */
+				connection.BlockRead();
+				return 0;
+			}
+
+			if (available >= fcgi_mux_max_buffered_shared) {
+				/* we can't stop reading because that
+				   would stall the other requests, and
+				   we can't buffer forever */
+				stopwatch.RecordEvent("overflow");
+
+				SendAbort();
+				AbortResponseBody(std::make_exception_ptr(FcgiClientError{FcgiClientErrorCode::IO,
+											   "FastCGI response body buffer overflow"}));
+				return src.size();
+			}
+		}
+
+		response_body_control->Push(src);
+		response_body_control->SubmitBuffer();
+		return src.size();
+	}
+
+	/* a header line may be split across several records, and the
+	   records of other requests may be in between, so we need to
+	   copy the payload to our own buffer */
+	header_buffer.append(ToStringView(src));
+
+	try {
+		if (ParseHeaders())
+			SubmitResponse();
+	} catch (...) {
+		SendAbort();
+		AbortResponseHeaders(std::current_exception());
+	}
+
+	return src.size();
+}
+
+void
+FcgiMuxConnection::Request::OnStderr(std::span<const std::byte> src) noexcept
+{
+	/* ignore errors and partial writes while forwarding STDERR
+	   payload; there's nothing useful we can do, and we can't let
+	   this delay/disturb the response delivery */
+
+	if (stderr_fd.IsDefined())
+		stderr_fd.Write(src);
+	else
+		fwrite(src.data(), 1, src.size(), stderr);
+}
+
+inline void
+FcgiMuxConnection::Request::SubmitResponse() noexcept
+{
+	assert(state == State::HEADERS);
+
+	if (const char *p = response_headers.Remove(status_header)) {
+		int i = atoi(p);
+		if (http_status_is_valid(static_cast<HttpStatus>(i)))
+			status = static_cast<HttpStatus>(i);
+	}
+
+	if (no_body || http_status_is_empty(status)) {
+		stopwatch.RecordEvent("response_no_body");
+
+		/* wait for END_REQUEST */
+		state = State::NO_BODY;
+		header_buffer = {};
+		return;
+	}
+
+	state = State::BODY;
+
+	MultiFifoBufferIstreamHandler &fbi_handler = *this;
+	response_body_control = NewFromPool<MultiFifoBufferIstream>(pool, pool,
+								    fbi_handler);
+
+	/* the rest of the header buffer is the beginning of the
+	   response body */
+	response_body_control->Push(AsBytes(header_buffer));
+	header_buffer = {};
+
+	UnusedIstreamPtr response_body{response_body_control};
+
+	if (const char *p = response_headers.Remove(content_length_header)) {
+		char *endptr;
+		unsigned long long length = strtoull(p, &endptr, 10);
+		if (endptr > p && *endptr == 0)
+			response_body = NewIstreamPtr<LengthIstream>(pool,
+								     std::move(response_body),
+								     length);
+	}
+
+	handler.InvokeResponse(status, std::move(response_headers),
+			       std::move(response_body));
+}
+
+void
+FcgiMuxConnection::Request::OnEndRequest() noexcept
+{
+	stopwatch.RecordEvent("end");
+
+	switch (state) {
+	case State::HEADERS:
+		AbortResponseHeaders(std::make_exception_ptr(FcgiClientError(FcgiClientErrorCode::GARBAGE,
+									     "premature end of headers "
+									     "from FastCGI application")));
+		break;
+
+	case State::NO_BODY:
+		{
+			auto &_handler = handler;
+			const auto _status = status;
+			auto headers = std::move(response_headers);
+			Destroy();
+			_handler.InvokeResponse(_status, std::move(headers),
+						UnusedIstreamPtr{});
+		}
+
+		break;
+
+	case State::BODY:
+		DestroyEof();
+		break;
+	}
+}
+
+std::size_t
+FcgiMuxConnection::Request::OnData(std::span<const std::byte> src) noexcept
+{
+	if (connection.IsOutputFull()) {
+		write_blocked = true;
+		return 0;
+	}
+
+	src = src.first(std::min(src.size(), fcgi_mux_max_record));
+	connection.WriteRecord(FcgiRecordType::STDIN, id, src);
+	return src.size();
+}
+
+void
+FcgiMuxConnection::Request::OnEof() noexcept
+{
+	ClearInput();
+
+	stopwatch.RecordEvent("request_end");
+
+	connection.WriteRecord(FcgiRecordType::STDIN, id);
+}
+
+void
+FcgiMuxConnection::Request::OnError(std::exception_ptr e) noexcept
+{
+	ClearInput();
+
+	stopwatch.RecordEvent("request_error");
+
+	SendAbort();
+	AbortError(NestException(e,
+				 std::runtime_error("FastCGI request stream failed")));
+}
+
+FcgiMuxConnection::FcgiMuxConnection(EventLoop &event_loop,
+				     UniqueSocketDescriptor &&fd,
+				     bool probed,
+				     FcgiMuxConnectionHandler &_handler) noexcept
+	:handler(_handler),
+	 socket(event_loop),
+	 defer_write(event_loop, BIND_THIS_METHOD(OnDeferredWrite)),
+	 defer_read(event_loop, BIND_THIS_METHOD(OnDeferredRead)),
+	 timeout_event(event_loop, BIND_THIS_METHOD(OnTimeout)),
+	 state(probed ? State::READY : State::PROBE)
+{
+	socket.Init(fd.Release(), FdType::FD_SOCKET, Event::Duration{-1}, *this);
+	socket.ScheduleRead();
+
+	if (!probed)
+		SendGetValues();
+}
+
+FcgiMuxConnection::~FcgiMuxConnection() noexcept
+{
+	/* all requests must be finished/canceled before this object
+	   gets destructed */
+	assert(requests.empty());
+}
+
+void
+FcgiMuxConnection::SendRequest(struct pool &pool,
+			       StopwatchPtr stopwatch,
+			       Lease &lease,
+			       HttpMethod method, const char *uri,
+			       const char *script_filename,
+			       const char *script_name, const char *path_info,
+			       const char *query_string,
+			       const char *document_root,
+			       const char *remote_addr,
+			       const StringMap &headers, UnusedIstreamPtr body,
+			       std::span<const char *const> params,
+			       UniqueFileDescriptor &&stderr_fd,
+			       HttpResponseHandler &_handler,
+			       CancellablePointer &cancel_ptr) noexcept
+{
+	assert(IsReady());
+
+	const auto id = MakeRequestId();
+
+	SerializeFcgiRequest(output, id, method, uri,
+			     script_filename, script_name, path_info,
+			     query_string, document_root, remote_addr,
+			     headers,
+			     body ? body.GetAvailable(false) : -1,
+			     params);
+
+	/* end of the PARAMS stream */
+	WriteRecord(FcgiRecordType::PARAMS, id);
+
+	auto *request = NewFromPool<Request>(pool, pool, std::move(stopwatch),
+					     *this, lease, id, method,
+					     std::move(stderr_fd),
+					     _handler, cancel_ptr);
+	requests.push_back(*request);
+
+	if (read_blocked)
+		/* with more than one request, a slow response body
+		   handler must not block the socket anymore */
+		defer_read.Schedule();
+	else if (!timeout_event.IsPending())
+		RefreshTimeout();
+
+	request->Start(std::move(body));
+}
+
+inline FcgiMuxConnection::Request *
+FcgiMuxConnection::FindRequest(uint_least16_t id) noexcept
+{
+	for (auto &i : requests)
+		if (i.GetId() == id)
+			return &i;
+
+	return nullptr;
+}
+
+uint_least16_t
+FcgiMuxConnection::MakeRequestId() noexcept
+{
+	/* note: the id of a canceled request may be reused before the
+	   application has sent its END_REQUEST record; with 65535
+	   ids, this is very unlikely */
+
+	do {
+		/* zero is reserved for management records */
+		if (++next_request_id == 0)
+			next_request_id = 1;
+	} while (FindRequest(next_request_id) != nullptr);
+
+	return next_request_id;
+}
+
+void
+FcgiMuxConnection::RemoveRequest(Request &request) noexcept
+{
+	if (current == &request)
+		/* discard the rest of the current record */
+		current = nullptr;
+
+	requests.erase(requests.iterator_to(request));
+
+	if (requests.empty())
+		timeout_event.Cancel();
+}
+
+bool
+FcgiMuxConnection::AbortRequests(std::exception_ptr error) noexcept
+{
+	const DestructObserver destructed(*this);
+
+	while (!requests.empty()) {
+		requests.front().AbortError(error);
+		if (destructed)
+			return false;
+	}
+
+	return true;
+}
+
+void
+FcgiMuxConnection::Abort(std::exception_ptr error) noexcept
+{
+	if (!AbortRequests(NestException(error,
+					 FcgiClientError(FcgiClientErrorCode::IO,
+							 "FastCGI connection failed"))))
+		return;
+
+	handler.OnFcgiMuxError(std::move(error));
+}
+
+bool
+FcgiMuxConnection::IsOutputFull() const noexcept
+{
+	return output.GetSize() >= fcgi_mux_max_output;
+}
+
+void
+FcgiMuxConnection::WriteRecord(FcgiRecordType type, uint_least16_t request_id,
+			       std::span<const std::byte> payload) noexcept
+{
+	assert(payload.size() <= 0xffff);
+
+	const FcgiRecordHeader header{
+		.version = FCGI_VERSION_1,
+		.type = type,
+		.request_id = request_id,
+		.content_length = static_cast<uint16_t>(payload.size()),
+	};
+
+	output.WriteT(header);
+	if (!payload.empty())
+		output.Write(payload);
+
+	DeferWrite();
+}
+
+bool
+FcgiMuxConnection::Flush() noexcept
+{
+	while (!output.IsEmpty()) {
+		const auto r = output.Read();
+		const ssize_t nbytes = socket.Write(r);
+		if (nbytes > 0) [[likely]] {
+			output.Consume(nbytes);
+			if (static_cast<std::size_t>(nbytes) < r.size()) {
+				socket.ScheduleWrite();
+				return true;
+			}
+		} else if (nbytes == WRITE_BLOCKING) {
+			return true;
+		} else if (nbytes == WRITE_DESTROYED) {
+			return false;
+		} else {
+			Abort(std::make_exception_ptr(MakeSocketError("Write error")));
+			return false;
+		}
+	}
+
+	socket.UnscheduleWrite();
+
+	/* resume the request bodies which were waiting for the
+	   output buffer to drain */
+	const DestructObserver destructed(*this);
+	for (auto i = requests.begin(); i != requests.end() && !IsOutputFull();) {
+		auto &request = *i++;
+		request.ResumeBody();
+		if (destructed)
+			return false;
+	}
+
+	return true;
+}
+
+void
+FcgiMuxConnection::OnDeferredWrite() noexcept
+{
+	Flush();
+}
+
+void
+FcgiMuxConnection::OnDeferredRead() noexcept
+{
+	read_blocked = false;
+	RefreshTimeout();
+	socket.Read();
+}
+
+void
+FcgiMuxConnection::OnTimeout() noexcept
+{
+	Abort(std::make_exception_ptr(TimeoutError{}));
+}
+
+void
+FcgiMuxConnection::RefreshTimeout() noexcept
+{
+	if (state == State::PROBE)
+		/* the probe timeout keeps running */
+		return;
+
+	if (read_blocked)
+		/* we're waiting for a response body handler, not for
+		   the application */
+		return;
+
+	if (!requests.empty())
+		timeout_event.Schedule(fcgi_mux_timeout);
+}
+
+void
+FcgiMuxConnection::SendGetValues() noexcept
+{
+	assert(state == State::PROBE);
+
+	FcgiParamsSerializer ps(output, FcgiRecordType::GET_VALUES, 0);
+	ps(FCGI_MPXS_CONNS, std::string_view{})
+		(FCGI_MAX_REQS, std::string_view{});
+	ps.Commit();
+
+	DeferWrite();
+
+	timeout_event.Schedule(fcgi_mux_probe_timeout);
+}
+
+inline bool
+FcgiMuxConnection::HandleGetValuesResult(std::span<const std::byte> payload)
+{
+	assert(state == State::PROBE);
+
+	bool mpxs_conns = false;
+
+	while (!payload.empty()) {
+		const auto [name, value] = DeserializeFcgiPair(payload);
+		if (name == FCGI_MPXS_CONNS)
+			mpxs_conns = value == "1"sv;
+		else if (name == FCGI_MAX_REQS) {
+			if (const auto n = ParseInteger<std::size_t>(value);
+			    n && *n > 0)
+				max_requests = *n;
+		}
+	}
+
+	timeout_event.Cancel();
+
+	if (!mpxs_conns) {
+		handler.OnFcgiMuxUnsupported();
+		return false;
+	}
+
+	state = State::READY;
+	handler.OnFcgiMuxReady();
+	return true;
+}
+
+inline bool
+FcgiMuxConnection::HandleEndRequest(Request &request,
+				    std::span<const std::byte> payload)
+{
+	if (payload.size() < sizeof(FcgiEndRequest))
+		throw FcgiClientError{FcgiClientErrorCode::GARBAGE, "Malformed END_REQUEST record"};
+
+	const auto &end_request = *reinterpret_cast<const FcgiEndRequest *>(payload.data());
+
+	const DestructObserver destructed(*this);
+
+	switch (static_cast<FcgiProtocolStatus>(end_request.protocol_status)) {
+	case FcgiProtocolStatus::REQUEST_COMPLETE:
+		request.OnEndRequest();
+		return !destructed;
+
+	case FcgiProtocolStatus::CANT_MPX_CONN:
+		/* the application has announced FCGI_MPXS_CONNS, but
+		   refuses to do it; fail all requests (they may be
+		   retried on a new connection) and fall back to one
+		   connection per request */
+		if (!AbortRequests(std::make_exception_ptr(FcgiClientError(FcgiClientErrorCode::REFUSED,
+									   "FastCGI application cannot multiplex"))))
+			return false;
+
+		handler.OnFcgiMuxUnsupported();
+		return false;
+
+	case FcgiProtocolStatus::OVERLOADED:
+		request.AbortError(std::make_exception_ptr(FcgiClientError(FcgiClientErrorCode::REFUSED,
+									   "FastCGI application is overloaded")));
+		return !destructed;
+
+	case FcgiProtocolStatus::UNKNOWN_ROLE:
+		break;
+	}
+
+	request.AbortError(std::make_exception_ptr(FcgiClientError(FcgiClientErrorCode::GARBAGE,
+								   "FastCGI application has rejected the request")));
+	return !destructed;
+}
+
+BufferedResult
+FcgiMuxConnection::OnBufferedData()
+{
+	RefreshTimeout();
+
+	FcgiParser::FeedResult result;
+
+	try {
+		result = parser.Feed(socket.ReadBuffer(), *this);
+	} catch (...) {
+		Abort(std::current_exception());
+		return BufferedResult::DESTROYED;
+	}
+
+	if (result == FcgiParser::FeedResult::CLOSED)
+		return BufferedResult::DESTROYED;
+
+	socket.AfterConsumed();
+
+	switch (result) {
+	case FcgiParser::FeedResult::OK:
+	case FcgiParser::FeedResult::MORE:
+		return BufferedResult::MORE;
+
+	case FcgiParser::FeedResult::BLOCKING:
+	case FcgiParser::FeedResult::STOP:
+		return BufferedResult::OK;
+
+	case FcgiParser::FeedResult::CLOSED:
+		break;
+	}
+
+	std::unreachable();
+}
+
+bool
+FcgiMuxConnection::OnBufferedClosed() noexcept
+{
+	Abort(std::make_exception_ptr(SocketClosedPrematurelyError{}));
+	return false;
+}
+
+bool
+FcgiMuxConnection::OnBufferedWrite()
+{
+	return Flush();
+}
+
+void
+FcgiMuxConnection::OnBufferedError(std::exception_ptr e) noexcept
+{
+	Abort(std::move(e));
+}
+
+void
+FcgiMuxConnection::OnFrameConsumed(std::size_t nbytes) noexcept
+{
+	socket.DisposeConsumed(nbytes);
+}
+
+FcgiFrameHandler::FrameResult
+FcgiMuxConnection::OnFrameHeader(FcgiRecordType type, uint_least16_t request_id)
+{
+	current = nullptr;
+	current_type = type;
+	record_fill = 0;
+
+	if (request_id == 0)
+		/* a management record */
+		return type == FcgiRecordType::GET_VALUES_RESULT &&
+			state == State::PROBE
+			? FrameResult::CONTINUE
+			: FrameResult::SKIP;
+
+	switch (type) {
+	case FcgiRecordType::STDOUT:
+	case FcgiRecordType::STDERR:
+	case FcgiRecordType::END_REQUEST:
+		current = FindRequest(request_id);
+
+		/* if the request is unknown (because it was canceled
+		   already), the record is discarded */
+		return current != nullptr
+			? FrameResult::CONTINUE
+			: FrameResult::SKIP;
+
+	default:
+		return FrameResult::SKIP;
+	}
+}
+
+std::pair<FcgiFrameHandler::FrameResult, std::size_t>
+FcgiMuxConnection::OnFramePayload(std::span<const std::byte> src)
+{
+	switch (current_type) {
+	case FcgiRecordType::STDOUT:
+		if (current != nullptr) {
+			const DestructObserver destructed(*this);
+			const std::size_t nbytes = current->OnStdout(src);
+			if (destructed)
+				return {FrameResult::CLOSED, 0};
+
+			return {FrameResult::CONTINUE, nbytes};
+		}
+
+		break;
+
+	case FcgiRecordType::STDERR:
+		if (current != nullptr)
+			current->OnStderr(src);
+		break;
+
+	case FcgiRecordType::GET_VALUES_RESULT:
+	case FcgiRecordType::END_REQUEST:
+		{
+			/* collect the (small) payload; excess data
+			   is ignored */
+			const std::size_t n = std::min(src.size(),
+						       sizeof(record_buffer) - record_fill);
+			std::copy_n(src.begin(), n, record_buffer + record_fill);
+			record_fill += n;
+		}
+
+		break;
+
+	default:
+		break;
+	}
+
+	return {FrameResult::CONTINUE, src.size()};
+}
+
+FcgiFrameHandler::FrameResult
+FcgiMuxConnection::OnFrameEnd()
+{
+	const std::span<const std::byte> payload{record_buffer, record_fill};
+
+	switch (current_type) {
+	case FcgiRecordType::GET_VALUES_RESULT:
+		if (state == State::PROBE &&
+		    !HandleGetValuesResult(payload))
+			return FrameResult::CLOSED;
+
+		break;
+
+	case FcgiRecordType::END_REQUEST:
+		if (current != nullptr) {
+			auto &request = *current;
+			current = nullptr;
+
+			if (!HandleEndRequest(request, payload))
+				return FrameResult::CLOSED;
+		}
+
+		break;
+
+	default:
+		break;
+	}
+
+	return FrameResult::CONTINUE;
+}
@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#pragma once
+
+#include "Parser.hxx"
+#include "event/net/BufferedSocket.hxx"
+#include "event/CoarseTimerEvent.hxx"
+#include "event/DeferEvent.hxx"
+#include "memory/GrowingBuffer.hxx"
+#include "util/DestructObserver.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <span>
+
+enum class HttpMethod : uint_least8_t;
+struct pool;
+class UnusedIstreamPtr;
+class UniqueFileDescriptor;
+class UniqueSocketDescriptor;
+class StringMap;
+class Lease;
+class HttpResponseHandler;
+class CancellablePointer;
+class StopwatchPtr;
+
+class FcgiMuxConnectionHandler {
+public:
+	/**
+	 * The FastCGI application has announced that it supports
+	 * multiplexing (FCGI_MPXS_CONNS).  From now on,
+	 * FcgiMuxConnection::IsReady() may return true.
+	 */
+	virtual void OnFcgiMuxReady() noexcept = 0;
+
+	/**
+	 * The FastCGI application does not support multiplexing.
+	 * All pending requests have been aborted.  The handler is
+	 * expected to destroy the #FcgiMuxConnection.
+	 */
+	virtual void OnFcgiMuxUnsupported() noexcept = 0;
+
+	/**
+	 * The connection has failed.  All pending requests have been
+	 * aborted.  The handler is expected to destroy the
+	 * #FcgiMuxConnection.
+	 */
+	virtual void OnFcgiMuxError(std::exception_ptr error) noexcept = 0;
+};
+
+/**
+ * A connection to a FastCGI application which sends multiple
+ * concurrent requests (with distinct request ids) over one socket.
+ *
+ * Unless created with "probed=true", it first asks the application
+ * with a GET_VALUES record whether it supports this
+ * (FCGI_MPXS_CONNS); until the answer has been received, no requests
+ * can be sent.
+ */
+class FcgiMuxConnection final
+	: BufferedSocketHandler, FcgiFrameHandler, DestructAnchor
+{
+	FcgiMuxConnectionHandler &handler;
+
+	BufferedSocket socket;
+
+	/**
+	 * Data to be sent to the application.  Records are always
+	 * appended as a whole, so records of different requests are
+	 * never interleaved.
+	 */
+	GrowingBuffer output;
+
+	FcgiParser parser;
+
+	/**
+	 * Flushes #output.
+	 */
+	DeferEvent defer_write;
+
+	/**
+	 * Resumes parsing the input after a response body handler
+	 * has consumed data from its buffer.
+	 */
+	DeferEvent defer_read;
+
+	/**
+	 * Aborts the GET_VALUES request or all pending requests if
+	 * the application does not respond.  It is not running while
+	 * #read_blocked is set.
+	 */
+	CoarseTimerEvent timeout_event;
+
+	class Request;
+	using RequestList = IntrusiveList<
+		Request,
+		IntrusiveListBaseHookTraits<Request>,
+		IntrusiveListOptions{.constant_time_size = true}>;
+
+	RequestList requests;
+
+	/**
+	 * The request which receives the payload of the current
+	 * record.  This is nullptr if the payload shall be discarded.
+	 */
+	Request *current = nullptr;
+
+	/**
+	 * The maximum number of concurrent requests announced by the
+	 * application (FCGI_MAX_REQS).
+	 */
+	std::size_t max_requests = std::numeric_limits<std::size_t>::max();
+
+	/**
+	 * Collects the payload of a GET_VALUES_RESULT or END_REQUEST
+	 * record.
+	 */
+	std::byte record_buffer[256];
+	std::size_t record_fill;
+
+	uint_least16_t next_request_id = 0;
+
+	FcgiRecordType current_type;
+
+	enum class State : uint_least8_t {
+		/**
+		 * Waiting for the GET_VALUES_RESULT record.
+		 */
+		PROBE,
+
+		READY,
+	} state;
+
+	/**
+	 * Set if the response body buffer of the only request was
+	 * full; parsing the input will resume as soon as data gets
+	 * consumed or another request is sent.
+	 */
+	bool read_blocked = false;
+
+public:
+	/**
+	 * @param probed true if the application is already known to
+	 * support multiplexing, i.e. GET_VALUES can be skipped
+	 */
+	FcgiMuxConnection(EventLoop &event_loop, UniqueSocketDescriptor &&fd,
+			  bool probed,
+			  FcgiMuxConnectionHandler &_handler) noexcept;
+
+	~FcgiMuxConnection() noexcept;
+
+	auto &GetEventLoop() const noexcept {
+		return defer_write.GetEventLoop();
+	}
+
+	/**
+	 * Has the application confirmed that it supports
+	 * multiplexing, i.e. can requests be sent on this connection?
+	 */
+	bool IsReady() const noexcept {
+		return state == State::READY;
+	}
+
+	/**
+	 * Has the maximum number of concurrent requests announced by
+	 * the application (FCGI_MAX_REQS) been reached?
+	 */
+	bool IsFull() const noexcept {
+		return requests.size() >= max_requests;
+	}
+
+	/**
+	 * Send a request to the FastCGI application.  The parameters
+	 * are the same as for fcgi_client_request().
+	 *
+	 * @param lease will be released when the response has been
+	 * received completely (or when the request gets aborted)
+	 */
+	void SendRequest(struct pool &pool,
+			 StopwatchPtr stopwatch,
+			 Lease &lease,
+			 HttpMethod method, const char *uri,
+			 const char *script_filename,
+			 const char *script_name, const char *path_info,
+			 const char *query_string,
+			 const char *document_root,
+			 const char *remote_addr,
+			 const StringMap &headers, UnusedIstreamPtr body,
+			 std::span<const char *const> params,
+			 UniqueFileDescriptor &&stderr_fd,
+			 HttpResponseHandler &handler,
+			 CancellablePointer &cancel_ptr) noexcept;
+
+private:
+	[[gnu::pure]]
+	Request *FindRequest(uint_least16_t id) noexcept;
+
+	uint_least16_t MakeRequestId() noexcept;
+
+	void RemoveRequest(Request &request) noexcept;
+
+	/**
+	 * @return false if this object has been destroyed
+	 */
+	bool AbortRequests(std::exception_ptr error) noexcept;
+
+	/**
+	 * Abort all requests, then invoke
+	 * FcgiMuxConnectionHandler::OnFcgiMuxError().  The caller
+	 * must assume that this object has been destroyed.
+	 */
+	void Abort(std::exception_ptr error) noexcept;
+
+	/**
+	 * Is #output so large that request bodies should wait until
+	 * it has been flushed?
+	 */
+	[[gnu::pure]]
+	bool IsOutputFull() const noexcept;
+
+	void WriteRecord(FcgiRecordType type, uint_least16_t request_id,
+			 std::span<const std::byte> payload={}) noexcept;
+
+	void DeferWrite() noexcept {
+		defer_write.Schedule();
+	}
+
+	/**
+	 * @return false if this object has been destroyed
+	 */
+	bool Flush() noexcept;
+
+	/**
+	 * Stop reading from the socket until a response body handler
+	 * has consumed data.
+	 */
+	void BlockRead() noexcept {
+		read_blocked = true;
+		timeout_event.Cancel();
+	}
+
+	void OnDeferredWrite() noexcept;
+	void OnDeferredRead() noexcept;
+	void OnTimeout() noexcept;
+
+	/**
+	 * (Re)start the response timeout if there are pending
+	 * requests.
+	 */
+	void RefreshTimeout() noexcept;
+
+	void SendGetValues() noexcept;
+
+	/**
+	 * Throws on error.
+	 *
+	 * @return false if this object has been destroyed
+	 */
+	bool HandleGetValuesResult(std::span<const std::byte> payload);
+
+	/**
+	 * Throws on error.
+	 *
+	 * @return false if this object has been destroyed
+	 */
+	bool HandleEndRequest(Request &request,
+			      std::span<const std::byte> payload);
+
+	/* virtual methods from class BufferedSocketHandler */
+	BufferedResult OnBufferedData() override;
+	bool OnBufferedClosed() noexcept override;
+	bool OnBufferedWrite() override;
+	void OnBufferedError(std::exception_ptr e) noexcept override;
+
+	/* virtual methods from class FcgiFrameHandler */
+	void OnFrameConsumed(std::size_t nbytes) noexcept override;
+	FrameResult OnFrameHeader(FcgiRecordType type, uint_least16_t request_id) override;
+	std::pair<FrameResult, std::size_t> OnFramePayload(std::span<const std::byte> src) override;
+	FrameResult OnFrameEnd() override;
+};
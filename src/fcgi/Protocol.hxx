@@ -8,6 +8,7 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <string_view>
 
 static constexpr uint8_t FCGI_VERSION_1 = 1;
 
@@ -41,6 +42,13 @@ struct FcgiRecordHeader {
 static_assert(sizeof(FcgiRecordHeader) == 8, "Wrong FastCGI header size");
 static_assert(alignof(FcgiRecordHeader) == 1);
 
+/*
+ * Variable names for GET_VALUES and GET_VALUES_RESULT
+ */
+static constexpr std::string_view FCGI_MAX_CONNS = "FCGI_MAX_CONNS";
+static constexpr std::string_view FCGI_MAX_REQS = "FCGI_MAX_REQS";
+static constexpr std::string_view FCGI_MPXS_CONNS = "FCGI_MPXS_CONNS";
+
 /*
  * Values for role component of FCGI_BeginRequestBody
  */
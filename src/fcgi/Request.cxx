@@ -6,6 +6,7 @@
 #include "Stock.hxx"
 #include "SConnection.hxx"
 #include "Client.hxx"
+#include "Error.hxx"
 #include "http/PendingRequest.hxx"
 #include "http/ResponseHandler.hxx"
 #include "cgi/Address.hxx"
@@ -168,6 +169,36 @@ FcgiRequest::OnStockItemReady(StockItem &item) noexcept
 
 	const char *script_filename = address.path;
 
+	if (fcgi_stock_item_is_multiplexed(*stock_item)) {
+		auto *mux = fcgi_stock_item_get_mux(*stock_item);
+		if (mux == nullptr) [[unlikely]] {
+			/* the multiplexed connection has failed
+			   meanwhile */
+			auto &_item = *stock_item;
+			stock_item = nullptr;
+			_item.Put(PutAction::DESTROY);
+
+			OnStockItemError(std::make_exception_ptr(FcgiClientError(FcgiClientErrorCode::IO,
+										  "FastCGI connection lost")));
+			return;
+		}
+
+		mux->SendRequest(pool, std::move(stopwatch),
+				 *this,
+				 pending_request.method, pending_request.uri,
+				 script_filename,
+				 address.script_name, address.path_info,
+				 address.query_string,
+				 address.document_root,
+				 remote_addr,
+				 pending_request.headers,
+				 std::move(pending_request.body),
+				 address.params.ToArray(pool),
+				 std::move(stderr_fd2),
+				 *this, cancel_ptr);
+		return;
+	}
+
 	fcgi_client_request(&pool, std::move(stopwatch),
 			    fcgi_stock_item_get(*stock_item),
 			    *this,
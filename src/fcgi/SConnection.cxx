@@ -8,11 +8,10 @@
 
 #include <utility> // for std::unreachable()
 
-FcgiStockConnection::FcgiStockConnection(CreateStockItem c, ListenChildStockItem &_child,
+FcgiStockConnection::FcgiStockConnection(CreateStockItem c, FcgiChild &_child,
 					 UniqueSocketDescriptor &&_socket) noexcept
-	:StockItem(c),
+	:FcgiStockItem(c, _child, false),
 	 logger(GetStockNameView()),
-	 child(_child),
 	 socket(GetStock().GetEventLoop())
 {
 	socket.Init(_socket.Release(), FdType::FD_SOCKET, Event::Duration{-1}, *this);
@@ -21,13 +20,6 @@ FcgiStockConnection::FcgiStockConnection(CreateStockItem c, ListenChildStockItem
 
 FcgiStockConnection::~FcgiStockConnection() noexcept = default;
 
-void
-FcgiStockConnection::SetAborted() noexcept
-{
-	if (fresh)
-		child.Fade();
-}
-
 BufferedResult
 FcgiStockConnection::OnBufferedData()
 {
@@ -76,6 +68,11 @@ FcgiStockConnection::Borrow() noexcept
 		return false;
 	}
 
+	if (child.GetMuxConnection() != nullptr)
+		/* the child supports multiplexing; don't use this
+		   dedicated connection anymore */
+		return false;
+
 	return true;
 }
 
@@ -4,42 +4,57 @@
 
 #pragma once
 
-#include "spawn/ListenChildStock.hxx"
+#include "Child.hxx"
 #include "stock/Item.hxx"
 #include "event/net/BufferedSocket.hxx"
 #include "io/Logger.hxx"
 
 class UniqueSocketDescriptor;
 
-class FcgiStockConnection final : public StockItem, BufferedSocketHandler {
-	const LLogger logger;
-
-	ListenChildStockItem &child;
-
-	BufferedSocket socket;
+/**
+ * Base class for the items managed by #FcgiStock.
+ */
+class FcgiStockItem : public StockItem {
+protected:
+	FcgiChild &child;
 
 	/**
 	 * Is this a fresh connection to the FastCGI child process?
 	 */
 	bool fresh = true;
 
+private:
+	/**
+	 * Are requests sent over the child's #FcgiMuxConnection
+	 * instead of a connection owned by this item?
+	 */
+	const bool multiplexed;
+
 public:
-	explicit FcgiStockConnection(CreateStockItem c, ListenChildStockItem &_child,
-				     UniqueSocketDescriptor &&socket) noexcept;
+	FcgiStockItem(CreateStockItem c, FcgiChild &_child,
+		      bool _multiplexed) noexcept
+		:StockItem(c), child(_child), multiplexed(_multiplexed) {}
 
-	~FcgiStockConnection() noexcept override;
+	bool IsMultiplexed() const noexcept {
+		return multiplexed;
+	}
+
+	/**
+	 * Returns the multiplexed connection to send the request
+	 * over.  May return nullptr if that connection has failed
+	 * meanwhile.
+	 */
+	FcgiMuxConnection *GetMuxConnection() noexcept {
+		assert(multiplexed);
+
+		return child.GetMuxConnection();
+	}
 
 	[[gnu::pure]]
 	std::string_view GetTag() const noexcept {
 		return child.GetTag();
 	}
 
-	BufferedSocket &GetSocket() noexcept {
-		assert(socket.IsConnected());
-
-		return socket;
-	}
-
 	UniqueFileDescriptor GetStderr() const noexcept {
 		return child.GetStderr();
 	}
@@ -52,7 +67,32 @@ public:
 		child.SetUri(uri);
 	}
 
-	void SetAborted() noexcept;
+	void SetAborted() noexcept {
+		if (fresh)
+			child.Fade();
+	}
+};
+
+/**
+ * A dedicated connection to the FastCGI child process which handles
+ * one request at a time.
+ */
+class FcgiStockConnection final : public FcgiStockItem, BufferedSocketHandler {
+	const LLogger logger;
+
+	BufferedSocket socket;
+
+public:
+	explicit FcgiStockConnection(CreateStockItem c, FcgiChild &_child,
+				     UniqueSocketDescriptor &&socket) noexcept;
+
+	~FcgiStockConnection() noexcept override;
+
+	BufferedSocket &GetSocket() noexcept {
+		assert(socket.IsConnected());
+
+		return socket;
+	}
 
 	/* virtual methods from class StockItem */
 	bool Borrow() noexcept override;
@@ -67,20 +107,62 @@ private:
 	void OnBufferedError(std::exception_ptr e) noexcept override;
 };
 
+/**
+ * An item without its own connection; the request is sent over the
+ * child's #FcgiMuxConnection.  This only exists so #MultiStock can
+ * enforce the concurrency limit.
+ */
+class FcgiMuxChannel final : public FcgiStockItem {
+public:
+	FcgiMuxChannel(CreateStockItem c, FcgiChild &_child) noexcept
+		:FcgiStockItem(c, _child, true) {}
+
+	/* virtual methods from class StockItem */
+	bool Borrow() noexcept override {
+		auto *mux = child.GetMuxConnection();
+		return mux != nullptr && !mux->IsFull();
+	}
+
+	bool Release() noexcept override {
+		fresh = false;
+		return true;
+	}
+};
+
 static inline void
 fcgi_stock_item_set_site(StockItem &item, const char *site) noexcept
 {
-	auto &connection = (FcgiStockConnection &)item;
+	auto &connection = (FcgiStockItem &)item;
 	connection.SetSite(site);
 }
 
 static inline void
 fcgi_stock_item_set_uri(StockItem &item, const char *uri) noexcept
 {
-	auto &connection = (FcgiStockConnection &)item;
+	auto &connection = (FcgiStockItem &)item;
 	connection.SetUri(uri);
 }
 
+/**
+ * Does the specified stock item send requests over the child's
+ * #FcgiMuxConnection?  If yes, use fcgi_stock_item_get_mux(),
+ * else fcgi_stock_item_get().
+ */
+[[gnu::pure]]
+static inline bool
+fcgi_stock_item_is_multiplexed(const StockItem &item) noexcept
+{
+	const auto &connection = (const FcgiStockItem &)item;
+	return connection.IsMultiplexed();
+}
+
+static inline FcgiMuxConnection *
+fcgi_stock_item_get_mux(StockItem &item) noexcept
+{
+	auto &connection = (FcgiStockItem &)item;
+	return connection.GetMuxConnection();
+}
+
 /**
  * Returns the socket of the specified stock item.
  */
@@ -95,7 +177,7 @@ fcgi_stock_item_get(StockItem &item) noexcept
 static inline UniqueFileDescriptor
 fcgi_stock_item_get_stderr(const StockItem &item) noexcept
 {
-	const auto &connection = (const FcgiStockConnection &)item;
+	const auto &connection = (const FcgiStockItem &)item;
 	return connection.GetStderr();
 }
 
@@ -109,7 +191,7 @@ fcgi_stock_item_get_stderr(const StockItem &item) noexcept
 static inline void
 fcgi_stock_aborted(StockItem &item) noexcept
 {
-	auto *connection = (FcgiStockConnection *)&item;
+	auto *connection = (FcgiStockItem *)&item;
 
 	connection->SetAborted();
 }
@@ -4,15 +4,25 @@
 
 #include "Serialize.hxx"
 #include "Protocol.hxx"
+#include "Error.hxx"
 #include "memory/GrowingBuffer.hxx"
+#include "http/CommonHeaders.hxx"
+#include "http/Method.hxx"
 #include "strmap.hxx"
+#include "product.h"
 #include "util/ByteOrder.hxx"
 #include "util/CharUtil.hxx"
+#include "util/SpanCast.hxx"
 #include "util/StringAPI.hxx"
+#include "util/StringSplit.hxx"
+
+#include <fmt/format.h>
 
 #include <cassert>
 #include <cstdint>
 
+#include <string.h>
+
 FcgiRecordSerializer::FcgiRecordSerializer(GrowingBuffer &_buffer,
 					   FcgiRecordType type,
 					   uint16_t request_id_be) noexcept
@@ -65,6 +75,11 @@ FcgiParamsSerializer::FcgiParamsSerializer(GrowingBuffer &_buffer,
 					   uint16_t request_id_be) noexcept
 	:record(_buffer, FcgiRecordType::PARAMS, request_id_be) {}
 
+FcgiParamsSerializer::FcgiParamsSerializer(GrowingBuffer &_buffer,
+					   FcgiRecordType type,
+					   uint16_t request_id_be) noexcept
+	:record(_buffer, type, request_id_be) {}
+
 FcgiParamsSerializer &
 FcgiParamsSerializer::operator()(std::string_view name,
 				 std::string_view value) noexcept
@@ -98,3 +113,112 @@ FcgiParamsSerializer::Headers(const StringMap &headers) noexcept
 		(*this)({buffer, 5 + i}, pair.value);
 	}
 }
+
+void
+SerializeFcgiRequest(GrowingBuffer &buffer, uint16_t request_id,
+		     HttpMethod method, const char *uri,
+		     const char *script_filename,
+		     const char *script_name, const char *path_info,
+		     const char *query_string,
+		     const char *document_root,
+		     const char *remote_addr,
+		     const StringMap &headers, off_t content_length,
+		     std::span<const char *const> params) noexcept
+{
+	const FcgiRecordHeader header{
+		.version = FCGI_VERSION_1,
+		.type = FcgiRecordType::BEGIN_REQUEST,
+		.request_id = request_id,
+		.content_length = sizeof(FcgiBeginRequest),
+	};
+	static constexpr FcgiBeginRequest begin_request{
+		.role = static_cast<uint16_t>(FcgiRole::RESPONDER),
+		.flags = FCGI_FLAG_KEEP_CONN,
+	};
+
+	assert(http_method_is_valid(method));
+
+	buffer.WriteT(header);
+	buffer.WriteT(begin_request);
+
+	FcgiParamsSerializer ps(buffer, request_id);
+
+	ps("REQUEST_METHOD", http_method_to_string(method))
+		("REQUEST_URI", uri)
+		("SCRIPT_FILENAME", script_filename)
+		("SCRIPT_NAME", script_name)
+		("PATH_INFO", path_info)
+		("QUERY_STRING", query_string)
+		("DOCUMENT_ROOT", document_root)
+		("SERVER_SOFTWARE", PRODUCT_TOKEN);
+
+	if (remote_addr != nullptr)
+		ps("REMOTE_ADDR", remote_addr);
+
+	if (content_length >= 0) {
+		const fmt::format_int value{content_length};
+
+		ps("HTTP_CONTENT_LENGTH", value.c_str())
+			/* PHP wants the parameter without
+			   "HTTP_" */
+			("CONTENT_LENGTH", value.c_str());
+	}
+
+	if (const char *content_type = headers.Get(content_type_header);
+	    content_type != nullptr)
+		/* same for the "Content-Type" request
+		   header */
+		ps("CONTENT_TYPE", content_type);
+
+	if (const char *https = headers.Get(x_cm4all_https_header);
+	    https != nullptr && strcmp(https, "on") == 0)
+		ps("HTTPS", https);
+
+	ps.Headers(headers);
+
+	for (const std::string_view param : params) {
+		const auto [name, value] = Split(param, '=');
+		if (!name.empty() && value.data() != nullptr)
+			ps(name, value);
+	}
+
+	ps.Commit();
+}
+
+static std::size_t
+fcgi_deserialize_length(std::span<const std::byte> &src)
+{
+	if (src.empty())
+		throw FcgiClientError{FcgiClientErrorCode::GARBAGE, "Truncated FastCGI name-value pair"};
+
+	if ((static_cast<uint8_t>(src.front()) & 0x80) == 0) {
+		const std::size_t length = static_cast<uint8_t>(src.front());
+		src = src.subspan(1);
+		return length;
+	}
+
+	if (src.size() < sizeof(uint32_t))
+		throw FcgiClientError{FcgiClientErrorCode::GARBAGE, "Truncated FastCGI name-value pair"};
+
+	uint32_t length;
+	memcpy(&length, src.data(), sizeof(length));
+	src = src.subspan(sizeof(length));
+	return FromBE32(length) & 0x7fffffff;
+}
+
+std::pair<std::string_view, std::string_view>
+DeserializeFcgiPair(std::span<const std::byte> &src)
+{
+	const std::size_t name_length = fcgi_deserialize_length(src);
+	const std::size_t value_length = fcgi_deserialize_length(src);
+
+	if (src.size() < name_length + value_length)
+		throw FcgiClientError{FcgiClientErrorCode::GARBAGE, "Truncated FastCGI name-value pair"};
+
+	const auto name = ToStringView(src.first(name_length));
+	src = src.subspan(name_length);
+	const auto value = ToStringView(src.first(value_length));
+	src = src.subspan(value_length);
+
+	return {name, value};
+}
@@ -8,11 +8,15 @@
 
 #pragma once
 
+#include <span>
 #include <string_view>
+#include <utility> // for std::pair
 
 #include <stdint.h>
 #include <stddef.h>
+#include <sys/types.h> // for off_t
 
+enum class HttpMethod : uint_least8_t;
 enum class FcgiRecordType : uint8_t;
 struct FcgiRecordHeader;
 class GrowingBuffer;
@@ -42,6 +46,13 @@ public:
 	FcgiParamsSerializer(GrowingBuffer &_buffer,
 			     uint16_t request_id_be) noexcept;
 
+	/**
+	 * Serialize name-value pairs into a record of a different
+	 * type, e.g. #FcgiRecordType::GET_VALUES.
+	 */
+	FcgiParamsSerializer(GrowingBuffer &_buffer, FcgiRecordType type,
+			     uint16_t request_id_be) noexcept;
+
 	FcgiParamsSerializer &operator()(std::string_view name,
 					 std::string_view value) noexcept;
 
@@ -59,3 +70,31 @@ public:
 		record.Commit(content_length);
 	}
 };
+
+/**
+ * Serialize the BEGIN_REQUEST and PARAMS records of a "responder"
+ * request (but not the empty PARAMS record which terminates the
+ * parameter stream).
+ *
+ * @param content_length the length of the request body or -1 if
+ * unknown or if there is no request body
+ */
+void
+SerializeFcgiRequest(GrowingBuffer &buffer, uint16_t request_id,
+		     HttpMethod method, const char *uri,
+		     const char *script_filename,
+		     const char *script_name, const char *path_info,
+		     const char *query_string,
+		     const char *document_root,
+		     const char *remote_addr,
+		     const StringMap &headers, off_t content_length,
+		     std::span<const char *const> params) noexcept;
+
+/**
+ * Deserialize one name-value pair (e.g. from a GET_VALUES_RESULT
+ * record) and remove it from the front of the given buffer.
+ *
+ * Throws on error.
+ */
+std::pair<std::string_view, std::string_view>
+DeserializeFcgiPair(std::span<const std::byte> &src);
@@ -120,6 +120,21 @@ FcgiStock::GetChildTag(const void *info) const noexcept
 	return params.options.tag;
 }
 
+std::unique_ptr<ChildStockItem>
+FcgiStock::CreateChild(CreateStockItem c,
+		       const void *info,
+		       ChildStock &_child_stock)
+{
+	const auto &params = *(const CgiChildParams *)info;
+
+	/* multiplexing is only useful if the application handles
+	   concurrent requests; with concurrency=1, MultiStock would
+	   never send more than one request anyway */
+	return std::make_unique<FcgiChild>(c, _child_stock,
+					   GetChildTag(info),
+					   params.concurrency > 1);
+}
+
 void
 FcgiStock::PrepareChild(const void *info, PreparedChildProcess &p,
 			FdHolder &close_fds)
@@ -159,7 +174,10 @@ FcgiStock::PrepareListenChild(const void *, UniqueSocketDescriptor fd,
 StockItem *
 FcgiStock::Create(CreateStockItem c, StockItem &shared_item)
 {
-	auto &child = (ListenChildStockItem &)shared_item;
+	auto &child = (FcgiChild &)shared_item;
+
+	if (child.MakeMuxConnection() != nullptr)
+		return new FcgiMuxChannel(c, child);
 
 	try {
 		return new FcgiStockConnection(c, child, child.Connect());
@@ -72,6 +72,9 @@ private:
 	bool WantStderrFd(const void *info) const noexcept override;
 	bool WantStderrPond(const void *info) const noexcept override;
 	std::string_view GetChildTag(const void *info) const noexcept override;
+	std::unique_ptr<ChildStockItem> CreateChild(CreateStockItem c,
+						    const void *info,
+						    ChildStock &child_stock) override;
 	void PrepareChild(const void *info, PreparedChildProcess &p,
 			  FdHolder &close_fds) override;
 
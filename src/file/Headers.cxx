@@ -8,9 +8,12 @@
 #include "http/CommonHeaders.hxx"
 #include "http/Date.hxx"
 #include "io/FileDescriptor.hxx"
+#include "io/FileMetadata.hxx"
 #include "util/Base32.hxx"
 #include "AllocatorPtr.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -58,20 +61,53 @@ static_etag(char *p, const struct statx &st) noexcept
 	*p = 0;
 }
 
+/**
+ * Copy a cached xattr value to the caller's buffer.
+ *
+ * @return false if the value is empty (i.e. the xattr does not
+ * exist) or if it does not fit into the buffer
+ */
+static bool
+CopyCachedValue(char *buffer, size_t size, const std::string &value) noexcept
+{
+	if (value.empty() || value.size() >= size)
+		return false;
+
+	*std::copy(value.begin(), value.end(), buffer) = 0;
+	return true;
+}
+
 void
 GetAnyETag(char *buffer, size_t size,
 	   FileDescriptor fd, const struct statx &st,
-	   bool use_xattr) noexcept
+	   bool use_xattr, FileMetadata *metadata) noexcept
 {
-	if (!use_xattr || !fd.IsDefined() || !ReadETag(fd, buffer, size))
-		static_etag(buffer, st);
+	if (use_xattr && fd.IsDefined()) {
+		if (metadata == nullptr) {
+			if (ReadETag(fd, buffer, size))
+				return;
+		} else {
+			if (!metadata->etag) {
+				/* load into a buffer of fixed size so
+				   the cached value does not depend on
+				   the first caller's buffer */
+				char tmp[512];
+				metadata->etag.emplace(ReadETag(fd, tmp, sizeof(tmp))
+						       ? tmp : "");
+			}
+
+			if (CopyCachedValue(buffer, size, *metadata->etag))
+				return;
+		}
+	}
+
+	static_etag(buffer, st);
 }
 
-bool
-load_xattr_content_type(char *buffer, size_t size, FileDescriptor fd) noexcept
+static bool
+ReadContentType(FileDescriptor fd, char *buffer, size_t size) noexcept
 {
-	if (!fd.IsDefined())
-		return false;
+	assert(fd.IsDefined());
 
 	ssize_t nbytes = fgetxattr(fd.Get(), "user.Content-Type",
 				   buffer, size - 1);
@@ -83,6 +119,25 @@ load_xattr_content_type(char *buffer, size_t size, FileDescriptor fd) noexcept
 	return true;
 }
 
+bool
+load_xattr_content_type(char *buffer, size_t size, FileDescriptor fd,
+			FileMetadata *metadata) noexcept
+{
+	if (!fd.IsDefined())
+		return false;
+
+	if (metadata == nullptr)
+		return ReadContentType(fd, buffer, size);
+
+	if (!metadata->content_type) {
+		char tmp[256];
+		metadata->content_type.emplace(ReadContentType(fd, tmp, sizeof(tmp))
+					       ? tmp : "");
+	}
+
+	return CopyCachedValue(buffer, size, *metadata->content_type);
+}
+
 StringMap
 static_response_headers(struct pool &pool,
 			FileDescriptor fd, const struct statx &st,
@@ -15,14 +15,24 @@ struct pool;
 class FileDescriptor;
 class StringMap;
 struct statx;
+struct FileMetadata;
 
+/**
+ * @param metadata an optional cache for the "user.ETag" xattr; if
+ * it has been loaded already, then no system call is needed
+ */
 void
 GetAnyETag(char *buffer, size_t size,
 	   FileDescriptor fd, const struct statx &st,
-	   bool use_xattr) noexcept;
+	   bool use_xattr, FileMetadata *metadata=nullptr) noexcept;
 
+/**
+ * @param metadata an optional cache for the "user.Content-Type"
+ * xattr
+ */
 bool
-load_xattr_content_type(char *buffer, size_t size, FileDescriptor fd) noexcept;
+load_xattr_content_type(char *buffer, size_t size, FileDescriptor fd,
+			FileMetadata *metadata=nullptr) noexcept;
 
 /**
  * @param fd a file descriptor for loading xattr, or -1 to disable
@@ -129,6 +129,27 @@ public:
 			: FdType::FD_NONE;
 	}
 
+	/**
+	 * May data be written directly to the socket (bypassing the
+	 * filter), e.g. with WriteV() or WriteFrom()?  This is the
+	 * case if there is no filter or if the filter has offloaded
+	 * its output to the kernel.
+	 */
+	[[nodiscard]] [[gnu::pure]]
+	bool IsOutputDirect() const noexcept {
+		return filter == nullptr || filter->IsOutputOffloaded();
+	}
+
+	/**
+	 * Like GetType(), but for writing to the socket.
+	 */
+	[[nodiscard]] [[gnu::pure]]
+	FdType GetOutputType() const noexcept {
+		return IsOutputDirect()
+			? base.GetType()
+			: FdType::FD_NONE;
+	}
+
 	/**
 	 * Install a callback that will be invoked as soon as the filter's
 	 * protocol "handshake" is complete.  Before this time, no data
@@ -287,7 +308,7 @@ public:
 
 	[[nodiscard]]
 	ssize_t WriteV(std::span<const struct iovec> v) noexcept {
-		assert(filter == nullptr);
+		assert(IsOutputDirect());
 
 		return base.WriteV(v);
 	}
@@ -295,14 +316,14 @@ public:
 	[[nodiscard]]
 	ssize_t WriteFrom(FileDescriptor fd, FdType fd_type, off_t *offset,
 			  std::size_t length) noexcept {
-		assert(filter == nullptr);
+		assert(IsOutputDirect());
 
 		return base.WriteFrom(fd, fd_type, offset, length);
 	}
 
 	[[nodiscard]] [[gnu::pure]]
 	bool IsReadyForWriting() const noexcept {
-		assert(filter == nullptr);
+		assert(IsOutputDirect());
 
 		return base.IsReadyForWriting();
 	}
@@ -97,6 +97,16 @@ public:
 		return socket->GetType();
 	}
 
+	/**
+	 * @see FilteredSocket::IsOutputDirect()
+	 */
+	[[gnu::pure]]
+	bool IsOutputDirect() const noexcept {
+		assert(!IsReleased());
+
+		return socket->IsOutputDirect();
+	}
+
 	void SetDirect(bool _direct) noexcept {
 		assert(!IsReleased());
 
@@ -67,6 +67,17 @@ public:
 	[[nodiscard]]
 	virtual ssize_t Write(std::span<const std::byte> src) noexcept = 0;
 
+	/**
+	 * Has the filter handed over output filtering to the kernel
+	 * (e.g. kernel TLS), and has all of its own output been
+	 * flushed?  If yes, the client may write directly to the
+	 * underlying socket, e.g. with splice() or sendfile().
+	 */
+	[[nodiscard]] [[gnu::pure]]
+	virtual bool IsOutputOffloaded() const noexcept {
+		return false;
+	}
+
 	/**
 	 * The client is willing to read, but does not expect it yet.  The
 	 * filter processes the call, and may then call
@@ -12,6 +12,7 @@
 #include "pool/DisposablePointer.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "stock/Stock.hxx"
+#include "stock/Stats.hxx"
 #include "stock/GetHandler.hxx"
 #include "stock/LoggerDomain.hxx"
 #include "event/CoarseTimerEvent.hxx"
@@ -19,14 +20,27 @@
 #include "net/AllocatedSocketAddress.hxx"
 #include "io/Logger.hxx"
 #include "util/Cancellable.hxx"
+#include "util/DeleteDisposer.hxx"
 #include "util/StringBuilder.hxx"
 #include "util/Exception.hxx"
 #include "stopwatch.hxx"
 
+#include <algorithm> // for std::max()
 #include <cassert>
 #include <memory>
 #include <utility> // for std::unreachable()
 
+/**
+ * How often are the idle connections of all
+ * #FilteredSocketStock::WarmTarget instances refilled?
+ */
+static constexpr Event::Duration WARM_INTERVAL = std::chrono::seconds{10};
+
+/**
+ * Idle connections are closed after this duration.
+ */
+static constexpr Event::Duration IDLE_TIMEOUT = std::chrono::minutes{1};
+
 struct FilteredSocketStockRequest {
 	StopwatchPtr stopwatch;
 
@@ -136,7 +150,21 @@ public:
 		return *socket;
 	}
 
+	/**
+	 * Prepare a connection which was passed to the constructor
+	 * for the idle list.
+	 *
+	 * @param idle_timeout close the connection if it remains
+	 * idle for this long
+	 * @return false if the connection is not usable
+	 */
+	bool InitIdle(Event::Duration idle_timeout) noexcept {
+		return SetIdle(idle_timeout);
+	}
+
 private:
+	bool SetIdle(Event::Duration idle_timeout) noexcept;
+
 	void OnIdleTimeout() noexcept {
 		InvokeIdleDisconnect();
 	}
@@ -279,7 +307,7 @@ FilteredSocketStock::GetFairnessHash(const void *_request) const noexcept
 }
 
 bool
-FilteredSocketStockConnection::Release() noexcept
+FilteredSocketStockConnection::SetIdle(Event::Duration idle_timeout) noexcept
 {
 	assert(socket);
 
@@ -295,16 +323,203 @@ FilteredSocketStockConnection::Release() noexcept
 	socket->UnscheduleWrite();
 
 	socket->ScheduleRead();
-	idle_timer.Schedule(std::chrono::minutes(1));
+	idle_timer.Schedule(idle_timeout);
 
 	return true;
 }
 
+bool
+FilteredSocketStockConnection::Release() noexcept
+{
+	return SetIdle(IDLE_TIMEOUT);
+}
+
+/*
+ * prewarming
+ *
+ */
+
+class FilteredSocketStock::WarmTarget::Connect final
+	: public IntrusiveListHook<IntrusiveHookMode::NORMAL>,
+	  ConnectFilteredSocketHandler {
+
+	WarmTarget &target;
+
+	CancellablePointer cancel_ptr;
+
+public:
+	explicit Connect(WarmTarget &_target) noexcept
+		:target(_target) {}
+
+	void Start() noexcept {
+		ConnectFilteredSocket(target.stock.GetEventLoop(),
+				      nullptr,
+				      false,
+				      target.bind_address,
+				      target.address,
+				      target.timeout,
+				      target.filter_params != nullptr
+				      ? target.filter_params->CreateFactory()
+				      : nullptr,
+				      *this, cancel_ptr);
+	}
+
+	void Cancel() noexcept {
+		cancel_ptr.Cancel();
+	}
+
+private:
+	/* virtual methods from class ConnectFilteredSocketHandler */
+	void OnConnectFilteredSocket(std::unique_ptr<FilteredSocket> socket) noexcept override {
+		cancel_ptr = nullptr;
+		target.OnConnected(*this, std::move(socket));
+	}
+
+	void OnConnectFilteredSocketError(std::exception_ptr e) noexcept override {
+		cancel_ptr = nullptr;
+		target.OnConnectError(*this, std::move(e));
+	}
+};
+
+FilteredSocketStock::WarmTarget::WarmTarget(FilteredSocketStock &_stock,
+					    std::string &&_key,
+					    SocketAddress _bind_address,
+					    SocketAddress _address,
+					    Event::Duration _timeout,
+					    const SocketFilterParams *_filter_params,
+					    std::size_t _min_idle) noexcept
+	:stock(_stock), key(std::move(_key)),
+	 bind_address(_bind_address), address(_address),
+	 timeout(_timeout), filter_params(_filter_params),
+	 min_idle(_min_idle)
+{
+}
+
+FilteredSocketStock::WarmTarget::~WarmTarget() noexcept
+{
+	connects.clear_and_dispose([](Connect *c){
+		c->Cancel();
+		delete c;
+	});
+}
+
+void
+FilteredSocketStock::WarmTarget::Refill() noexcept
+{
+	StockStats stats{};
+	stock.stock.GetStock(StockKey{key.c_str()}, nullptr).AddStats(stats);
+
+	demand = std::max<std::size_t>(stats.busy, demand - demand / 4);
+
+	const std::size_t idle = stats.idle + connects.size();
+	const std::size_t total = stats.busy + idle;
+
+	std::size_t n = 0;
+	if (idle < min_idle)
+		n = min_idle - idle;
+	if (total + n < demand)
+		n = demand - total;
+
+	if (idle + n > stock.max_idle)
+		n = stock.max_idle > idle ? stock.max_idle - idle : 0;
+
+	for (; n > 0; --n) {
+		auto *c = new Connect(*this);
+		connects.push_back(*c);
+		c->Start();
+	}
+}
+
+void
+FilteredSocketStock::WarmTarget::OnConnected(Connect &c,
+					     std::unique_ptr<FilteredSocket> socket) noexcept
+{
+	connects.erase_and_dispose(connects.iterator_to(c), DeleteDisposer{});
+
+	/* connections which were established together would
+	   expire together, leaving no idle connection until the
+	   next Refill(); spread their idle timeouts over several
+	   refill intervals, so they get replaced one slot at a
+	   time */
+	const unsigned slot = stock.n_prewarmed % (IDLE_TIMEOUT / WARM_INTERVAL);
+	const Event::Duration idle_timeout = IDLE_TIMEOUT + slot * WARM_INTERVAL;
+
+	if (stock.Add(StockKey{key.c_str()}, address, std::move(socket),
+		      idle_timeout))
+		++stock.n_prewarmed;
+}
+
+void
+FilteredSocketStock::WarmTarget::OnConnectError(Connect &c,
+						std::exception_ptr e) noexcept
+{
+	connects.erase_and_dispose(connects.iterator_to(c), DeleteDisposer{});
+
+	LogConcat(2, key.c_str(), "Prewarming failed: ", e);
+}
+
+void
+FilteredSocketStock::OnWarmTimer() noexcept
+{
+	for (auto &i : warm_targets)
+		i.Refill();
+
+	if (!warm_targets.empty())
+		warm_timer.Schedule(WARM_INTERVAL);
+}
+
+std::unique_ptr<FilteredSocketStock::WarmTarget>
+FilteredSocketStock::AddWarmTarget(std::string_view name,
+				   SocketAddress bind_address,
+				   SocketAddress address,
+				   Event::Duration timeout,
+				   const SocketFilterParams *filter_params,
+				   std::size_t min_idle) noexcept
+{
+	assert(!address.IsNull());
+
+	char key_buffer[1024];
+	try {
+		StringBuilder b(key_buffer);
+		MakeFilteredSocketStockKey(b, name, bind_address, address,
+					   filter_params);
+	} catch (StringBuilder::Overflow) {
+		/* shouldn't happen */
+		return nullptr;
+	}
+
+	auto target = std::make_unique<WarmTarget>(*this, key_buffer,
+						   bind_address, address,
+						   timeout, filter_params,
+						   min_idle);
+	warm_targets.push_back(*target);
+
+	/* fill it soon */
+	warm_timer.Schedule(Event::Duration{});
+
+	return target;
+}
+
 /*
  * interface
  *
  */
 
+FilteredSocketStock::FilteredSocketStock(EventLoop &event_loop,
+					 std::size_t limit,
+					 std::size_t _max_idle) noexcept
+	:stock(event_loop, *this, limit, _max_idle,
+	       std::chrono::minutes(5)),
+	 max_idle(_max_idle),
+	 warm_timer(event_loop, BIND_THIS_METHOD(OnWarmTimer))
+{
+}
+
+FilteredSocketStock::~FilteredSocketStock() noexcept
+{
+	assert(warm_targets.empty());
+}
+
 void
 FilteredSocketStock::Get(AllocatorPtr alloc,
 			 StopwatchPtr stopwatch,
@@ -345,9 +560,10 @@ FilteredSocketStock::Get(AllocatorPtr alloc,
 	stock.Get(key, std::move(request), handler, cancel_ptr);
 }
 
-void
+bool
 FilteredSocketStock::Add(StockKey key, SocketAddress address,
-			 std::unique_ptr<FilteredSocket> socket) noexcept
+			 std::unique_ptr<FilteredSocket> socket,
+			 Event::Duration idle_timeout) noexcept
 {
 	auto &_stock = stock.GetStock(key, nullptr);
 
@@ -355,7 +571,13 @@ FilteredSocketStock::Add(StockKey key, SocketAddress address,
 
 	auto *connection = new FilteredSocketStockConnection(c, address,
 							     std::move(socket));
+	if (!connection->InitIdle(idle_timeout)) {
+		delete connection;
+		return false;
+	}
+
 	_stock.InjectIdle(*connection);
+	return true;
 }
 
 FilteredSocket &
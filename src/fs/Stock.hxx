@@ -10,8 +10,13 @@
 
 #include "stock/Class.hxx"
 #include "stock/MapStock.hxx"
+#include "event/CoarseTimerEvent.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "util/IntrusiveList.hxx"
 
+#include <exception>
 #include <memory>
+#include <string>
 
 class StockItem;
 class StockGetHandler;
@@ -29,14 +34,33 @@ class AllocatorPtr;
 class FilteredSocketStock final : StockClass {
 	StockMap stock;
 
+	const std::size_t max_idle;
+
+public:
+	class WarmTarget;
+
+private:
+	IntrusiveList<WarmTarget> warm_targets;
+
+	/**
+	 * Periodically creates new idle connections for all
+	 * #warm_targets.
+	 */
+	CoarseTimerEvent warm_timer;
+
+	/**
+	 * The number of connections which were established in
+	 * advance for a #WarmTarget.
+	 */
+	uint_least64_t n_prewarmed = 0;
+
 public:
 	/**
 	 * @param limit the maximum number of connections per host
 	 */
 	FilteredSocketStock(EventLoop &event_loop,
-			    std::size_t limit, std::size_t max_idle) noexcept
-		:stock(event_loop, *this, limit, max_idle,
-		       std::chrono::minutes(5)) {}
+			    std::size_t limit, std::size_t _max_idle) noexcept;
+	~FilteredSocketStock() noexcept;
 
 	EventLoop &GetEventLoop() noexcept {
 		return stock.GetEventLoop();
@@ -46,6 +70,10 @@ public:
 		stock.AddStats(data);
 	}
 
+	uint_least64_t GetPrewarmCount() const noexcept {
+		return n_prewarmed;
+	}
+
 	void FadeAll() noexcept {
 		stock.FadeAll();
 	}
@@ -73,14 +101,42 @@ public:
 		 CancellablePointer &cancel_ptr) noexcept;
 
 	/**
-	 * Add a newly connected socket to the stock.
+	 * Add a newly connected socket to the stock as an idle
+	 * connection.
 	 *
 	 * @param key a string generated with MakeFilteredSocketStockKey()
+	 * @param idle_timeout close the connection if it remains
+	 * idle for this long
+	 * @return false if the socket was not usable (it has been
+	 * closed)
+	 */
+	bool Add(StockKey key, SocketAddress address,
+		 std::unique_ptr<FilteredSocket> socket,
+		 Event::Duration idle_timeout=std::chrono::minutes{1}) noexcept;
+
+	/**
+	 * Keep idle connections to the given address ready
+	 * ("prewarming"), so requests don't have to wait for the TCP
+	 * and TLS handshakes.  There will be at least #min_idle idle
+	 * connections, more if there were more busy connections
+	 * recently (but no more than "max_idle").  Idle connections
+	 * which were closed (e.g. by the idle timeout) are replaced.
+	 *
+	 * Parameters are the same as for Get().
+	 *
+	 * @return a handle which stops prewarming when it is
+	 * destroyed
 	 */
-	void Add(StockKey key, SocketAddress address,
-		 std::unique_ptr<FilteredSocket> socket) noexcept;
+	std::unique_ptr<WarmTarget> AddWarmTarget(std::string_view name,
+						  SocketAddress bind_address,
+						  SocketAddress address,
+						  Event::Duration timeout,
+						  const SocketFilterParams *filter_params,
+						  std::size_t min_idle) noexcept;
 
 private:
+	void OnWarmTimer() noexcept;
+
 	/* virtual methods from class StockClass */
 	void Create(CreateStockItem c, StockRequest request,
 		    StockGetHandler &handler,
@@ -91,6 +147,54 @@ private:
 	uint_fast64_t GetFairnessHash(const void *request) const noexcept override;
 };
 
+class FilteredSocketStock::WarmTarget final
+	: public IntrusiveListHook<IntrusiveHookMode::AUTO_UNLINK> {
+
+	friend class FilteredSocketStock;
+
+	FilteredSocketStock &stock;
+
+	const std::string key;
+
+	const AllocatedSocketAddress bind_address, address;
+
+	const Event::Duration timeout;
+
+	const SocketFilterParams *const filter_params;
+
+	const std::size_t min_idle;
+
+	/**
+	 * The recent peak of the number of busy connections; it
+	 * decays slowly.
+	 */
+	std::size_t demand = 0;
+
+	class Connect;
+	IntrusiveList<Connect> connects;
+
+public:
+	WarmTarget(FilteredSocketStock &_stock, std::string &&_key,
+		   SocketAddress _bind_address, SocketAddress _address,
+		   Event::Duration _timeout,
+		   const SocketFilterParams *_filter_params,
+		   std::size_t _min_idle) noexcept;
+	~WarmTarget() noexcept;
+
+	WarmTarget(const WarmTarget &) = delete;
+	WarmTarget &operator=(const WarmTarget &) = delete;
+
+private:
+	/**
+	 * Start new connections if there are not enough idle ones.
+	 */
+	void Refill() noexcept;
+
+	void OnConnected(Connect &c,
+			 std::unique_ptr<FilteredSocket> socket) noexcept;
+	void OnConnectError(Connect &c, std::exception_ptr e) noexcept;
+};
+
 [[gnu::pure]]
 FilteredSocket &
 fs_stock_item_get(StockItem &item);
@@ -147,7 +147,9 @@ ThreadSocketFilter::CheckRead(std::unique_lock<std::mutex> &lock) noexcept
 inline bool
 ThreadSocketFilter::CheckWrite(std::unique_lock<std::mutex> &lock) noexcept
 {
-	if (!want_write || plain_output.IsDefinedAndFull())
+	if (!want_write || plain_output.IsDefinedAndFull() ||
+	    /* after offloading, writing is driven by socket events */
+	    output_offloaded)
 		return true;
 
 	lock.unlock();
@@ -161,6 +163,37 @@ ThreadSocketFilter::CheckWrite(std::unique_lock<std::mutex> &lock) noexcept
 	return true;
 }
 
+void
+ThreadSocketFilter::OffloadOutput(std::unique_lock<std::mutex> &lock) noexcept
+{
+	assert(output_offload_ready);
+	assert(!output_offloaded);
+	assert(encrypted_output.empty());
+
+	output_offload_ready = false;
+
+	lock.unlock();
+	const bool success = handler->OffloadOutput(socket->GetSocket());
+	lock.lock();
+
+	output_offloaded = success;
+
+	const bool pending = !plain_output.empty();
+	lock.unlock();
+
+	if (success) {
+		if (pending || want_write)
+			/* flush data which was submitted before the
+			   switch (or let the client write) as soon as
+			   the socket is writable */
+			socket->InternalScheduleWrite();
+	} else if (pending)
+		/* the handler continues to filter the output */
+		Schedule();
+
+	lock.lock();
+}
+
 void
 ThreadSocketFilter::OnDeferred() noexcept
 {
@@ -262,7 +295,7 @@ try {
 		/* an error has occurred inside the worker thread: forward it
 		   to the FilteredSocket */
 
-		if (socket->IsConnected()) {
+		if (socket->IsConnected() && !output_offloaded) {
 			/* flush the encrypted_output buffer, because it may
 			   contain a "TLS alert" */
 			auto r = encrypted_output.Read();
@@ -369,6 +402,9 @@ try {
 		if (!encrypted_input.IsDefinedAndFull())
 			socket->InternalScheduleRead();
 
+		if (output_offload_ready && encrypted_output.empty())
+			OffloadOutput(lock);
+
 		if (!encrypted_output.empty())
 			/* be optimistic and assume the socket is
 			   already writable (calling
@@ -513,6 +549,11 @@ ThreadSocketFilter::Write(std::span<const std::byte> src) noexcept
 	if (src.empty())
 		return 0;
 
+	if (IsOutputOffloaded())
+		/* the kernel filters the output; bypass the worker
+		   thread */
+		return socket->InternalWrite(src);
+
 	const std::size_t nbytes = LockWritePlainOutput(src);
 
 	if (nbytes < src.size())
@@ -530,6 +571,13 @@ ThreadSocketFilter::Write(std::span<const std::byte> src) noexcept
 	return nbytes;
 }
 
+bool
+ThreadSocketFilter::IsOutputOffloaded() const noexcept
+{
+	const std::scoped_lock lock{mutex};
+	return output_offloaded && plain_output.empty();
+}
+
 void
 ThreadSocketFilter::ScheduleRead() noexcept
 {
@@ -546,7 +594,11 @@ ThreadSocketFilter::ScheduleWrite() noexcept
 		return;
 
 	want_write = true;
-	defer_event.Schedule();
+
+	if (output_offloaded)
+		socket->InternalScheduleWrite();
+	else
+		defer_event.Schedule();
 }
 
 void
@@ -557,18 +609,31 @@ ThreadSocketFilter::UnscheduleWrite() noexcept
 
 	want_write = false;
 
-	if (!want_read)
+	if (IsOutputOffloaded())
+		socket->InternalUnscheduleWrite();
+	else if (!want_read)
 		defer_event.Cancel();
 }
 
 bool
 ThreadSocketFilter::InternalWrite() noexcept
 {
+	/* after the output has been offloaded to the kernel, the
+	   data in #plain_output (submitted before the switch) is
+	   written as-is */
+	auto &output = output_offloaded ? plain_output : encrypted_output;
+
 	std::unique_lock lock{mutex};
 
-	auto r = encrypted_output.Read();
+	auto r = output.Read();
 	if (r.empty()) {
 		lock.unlock();
+
+		if (output_offloaded && want_write)
+			/* our buffer is empty; the client may now
+			   write directly to the socket */
+			return socket->InvokeWrite();
+
 		socket->InternalUnscheduleWrite();
 		return true;
 	}
@@ -582,11 +647,22 @@ ThreadSocketFilter::InternalWrite() noexcept
 	ssize_t nbytes = socket->InternalWrite(std::span{copy}.first(r.size()));
 	if (nbytes > 0) {
 		lock.lock();
-		const bool add = encrypted_output.IsFull();
-		encrypted_output.Consume(nbytes);
-		encrypted_output.FreeIfEmpty();
-		const bool empty = encrypted_output.empty();
+		const bool add = !output_offloaded && output.IsFull();
+		output.Consume(nbytes);
+		output.FreeIfEmpty();
+		const bool empty = output.empty();
 		const bool _drained = empty && drained && plain_output.empty();
+
+		if (empty && output_offload_ready)
+			OffloadOutput(lock);
+
+		/* after offloading, keep EPOLLOUT registered as long
+		   as there is pending data or the client wants to
+		   write */
+		const bool more = output_offloaded
+			? want_write || !plain_output.empty()
+			: !empty;
+
 		lock.unlock();
 
 		if (add)
@@ -594,7 +670,7 @@ ThreadSocketFilter::InternalWrite() noexcept
 			   was full; try again, now that it's not full anymore */
 			Schedule();
 
-		if (empty)
+		if (!more)
 			socket->InternalUnscheduleWrite();
 		else if (std::size_t(nbytes) < r.size())
 			/* if this was only a partial write, and this
@@ -9,6 +9,7 @@
 #include "event/DeferEvent.hxx"
 #include "event/CoarseTimerEvent.hxx"
 #include "memory/SliceFifoBuffer.hxx"
+#include "net/SocketDescriptor.hxx"
 
 #include <exception> // for std::exception_ptr
 #include <memory>
@@ -70,6 +71,21 @@ public:
 	 * shutting down the connection.
 	 */
 	virtual void CancelRun(ThreadSocketFilterInternal &) noexcept {}
+
+	/**
+	 * Called in the main thread after Run() has set
+	 * ThreadSocketFilterInternal::output_offload_ready and all of
+	 * ThreadSocketFilterInternal::encrypted_output has been
+	 * written to the socket.  The handler may now configure the
+	 * socket to let the kernel filter all further output (e.g.
+	 * kernel TLS).
+	 *
+	 * @return true on success; false if Run() shall continue to
+	 * filter the output
+	 */
+	virtual bool OffloadOutput(SocketDescriptor) noexcept {
+		return false;
+	}
 };
 
 struct ThreadSocketFilterInternal : ThreadJob {
@@ -117,6 +133,25 @@ struct ThreadSocketFilterInternal : ThreadJob {
 	 */
 	bool shutting_down = false;
 
+	/**
+	 * Set by the #ThreadSocketFilterHandler when it has stopped
+	 * consuming #plain_output because it wants the kernel to
+	 * take over; see ThreadSocketFilterHandler::OffloadOutput().
+	 *
+	 * Protected by #mutex.
+	 */
+	bool output_offload_ready = false;
+
+	/**
+	 * True after ThreadSocketFilterHandler::OffloadOutput() has
+	 * succeeded.  From now on, #plain_output is written to the
+	 * socket as-is, and once it is empty, the #FilteredSocket
+	 * writes directly to the socket.
+	 *
+	 * Protected by #mutex (but only modified in the main thread).
+	 */
+	bool output_offloaded = false;
+
 	mutable std::mutex mutex;
 
 	/**
@@ -266,6 +301,14 @@ private:
 	bool CheckRead(std::unique_lock<std::mutex> &lock) noexcept;
 	bool CheckWrite(std::unique_lock<std::mutex> &lock) noexcept;
 
+	/**
+	 * Ask the handler to offload output filtering to the kernel
+	 * (see ThreadSocketFilterHandler::OffloadOutput()).  The
+	 * caller must hold the lock, and #encrypted_output must be
+	 * empty.
+	 */
+	void OffloadOutput(std::unique_lock<std::mutex> &lock) noexcept;
+
 	void HandshakeTimeoutCallback() noexcept;
 
 	/**
@@ -308,6 +351,7 @@ public:
 	void AfterConsumed() noexcept override;
 	BufferedReadResult Read() noexcept override;
 	ssize_t Write(std::span<const std::byte> src) noexcept override;
+	bool IsOutputOffloaded() const noexcept override;
 	void ScheduleRead() noexcept override;
 	void ScheduleWrite() noexcept override;
 	void UnscheduleWrite() noexcept override;
@@ -618,7 +618,7 @@ struct RequestBodyCanceled {};
 inline HttpClient::BucketResult
 HttpClient::TryWriteBuckets2()
 {
-	if (socket.HasFilter())
+	if (!socket.IsOutputDirect())
 		return BucketResult::FALLBACK;
 
 	IstreamBucketList list;
@@ -3,6 +3,7 @@
 // author: Max Kellermann <mk@cm4all.com>
 
 #include "HeaderParser.hxx"
+#include "HeaderToken.hxx"
 #include "pool/pool.hxx"
 #include "strmap.hxx"
 #include "memory/GrowingBuffer.hxx"
@@ -47,7 +48,13 @@ header_parse_line(AllocatorPtr alloc, StringMap &headers,
 
 	value = StripLeft(value);
 
-	headers.Add(alloc, alloc.DupToLower(name), alloc.DupZ(value));
+	if (const auto token = LookupHeaderToken(name);
+	    token != HeaderToken::UNKNOWN)
+		/* a well-known header: use the static lower-case name
+		   (with its precalculated hash) */
+		headers.Add(alloc, GetHeaderTokenKey(token), alloc.DupZ(value));
+	else
+		headers.Add(alloc, alloc.DupToLower(name), alloc.DupZ(value));
 	return true;
 }
 
@@ -0,0 +1,219 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "HeaderToken.hxx"
+#include "strmap.hxx"
+#include "util/CharUtil.hxx"
+#include "util/StringCompare.hxx"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <utility> // for std::index_sequence
+
+using std::string_view_literals::operator""sv;
+
+/**
+ * All well-known header names, in the order of #HeaderToken (which
+ * is sorted alphabetically).
+ */
+static constexpr std::array<const char *, std::size_t(HeaderToken::COUNT)> header_token_names{
+	"",
+	"accept",
+	"accept-charset",
+	"accept-encoding",
+	"accept-language",
+	"accept-ranges",
+	"access-control-allow-credentials",
+	"access-control-allow-headers",
+	"access-control-allow-methods",
+	"access-control-allow-origin",
+	"access-control-expose-headers",
+	"access-control-max-age",
+	"access-control-request-headers",
+	"access-control-request-method",
+	"age",
+	"allow",
+	"authentication-info",
+	"authorization",
+	"cache-control",
+	"connection",
+	"content-disposition",
+	"content-encoding",
+	"content-language",
+	"content-length",
+	"content-location",
+	"content-md5",
+	"content-range",
+	"content-security-policy",
+	"content-type",
+	"cookie",
+	"cookie2",
+	"date",
+	"digest",
+	"etag",
+	"expect",
+	"expires",
+	"from",
+	"host",
+	"if-match",
+	"if-modified-since",
+	"if-none-match",
+	"if-range",
+	"if-unmodified-since",
+	"keep-alive",
+	"last-modified",
+	"location",
+	"origin",
+	"pragma",
+	"proxy-authenticate",
+	"proxy-authorization",
+	"range",
+	"referer",
+	"retry-after",
+	"server",
+	"set-cookie",
+	"set-cookie2",
+	"te",
+	"trailer",
+	"transfer-encoding",
+	"upgrade",
+	"user-agent",
+	"vary",
+	"via",
+	"www-authenticate",
+	"x-cm4all-beng-peer-issuer-subject",
+	"x-cm4all-beng-peer-subject",
+	"x-cm4all-beng-user",
+	"x-cm4all-docroot",
+	"x-cm4all-generator",
+	"x-cm4all-https",
+	"x-cm4all-view",
+	"x-content-type-options",
+	"x-forwarded-for",
+	"x-forwarded-host",
+	"x-frame-options",
+};
+
+static_assert(header_token_names.back() != nullptr,
+	      "HeaderToken and header_token_names mismatch");
+static_assert(header_token_names[std::size_t(HeaderToken::X_FRAME_OPTIONS)] == "x-frame-options"sv,
+	      "HeaderToken and header_token_names mismatch");
+static_assert(std::is_sorted(std::next(header_token_names.begin()),
+			     header_token_names.end(),
+			     [](std::string_view a, std::string_view b){
+				     return a < b;
+			     }),
+	      "header_token_names must be sorted like HeaderToken");
+
+/**
+ * The number of slots in the hash table.  Sparse enough that a
+ * perfect seed is found after few attempts even if more names get
+ * added.
+ */
+static constexpr std::size_t HEADER_TOKEN_TABLE_SIZE = 1024;
+
+/**
+ * The number of seeds tried by FindPerfectSeed() before giving up.
+ */
+static constexpr uint32_t MAX_HEADER_TOKEN_SEED = 4096;
+
+static constexpr uint32_t
+HashHeaderName(std::string_view name, uint32_t seed) noexcept
+{
+	uint32_t hash = seed;
+	for (const char ch : name)
+		hash = hash * 131 + static_cast<unsigned char>(ToLowerASCII(ch));
+
+	/* mix all bits into the low ones; without this, the slot
+	   would depend only on the lowest bits of the seed */
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3b;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+/**
+ * Does this seed map all names to distinct table slots?
+ */
+static constexpr bool
+IsPerfectSeed(uint32_t seed) noexcept
+{
+	std::array<bool, HEADER_TOKEN_TABLE_SIZE> used{};
+
+	for (std::size_t i = 1; i < header_token_names.size(); ++i) {
+		auto &u = used[HashHeaderName(header_token_names[i], seed) % HEADER_TOKEN_TABLE_SIZE];
+		if (u)
+			return false;
+
+		u = true;
+	}
+
+	return true;
+}
+
+/**
+ * Find a seed which makes HashHeaderName() a perfect hash function
+ * for #header_token_names.  This runs at compile time, therefore
+ * adding a new name does not require manual tuning.
+ *
+ * @return the seed or #MAX_HEADER_TOKEN_SEED if none was found
+ */
+static constexpr uint32_t
+FindPerfectSeed() noexcept
+{
+	for (uint32_t seed = 0; seed < MAX_HEADER_TOKEN_SEED; ++seed)
+		if (IsPerfectSeed(seed))
+			return seed;
+
+	return MAX_HEADER_TOKEN_SEED;
+}
+
+static constexpr uint32_t header_token_seed = FindPerfectSeed();
+
+static_assert(header_token_seed < MAX_HEADER_TOKEN_SEED,
+	      "No perfect hash seed found; increase HEADER_TOKEN_TABLE_SIZE");
+
+static constexpr auto header_token_table = []{
+	std::array<HeaderToken, HEADER_TOKEN_TABLE_SIZE> table{};
+
+	for (std::size_t i = 1; i < header_token_names.size(); ++i)
+		table[HashHeaderName(header_token_names[i], header_token_seed) % HEADER_TOKEN_TABLE_SIZE] =
+			static_cast<HeaderToken>(i);
+
+	return table;
+}();
+
+template<std::size_t... I>
+static constexpr auto
+MakeHeaderTokenKeys(std::index_sequence<I...>) noexcept
+{
+	return std::array<StringMapKey, sizeof...(I)>{
+		StringMapKey{header_token_names[I]}...
+	};
+}
+
+static constexpr auto header_token_keys =
+	MakeHeaderTokenKeys(std::make_index_sequence<header_token_names.size()>());
+
+HeaderToken
+LookupHeaderToken(std::string_view name) noexcept
+{
+	const auto token = header_token_table[HashHeaderName(name, header_token_seed) % HEADER_TOKEN_TABLE_SIZE];
+	if (token == HeaderToken::UNKNOWN ||
+	    !StringIsEqualIgnoreCase(name, std::string_view{header_token_names[std::size_t(token)]}))
+		return HeaderToken::UNKNOWN;
+
+	return token;
+}
+
+StringMapKey
+GetHeaderTokenKey(HeaderToken token) noexcept
+{
+	assert(token != HeaderToken::UNKNOWN);
+	assert(token < HeaderToken::COUNT);
+
+	return header_token_keys[std::size_t(token)];
+}
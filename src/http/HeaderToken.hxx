@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+struct StringMapKey;
+
+/**
+ * A compact identifier for a well-known HTTP header name.  Parsers
+ * look up the name once (with LookupHeaderToken()), and code which
+ * needs to classify headers can then compare integers instead of
+ * strings.
+ */
+enum class HeaderToken : uint_least8_t {
+	/**
+	 * Not a well-known header name.
+	 */
+	UNKNOWN,
+
+	ACCEPT,
+	ACCEPT_CHARSET,
+	ACCEPT_ENCODING,
+	ACCEPT_LANGUAGE,
+	ACCEPT_RANGES,
+	ACCESS_CONTROL_ALLOW_CREDENTIALS,
+	ACCESS_CONTROL_ALLOW_HEADERS,
+	ACCESS_CONTROL_ALLOW_METHODS,
+	ACCESS_CONTROL_ALLOW_ORIGIN,
+	ACCESS_CONTROL_EXPOSE_HEADERS,
+	ACCESS_CONTROL_MAX_AGE,
+	ACCESS_CONTROL_REQUEST_HEADERS,
+	ACCESS_CONTROL_REQUEST_METHOD,
+	AGE,
+	ALLOW,
+	AUTHENTICATION_INFO,
+	AUTHORIZATION,
+	CACHE_CONTROL,
+	CONNECTION,
+	CONTENT_DISPOSITION,
+	CONTENT_ENCODING,
+	CONTENT_LANGUAGE,
+	CONTENT_LENGTH,
+	CONTENT_LOCATION,
+	CONTENT_MD5,
+	CONTENT_RANGE,
+	CONTENT_SECURITY_POLICY,
+	CONTENT_TYPE,
+	COOKIE,
+	COOKIE2,
+	DATE,
+	DIGEST,
+	ETAG,
+	EXPECT,
+	EXPIRES,
+	FROM,
+	HOST,
+	IF_MATCH,
+	IF_MODIFIED_SINCE,
+	IF_NONE_MATCH,
+	IF_RANGE,
+	IF_UNMODIFIED_SINCE,
+	KEEP_ALIVE,
+	LAST_MODIFIED,
+	LOCATION,
+	ORIGIN,
+	PRAGMA,
+	PROXY_AUTHENTICATE,
+	PROXY_AUTHORIZATION,
+	RANGE,
+	REFERER,
+	RETRY_AFTER,
+	SERVER,
+	SET_COOKIE,
+	SET_COOKIE2,
+	TE,
+	TRAILER,
+	TRANSFER_ENCODING,
+	UPGRADE,
+	USER_AGENT,
+	VARY,
+	VIA,
+	WWW_AUTHENTICATE,
+	X_CM4ALL_BENG_PEER_ISSUER_SUBJECT,
+	X_CM4ALL_BENG_PEER_SUBJECT,
+	X_CM4ALL_BENG_USER,
+	X_CM4ALL_DOCROOT,
+	X_CM4ALL_GENERATOR,
+	X_CM4ALL_HTTPS,
+	X_CM4ALL_VIEW,
+	X_CONTENT_TYPE_OPTIONS,
+	X_FORWARDED_FOR,
+	X_FORWARDED_HOST,
+	X_FRAME_OPTIONS,
+
+	/**
+	 * The number of tokens (not a real token).
+	 */
+	COUNT,
+};
+
+/**
+ * Look up a header name (case-insensitive) in the perfect hash table
+ * of well-known header names.
+ *
+ * @return the token or HeaderToken::UNKNOWN
+ */
+[[gnu::pure]]
+HeaderToken
+LookupHeaderToken(std::string_view name) noexcept;
+
+/**
+ * Return the lower-case name of the given (known) token with its
+ * precalculated #StringMap hash.  The string is static, i.e. it can
+ * be used as #StringMap key without copying it.
+ */
+[[gnu::const]]
+StringMapKey
+GetHeaderTokenKey(HeaderToken token) noexcept;
@@ -5,6 +5,8 @@
 #include "Age.hxx"
 #include "strmap.hxx"
 
+#include <algorithm> // for std::min()
+
 static constexpr std::chrono::hours HOUR(1);
 static constexpr std::chrono::hours DAY = 24 * HOUR;
 static constexpr auto WEEK = 7 * DAY;
@@ -42,24 +44,32 @@ std::chrono::steady_clock::time_point
 http_cache_calc_expires(std::chrono::steady_clock::time_point steady_now,
 			std::chrono::system_clock::time_point system_now,
 			std::chrono::system_clock::time_point expires,
+			std::chrono::system_clock::duration max_stale,
 			const StringMap &vary) noexcept
 {
-	std::chrono::steady_clock::duration max_age;
+	using std::chrono::duration_cast;
+
+	const std::chrono::steady_clock::duration age_limit = http_cache_age_limit(vary);
+
 	if (expires == std::chrono::system_clock::from_time_t(-1))
 		/* there is no Expires response header; keep it in the cache
 		   for 1 hour, but check with If-Modified-Since */
-		max_age = std::chrono::hours(1);
-	else {
-		if (expires <= system_now)
-			/* already expired, bail out */
-			return {};
+		return steady_now + std::min<std::chrono::steady_clock::duration>(std::chrono::hours(1),
+										 age_limit);
 
-		max_age = std::chrono::duration_cast<std::chrono::steady_clock::duration>(expires - system_now);
-	}
+	if (expires + max_stale <= system_now)
+		/* already expired, bail out */
+		return {};
 
-	const std::chrono::steady_clock::duration age_limit = http_cache_age_limit(vary);
+	const auto max_age = duration_cast<std::chrono::steady_clock::duration>(expires - system_now);
 	if (age_limit < max_age)
-		max_age = age_limit;
+		/* clipped: the item will be removed while it is
+		   still fresh, therefore it will never be served
+		   stale */
+		return steady_now + age_limit;
 
-	return steady_now + max_age;
+	/* keep the stale item for as long as "stale-while-revalidate"
+	   or "stale-if-error" allows serving it; this may exceed the
+	   age limit, but only by this much */
+	return steady_now + max_age + duration_cast<std::chrono::steady_clock::duration>(max_stale);
 }
@@ -11,10 +11,15 @@ class StringMap;
 /**
  * Calculate the "expires" value for the new cache item, based on the
  * "Expires" response header.
+ *
+ * @param max_stale for how long after #expires may the stale item
+ * still be served ("stale-while-revalidate" or "stale-if-error");
+ * the item is kept in the cache for that much longer
  */
 [[gnu::pure]]
 std::chrono::steady_clock::time_point
 http_cache_calc_expires(std::chrono::steady_clock::time_point steady_now,
 			std::chrono::system_clock::time_point system_now,
 			std::chrono::system_clock::time_point expires,
+			std::chrono::system_clock::duration max_stale,
 			const StringMap &vary) noexcept;
@@ -0,0 +1,1207 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "Disk.hxx"
+#include "strmap.hxx"
+#include "memory/AllocatorStats.hxx"
+#include "istream/UnusedPtr.hxx"
+#include "istream/FileIstream.hxx"
+#include "pool/pool.hxx"
+#include "pool/tpool.hxx"
+#include "AllocatorPtr.hxx"
+#include "http/Status.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "lib/fmt/SystemError.hxx"
+#include "io/Logger.hxx"
+#include "io/Open.hxx"
+#include "system/Error.hxx"
+#include "thread/Job.hxx"
+#include "thread/Pool.hxx"
+#include "thread/Queue.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "util/SpanCast.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <concepts> // for std::invocable
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h> // for flock()
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::string_view_literals::operator""sv;
+
+namespace {
+
+/**
+ * Each record begins with this value; it needs to be changed
+ * whenever the file format changes.
+ */
+static constexpr uint32_t HTTP_CACHE_DISK_MAGIC = 0x48434432; // "HCD2"
+
+enum RecordType : uint32_t {
+	/**
+	 * A cache item; the metadata is followed by the response
+	 * body.
+	 */
+	RECORD_ITEM = 1,
+
+	/**
+	 * A tombstone: all earlier items with this key are invalid.
+	 * The metadata consists of the 64 bit hash and the key.
+	 */
+	RECORD_REMOVE_KEY = 2,
+
+	/**
+	 * A tombstone: all earlier items with this tag are invalid.
+	 * The metadata consists of a (meaningless) 64 bit hash and
+	 * the tag.
+	 */
+	RECORD_REMOVE_TAG = 3,
+};
+
+struct RecordHeader {
+	uint32_t magic;
+	uint32_t type;
+	uint32_t meta_size;
+	uint32_t body_size;
+
+	/**
+	 * When this record was submitted, in microseconds since the
+	 * epoch.  Strictly monotonic within one shard.
+	 */
+	uint64_t time;
+};
+
+/**
+ * Reject records with more metadata than this while loading.
+ */
+static constexpr std::size_t MAX_META_SIZE = 256 * 1024;
+
+class DiskFormatError final : public std::runtime_error {
+public:
+	using std::runtime_error::runtime_error;
+};
+
+/**
+ * Serialize metadata into a memory buffer.
+ */
+class RecordWriter {
+	std::string buffer;
+
+public:
+	std::span<const std::byte> GetBuffer() const noexcept {
+		return AsBytes(buffer);
+	}
+
+	template<typename T>
+	void WriteT(const T &value) noexcept {
+		buffer.append(reinterpret_cast<const char *>(&value),
+			      sizeof(value));
+	}
+
+	void Write(std::string_view s) noexcept {
+		WriteT(static_cast<uint32_t>(s.size()));
+		buffer.append(s);
+	}
+
+	void Write(const char *s) noexcept {
+		if (s == nullptr) {
+			WriteT(UINT32_MAX);
+			return;
+		}
+
+		Write(std::string_view{s});
+	}
+
+	void Write(const StringMap &map) noexcept {
+		for (const auto &i : map) {
+			Write(i.key);
+			Write(i.value);
+		}
+
+		/* end marker */
+		Write(nullptr);
+	}
+};
+
+/**
+ * Deserialize metadata from a memory buffer.
+ */
+class RecordReader {
+	std::span<const std::byte> src;
+
+public:
+	explicit RecordReader(std::span<const std::byte> _src) noexcept
+		:src(_src) {}
+
+	template<typename T>
+	T ReadT() {
+		if (src.size() < sizeof(T))
+			throw DiskFormatError{"Truncated record"};
+
+		T value;
+		memcpy(&value, src.data(), sizeof(value));
+		src = src.subspan(sizeof(value));
+		return value;
+	}
+
+	/**
+	 * @return a null-terminated copy allocated from the given
+	 * allocator or nullptr
+	 */
+	const char *ReadString(AllocatorPtr alloc) {
+		const auto length = ReadT<uint32_t>();
+		if (length == UINT32_MAX)
+			return nullptr;
+
+		if (src.size() < length)
+			throw DiskFormatError{"Truncated record"};
+
+		const auto s = ToStringView(src.first(length));
+		src = src.subspan(length);
+		return alloc.DupZ(s);
+	}
+
+	StringMap ReadStringMap(AllocatorPtr alloc) {
+		StringMap map;
+
+		while (const char *key = ReadString(alloc)) {
+			const char *value = ReadString(alloc);
+			if (value == nullptr)
+				throw DiskFormatError{"Malformed string map"};
+
+			map.Add(alloc, key, value);
+		}
+
+		return map;
+	}
+};
+
+static void
+WriteInfo(RecordWriter &w, const HttpCacheResponseInfo &info) noexcept
+{
+	using std::chrono::duration_cast;
+
+	w.WriteT(static_cast<int64_t>(std::chrono::system_clock::to_time_t(info.expires)));
+	w.WriteT(static_cast<int64_t>(duration_cast<std::chrono::seconds>(info.stale_while_revalidate).count()));
+	w.WriteT(static_cast<int64_t>(duration_cast<std::chrono::seconds>(info.stale_if_error).count()));
+	w.Write(info.last_modified);
+	w.Write(info.etag);
+	w.Write(info.vary);
+}
+
+static HttpCacheResponseInfo
+ReadInfo(RecordReader &r, AllocatorPtr alloc)
+{
+	HttpCacheResponseInfo info;
+	info.expires = std::chrono::system_clock::from_time_t(r.ReadT<int64_t>());
+	info.stale_while_revalidate = std::chrono::seconds(r.ReadT<int64_t>());
+	info.stale_if_error = std::chrono::seconds(r.ReadT<int64_t>());
+	info.last_modified = r.ReadString(alloc);
+	info.etag = r.ReadString(alloc);
+	info.vary = r.ReadString(alloc);
+	return info;
+}
+
+/**
+ * Check for changes by other processes at this interval.
+ */
+static constexpr Event::Duration http_cache_disk_rescan_interval =
+	std::chrono::seconds(10);
+
+/**
+ * The maximum number of processes sharing one directory.
+ */
+static constexpr unsigned MAX_SHARDS = 256;
+
+struct SegmentName {
+	unsigned shard;
+	uint_least32_t id;
+
+	constexpr auto operator<=>(const SegmentName &) const noexcept = default;
+};
+
+/**
+ * Parse a segment file name ("SS-IIIIIIII.seg").
+ */
+[[gnu::pure]]
+static std::optional<SegmentName>
+ParseSegmentName(const char *name) noexcept
+{
+	char *endptr;
+	const unsigned long shard = strtoul(name, &endptr, 16);
+	if (endptr != name + 2 || *endptr != '-' || shard >= MAX_SHARDS)
+		return std::nullopt;
+
+	const char *id_string = endptr + 1;
+	const unsigned long id = strtoul(id_string, &endptr, 16);
+	if (endptr != id_string + 8 || strcmp(endptr, ".seg") != 0 ||
+	    id > UINT32_MAX)
+		return std::nullopt;
+
+	return SegmentName{(unsigned)shard, (uint_least32_t)id};
+}
+
+/**
+ * Throws on error.
+ *
+ * @return all segments in the directory, sorted
+ */
+static std::vector<SegmentName>
+ListSegments(FileDescriptor directory)
+{
+	/* fdopendir() takes ownership, so pass a duplicate */
+	const std::unique_ptr<DIR, decltype(&closedir)> dir{fdopendir(dup(directory.Get())), closedir};
+	if (!dir)
+		throw MakeErrno("Failed to open disk cache directory");
+
+	std::vector<SegmentName> names;
+
+	while (const auto *e = readdir(dir.get()))
+		if (const auto name = ParseSegmentName(e->d_name))
+			names.push_back(*name);
+
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+} // anonymous namespace
+
+HttpCacheSegment::HttpCacheSegment(HttpCacheDisk &_disk,
+				   UniqueFileDescriptor &&_fd,
+				   unsigned _shard, uint_least32_t _id,
+				   bool _foreign, bool _writable) noexcept
+	:disk(&_disk), fd(std::move(_fd)),
+	 shard(_shard), id(_id),
+	 foreign(_foreign), writable(_writable)
+{
+	MakeName(name, shard, id);
+}
+
+const char *
+HttpCacheSegment::MakeName(char *buffer, unsigned shard,
+			   uint_least32_t id) noexcept
+{
+	snprintf(buffer, 16, "%02x-%08x.seg", shard, (unsigned)id);
+	return buffer;
+}
+
+off_t
+HttpCacheSegment::Reserve(std::size_t record_size) noexcept
+{
+	assert(writable);
+	assert(disk != nullptr);
+
+	const off_t offset = size;
+	size += record_size;
+	disk->total_size += record_size;
+	return offset;
+}
+
+/**
+ * Throws on error.
+ */
+static void
+WriteAt(FileDescriptor fd, off_t offset, std::span<const std::byte> src,
+	const char *name)
+{
+	while (!src.empty()) {
+		const ssize_t nbytes = pwrite(fd.Get(), src.data(), src.size(),
+					      offset);
+		if (nbytes < 0)
+			throw FmtErrno("Failed to write to {}", name);
+
+		if (nbytes == 0)
+			throw FmtRuntimeError("Short write to {}", name);
+
+		src = src.subspan(nbytes);
+		offset += nbytes;
+	}
+}
+
+void
+HttpCacheSegment::WriteRecord(off_t offset, std::span<const std::byte> record,
+			      std::size_t header_size) const
+{
+	assert(record.size() >= header_size);
+
+	/* the header is written last; until then, readers see a
+	   hole where the header belongs */
+	WriteAt(fd, offset + header_size, record.subspan(header_size), name);
+	WriteAt(fd, offset, record.first(header_size), name);
+}
+
+void
+HttpCacheSegment::OnAbandoned() noexcept
+{
+	if (disk != nullptr)
+		disk->OnSegmentAbandoned(*this);
+	else
+		/* the HttpCacheDisk has been destroyed, and we were
+		   the last one to be used */
+		delete this;
+}
+
+/**
+ * A record which has been submitted to the #HttpCacheDiskWriter.
+ * Its space in the segment file has already been reserved.
+ */
+struct HttpCacheDiskRecord final
+	: IntrusiveListHook<IntrusiveHookMode::NORMAL>
+{
+	HttpCacheSegment &segment;
+
+	/**
+	 * Keeps the #segment open until the record has been written.
+	 */
+	const SharedLease segment_lease;
+
+	const off_t offset;
+
+	/**
+	 * The whole record, beginning with the #RecordHeader.
+	 */
+	std::vector<std::byte> buffer;
+
+	/**
+	 * The key and the tag (or an empty string) of the item (if
+	 * this is a RECORD_ITEM), to be able to cancel it.
+	 */
+	std::string key, tag;
+
+	/**
+	 * Set by HttpCacheDisk::Remove() or
+	 * HttpCacheDisk::FlushTag() if the item was invalidated
+	 * before it could be indexed.
+	 */
+	bool obsolete = false;
+
+	/**
+	 * The error which occurred while writing the record (in the
+	 * worker thread).
+	 */
+	std::exception_ptr error;
+
+	HttpCacheDiskRecord(HttpCacheSegment &_segment, off_t _offset,
+			    const RecordHeader &header,
+			    std::span<const std::byte> meta,
+			    std::span<const std::byte> body) noexcept
+		:segment(_segment), segment_lease(_segment), offset(_offset)
+	{
+		const auto h = std::as_bytes(std::span{&header, 1});
+		buffer.reserve(h.size() + meta.size() + body.size());
+		buffer.insert(buffer.end(), h.begin(), h.end());
+		buffer.insert(buffer.end(), meta.begin(), meta.end());
+		buffer.insert(buffer.end(), body.begin(), body.end());
+	}
+
+	RecordHeader GetHeader() const noexcept {
+		RecordHeader header;
+		memcpy(&header, buffer.data(), sizeof(header));
+		return header;
+	}
+
+	std::span<const std::byte> GetMeta() const noexcept {
+		return std::span{buffer}.subspan(sizeof(RecordHeader),
+						 GetHeader().meta_size);
+	}
+
+	/**
+	 * Throws on error.
+	 */
+	void Write() const {
+		segment.WriteRecord(offset, buffer, sizeof(RecordHeader));
+	}
+};
+
+/**
+ * Writes #HttpCacheDiskRecord instances in a worker thread, in the
+ * order they were submitted, so the event loop never blocks on disk
+ * I/O.
+ */
+class HttpCacheDiskWriter final : ThreadJob {
+	ThreadQueue &queue;
+
+	/**
+	 * The owner; nullptr after it has been destroyed while the
+	 * worker thread was still busy.
+	 */
+	HttpCacheDisk *disk;
+
+	using RecordList = IntrusiveList<HttpCacheDiskRecord>;
+
+	/**
+	 * Records which have not yet been submitted to the worker
+	 * thread.
+	 */
+	RecordList pending;
+
+	/**
+	 * Records which are being written by the worker thread.  The
+	 * main thread must not modify this list until Done() gets
+	 * called.
+	 */
+	RecordList running;
+
+public:
+	HttpCacheDiskWriter(ThreadQueue &_queue, HttpCacheDisk &_disk) noexcept
+		:queue(_queue), disk(&_disk) {}
+
+	~HttpCacheDiskWriter() noexcept {
+		pending.clear_and_dispose(DeleteDisposer{});
+		running.clear_and_dispose(DeleteDisposer{});
+	}
+
+	bool IsBusy() const noexcept {
+		return !pending.empty() || !running.empty();
+	}
+
+	void Add(HttpCacheDiskRecord &record) noexcept {
+		pending.push_back(record);
+
+		if (running.empty())
+			Start();
+	}
+
+	/**
+	 * Invoke the given function for each record which has not
+	 * yet been indexed.  It may only modify the record's
+	 * #obsolete flag.
+	 */
+	void ForEach(std::invocable<HttpCacheDiskRecord &> auto f) noexcept {
+		for (auto &i : running)
+			f(i);
+		for (auto &i : pending)
+			f(i);
+	}
+
+	/**
+	 * The #HttpCacheDisk is being destroyed.  The records which
+	 * have not yet been written are written synchronously.  This
+	 * object deletes itself (possibly later, when the worker
+	 * thread has finished).
+	 */
+	void Close() noexcept;
+
+private:
+	void Start() noexcept {
+		assert(running.empty());
+		assert(!pending.empty());
+
+		while (!pending.empty()) {
+			auto &record = pending.front();
+			pending.pop_front();
+			running.push_back(record);
+		}
+
+		queue.Add(*this);
+	}
+
+	static void WriteAll(RecordList &list) noexcept {
+		for (auto &record : list) {
+			try {
+				record.Write();
+			} catch (...) {
+				record.error = std::current_exception();
+			}
+		}
+	}
+
+	static void LogErrors(const RecordList &list) noexcept {
+		for (const auto &record : list)
+			if (record.error)
+				LogConcat(2, "HttpCache", "Failed to write to disk cache: ",
+					  record.error);
+	}
+
+	/* virtual methods from class ThreadJob */
+	void Run() noexcept override {
+		WriteAll(running);
+	}
+
+	void Done() noexcept override;
+};
+
+void
+HttpCacheDiskWriter::Close() noexcept
+{
+	disk = nullptr;
+
+	/* at shutdown, blocking the event loop doesn't matter */
+	WriteAll(pending);
+	LogErrors(pending);
+	pending.clear_and_dispose(DeleteDisposer{});
+
+	if (!running.empty() && !queue.Cancel(*this))
+		/* the worker thread is still busy; Done() will
+		   delete this object */
+		return;
+
+	/* the job was cancelled before it was started (or after it
+	   had finished); writing a record again is harmless */
+	WriteAll(running);
+	LogErrors(running);
+	delete this;
+}
+
+void
+HttpCacheDiskWriter::Done() noexcept
+{
+	if (disk == nullptr) {
+		LogErrors(running);
+		delete this;
+		return;
+	}
+
+	/* this may submit new records (to #pending) */
+	running.clear_and_dispose([this](HttpCacheDiskRecord *record){
+		disk->OnRecordWritten(*record);
+		delete record;
+	});
+
+	if (!pending.empty())
+		Start();
+}
+
+HttpCacheDisk::HttpCacheDisk(struct pool &_pool, EventLoop &event_loop,
+			     const char *path, std::size_t _max_size)
+	:pool(_pool),
+	 slice_pool(1024, 65536, "http_cache_disk_meta"),
+	 directory(OpenDirectory(path)),
+	 rescan_timer(event_loop, BIND_THIS_METHOD(OnRescanTimer)),
+	 segment_size(std::max<std::size_t>(_max_size / 16, 1024 * 1024)),
+	 max_size(_max_size),
+	 cache(event_loop, _max_size),
+	 writer(std::make_unique<HttpCacheDiskWriter>(thread_pool_get_queue(event_loop),
+						      *this))
+{
+	ClaimShard();
+
+	/* load all existing segments, oldest first */
+	TombstoneList tombstones;
+	Scan(true, tombstones);
+	ApplyTombstones(std::move(tombstones));
+
+	Shrink();
+
+	rescan_timer.Schedule(http_cache_disk_rescan_interval);
+}
+
+HttpCacheDisk::~HttpCacheDisk() noexcept
+{
+	writer.release()->Close();
+
+	/* keep all segment files for the next start */
+	cache.Flush();
+
+	/* segments which are still being used (by istreams or by
+	   the worker thread) will be deleted by
+	   HttpCacheSegment::OnAbandoned() */
+	const auto dispose = [](HttpCacheSegment *segment){
+		if (segment->IsAbandoned())
+			delete segment;
+		else
+			segment->disk = nullptr;
+	};
+
+	segments.clear_and_dispose(dispose);
+	foreign_segments.clear_and_dispose(dispose);
+}
+
+void
+HttpCacheDisk::ClaimShard()
+{
+	for (unsigned i = 0; i < MAX_SHARDS; ++i) {
+		char name[16];
+		snprintf(name, sizeof(name), "%02x.lock", i);
+
+		UniqueFileDescriptor fd;
+		if (!fd.Open(directory, name, O_CREAT|O_RDWR, 0600))
+			throw FmtErrno("Failed to open {}", name);
+
+		if (flock(fd.Get(), LOCK_EX|LOCK_NB) == 0) {
+			/* this shard is ours as long as the file
+			   descriptor remains open */
+			shard = i;
+			shard_lock = std::move(fd);
+			return;
+		}
+
+		if (errno != EWOULDBLOCK)
+			throw FmtErrno("Failed to lock {}", name);
+	}
+
+	throw std::runtime_error{"All disk cache shards are in use"};
+}
+
+void
+HttpCacheDisk::Scan(bool startup, TombstoneList &tombstones)
+{
+	for (const auto &name : ListSegments(directory)) {
+		if (name.shard == shard) {
+			/* our own segments are only loaded at
+			   startup; later, we know them already */
+			if (!startup)
+				continue;
+
+			next_segment_id = name.id + 1;
+		} else if (std::any_of(foreign_segments.begin(),
+				       foreign_segments.end(),
+				       [&name](const auto &i){
+					       return i.IsSegment(name.shard, name.id);
+				       }))
+			continue;
+
+		try {
+			LoadSegment(name.shard, name.id, tombstones);
+		} catch (...) {
+			/* keep what has been loaded until the error */
+			LogConcat(2, "HttpCache", "Failed to load disk cache segment: ",
+				  std::current_exception());
+		}
+	}
+}
+
+void
+HttpCacheDisk::UpdateForeignSegments(TombstoneList &tombstones) noexcept
+{
+	for (auto i = foreign_segments.begin(); i != foreign_segments.end();) {
+		auto &segment = *i++;
+
+		struct stat st;
+		if (fstat(segment.GetFileDescriptor().Get(), &st) == 0 &&
+		    st.st_nlink == 0) {
+			/* the owner has deleted this segment */
+			DiscardSegment(segment);
+			continue;
+		}
+
+		try {
+			LoadRecords(segment, tombstones);
+		} catch (...) {
+			LogConcat(2, "HttpCache", "Failed to load ",
+				  segment.GetName(), ": ",
+				  std::current_exception());
+		}
+	}
+}
+
+void
+HttpCacheDisk::OnRescanTimer() noexcept
+{
+	TombstoneList tombstones;
+	UpdateForeignSegments(tombstones);
+
+	try {
+		Scan(false, tombstones);
+	} catch (...) {
+		LogConcat(2, "HttpCache", "Failed to scan disk cache: ",
+			  std::current_exception());
+	}
+
+	/* apply the tombstones only after all new records have been
+	   loaded, because the records of different shards are not
+	   loaded in chronological order */
+	ApplyTombstones(std::move(tombstones));
+
+	rescan_timer.Schedule(http_cache_disk_rescan_interval);
+}
+
+AllocatorStats
+HttpCacheDisk::GetStats() const noexcept
+{
+	return slice_pool.GetStats();
+}
+
+bool
+HttpCacheDisk::HasPendingWrites() const noexcept
+{
+	return writer->IsBusy();
+}
+
+static bool
+http_cache_disk_item_match(const CacheItem *_item, void *ctx) noexcept
+{
+	const auto &item = *(const HttpCacheItem *)_item;
+	const auto &headers = *(const StringMap *)ctx;
+
+	return item.VaryFits(headers);
+}
+
+HttpCacheItem *
+HttpCacheDisk::Get(StringWithHash key, StringMap &request_headers) noexcept
+{
+	return (HttpCacheItem *)cache.GetMatch(key,
+					       http_cache_disk_item_match,
+					       &request_headers);
+}
+
+inline void
+HttpCacheDisk::Insert(HttpCacheItem &item) noexcept
+{
+	if (item.GetTag() != nullptr)
+		per_tag.insert(item);
+
+	cache.PutMatch(item,
+		       http_cache_disk_item_match,
+		       const_cast<void *>((const void *)&item.vary));
+}
+
+void
+HttpCacheDisk::Demote(const HttpCacheItem &src) noexcept
+try {
+	RecordWriter w;
+	w.WriteT(static_cast<uint64_t>(src.GetKey().hash));
+	w.Write(src.GetKey().value);
+	w.Write(src.GetTag());
+	w.WriteT(static_cast<uint16_t>(src.status));
+	WriteInfo(w, src.info);
+	w.Write(src.vary);
+	w.Write(src.response_headers);
+
+	/* the item will be indexed by OnRecordWritten() (by
+	   parsing the metadata we just serialized) */
+	AppendRecord(RECORD_ITEM, w.GetBuffer(), src.GetBody(), &src);
+} catch (...) {
+	LogConcat(2, "HttpCache", "Failed to write to disk cache: ",
+		  std::current_exception());
+}
+
+void
+HttpCacheDisk::AppendRecord(uint_least32_t type,
+			    std::span<const std::byte> meta,
+			    std::span<const std::byte> body,
+			    const HttpCacheItem *src)
+{
+	const uint_least64_t now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	last_record_time = std::max(now, last_record_time + 1);
+
+	const RecordHeader header{
+		.magic = HTTP_CACHE_DISK_MAGIC,
+		.type = type,
+		.meta_size = static_cast<uint32_t>(meta.size()),
+		.body_size = static_cast<uint32_t>(body.size()),
+		.time = last_record_time,
+	};
+
+	const std::size_t record_size = sizeof(header) + meta.size() + body.size();
+
+	auto &segment = GetCurrentSegment();
+	auto *record = new HttpCacheDiskRecord(segment,
+					       segment.Reserve(record_size),
+					       header, meta, body);
+	if (src != nullptr) {
+		record->key = src->GetKey().value;
+		if (src->GetTag() != nullptr)
+			record->tag = src->GetTag();
+	}
+
+	writer->Add(*record);
+
+	if (segment.GetSize() >= (off_t)segment_size) {
+		NewSegment();
+		Shrink();
+	}
+}
+
+void
+HttpCacheDisk::WriteTombstone(uint_least32_t type, StringWithHash value) noexcept
+try {
+	const uint64_t hash = value.hash;
+
+	std::vector<std::byte> meta(sizeof(hash) + value.value.size());
+	memcpy(meta.data(), &hash, sizeof(hash));
+	memcpy(meta.data() + sizeof(hash), value.value.data(), value.value.size());
+
+	AppendRecord(type, meta, {});
+} catch (...) {
+	LogConcat(2, "HttpCache", "Failed to write to disk cache: ",
+		  std::current_exception());
+}
+
+void
+HttpCacheDisk::OnRecordWritten(HttpCacheDiskRecord &record) noexcept
+{
+	auto &segment = record.segment;
+
+	if (record.error) {
+		LogConcat(2, "HttpCache", "Failed to write to disk cache: ",
+			  record.error);
+
+		/* the loader would stop at the incomplete record;
+		   continue in a new segment */
+		segment.SetBroken();
+		return;
+	}
+
+	const auto header = record.GetHeader();
+	if (header.type != RECORD_ITEM)
+		return;
+
+	if (record.obsolete || !segment.is_linked())
+		/* invalidated or discarded meanwhile */
+		return;
+
+	try {
+		LoadItem(segment, header.time, record.GetMeta(),
+			 record.offset + sizeof(header) + header.meta_size,
+			 header.body_size, record.buffer.size());
+	} catch (...) {
+		LogConcat(2, "HttpCache", "Failed to index disk cache record: ",
+			  std::current_exception());
+	}
+}
+
+void
+HttpCacheDisk::Remove(StringWithHash key, const StringMap &headers) noexcept
+{
+	bool found = false;
+
+	cache.RemoveKeyIf(key, [&headers, &found](const CacheItem &_item){
+		const auto &item = static_cast<const HttpCacheItem &>(_item);
+		if (!item.VaryFits(headers))
+			return false;
+
+		found = true;
+		return true;
+	});
+
+	/* the "Vary" headers of items which are still being
+	   written are not known here; cancel all of them */
+	writer->ForEach([key, &found](HttpCacheDiskRecord &record){
+		if (record.key == key.value) {
+			record.obsolete = true;
+			found = true;
+		}
+	});
+
+	if (!found)
+		/* there is nothing on disk which could be loaded
+		   again after a restart */
+		return;
+
+	/* the tombstone discards all variants; that is more than
+	   necessary, but only matters after a restart and for
+	   other processes */
+	WriteTombstone(RECORD_REMOVE_KEY, key);
+}
+
+void
+HttpCacheDisk::Flush() noexcept
+{
+	/* a new current segment is created on demand */
+	while (!segments.empty())
+		DiscardSegment(segments.front());
+
+	/* foreign segments remain in the list, or else they would be
+	   loaded again by the next Scan() */
+	for (auto &segment : foreign_segments)
+		RemoveItems(segment);
+}
+
+void
+HttpCacheDisk::FlushTag(std::string_view tag) noexcept
+{
+	bool found = false;
+
+	per_tag.remove_and_dispose_key(tag, [this, &found](auto *item){
+		cache.Remove(*item);
+		found = true;
+	});
+
+	writer->ForEach([tag, &found](HttpCacheDiskRecord &record){
+		if (!record.tag.empty() && record.tag == tag) {
+			record.obsolete = true;
+			found = true;
+		}
+	});
+
+	if (found)
+		WriteTombstone(RECORD_REMOVE_TAG, StringWithHash{tag, 0});
+}
+
+UnusedIstreamPtr
+HttpCacheDisk::OpenStream(EventLoop &event_loop, struct pool &_pool,
+			  HttpCacheItem &item) noexcept
+{
+	assert(item.IsOnDisk());
+
+	auto &segment = item.GetSegment();
+	const off_t offset = item.GetBodyOffset();
+
+	/* the lease keeps the file open even if the item gets
+	   removed meanwhile */
+	return istream_file_fd_new(event_loop, _pool,
+				   segment.GetName(),
+				   segment.GetFileDescriptor(),
+				   SharedLease{segment},
+				   offset, offset + item.GetBodySize());
+}
+
+HttpCacheSegment &
+HttpCacheDisk::GetCurrentSegment()
+{
+	if (segments.empty() || !segments.back().IsWritable())
+		NewSegment();
+
+	return segments.back();
+}
+
+void
+HttpCacheDisk::NewSegment()
+{
+	const uint_least32_t id = next_segment_id++;
+
+	char name[16];
+	HttpCacheSegment::MakeName(name, shard, id);
+
+	UniqueFileDescriptor fd;
+	if (!fd.Open(directory, name, O_CREAT|O_EXCL|O_RDWR, 0600))
+		throw FmtErrno("Failed to create {}", name);
+
+	segments.push_back(*new HttpCacheSegment(*this, std::move(fd),
+						 shard, id, false, true));
+}
+
+void
+HttpCacheDisk::Shrink() noexcept
+{
+	while (total_size > max_size &&
+	       &segments.front() != &segments.back())
+		DiscardSegment(segments.front());
+}
+
+void
+HttpCacheDisk::DiscardSegment(HttpCacheSegment &segment) noexcept
+{
+	/* this lease postpones OnSegmentAbandoned() until we're
+	   done here */
+	const SharedLease lease{segment};
+
+	if (segment.IsForeign()) {
+		foreign_segments.erase(foreign_segments.iterator_to(segment));
+	} else {
+		/* delete the file now to free the disk space;
+		   istreams which are still reading from it keep it
+		   open */
+		unlinkat(directory.Get(), segment.GetName(), 0);
+
+		assert(total_size >= (std::size_t)segment.GetSize());
+		total_size -= segment.GetSize();
+		segments.erase(segments.iterator_to(segment));
+	}
+
+	RemoveItems(segment);
+}
+
+void
+HttpCacheDisk::RemoveItems(HttpCacheSegment &segment) noexcept
+{
+	while (!segment.items.empty()) {
+		auto &item = segment.items.front();
+		segment.items.pop_front();
+		cache.Remove(item);
+	}
+}
+
+void
+HttpCacheDisk::OnSegmentAbandoned(HttpCacheSegment &segment) noexcept
+{
+	if (!segment.is_linked())
+		/* this segment was discarded and nobody uses it
+		   anymore */
+		delete &segment;
+}
+
+void
+HttpCacheDisk::LoadSegment(unsigned _shard, uint_least32_t id,
+			   TombstoneList &tombstones)
+{
+	char name[16];
+	HttpCacheSegment::MakeName(name, _shard, id);
+
+	UniqueFileDescriptor fd;
+	if (!fd.Open(directory, name, O_RDONLY))
+		throw FmtErrno("Failed to open {}", name);
+
+	const bool foreign = _shard != shard;
+
+	/* the segment is kept even if it contains no valid items,
+	   because its tombstones may still be needed */
+	auto *segment = new HttpCacheSegment(*this, std::move(fd),
+					     _shard, id, foreign, false);
+	(foreign ? foreign_segments : segments).push_back(*segment);
+
+	LoadRecords(*segment, tombstones);
+}
+
+void
+HttpCacheDisk::LoadRecords(HttpCacheSegment &segment,
+			   TombstoneList &tombstones)
+{
+	const FileDescriptor fd = segment.GetFileDescriptor();
+	const off_t file_size = fd.GetSize();
+	if (file_size < 0)
+		throw FmtErrno("Failed to stat {}", segment.GetName());
+
+	std::vector<std::byte> meta;
+
+	while (segment.size < file_size) {
+		const off_t offset = segment.size;
+
+		RecordHeader header;
+		if (fd.ReadAt(offset, std::as_writable_bytes(std::span{&header, 1})) != sizeof(header) ||
+		    header.magic != HTTP_CACHE_DISK_MAGIC ||
+		    header.meta_size > MAX_META_SIZE)
+			/* incomplete (the header is written last) or
+			   corrupt */
+			break;
+
+		const off_t meta_offset = offset + sizeof(header);
+		const off_t body_offset = meta_offset + header.meta_size;
+		const off_t end_offset = body_offset + header.body_size;
+		if (end_offset > file_size)
+			break;
+
+		meta.resize(header.meta_size);
+		if (fd.ReadAt(meta_offset, std::span{meta}) != (ssize_t)meta.size())
+			break;
+
+		const std::size_t record_size = end_offset - offset;
+		segment.size = end_offset;
+		if (!segment.IsForeign()) {
+			total_size += record_size;
+			last_record_time = std::max<uint_least64_t>(last_record_time,
+								    header.time);
+		}
+
+		try {
+			switch (header.type) {
+			case RECORD_ITEM:
+				LoadItem(segment, header.time, meta,
+					 body_offset, header.body_size,
+					 record_size);
+				break;
+
+			case RECORD_REMOVE_KEY:
+			case RECORD_REMOVE_TAG:
+				{
+					RecordReader r{meta};
+					const std::size_t hash = r.ReadT<uint64_t>();
+					tombstones.push_back({
+						.value = std::string{ToStringView(std::span<const std::byte>{meta}.subspan(sizeof(uint64_t)))},
+						.hash = hash,
+						.time = header.time,
+						.type = header.type,
+					});
+				}
+
+				break;
+
+			default:
+				/* unknown record type; skip it */
+				break;
+			}
+		} catch (...) {
+			LogConcat(2, "HttpCache", "Skipping malformed record in ",
+				  segment.GetName(), ": ",
+				  std::current_exception());
+		}
+	}
+}
+
+void
+HttpCacheDisk::LoadItem(HttpCacheSegment &segment, uint_least64_t time,
+			std::span<const std::byte> meta,
+			off_t body_offset, std::size_t body_size,
+			std::size_t record_size)
+{
+	RecordReader r{meta};
+	const std::size_t hash = r.ReadT<uint64_t>();
+
+	const TempPoolLease tpool;
+	const AllocatorPtr tmp{tpool};
+
+	const char *key = r.ReadString(tmp);
+	if (key == nullptr)
+		throw DiskFormatError{"Malformed record"};
+
+	const char *tag = r.ReadString(tmp);
+	const auto status = static_cast<HttpStatus>(r.ReadT<uint16_t>());
+	const auto info = ReadInfo(r, tmp);
+	const auto vary = r.ReadStringMap(tmp);
+	const auto response_headers = r.ReadStringMap(tmp);
+
+	const auto system_now = cache.SystemNow();
+	if (info.expires + info.GetMaxStale() < system_now)
+		/* expired already (and too old to be served stale),
+		   don't bother */
+		return;
+
+	auto new_pool = pool_new_slice(pool, "http_cache_disk_item", slice_pool);
+	const AllocatorPtr alloc{new_pool};
+
+	auto *item = NewFromPool<HttpCacheItem>(std::move(new_pool),
+						alloc.Dup(StringWithHash{key, hash}),
+						cache.SteadyNow(), system_now,
+						tag,
+						info, vary,
+						status, response_headers,
+						body_size,
+						segment, body_offset,
+						record_size, time);
+	Insert(*item);
+}
+
+void
+HttpCacheDisk::ApplyTombstone(const Tombstone &tombstone) noexcept
+{
+	/* when in doubt (same time stamp in different shards),
+	   invalidate */
+	const auto older = [time = tombstone.time](const HttpCacheItem &item){
+		return item.GetRecordTime() <= time;
+	};
+
+	switch (tombstone.type) {
+	case RECORD_REMOVE_KEY:
+		cache.RemoveKeyIf(StringWithHash{tombstone.value, tombstone.hash},
+				  [&older](const CacheItem &item){
+			return older(static_cast<const HttpCacheItem &>(item));
+		});
+		break;
+
+	case RECORD_REMOVE_TAG:
+		per_tag.remove_and_dispose_key_if(tombstone.value, older,
+						  [this](HttpCacheItem *item){
+			cache.Remove(*item);
+		});
+		break;
+	}
+}
+
+void
+HttpCacheDisk::ApplyTombstones(TombstoneList &&tombstones) noexcept
+{
+	for (const auto &i : previous_tombstones)
+		ApplyTombstone(i);
+
+	for (const auto &i : tombstones)
+		ApplyTombstone(i);
+
+	previous_tombstones = std::move(tombstones);
+}
@@ -0,0 +1,460 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#pragma once
+
+#include "Item.hxx"
+#include "cache/Cache.hxx"
+#include "event/FarTimerEvent.hxx"
+#include "memory/SlicePool.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "util/IntrusiveHashSet.hxx"
+#include "util/IntrusiveList.hxx"
+#include "util/SharedLease.hxx"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct pool;
+class EventLoop;
+class StringMap;
+class UnusedIstreamPtr;
+struct AllocatorStats;
+class HttpCacheDisk;
+class HttpCacheDiskWriter;
+struct HttpCacheDiskRecord;
+
+/**
+ * One append-only file of the #HttpCacheDisk.  After it has been
+ * discarded (or after the #HttpCacheDisk has been destroyed), it is
+ * kept alive by #SharedLease instances owned by its remaining items,
+ * by the istreams reading from it and by pending writes.
+ */
+class HttpCacheSegment final
+	: public SharedAnchor,
+	  public IntrusiveListHook<IntrusiveHookMode::NORMAL>
+{
+	friend class HttpCacheDisk;
+
+	/**
+	 * The owner; nullptr after it has been destroyed while this
+	 * segment was still in use.
+	 */
+	HttpCacheDisk *disk;
+
+	const UniqueFileDescriptor fd;
+
+	const unsigned shard;
+	const uint_least32_t id;
+
+	/**
+	 * Was this segment written by another process?  Those are
+	 * only read, never modified or deleted.
+	 */
+	const bool foreign;
+
+	/**
+	 * Was this segment created by this process?  Only those can
+	 * be appended to.  Cleared after a write error.
+	 */
+	bool writable;
+
+	/**
+	 * The file name (relative to the cache directory).
+	 */
+	char name[16];
+
+	/**
+	 * The number of bytes which have been written (or reserved
+	 * for a pending write) or loaded, i.e. the offset where the
+	 * next record will be appended or loaded from.
+	 */
+	off_t size = 0;
+
+public:
+	/**
+	 * All items stored in this segment.
+	 */
+	IntrusiveList<HttpCacheItem,
+		      IntrusiveListMemberHookTraits<&HttpCacheItem::segment_siblings>> items;
+
+	HttpCacheSegment(HttpCacheDisk &_disk, UniqueFileDescriptor &&_fd,
+			 unsigned _shard, uint_least32_t _id,
+			 bool _foreign, bool _writable) noexcept;
+
+	HttpCacheSegment(const HttpCacheSegment &) = delete;
+	HttpCacheSegment &operator=(const HttpCacheSegment &) = delete;
+
+	/**
+	 * Format the file name for the given segment into the buffer
+	 * (which must have room for 16 characters).
+	 */
+	static const char *MakeName(char *buffer, unsigned shard,
+				    uint_least32_t id) noexcept;
+
+	FileDescriptor GetFileDescriptor() const noexcept {
+		return fd;
+	}
+
+	bool IsSegment(unsigned _shard, uint_least32_t _id) const noexcept {
+		return shard == _shard && id == _id;
+	}
+
+	bool IsForeign() const noexcept {
+		return foreign;
+	}
+
+	bool IsWritable() const noexcept {
+		return writable;
+	}
+
+	const char *GetName() const noexcept {
+		return name;
+	}
+
+	off_t GetSize() const noexcept {
+		return size;
+	}
+
+	/**
+	 * Reserve space for a record at the end of the file.  It will
+	 * be written later by WriteRecord().
+	 *
+	 * @return the file offset where the record begins
+	 */
+	off_t Reserve(std::size_t record_size) noexcept;
+
+	/**
+	 * Write a record which was reserved with Reserve().  The
+	 * record header (the first #header_size bytes) is written
+	 * last, so concurrent readers never see an incomplete
+	 * record.  This may be called in a worker thread.
+	 *
+	 * Throws on error.
+	 */
+	void WriteRecord(off_t offset, std::span<const std::byte> record,
+			 std::size_t header_size) const;
+
+	/**
+	 * A write has failed; don't append any more records, because
+	 * the loader would stop at the incomplete one.
+	 */
+	void SetBroken() noexcept {
+		writable = false;
+	}
+
+protected:
+	/* virtual methods from SharedAnchor */
+	void OnAbandoned() noexcept override;
+};
+
+/**
+ * A persistent second tier for #HttpCacheHeap: items evicted from
+ * memory are appended to segment files in a directory, and hits are
+ * served directly from those files.  Only the index (i.e. the
+ * metadata) is kept in memory.  The segment files are loaded again
+ * at startup.
+ *
+ * Invalidations are recorded as "tombstone" records, so they survive
+ * a restart.  Each record has a time stamp, and a tombstone applies
+ * only to items which are older; this matters because the segments
+ * of different shards are not loaded in chronological order.  When
+ * the disk space is exhausted, the oldest segment is discarded as a
+ * whole; segments are never deleted out of order, because that could
+ * lose tombstones referring to older segments.
+ *
+ * The directory may be shared by several processes.  Each one claims
+ * a "shard" (by locking a file), and only writes and deletes the
+ * segments of its own shard.  The segments of other shards are
+ * indexed (without any locking) by polling the directory
+ * periodically; their bodies are shared through the kernel's page
+ * cache.
+ */
+class HttpCacheDisk {
+	friend class HttpCacheSegment;
+	friend class HttpCacheDiskWriter;
+
+	struct pool &pool;
+
+	SlicePool slice_pool;
+
+	const UniqueFileDescriptor directory;
+
+	/**
+	 * The lock file of the #shard owned by this process; the
+	 * lock is held as long as this file descriptor is open.
+	 */
+	UniqueFileDescriptor shard_lock;
+
+	unsigned shard;
+
+	/**
+	 * Check for changes by other processes.
+	 */
+	FarTimerEvent rescan_timer;
+
+	/**
+	 * Start a new segment when the current one reaches this size.
+	 */
+	const std::size_t segment_size;
+
+	/**
+	 * The maximum total size of all segment files.
+	 */
+	const std::size_t max_size;
+
+	/**
+	 * All segments of this shard, oldest first.  The last one is
+	 * the "current" segment where new records are appended (if
+	 * it is writable).
+	 */
+	IntrusiveList<HttpCacheSegment> segments;
+
+	/**
+	 * The segments of other shards.
+	 */
+	IntrusiveList<HttpCacheSegment> foreign_segments;
+
+	/**
+	 * The total size of all #segments (not including
+	 * #foreign_segments).
+	 */
+	std::size_t total_size = 0;
+
+	uint_least32_t next_segment_id = 0;
+
+	/**
+	 * The time stamp of the most recent record written by this
+	 * process.  Used to make time stamps strictly monotonic even
+	 * if the clock goes backwards.
+	 */
+	uint_least64_t last_record_time = 0;
+
+	/**
+	 * A tombstone which has been loaded from a segment file.
+	 * Tombstones are applied after all records of a scan have
+	 * been loaded.
+	 */
+	struct Tombstone {
+		std::string value;
+		std::size_t hash;
+		uint_least64_t time;
+		uint_least32_t type;
+	};
+
+	using TombstoneList = std::vector<Tombstone>;
+
+	/**
+	 * The tombstones loaded by the previous scan.  They are
+	 * applied again to the items loaded by the next scan, which
+	 * may include items that were submitted earlier, but whose
+	 * records became visible only after the scan (because
+	 * another process was still writing them).
+	 */
+	TombstoneList previous_tombstones;
+
+	Cache cache;
+
+	/**
+	 * Writes new records in a worker thread.
+	 */
+	std::unique_ptr<HttpCacheDiskWriter> writer;
+
+	/**
+	 * Lookup table to speed up FlushTag().
+	 */
+	IntrusiveHashSet<HttpCacheItem, 65536,
+			 IntrusiveHashSetOperators<HttpCacheItem,
+						   HttpCacheItem::GetTagFunction,
+						   HttpCacheItem::TagHash,
+						   std::equal_to<std::string_view>>,
+			 IntrusiveHashSetMemberHookTraits<&HttpCacheItem::per_tag_hook>> per_tag;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param path the directory containing the segment files
+	 */
+	HttpCacheDisk(struct pool &_pool, EventLoop &event_loop,
+		      const char *path, std::size_t _max_size);
+
+	~HttpCacheDisk() noexcept;
+
+	HttpCacheDisk(const HttpCacheDisk &) = delete;
+	HttpCacheDisk &operator=(const HttpCacheDisk &) = delete;
+
+	void ForkCow(bool inherit) noexcept {
+		slice_pool.ForkCow(inherit);
+	}
+
+	void Compress() noexcept {
+		slice_pool.Compress();
+	}
+
+	[[gnu::pure]]
+	AllocatorStats GetStats() const noexcept;
+
+	/**
+	 * Are there records which have not yet been written?
+	 */
+	[[gnu::pure]]
+	bool HasPendingWrites() const noexcept;
+
+	HttpCacheItem *Get(StringWithHash key,
+			   StringMap &request_headers) noexcept;
+
+	/**
+	 * Copy an item which is being evicted from the memory tier to
+	 * disk.  The record is written in a worker thread, and the
+	 * item will be available after that.  Errors are logged.
+	 */
+	void Demote(const HttpCacheItem &src) noexcept;
+
+	void Remove(HttpCacheItem &item) noexcept {
+		cache.Remove(item);
+	}
+
+	/**
+	 * Remove all matching items.  If there were any (or if one
+	 * is still being written), record this in a tombstone, so
+	 * they will not be loaded again after a restart.
+	 */
+	void Remove(StringWithHash key, const StringMap &headers) noexcept;
+
+	/**
+	 * Remove all items and delete all segment files of this
+	 * shard.
+	 */
+	void Flush() noexcept;
+
+	void FlushTag(std::string_view tag) noexcept;
+
+	UnusedIstreamPtr OpenStream(EventLoop &event_loop, struct pool &_pool,
+				    HttpCacheItem &item) noexcept;
+
+private:
+	/**
+	 * Lock the first free shard.
+	 *
+	 * Throws on error.
+	 */
+	void ClaimShard();
+
+	/**
+	 * Load new segments.
+	 *
+	 * Throws on error.
+	 *
+	 * @param startup load the segments of this shard, too
+	 * @param tombstones loaded tombstones are added here
+	 */
+	void Scan(bool startup, TombstoneList &tombstones);
+
+	/**
+	 * Load new records from other processes and discard segments
+	 * they have deleted.
+	 *
+	 * @param tombstones loaded tombstones are added here
+	 */
+	void UpdateForeignSegments(TombstoneList &tombstones) noexcept;
+
+	/**
+	 * Remove all items which are older than a matching
+	 * tombstone, considering the given tombstones and
+	 * #previous_tombstones.  Afterwards, the given tombstones
+	 * become the new #previous_tombstones.
+	 */
+	void ApplyTombstones(TombstoneList &&tombstones) noexcept;
+
+	void ApplyTombstone(const Tombstone &tombstone) noexcept;
+
+	void OnRescanTimer() noexcept;
+
+	/**
+	 * Throws on error.
+	 */
+	HttpCacheSegment &GetCurrentSegment();
+
+	/**
+	 * Throws on error.
+	 */
+	void NewSegment();
+
+	/**
+	 * Discard old segments until there is enough room.
+	 */
+	void Shrink() noexcept;
+
+	/**
+	 * Remove the segment from the list, delete the file (unless
+	 * it is foreign) and remove all of its items.
+	 */
+	void DiscardSegment(HttpCacheSegment &segment) noexcept;
+
+	void RemoveItems(HttpCacheSegment &segment) noexcept;
+
+	/**
+	 * Submit a new record to the #writer.
+	 *
+	 * Throws on error.
+	 *
+	 * @param src the item being demoted (for RECORD_ITEM); its
+	 * key and tag allow Remove() and FlushTag() to cancel the
+	 * pending record
+	 */
+	void AppendRecord(uint_least32_t type,
+			  std::span<const std::byte> meta,
+			  std::span<const std::byte> body,
+			  const HttpCacheItem *src=nullptr);
+
+	/**
+	 * Append a tombstone.  Errors are logged.
+	 */
+	void WriteTombstone(uint_least32_t type, StringWithHash value) noexcept;
+
+	/**
+	 * Called by the #writer on the main thread after a record
+	 * has been written (or failed to be written).
+	 */
+	void OnRecordWritten(HttpCacheDiskRecord &record) noexcept;
+
+	/**
+	 * Throws on error.
+	 */
+	void LoadSegment(unsigned _shard, uint_least32_t id,
+			 TombstoneList &tombstones);
+
+	/**
+	 * Load all records after HttpCacheSegment::size.  Stops at
+	 * the first incomplete record, which may still be in the
+	 * process of being written.  Items are indexed, tombstones
+	 * are added to the list (to be applied by the caller).
+	 *
+	 * Throws on I/O error.
+	 */
+	void LoadRecords(HttpCacheSegment &segment,
+			 TombstoneList &tombstones);
+
+	/**
+	 * Index an item record.
+	 *
+	 * Throws on error.
+	 */
+	void LoadItem(HttpCacheSegment &segment, uint_least64_t time,
+		      std::span<const std::byte> meta,
+		      off_t body_offset, std::size_t body_size,
+		      std::size_t record_size);
+
+	void Insert(HttpCacheItem &item) noexcept;
+
+	/**
+	 * Called by HttpCacheSegment::OnAbandoned().
+	 */
+	void OnSegmentAbandoned(HttpCacheSegment &segment) noexcept;
+};
@@ -236,6 +236,7 @@ EncodingCache::Add(StringWithHash key,
 
 EncodingCache::EncodingCache(EventLoop &_event_loop, size_t max_size)
 	:rubber(max_size, "encoding_cache"),
+	 rubber_compressor(_event_loop, rubber),
 	 /* leave 12.5% of the rubber allocator empty, to increase the
 	    chances that a hole can be found for a new allocation, to
 	    reduce the pressure that rubber_compress() creates */
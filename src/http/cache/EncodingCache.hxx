@@ -7,6 +7,7 @@
 #include "cache/Cache.hxx"
 #include "stats/CacheStats.hxx"
 #include "memory/Rubber.hxx"
+#include "memory/RubberCompressor.hxx"
 #include "event/FarTimerEvent.hxx"
 #include "util/IntrusiveList.hxx"
 
@@ -16,6 +17,7 @@ class EncodingCache final {
 	static constexpr Event::Duration compress_interval = std::chrono::minutes(10);
 
 	Rubber rubber;
+	RubberCompressor rubber_compressor;
 	Cache cache;
 
 	FarTimerEvent compress_timer;
@@ -43,12 +45,17 @@ public:
 
 	CacheStats GetStats() const noexcept {
 		stats.allocator = rubber.GetStats();
+
+		const auto hole_stats = rubber.GetHoleStats();
+		stats.holes = hole_stats.n_holes;
+		stats.largest_hole = hole_stats.largest_hole;
+
 		return stats;
 	}
 
 	void Flush() noexcept {
 		cache.Flush();
-		Compress();
+		rubber.Compress();
 	}
 
 	UnusedIstreamPtr Get(struct pool &pool, StringWithHash key) noexcept;
@@ -61,7 +68,7 @@ private:
 		 RubberAllocation &&a, std::size_t size) noexcept;
 
 	void Compress() noexcept {
-		rubber.Compress();
+		rubber_compressor.Start();
 	}
 
 	void OnCompressTimer() noexcept {
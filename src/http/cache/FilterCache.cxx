@@ -18,6 +18,7 @@
 #include "istream/RefIstream.hxx"
 #include "memory/istream_rubber.hxx"
 #include "memory/Rubber.hxx"
+#include "memory/RubberCompressor.hxx"
 #include "memory/sink_rubber.hxx"
 #include "memory/SlicePool.hxx"
 #include "stats/CacheStats.hxx"
@@ -236,6 +237,7 @@ class FilterCache final : LeakDetector {
 	PoolPtr pool;
 	SlicePool slice_pool;
 	Rubber rubber;
+	RubberCompressor rubber_compressor;
 	Cache cache;
 
 	/**
@@ -263,7 +265,8 @@ class FilterCache final : LeakDetector {
 
 public:
 	FilterCache(struct pool &_pool, size_t max_size,
-		    EventLoop &_event_loop, ResourceLoader &_resource_loader);
+		    EventLoop &_event_loop, ResourceLoader &_resource_loader,
+		    CachePolicy policy);
 
 	~FilterCache() noexcept;
 
@@ -278,12 +281,18 @@ public:
 
 	CacheStats GetStats() const noexcept {
 		stats.allocator = slice_pool.GetStats() + rubber.GetStats();
+
+		const auto hole_stats = rubber.GetHoleStats();
+		stats.holes = hole_stats.n_holes;
+		stats.largest_hole = hole_stats.largest_hole;
+
 		return stats;
 	}
 
 	void Flush() noexcept {
 		cache.Flush();
-		Compress();
+		rubber.Compress();
+		slice_pool.Compress();
 	}
 
 	void FlushTag(std::string_view tag) noexcept;
@@ -321,7 +330,7 @@ private:
 		 HttpResponseHandler &handler) noexcept;
 
 	void Compress() noexcept {
-		rubber.Compress();
+		rubber_compressor.Start();
 		slice_pool.Compress();
 	}
 
@@ -658,14 +667,16 @@ FilterCacheRequest::OnHttpError(std::exception_ptr ep) noexcept
 
 FilterCache::FilterCache(struct pool &_pool, size_t max_size,
 			 EventLoop &_event_loop,
-			 ResourceLoader &_resource_loader)
+			 ResourceLoader &_resource_loader,
+			 CachePolicy policy)
 	:pool(pool_new_dummy(&_pool, "filter_cache")),
 	 slice_pool(1024, 65536, "filter_cache_meta"),
 	 rubber(max_size, "filter_cache_data"),
+	 rubber_compressor(_event_loop, rubber),
 	 /* leave 12.5% of the rubber allocator empty, to increase the
 	    chances that a hole can be found for a new allocation, to
 	    reduce the pressure that rubber_compress() creates */
-	 cache(_event_loop, max_size * 7 / 8),
+	 cache(_event_loop, max_size * 7 / 8, nullptr, policy),
 	 compress_timer(_event_loop, BIND_THIS_METHOD(OnCompressTimer)),
 	 resource_loader(_resource_loader) {
 	compress_timer.Schedule(fcache_compress_interval);
@@ -674,12 +685,13 @@ FilterCache::FilterCache(struct pool &_pool, size_t max_size,
 FilterCache *
 filter_cache_new(struct pool *pool, size_t max_size,
 		 EventLoop &event_loop,
-		 ResourceLoader &resource_loader)
+		 ResourceLoader &resource_loader,
+		 CachePolicy policy)
 {
 	assert(max_size > 0);
 
 	return new FilterCache(*pool, max_size,
-			       event_loop, resource_loader);
+			       event_loop, resource_loader, policy);
 }
 
 inline FilterCache::~FilterCache() noexcept
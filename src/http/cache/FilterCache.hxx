@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include "cache/Policy.hxx"
+
 #include <cstdint>
 #include <string_view>
 
@@ -27,7 +29,8 @@ struct StringWithHash;
 FilterCache *
 filter_cache_new(struct pool *pool, size_t max_size,
 		 EventLoop &event_loop,
-		 ResourceLoader &resource_loader);
+		 ResourceLoader &resource_loader,
+		 CachePolicy policy=CachePolicy::LRU);
 
 void
 filter_cache_close(FilterCache *cache) noexcept;
@@ -4,6 +4,7 @@
 
 #include "Heap.hxx"
 #include "Item.hxx"
+#include "Disk.hxx"
 #include "memory/AllocatorStats.hxx"
 #include "istream/UnusedPtr.hxx"
 #include "istream/SharedLeaseIstream.hxx"
@@ -22,9 +23,13 @@ http_cache_item_match(const CacheItem *_item, void *ctx) noexcept
 HttpCacheDocument *
 HttpCacheHeap::Get(StringWithHash key, StringMap &request_headers) noexcept
 {
-	return (HttpCacheItem *)cache.GetMatch(key,
-					       http_cache_item_match,
-					       &request_headers);
+	auto *item = (HttpCacheItem *)cache.GetMatch(key,
+						     http_cache_item_match,
+						     &request_headers);
+	if (item == nullptr && disk)
+		item = disk->Get(key, request_headers);
+
+	return item;
 }
 
 void
@@ -35,6 +40,10 @@ HttpCacheHeap::Put(StringWithHash key, const char *tag,
 		   const StringMap &response_headers,
 		   RubberAllocation &&a, size_t size) noexcept
 {
+	if (disk)
+		/* the new item replaces the (older) one on disk */
+		disk->Remove(key, request_headers);
+
 	auto new_pool = pool_new_slice(pool, "http_cache_item", slice_pool);
 	const AllocatorPtr alloc{new_pool};
 	key = alloc.Dup(key);
@@ -61,7 +70,10 @@ HttpCacheHeap::Remove(HttpCacheDocument &document) noexcept
 {
 	auto &item = (HttpCacheItem &)document;
 
-	cache.Remove(item);
+	if (item.IsOnDisk())
+		disk->Remove(item);
+	else
+		cache.Remove(item);
 }
 
 void
@@ -71,6 +83,9 @@ HttpCacheHeap::Remove(StringWithHash key, const StringMap &headers) noexcept
 		const auto &item = static_cast<const HttpCacheItem &>(_item);
 		return item.VaryFits(headers);
 	});
+
+	if (disk)
+		disk->Remove(key, headers);
 }
 
 void
@@ -78,13 +93,19 @@ HttpCacheHeap::ForkCow(bool inherit) noexcept
 {
 	slice_pool.ForkCow(inherit);
 	rubber.ForkCow(inherit);
+
+	if (disk)
+		disk->ForkCow(inherit);
 }
 
 void
 HttpCacheHeap::Compress() noexcept
 {
 	slice_pool.Compress();
-	rubber.Compress();
+	rubber_compressor.Start();
+
+	if (disk)
+		disk->Compress();
 }
 
 void
@@ -93,6 +114,9 @@ HttpCacheHeap::Flush() noexcept
 	cache.Flush();
 	slice_pool.Compress();
 	rubber.Compress();
+
+	if (disk)
+		disk->Flush();
 }
 
 void
@@ -101,6 +125,9 @@ HttpCacheHeap::FlushTag(std::string_view tag) noexcept
 	per_tag.remove_and_dispose_key(tag, [this](auto *item){
 		cache.Remove(*item);
 	});
+
+	if (disk)
+		disk->FlushTag(tag);
 }
 
 SharedLease
@@ -120,24 +147,48 @@ HttpCacheHeap::OpenStream(struct pool &_pool,
 		/* don't lock the item */
 		return {};
 
+	if (item.IsOnDisk())
+		return NewSharedLeaseIstream(_pool,
+					     disk->OpenStream(cache.GetEventLoop(),
+							      _pool, item),
+					     item);
+
 	return NewSharedLeaseIstream(_pool, item.OpenStream(_pool), item);
 }
 
+void
+HttpCacheHeap::OnCacheItemEvicted(const CacheItem &_item) noexcept
+{
+	const auto &item = static_cast<const HttpCacheItem &>(_item);
+
+	/* no point in keeping items which will expire soon */
+	if (item.Validate(cache.SteadyNow()))
+		disk->Demote(item);
+}
+
 /*
  * cache_class
  *
  */
 
 HttpCacheHeap::HttpCacheHeap(struct pool &_pool, EventLoop &event_loop,
-			     size_t max_size) noexcept
+			     size_t max_size,
+			     const char *disk_path, size_t disk_size,
+			     CachePolicy policy)
 	:pool(_pool),
 	 slice_pool(1024, 65536, "http_cache_meta"),
 	 rubber(max_size, "http_cache_data"),
+	 rubber_compressor(event_loop, rubber),
 	 /* leave 12.5% of the rubber allocator empty, to increase the
 	    chances that a hole can be found for a new allocation, to
 	    reduce the pressure that rubber_compress() creates */
-	 cache(event_loop, max_size * 7 / 8)
+	 cache(event_loop, max_size * 7 / 8,
+	       disk_path != nullptr ? this : nullptr,
+	       policy)
 {
+	if (disk_path != nullptr)
+		disk = std::make_unique<HttpCacheDisk>(pool, event_loop,
+						       disk_path, disk_size);
 }
 
 HttpCacheHeap::~HttpCacheHeap() noexcept = default;
@@ -145,5 +196,8 @@ HttpCacheHeap::~HttpCacheHeap() noexcept = default;
 AllocatorStats
 HttpCacheHeap::GetStats() const noexcept
 {
-	return slice_pool.GetStats() + rubber.GetStats();
+	auto stats = slice_pool.GetStats() + rubber.GetStats();
+	if (disk)
+		stats = stats + disk->GetStats();
+	return stats;
 }
@@ -6,10 +6,13 @@
 
 #include "Item.hxx"
 #include "cache/Cache.hxx"
+#include "cache/Handler.hxx"
 #include "memory/SlicePool.hxx"
 #include "memory/Rubber.hxx"
+#include "memory/RubberCompressor.hxx"
 #include "util/IntrusiveHashSet.hxx"
 
+#include <memory>
 #include <string>
 
 #include <stddef.h>
@@ -22,17 +25,21 @@ class StringMap;
 struct AllocatorStats;
 struct HttpCacheResponseInfo;
 struct HttpCacheDocument;
+class HttpCacheDisk;
 
 /**
- * Caching HTTP responses in heap memory.
+ * Caching HTTP responses in heap memory.  Optionally, items evicted
+ * from memory are moved to a #HttpCacheDisk.
  */
-class HttpCacheHeap {
+class HttpCacheHeap final : CacheHandler {
 	struct pool &pool;
 
 	SlicePool slice_pool;
 
 	Rubber rubber;
 
+	RubberCompressor rubber_compressor;
+
 	Cache cache;
 
 	/**
@@ -45,9 +52,23 @@ class HttpCacheHeap {
 						   std::equal_to<std::string_view>>,
 			 IntrusiveHashSetMemberHookTraits<&HttpCacheItem::per_tag_hook>> per_tag;
 
+	/**
+	 * The optional disk tier.
+	 */
+	std::unique_ptr<HttpCacheDisk> disk;
+
 public:
+	/**
+	 * Throws if the disk tier could not be opened.
+	 *
+	 * @param disk_path the directory for the disk tier; nullptr
+	 * to disable it
+	 * @param disk_size the maximum size of the disk tier
+	 */
 	HttpCacheHeap(struct pool &pool, EventLoop &event_loop,
-		      size_t max_size) noexcept;
+		      size_t max_size,
+		      const char *disk_path=nullptr, size_t disk_size=0,
+		      CachePolicy policy=CachePolicy::LRU);
 	~HttpCacheHeap() noexcept;
 
 	Rubber &GetRubber() noexcept {
@@ -59,6 +80,11 @@ public:
 	[[gnu::pure]]
 	AllocatorStats GetStats() const noexcept;
 
+	[[gnu::pure]]
+	Rubber::HoleStats GetHoleStats() const noexcept {
+		return rubber.GetHoleStats();
+	}
+
 	HttpCacheDocument *Get(StringWithHash key,
 			       StringMap &request_headers) noexcept;
 
@@ -72,7 +98,12 @@ public:
 	void Remove(HttpCacheDocument &document) noexcept;
 	void Remove(StringWithHash key, const StringMap &headers) noexcept;
 
+	/**
+	 * Start compressing the allocators.  The #Rubber is
+	 * compressed incrementally.
+	 */
 	void Compress() noexcept;
+
 	void Flush() noexcept;
 	void FlushTag(std::string_view tag) noexcept;
 
@@ -81,4 +112,8 @@ public:
 
 	UnusedIstreamPtr OpenStream(struct pool &_pool,
 				    HttpCacheDocument &document) noexcept;
+
+private:
+	/* virtual methods from CacheHandler */
+	void OnCacheItemEvicted(const CacheItem &item) noexcept override;
 };
@@ -8,6 +8,8 @@
 HttpCacheResponseInfo::HttpCacheResponseInfo(AllocatorPtr alloc,
 					     const HttpCacheResponseInfo &src) noexcept
 	:expires(src.expires),
+	 stale_while_revalidate(src.stale_while_revalidate),
+	 stale_if_error(src.stale_if_error),
 	 last_modified(alloc.CheckDup(src.last_modified)),
 	 etag(alloc.CheckDup(src.etag)),
 	 vary(alloc.CheckDup(src.vary))
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <algorithm> // for std::max()
 #include <chrono>
 
 class AllocatorPtr;
@@ -43,6 +44,22 @@ struct HttpCacheResponseInfo {
 	/** when will the cached resource expire? (beng-proxy time) */
 	std::chrono::system_clock::time_point expires;
 
+	/**
+	 * For how long after #expires may the stale resource be
+	 * served while it is being revalidated in the background?
+	 *
+	 * @see RFC 5861 3
+	 */
+	std::chrono::system_clock::duration stale_while_revalidate;
+
+	/**
+	 * For how long after #expires may the stale resource be
+	 * served if revalidation fails?
+	 *
+	 * @see RFC 5861 4
+	 */
+	std::chrono::system_clock::duration stale_if_error;
+
 	/** when was the cached resource last modified on the widget
 	    server? (widget server time) */
 	const char *last_modified;
@@ -58,5 +75,14 @@ struct HttpCacheResponseInfo {
 	HttpCacheResponseInfo(HttpCacheResponseInfo &&) = default;
 	HttpCacheResponseInfo &operator=(HttpCacheResponseInfo &&) = default;
 
+	/**
+	 * For how long after #expires may the stale resource be
+	 * served at all?  The cache needs to keep it at least that
+	 * long.
+	 */
+	constexpr std::chrono::system_clock::duration GetMaxStale() const noexcept {
+		return std::max(stale_while_revalidate, stale_if_error);
+	}
+
 	void MoveToPool(AllocatorPtr alloc) noexcept;
 };
@@ -3,6 +3,7 @@
 // author: Max Kellermann <mk@cm4all.com>
 
 #include "Item.hxx"
+#include "Disk.hxx"
 #include "Age.hxx"
 #include "memory/istream_rubber.hxx"
 #include "istream/UnusedPtr.hxx"
@@ -10,6 +11,8 @@
 #include "util/djb_hash.hxx"
 #include "util/SpanCast.hxx"
 
+#include <cassert>
+
 std::size_t
 HttpCacheItem::TagHash::operator()(std::string_view _tag) const noexcept
 {
@@ -31,13 +34,42 @@ HttpCacheItem::HttpCacheItem(PoolPtr &&_pool,
 	 HttpCacheDocument(pool, _info, _request_headers,
 			   _status, _response_headers),
 	 CacheItem(_key, pool_netto_size(pool) + _size,
-		   http_cache_calc_expires(now, system_now, _info.expires, vary)),
+		   http_cache_calc_expires(now, system_now, _info.expires,
+					   _info.GetMaxStale(), vary)),
 	 tag(_tag != nullptr ? p_strdup(GetPool(), _tag) : nullptr),
 	 size(_size),
 	 body(std::move(_body))
 {
 }
 
+HttpCacheItem::HttpCacheItem(PoolPtr &&_pool,
+			     StringWithHash _key,
+			     std::chrono::steady_clock::time_point now,
+			     std::chrono::system_clock::time_point system_now,
+			     const char *_tag,
+			     const HttpCacheResponseInfo &_info,
+			     const StringMap &_request_headers,
+			     HttpStatus _status,
+			     const StringMap &_response_headers,
+			     size_t _size,
+			     HttpCacheSegment &_segment, off_t _body_offset,
+			     size_t record_size,
+			     uint_least64_t _record_time) noexcept
+	:PoolHolder(std::move(_pool)),
+	 HttpCacheDocument(pool, _info, _request_headers,
+			   _status, _response_headers),
+	 CacheItem(_key, record_size,
+		   http_cache_calc_expires(now, system_now, _info.expires,
+					   _info.GetMaxStale(), vary)),
+	 tag(_tag != nullptr ? p_strdup(GetPool(), _tag) : nullptr),
+	 size(_size),
+	 segment(&_segment), segment_lease(_segment),
+	 body_offset(_body_offset),
+	 record_time(_record_time)
+{
+	_segment.items.push_back(*this);
+}
+
 void
 HttpCacheItem::SetExpires(std::chrono::steady_clock::time_point steady_now,
 			  std::chrono::system_clock::time_point system_now,
@@ -45,12 +77,32 @@ HttpCacheItem::SetExpires(std::chrono::steady_clock::time_point steady_now,
 {
 	info.expires = _expires;
 	CacheItem::SetExpires(http_cache_calc_expires(steady_now, system_now,
-						      _expires, vary));
+						      _expires, info.GetMaxStale(),
+						      vary));
+}
+
+std::span<const std::byte>
+HttpCacheItem::GetBody() const noexcept
+{
+	assert(!IsOnDisk());
+
+	if (size == 0)
+		/* this needs to be a special case because it is not
+		   allowed to call Read() on an empty
+		   RubberAllocation */
+		return {};
+
+	return {
+		reinterpret_cast<const std::byte *>(body.Read()),
+		size,
+	};
 }
 
 UnusedIstreamPtr
 HttpCacheItem::OpenStream(struct pool &_pool) noexcept
 {
+	assert(!IsOnDisk());
+
 	return istream_rubber_new(_pool, body.GetRubber(), body.GetId(),
 				  0, size, false);
 }
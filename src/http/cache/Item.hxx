@@ -9,8 +9,16 @@
 #include "cache/Item.hxx"
 #include "memory/Rubber.hxx"
 #include "util/IntrusiveHashSet.hxx"
+#include "util/IntrusiveList.hxx"
+#include "util/SharedLease.hxx"
+
+#include <cstdint>
+#include <span>
+
+#include <sys/types.h> // for off_t
 
 class UnusedIstreamPtr;
+class HttpCacheSegment;
 
 class HttpCacheItem final : PoolHolder, public HttpCacheDocument, public CacheItem {
 	const char *const tag;
@@ -19,12 +27,33 @@ class HttpCacheItem final : PoolHolder, public HttpCacheDocument, public CacheIt
 
 	const RubberAllocation body;
 
+	/**
+	 * If this item lives in the disk tier, then this is the
+	 * segment file containing the body (at #body_offset);
+	 * #segment_lease keeps it open.
+	 */
+	HttpCacheSegment *const segment = nullptr;
+	const SharedLease segment_lease;
+	const off_t body_offset = 0;
+
+	/**
+	 * The time stamp of the segment file record (in microseconds
+	 * since the epoch).  Only tombstones which are newer than
+	 * this apply to this item.
+	 */
+	const uint_least64_t record_time = 0;
+
 public:
 	/**
-	 * For #HttpCacheHeap::per_tag.
+	 * For #HttpCacheHeap::per_tag or #HttpCacheDisk::per_tag.
 	 */
 	IntrusiveHashSetHook<IntrusiveHookMode::AUTO_UNLINK> per_tag_hook;
 
+	/**
+	 * For HttpCacheSegment::items.
+	 */
+	IntrusiveListHook<IntrusiveHookMode::AUTO_UNLINK> segment_siblings;
+
 	struct TagHash {
 		[[gnu::pure]]
 		std::size_t operator()(std::string_view tag) const noexcept;
@@ -49,6 +78,26 @@ public:
 		      size_t _size,
 		      RubberAllocation &&_body) noexcept;
 
+	/**
+	 * Construct an item in the disk tier.
+	 *
+	 * @param record_size the size of the whole record in the
+	 * segment file
+	 * @param _record_time the time stamp of the record
+	 */
+	HttpCacheItem(PoolPtr &&_pool,
+		      StringWithHash _key,
+		      std::chrono::steady_clock::time_point now,
+		      std::chrono::system_clock::time_point system_now,
+		      const char *_tag,
+		      const HttpCacheResponseInfo &_info,
+		      const StringMap &_request_headers,
+		      HttpStatus _status,
+		      const StringMap &_response_headers,
+		      size_t _size,
+		      HttpCacheSegment &_segment, off_t _body_offset,
+		      size_t record_size, uint_least64_t _record_time) noexcept;
+
 	HttpCacheItem(const HttpCacheItem &) = delete;
 	HttpCacheItem &operator=(const HttpCacheItem &) = delete;
 
@@ -62,10 +111,41 @@ public:
 			std::chrono::system_clock::time_point system_now,
 			std::chrono::system_clock::time_point _expires) noexcept;
 
+	bool IsOnDisk() const noexcept {
+		return segment != nullptr;
+	}
+
+	HttpCacheSegment &GetSegment() const noexcept {
+		return *segment;
+	}
+
+	off_t GetBodyOffset() const noexcept {
+		return body_offset;
+	}
+
+	uint_least64_t GetRecordTime() const noexcept {
+		return record_time;
+	}
+
+	size_t GetBodySize() const noexcept {
+		return size;
+	}
+
 	bool HasBody() const noexcept {
-		return body;
+		return IsOnDisk() ? size > 0 : (bool)body;
 	}
 
+	/**
+	 * Returns the response body.  Only valid for items in the
+	 * memory tier.
+	 */
+	[[gnu::pure]]
+	std::span<const std::byte> GetBody() const noexcept;
+
+	/**
+	 * Open the response body.  Only valid for items in the memory
+	 * tier; see HttpCacheDisk::OpenStream().
+	 */
 	UnusedIstreamPtr OpenStream(struct pool &_pool) noexcept;
 
 	/* virtual methods from class CacheItem */
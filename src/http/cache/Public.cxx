@@ -23,6 +23,7 @@
 #include "istream/RefIstream.hxx"
 #include "pool/Holder.hxx"
 #include "AllocatorPtr.hxx"
+#include "stopwatch.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "event/FarTimerEvent.hxx"
 #include "event/Loop.hxx"
@@ -31,10 +32,12 @@
 #include "util/Cancellable.hxx"
 #include "util/djb_hash.hxx"
 #include "util/Exception.hxx"
+#include "util/IntrusiveHashSet.hxx"
 #include "util/IntrusiveList.hxx"
 #include "util/StringAPI.hxx"
 
 #include <functional>
+#include <stdexcept>
 
 #include <string.h>
 #include <stdio.h>
@@ -49,6 +52,85 @@ IsModifyingMethod(HttpMethod method) noexcept
 	return !IsSafeMethod(method);
 }
 
+/**
+ * A request which waits for another #HttpCacheRequest with the same
+ * cache key to complete; after that, it repeats the cache lookup.
+ */
+class HttpCacheWaiter final
+	: public IntrusiveListHook<IntrusiveHookMode::NORMAL>,
+	  Cancellable
+{
+	const PoolPtr caller_pool;
+
+	const StringWithHash key;
+
+	const ResourceRequestParams params;
+
+	const HttpMethod method;
+
+	const ResourceAddress &address;
+
+	StringMap headers;
+
+	const HttpCacheRequestInfo info;
+
+	HttpResponseHandler &handler;
+
+	CancellablePointer &cancel_ptr;
+
+public:
+	HttpCacheWaiter(struct pool &_caller_pool,
+			StringWithHash _key,
+			const ResourceRequestParams &_params,
+			const HttpCacheRequestInfo &_info,
+			HttpMethod _method,
+			const ResourceAddress &_address,
+			StringMap &&_headers,
+			HttpResponseHandler &_handler,
+			CancellablePointer &_cancel_ptr) noexcept
+		:caller_pool(_caller_pool), key(_key), params(_params),
+		 method(_method),
+		 /* the caller may free the address after we return */
+		 address(*NewFromPool<ResourceAddress>(_caller_pool,
+						       AllocatorPtr{_caller_pool},
+						       _address)),
+		 headers(std::move(_headers)),
+		 info(_info),
+		 handler(_handler), cancel_ptr(_cancel_ptr)
+	{
+		cancel_ptr = *this;
+	}
+
+	HttpCacheWaiter(const HttpCacheWaiter &) = delete;
+	HttpCacheWaiter &operator=(const HttpCacheWaiter &) = delete;
+
+	/**
+	 * The request we were waiting for has finished; repeat the
+	 * cache lookup.
+	 *
+	 * @param coalesce if true, then we may become the new
+	 * pending request others wait for, or wait for another
+	 * pending request
+	 */
+	void Dispatch(HttpCache &cache, bool coalesce) noexcept;
+
+	/**
+	 * The request we were waiting for has failed.
+	 */
+	void OnLeaderError(HttpCache &cache, std::exception_ptr ep) noexcept;
+
+private:
+	void Destroy() noexcept {
+		this->~HttpCacheWaiter();
+	}
+
+	/* virtual methods from class Cancellable */
+	void Cancel() noexcept override {
+		unlink();
+		Destroy();
+	}
+};
+
 class HttpCacheRequest final : PoolHolder,
 			       HttpResponseHandler,
 			       RubberSinkHandler,
@@ -56,6 +138,24 @@ class HttpCacheRequest final : PoolHolder,
 public:
 	IntrusiveListHook<IntrusiveHookMode::NORMAL> siblings;
 
+	/**
+	 * Hook for HttpCache::pending.  Only linked while this
+	 * request is in flight and other requests may wait for it.
+	 */
+	IntrusiveHashSetHook<IntrusiveHookMode::AUTO_UNLINK> pending_hook;
+
+	/**
+	 * Hook for HttpCache::background.
+	 */
+	IntrusiveListHook<IntrusiveHookMode::AUTO_UNLINK> background_siblings;
+
+	struct GetKeyFunction {
+		[[gnu::pure]]
+		StringWithHash operator()(const HttpCacheRequest &request) const noexcept {
+			return request.key;
+		}
+	};
+
 private:
 	PoolPtr caller_pool;
 
@@ -106,6 +206,12 @@ private:
 
 	CancellablePointer cancel_ptr;
 
+	/**
+	 * Requests with the same cache key which wait for this one to
+	 * complete.
+	 */
+	IntrusiveList<HttpCacheWaiter> waiters;
+
 	const bool eager_cache;
 
 public:
@@ -147,6 +253,12 @@ public:
 
 	EventLoop &GetEventLoop() const noexcept;
 
+	void AddWaiter(HttpCacheWaiter &waiter) noexcept {
+		assert(pending_hook.is_linked());
+
+		waiters.push_back(waiter);
+	}
+
 	void Serve() noexcept;
 
 	void Put(RubberAllocation &&a, size_t size) noexcept;
@@ -158,7 +270,10 @@ public:
 	void RubberStoreFinished() noexcept;
 
 	/**
-	 * Abort storing the response body in the rubber allocator.
+	 * Abort storing the response body in the rubber allocator (or
+	 * the request to the origin server, if this is a background
+	 * revalidation which has not yet received a response).
+	 * Waiters receive an error.
 	 *
 	 * This will not remove the request from the HttpCache, because
 	 * this method is supposed to be used as a "disposer".
@@ -170,6 +285,23 @@ private:
 		this->~HttpCacheRequest();
 	}
 
+	void RemovePending() noexcept {
+		if (pending_hook.is_linked())
+			pending_hook.unlink();
+	}
+
+	/**
+	 * Let all waiters repeat their cache lookup.  They will not
+	 * wait for another request, to avoid serializing requests
+	 * for a resource which turned out to be uncacheable.
+	 */
+	void ResumeWaiters() noexcept;
+
+	/**
+	 * Pass the error to all waiters.
+	 */
+	void FailWaiters(std::exception_ptr ep) noexcept;
+
 	/* virtual methods from class Cancellable */
 	void Cancel() noexcept override;
 
@@ -269,6 +401,28 @@ class HttpCache {
 	IntrusiveList<HttpCacheRequest,
 		      IntrusiveListMemberHookTraits<&HttpCacheRequest::siblings>> requests;
 
+	/**
+	 * All requests to the origin server which are currently in
+	 * flight (including storing the response body), indexed by
+	 * their cache key.  Concurrent requests with the same key
+	 * wait for the pending request instead of sending another
+	 * one.
+	 */
+	IntrusiveHashSet<HttpCacheRequest, 4096,
+			 IntrusiveHashSetOperators<HttpCacheRequest,
+						   HttpCacheRequest::GetKeyFunction,
+						   std::hash<StringWithHash>,
+						   std::equal_to<StringWithHash>>,
+			 IntrusiveHashSetMemberHookTraits<&HttpCacheRequest::pending_hook>> pending;
+
+	/**
+	 * Revalidation requests running in the background
+	 * ("stale-while-revalidate").  They have no caller who could
+	 * cancel them, so this object needs to do it.
+	 */
+	IntrusiveList<HttpCacheRequest,
+		      IntrusiveListMemberHookTraits<&HttpCacheRequest::background_siblings>> background;
+
 	mutable CacheStats stats{};
 
 	const bool obey_no_cache;
@@ -277,7 +431,9 @@ public:
 	HttpCache(struct pool &_pool, size_t max_size,
 		  bool obey_no_cache,
 		  EventLoop &event_loop,
-		  ResourceLoader &_resource_loader);
+		  ResourceLoader &_resource_loader,
+		  const char *disk_path, size_t disk_size,
+		  CachePolicy policy);
 
 	HttpCache(const HttpCache &) = delete;
 	HttpCache &operator=(const HttpCache &) = delete;
@@ -298,6 +454,11 @@ public:
 
 	CacheStats GetStats() const noexcept {
 		stats.allocator = heap.GetStats();
+
+		const auto hole_stats = heap.GetHoleStats();
+		stats.holes = hole_stats.n_holes;
+		stats.largest_hole = hole_stats.largest_hole;
+
 		return stats;
 	}
 
@@ -368,7 +529,20 @@ public:
 		 StringMap &&headers,
 		 const HttpCacheRequestInfo &info,
 		 HttpResponseHandler &handler,
-		 CancellablePointer &cancel_ptr) noexcept;
+		 CancellablePointer &cancel_ptr,
+		 bool coalesce=true) noexcept;
+
+	/**
+	 * Serve a (stale) document if "stale-if-error" allows it.
+	 *
+	 * @return false if no such document was found (and the
+	 * handler was not invoked)
+	 */
+	bool ServeStale(struct pool &caller_pool,
+			StringWithHash key,
+			StringMap &headers,
+			const HttpCacheRequestInfo &info,
+			HttpResponseHandler &handler) noexcept;
 
 	/**
 	 * Send the cached document to the caller.
@@ -388,6 +562,24 @@ private:
 	 */
 	void Miss(struct pool &caller_pool,
 		  const StopwatchPtr &parent_stopwatch,
+		  StringWithHash key,
+		  const ResourceRequestParams &params,
+		  const HttpCacheRequestInfo &info,
+		  HttpMethod method,
+		  const ResourceAddress &address,
+		  StringMap &&headers,
+		  HttpResponseHandler &handler,
+		  CancellablePointer &cancel_ptr,
+		  bool coalesce) noexcept;
+
+	/**
+	 * If another request with the same key is pending, wait for
+	 * it to complete.
+	 *
+	 * @return true if the request is now waiting, false if there
+	 * is no pending request (and nothing was done)
+	 */
+	bool Wait(struct pool &caller_pool,
 		  StringWithHash key,
 		  const ResourceRequestParams &params,
 		  const HttpCacheRequestInfo &info,
@@ -401,6 +593,11 @@ private:
 	 * Revalidate a cache entry.
 	 *
 	 * Caller pool is referenced synchronously and freed asynchronously.
+	 *
+	 * @param coalesce if true, then other requests may wait for
+	 * this one
+	 * @param background if true, then this request is owned by
+	 * the #HttpCache (see #background)
 	 */
 	void Revalidate(struct pool &caller_pool,
 			const StopwatchPtr &parent_stopwatch,
@@ -412,7 +609,22 @@ private:
 			const ResourceAddress &address,
 			StringMap &&headers,
 			HttpResponseHandler &handler,
-			CancellablePointer &cancel_ptr) noexcept;
+			CancellablePointer &cancel_ptr,
+			bool coalesce, bool background=false) noexcept;
+
+	/**
+	 * Revalidate a stale cache entry in the background, without
+	 * a caller waiting for the response (RFC 5861
+	 * "stale-while-revalidate").  All data owned by the caller
+	 * is copied.
+	 */
+	void BackgroundRevalidate(StringWithHash key,
+				  const ResourceRequestParams &params,
+				  const HttpCacheRequestInfo &info,
+				  HttpCacheDocument &document,
+				  HttpMethod method,
+				  const ResourceAddress &address,
+				  const StringMap &headers) noexcept;
 
 	/**
 	 * The requested document was found in the cache.  It is either
@@ -431,7 +643,8 @@ private:
 		   const ResourceAddress &address,
 		   StringMap &&headers,
 		   HttpResponseHandler &handler,
-		   CancellablePointer &cancel_ptr) noexcept;
+		   CancellablePointer &cancel_ptr,
+		   bool coalesce) noexcept;
 
 	void OnCompressTimer() noexcept {
 		heap.Compress();
@@ -448,6 +661,56 @@ UpdateHeader(AllocatorPtr alloc, StringMap &dest,
 		dest.SecureSet(alloc, name, alloc.Dup(value));
 }
 
+/**
+ * May the document be served up to the given duration after it has
+ * expired?
+ *
+ * @see RFC 5861
+ */
+[[gnu::pure]]
+static bool
+http_cache_may_serve_stale(EventLoop &event_loop,
+			   const HttpCacheDocument &document,
+			   std::chrono::system_clock::duration max_stale) noexcept
+{
+	return max_stale > std::chrono::system_clock::duration::zero() &&
+		document.info.expires + max_stale >= event_loop.SystemNow();
+}
+
+/**
+ * Does this response status allow serving a stale document with
+ * "stale-if-error"?
+ *
+ * @see RFC 5861 4
+ */
+static constexpr bool
+IsStaleIfErrorStatus(HttpStatus status) noexcept
+{
+	return status == HttpStatus::INTERNAL_SERVER_ERROR ||
+		status == HttpStatus::BAD_GATEWAY ||
+		status == HttpStatus::SERVICE_UNAVAILABLE ||
+		status == HttpStatus::GATEWAY_TIMEOUT;
+}
+
+/**
+ * The #HttpResponseHandler for background revalidation requests: the
+ * response is only used to update the cache, and nobody else is
+ * interested in it.
+ */
+class DiscardHttpResponseHandler final : public HttpResponseHandler {
+	/* virtual methods from class HttpResponseHandler */
+	void OnHttpResponse(HttpStatus, StringMap &&,
+			    UnusedIstreamPtr body) noexcept override {
+		body.Clear();
+	}
+
+	void OnHttpError(std::exception_ptr ep) noexcept override {
+		LogConcat(3, "HttpCache", "background revalidation failed: ", ep);
+	}
+};
+
+static DiscardHttpResponseHandler discard_http_response_handler;
+
 static StringWithHash
 http_cache_key(const AllocatorPtr alloc, const ResourceAddress &address,
 	       StringWithHash id) noexcept
@@ -481,6 +744,48 @@ HttpCacheRequest::GetEventLoop() const noexcept
 	return cache.GetEventLoop();
 }
 
+void
+HttpCacheWaiter::Dispatch(HttpCache &cache, bool coalesce) noexcept
+{
+	cache.Use(caller_pool, nullptr, key, params,
+		  method, address, std::move(headers), info,
+		  handler, cancel_ptr, coalesce);
+	Destroy();
+}
+
+void
+HttpCacheWaiter::OnLeaderError(HttpCache &cache, std::exception_ptr ep) noexcept
+{
+	if (!cache.ServeStale(caller_pool, key, headers, info, handler))
+		handler.InvokeError(ep);
+
+	Destroy();
+}
+
+void
+HttpCacheRequest::ResumeWaiters() noexcept
+{
+	RemovePending();
+
+	while (!waiters.empty()) {
+		auto &waiter = waiters.front();
+		waiters.pop_front();
+		waiter.Dispatch(cache, false);
+	}
+}
+
+void
+HttpCacheRequest::FailWaiters(std::exception_ptr ep) noexcept
+{
+	RemovePending();
+
+	while (!waiters.empty()) {
+		auto &waiter = waiters.front();
+		waiters.pop_front();
+		waiter.OnLeaderError(cache, ep);
+	}
+}
+
 void
 HttpCacheRequest::Put(RubberAllocation &&a, size_t size) noexcept
 {
@@ -523,6 +828,7 @@ HttpCacheRequest::RubberDone(RubberAllocation &&a, size_t size) noexcept
 	/* the request was successful, and all of the body data has been
 	   saved: add it to the cache */
 	Put(std::move(a), size);
+	ResumeWaiters();
 	Destroy();
 }
 
@@ -532,6 +838,7 @@ HttpCacheRequest::RubberOutOfMemory() noexcept
 	LogConcat(4, "HttpCache", "nocache oom ", key.value);
 
 	RubberStoreFinished();
+	ResumeWaiters();
 	Destroy();
 }
 
@@ -541,6 +848,7 @@ HttpCacheRequest::RubberTooLarge() noexcept
 	LogConcat(4, "HttpCache", "nocache too large ", key.value);
 
 	RubberStoreFinished();
+	ResumeWaiters();
 	Destroy();
 }
 
@@ -550,6 +858,7 @@ HttpCacheRequest::RubberError(std::exception_ptr ep) noexcept
 	LogConcat(4, "HttpCache", "body_abort ", key.value, ": ", ep);
 
 	RubberStoreFinished();
+	ResumeWaiters();
 	Destroy();
 }
 
@@ -592,6 +901,8 @@ HttpCacheRequest::OnHttpResponse(HttpStatus status, StringMap &&_headers,
 			/* copy the new "Expires" (or "max-age") value from the
 			   "304 Not Modified" response */
 			auto &item = *(HttpCacheItem *)document;
+			document->info.stale_while_revalidate = _info->stale_while_revalidate;
+			document->info.stale_if_error = _info->stale_if_error;
 			item.SetExpires(GetEventLoop().SteadyNow(),
 					GetEventLoop().SystemNow(),
 					_info->expires);
@@ -606,6 +917,7 @@ HttpCacheRequest::OnHttpResponse(HttpStatus status, StringMap &&_headers,
 
 		LogConcat(5, "HttpCache", "not_modified ", key.value);
 		Serve();
+		ResumeWaiters();
 		Destroy();
 		return;
 	}
@@ -618,6 +930,20 @@ HttpCacheRequest::OnHttpResponse(HttpStatus status, StringMap &&_headers,
 		body.Clear();
 
 		Serve();
+		ResumeWaiters();
+		Destroy();
+		return;
+	}
+
+	if (document != nullptr && IsStaleIfErrorStatus(status) &&
+	    http_cache_may_serve_stale(GetEventLoop(), *document,
+				       document->info.stale_if_error)) {
+		LogConcat(4, "HttpCache", "stale_if_error ", key.value);
+
+		body.Clear();
+
+		Serve();
+		ResumeWaiters();
 		Destroy();
 		return;
 	}
@@ -639,6 +965,8 @@ HttpCacheRequest::OnHttpResponse(HttpStatus status, StringMap &&_headers,
 		/* don't cache response */
 		LogConcat(4, "HttpCache", "nocache ", key.value);
 
+		ResumeWaiters();
+
 		if (body)
 			body = NewRefIstream(pool, std::move(body));
 		else
@@ -676,6 +1004,7 @@ HttpCacheRequest::OnHttpResponse(HttpStatus status, StringMap &&_headers,
 	bool destroy = false;
 	if (!body) {
 		Put({}, 0);
+		ResumeWaiters();
 		destroy = true;
 
 		/* workaround: if there is no response body, nobody
@@ -722,6 +1051,18 @@ HttpCacheRequest::OnHttpError(std::exception_ptr ep) noexcept
 {
 	ep = NestException(ep, FmtRuntimeError("http_cache {}", key.value));
 
+	FailWaiters(ep);
+
+	if (document != nullptr &&
+	    http_cache_may_serve_stale(GetEventLoop(), *document,
+				       document->info.stale_if_error)) {
+		LogConcat(4, "HttpCache", "stale_if_error ", key.value, ": ", ep);
+
+		Serve();
+		Destroy();
+		return;
+	}
+
 	auto &_handler = handler;
 	Destroy();
 	_handler.InvokeError(ep);
@@ -735,7 +1076,17 @@ HttpCacheRequest::OnHttpError(std::exception_ptr ep) noexcept
 void
 HttpCacheRequest::Cancel() noexcept
 {
+	RemovePending();
 	cancel_ptr.Cancel();
+
+	/* the waiters still need a response: the first one sends
+	   its own request and the others wait for it */
+	while (!waiters.empty()) {
+		auto &waiter = waiters.front();
+		waiters.pop_front();
+		waiter.Dispatch(cache, true);
+	}
+
 	Destroy();
 }
 
@@ -773,11 +1124,13 @@ inline
 HttpCache::HttpCache(struct pool &_pool, size_t max_size,
 		     bool _obey_no_cache,
 		     EventLoop &_event_loop,
-		     ResourceLoader &_resource_loader)
+		     ResourceLoader &_resource_loader,
+		     const char *disk_path, size_t disk_size,
+		     CachePolicy policy)
 	:pool(pool_new_dummy(&_pool, "http_cache")),
 	 event_loop(_event_loop),
 	 compress_timer(event_loop, BIND_THIS_METHOD(OnCompressTimer)),
-	 heap(pool, event_loop, max_size),
+	 heap(pool, event_loop, max_size, disk_path, disk_size, policy),
 	 resource_loader(_resource_loader),
 	 obey_no_cache(_obey_no_cache)
 {
@@ -790,12 +1143,15 @@ HttpCache *
 http_cache_new(struct pool &pool, size_t max_size,
 	       bool obey_no_cache,
 	       EventLoop &event_loop,
-	       ResourceLoader &resource_loader)
+	       ResourceLoader &resource_loader,
+	       const char *disk_path, size_t disk_size,
+	       CachePolicy policy)
 {
 	assert(max_size > 0);
 
 	return new HttpCache(pool, max_size, obey_no_cache,
-			     event_loop, resource_loader);
+			     event_loop, resource_loader,
+			     disk_path, disk_size, policy);
 }
 
 void
@@ -811,6 +1167,7 @@ void
 HttpCacheRequest::AbortRubberStore() noexcept
 {
 	cancel_ptr.Cancel();
+	FailWaiters(std::make_exception_ptr(std::runtime_error{"HTTP cache shut down"}));
 	Destroy();
 }
 
@@ -818,6 +1175,10 @@ inline
 HttpCache::~HttpCache() noexcept
 {
 	requests.clear_and_dispose(std::mem_fn(&HttpCacheRequest::AbortRubberStore));
+
+	/* background revalidations which are still waiting for the
+	   response */
+	background.clear_and_dispose(std::mem_fn(&HttpCacheRequest::AbortRubberStore));
 }
 
 void
@@ -860,8 +1221,15 @@ HttpCache::Miss(struct pool &caller_pool,
 		const ResourceAddress &address,
 		StringMap &&headers,
 		HttpResponseHandler &handler,
-		CancellablePointer &cancel_ptr) noexcept
+		CancellablePointer &cancel_ptr,
+		bool coalesce) noexcept
 {
+	if (coalesce && !info.only_if_cached &&
+	    Wait(caller_pool, key, params, info,
+		 method, address, std::move(headers),
+		 handler, cancel_ptr))
+		return;
+
 	++stats.misses;
 
 	if (info.only_if_cached) {
@@ -887,6 +1255,9 @@ HttpCache::Miss(struct pool &caller_pool,
 
 	LogConcat(4, "HttpCache", "miss ", request->GetKey().value);
 
+	if (coalesce)
+		pending.insert(*request);
+
 	request->Start(resource_loader, parent_stopwatch,
 		       params,
 		       method, address,
@@ -894,6 +1265,32 @@ HttpCache::Miss(struct pool &caller_pool,
 		       cancel_ptr);
 }
 
+inline bool
+HttpCache::Wait(struct pool &caller_pool,
+		StringWithHash key,
+		const ResourceRequestParams &params,
+		const HttpCacheRequestInfo &info,
+		HttpMethod method,
+		const ResourceAddress &address,
+		StringMap &&headers,
+		HttpResponseHandler &handler,
+		CancellablePointer &cancel_ptr) noexcept
+{
+	auto i = pending.find(key);
+	if (i == pending.end())
+		return false;
+
+	LogConcat(4, "HttpCache", "wait ", key.value);
+
+	auto *waiter = NewFromPool<HttpCacheWaiter>(caller_pool, caller_pool,
+						    key, params, info,
+						    method, address,
+						    std::move(headers),
+						    handler, cancel_ptr);
+	i->AddWaiter(*waiter);
+	return true;
+}
+
 [[gnu::pure]]
 static bool
 CheckETagList(const char *list, const StringMap &response_headers) noexcept
@@ -1032,7 +1429,8 @@ HttpCache::Revalidate(struct pool &caller_pool,
 		      const ResourceAddress &address,
 		      StringMap &&headers,
 		      HttpResponseHandler &handler,
-		      CancellablePointer &cancel_ptr) noexcept
+		      CancellablePointer &cancel_ptr,
+		      bool coalesce, bool _background) noexcept
 {
 	/* the cache request may live longer than the caller pool, so
 	   allocate a new pool for it from cache.pool */
@@ -1058,12 +1456,68 @@ HttpCache::Revalidate(struct pool &caller_pool,
 		headers.Set(request->GetPool(),
 			    if_none_match_header, document.info.etag);
 
+	if (coalesce)
+		pending.insert(*request);
+
+	if (_background)
+		background.push_back(*request);
+
 	request->Start(resource_loader, parent_stopwatch,
 		       params,
 		       method, address, std::move(headers),
 		       cancel_ptr);
 }
 
+void
+HttpCache::BackgroundRevalidate(StringWithHash key,
+				const ResourceRequestParams &params,
+				const HttpCacheRequestInfo &info,
+				HttpCacheDocument &document,
+				HttpMethod method,
+				const ResourceAddress &address,
+				const StringMap &headers) noexcept
+{
+	/* the caller will not wait for this request, so everything
+	   it owns needs to be copied to a new pool */
+	const auto caller_pool = pool_new_linear(pool, "HttpCacheBackground", 4096);
+	const AllocatorPtr alloc{caller_pool};
+
+	ResourceRequestParams background_params = params;
+	if (!params.address_id.IsNull())
+		background_params.address_id = alloc.Dup(params.address_id);
+	if (!params.body_etag.IsNull())
+		background_params.body_etag = alloc.Dup(params.body_etag);
+	background_params.cache_tag = alloc.CheckDup(params.cache_tag);
+	background_params.site_name = alloc.CheckDup(params.site_name);
+
+	/* the conditional request headers are the client's business;
+	   the background request just updates the cache (Revalidate()
+	   adds its own "If-Modified-Since" and "If-None-Match") */
+	HttpCacheRequestInfo background_info = info;
+	background_info.if_match = background_info.if_none_match = nullptr;
+	background_info.if_modified_since = background_info.if_unmodified_since = nullptr;
+
+	StringMap background_headers{alloc, headers};
+	background_headers.RemoveAll(if_match_header);
+	background_headers.RemoveAll(if_none_match_header);
+	background_headers.RemoveAll(if_modified_since_header);
+	background_headers.RemoveAll(if_unmodified_since_header);
+	background_headers.RemoveAll(if_range_header);
+
+	/* nobody will ever cancel the request through this pointer;
+	   ~HttpCache() uses the #background list instead */
+	CancellablePointer cancel_ptr;
+
+	LogConcat(4, "HttpCache", "background ", key.value);
+
+	Revalidate(caller_pool, nullptr, key,
+		   background_params, background_info, document,
+		   method, *alloc.New<ResourceAddress>(alloc, address),
+		   std::move(background_headers),
+		   discard_http_response_handler, cancel_ptr,
+		   true, true);
+}
+
 [[gnu::pure]]
 static bool
 http_cache_may_serve(EventLoop &event_loop,
@@ -1085,7 +1539,8 @@ HttpCache::Found(const HttpCacheRequestInfo &info,
 		 const ResourceAddress &address,
 		 StringMap &&headers,
 		 HttpResponseHandler &handler,
-		 CancellablePointer &cancel_ptr) noexcept
+		 CancellablePointer &cancel_ptr,
+		 bool coalesce) noexcept
 {
 	++stats.hits;
 
@@ -1095,12 +1550,33 @@ HttpCache::Found(const HttpCacheRequestInfo &info,
 	if (http_cache_may_serve(GetEventLoop(), info, document))
 		Serve(caller_pool, document, key,
 		      handler);
-	else
+	else if (!info.no_cache &&
+		 http_cache_may_serve_stale(GetEventLoop(), document,
+					    document.info.stale_while_revalidate)) {
+		/* RFC 5861 3: serve the stale document now and
+		   revalidate it in the background (unless that is
+		   already being done) */
+
+		/* this lease keeps the document alive even if the
+		   revalidation finishes synchronously */
+		const auto lease = Lock(document);
+
+		if (pending.find(key) == pending.end())
+			BackgroundRevalidate(key, params, info, document,
+					     method, address, headers);
+
+		Serve(caller_pool, document, key,
+		      handler);
+	} else if (!coalesce ||
+		   !Wait(caller_pool, key, params, info,
+			 method, address, std::move(headers),
+			 handler, cancel_ptr))
 		Revalidate(caller_pool, parent_stopwatch,
 			   key, params,
 			   info, document,
 			   method, address, std::move(headers),
-			   handler, cancel_ptr);
+			   handler, cancel_ptr,
+			   coalesce);
 }
 
 inline void
@@ -1113,7 +1589,8 @@ HttpCache::Use(struct pool &caller_pool,
 	       StringMap &&headers,
 	       const HttpCacheRequestInfo &info,
 	       HttpResponseHandler &handler,
-	       CancellablePointer &cancel_ptr) noexcept
+	       CancellablePointer &cancel_ptr,
+	       bool coalesce) noexcept
 {
 	auto *document = heap.Get(key, headers);
 
@@ -1121,12 +1598,32 @@ HttpCache::Use(struct pool &caller_pool,
 		Miss(caller_pool, parent_stopwatch,
 		     key, params, info,
 		     method, address, std::move(headers),
-		     handler, cancel_ptr);
+		     handler, cancel_ptr, coalesce);
 	else
 		Found(info, *document, key, caller_pool, parent_stopwatch,
 		      params,
 		      method, address, std::move(headers),
-		      handler, cancel_ptr);
+		      handler, cancel_ptr, coalesce);
+}
+
+bool
+HttpCache::ServeStale(struct pool &caller_pool,
+		      StringWithHash key,
+		      StringMap &headers,
+		      const HttpCacheRequestInfo &info,
+		      HttpResponseHandler &handler) noexcept
+{
+	auto *document = heap.Get(key, headers);
+	if (document == nullptr ||
+	    !http_cache_may_serve_stale(GetEventLoop(), *document,
+					document->info.stale_if_error))
+		return false;
+
+	LogConcat(4, "HttpCache", "stale_if_error ", key.value);
+
+	if (CheckCacheRequest(caller_pool, info, *document, handler))
+		Serve(caller_pool, *document, key, handler);
+	return true;
 }
 
 [[gnu::pure]]
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include "cache/Policy.hxx"
+
 #include <cstdint>
 #include <cstddef>
 #include <string_view>
@@ -24,12 +26,21 @@ class CancellablePointer;
 
 /**
  * Caching HTTP responses.
+ *
+ * Throws if the disk tier could not be opened.
+ *
+ * @param disk_path a directory for the optional disk tier (items
+ * evicted from memory are moved there); nullptr to disable it
+ * @param disk_size the maximum size of the disk tier
+ * @param policy the eviction policy of the memory tier
  */
 HttpCache *
 http_cache_new(struct pool &pool, size_t max_size,
 	       bool obey_no_cache,
 	       EventLoop &event_loop,
-	       ResourceLoader &resource_loader);
+	       ResourceLoader &resource_loader,
+	       const char *disk_path=nullptr, size_t disk_size=0,
+	       CachePolicy policy=CachePolicy::LRU);
 
 void
 http_cache_close(HttpCache *cache) noexcept;
@@ -110,6 +110,23 @@ http_cache_request_invalidate(HttpMethod method) noexcept
 		method == HttpMethod::POST;
 }
 
+/**
+ * Parse a "delta-seconds" value (RFC 9111 1.2.2).
+ *
+ * @return the number of seconds or -1 on error
+ */
+[[gnu::pure]]
+static int
+ParseDeltaSeconds(std::string_view s) noexcept
+{
+	char value[16];
+	if (s.size() >= sizeof(value))
+		return -1;
+
+	*std::copy(s.begin(), s.end(), value) = 0;
+	return atoi(value);
+}
+
 [[gnu::pure]]
 static std::chrono::system_clock::time_point
 parse_translate_time(const char *p,
@@ -180,6 +197,7 @@ http_cache_response_evaluate(const HttpCacheRequestInfo &request_info,
 
 	HttpCacheResponseInfo info;
 	info.expires = std::chrono::system_clock::from_time_t(-1);
+	info.stale_while_revalidate = info.stale_if_error = {};
 	if (const char *cache_control = headers.Get(cache_control_header)) {
 		for (std::string_view s : IterableSplitString(cache_control, ',')) {
 			s = Strip(s);
@@ -190,17 +208,16 @@ http_cache_response_evaluate(const HttpCacheRequestInfo &request_info,
 
 			if (SkipPrefix(s, "max-age="sv)) {
 				/* RFC 2616 14.9.3 */
-				char value[16];
-				int seconds;
-
-				if (s.size() >= sizeof(value))
-					continue;
-
-				*std::copy(s.begin(), s.end(), value) = 0;
-
-				seconds = atoi(value);
-				if (seconds > 0)
+				if (int seconds = ParseDeltaSeconds(s); seconds > 0)
 					info.expires = std::chrono::system_clock::now() + std::chrono::seconds(seconds);
+			} else if (SkipPrefix(s, "stale-while-revalidate="sv)) {
+				/* RFC 5861 3 */
+				if (int seconds = ParseDeltaSeconds(s); seconds > 0)
+					info.stale_while_revalidate = std::chrono::seconds(seconds);
+			} else if (SkipPrefix(s, "stale-if-error="sv)) {
+				/* RFC 5861 4 */
+				if (int seconds = ParseDeltaSeconds(s); seconds > 0)
+					info.stale_if_error = std::chrono::seconds(seconds);
 			}
 		}
 	}
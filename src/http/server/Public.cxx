@@ -66,7 +66,7 @@ HttpServerConnection::TryWriteBuckets2()
 	assert(HasInput());
 	assert(!request.cancel_ptr);
 
-	if (socket->HasFilter())
+	if (!socket->IsOutputDirect())
 		return BucketResult::FALLBACK;
 
 	IstreamBucketList list;
@@ -164,7 +164,7 @@ void
 HttpServerConnection::SetResponseIstream(UnusedIstreamPtr r) noexcept
 {
 	SetInput(std::move(r));
-	input.SetDirect(istream_direct_mask_to(socket->GetType()));
+	input.SetDirect(istream_direct_mask_to(socket->GetOutputType()));
 }
 
 bool
@@ -3,6 +3,7 @@
 // author: Max Kellermann <mk@cm4all.com>
 
 #include "FdCache.hxx"
+#include "FileMetadata.hxx"
 #include "event/Loop.hxx"
 #include "system/Error.hxx"
 #include "io/FileAt.hxx"
@@ -99,6 +100,13 @@ struct FdCache::Item final
 
 	UniqueFileDescriptor fd;
 
+	/**
+	 * Attributes derived from #fd.  They are discarded together
+	 * with this item, i.e. when the inotify watch fires or when
+	 * it expires.
+	 */
+	FileMetadata metadata;
+
 	int error = 0;
 
 	std::chrono::steady_clock::time_point expires;
@@ -171,7 +179,7 @@ private:
 		requests.clear_and_dispose([this](Request *r) {
 			auto on_success = r->on_success;
 			delete r;
-			on_success(fd, stx, *this);
+			on_success(fd, stx, metadata, *this);
 		});
 	}
 
@@ -364,7 +372,7 @@ FdCache::Item::Get(SuccessCallback on_success,
 		   CancellablePointer &cancel_ptr) noexcept
 {
 	if (fd.IsDefined() && (requested_stx_mask & ~stx.stx_mask) == 0) {
-		on_success(fd, stx, *this);
+		on_success(fd, stx, metadata, *this);
 	} else if (error) {
 		on_error(error);
 	} else {
@@ -18,6 +18,7 @@
 
 struct open_how;
 struct statx;
+struct FileMetadata;
 class FileDescriptor;
 class SharedLease;
 class CancellablePointer;
@@ -105,7 +106,13 @@ public:
 		return inotify_manager.IsShuttingDown();
 	}
 
+	/**
+	 * @param metadata lazily filled attributes of this file
+	 * which are shared by all users of the cached file
+	 * descriptor; it is valid as long as the #lease is held
+	 */
 	using SuccessCallback = BoundMethod<void(FileDescriptor fd, const struct statx &stx,
+						 FileMetadata &metadata,
 						 SharedLease &&lease) noexcept>;
 	using ErrorCallback = BoundMethod<void(int error) noexcept>;
 
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string>
+
+/**
+ * Attributes of a file which can only be obtained with additional
+ * system calls (extended attributes, neighbouring files).  #FdCache
+ * keeps one instance per cached file descriptor; it starts empty, is
+ * filled lazily by its users and gets discarded together with the
+ * file descriptor.
+ */
+struct FileMetadata {
+	/**
+	 * The "user.ETag" xattr enclosed in double quotes, or an
+	 * empty string if the file has no such xattr.  Not yet
+	 * loaded if std::nullopt.
+	 */
+	std::optional<std::string> etag;
+
+	/**
+	 * The "user.Content-Type" xattr, or an empty string if the
+	 * file has no such xattr.  Not yet loaded if std::nullopt.
+	 */
+	std::optional<std::string> content_type;
+
+	/**
+	 * The "user.MaxAge" xattr, or zero if the file has no (valid)
+	 * such xattr.  Not yet loaded if std::nullopt.
+	 */
+	std::optional<std::chrono::seconds> max_age;
+
+	/**
+	 * Is it known that there is no precompressed sibling
+	 * ("FILE.br" or "FILE.gz")?
+	 */
+	bool no_brotli_sibling = false, no_gzip_sibling = false;
+};
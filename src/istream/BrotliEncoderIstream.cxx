@@ -24,13 +24,16 @@ class BrotliEncoderFilter final : public ThreadIstreamFilter {
 	 */
 	std::span<const std::byte> pending{};
 
+	const uint32_t quality;
+
 	const BrotliEncoderMode mode;
 
 	BrotliEncoderOperation operation = BROTLI_OPERATION_PROCESS;
 
 public:
 	explicit BrotliEncoderFilter(BrotliEncoderParams params) noexcept
-		:mode(params.text_mode ? BROTLI_MODE_TEXT : BROTLI_MODE_GENERIC)
+		:quality(params.quality),
+		 mode(params.text_mode ? BROTLI_MODE_TEXT : BROTLI_MODE_GENERIC)
 	{
 	}
 
@@ -54,10 +57,7 @@ BrotliEncoderFilter::CreateEncoder() noexcept
 
 	state = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
 
-	/* use medium quality; doesn't use too much CPU, but
-	   compresses reasonably well */
-	BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY,
-				  (BROTLI_MIN_QUALITY + BROTLI_MAX_QUALITY) / 2);
+	BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY, quality);
 
 	BrotliEncoderSetParameter(state, BROTLI_PARAM_MODE, mode);
 }
@@ -9,6 +9,13 @@ class UnusedIstreamPtr;
 class ThreadQueue;
 
 struct BrotliEncoderParams {
+	/**
+	 * The compression quality (0..11).  The default is medium
+	 * quality, which doesn't use too much CPU, but compresses
+	 * reasonably well.
+	 */
+	unsigned quality = 5;
+
 	/**
 	 * Set BROTLI_MODE_TEXT.
 	 */
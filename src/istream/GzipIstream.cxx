@@ -6,6 +6,7 @@
 #include "UnusedPtr.hxx"
 #include "New.hxx"
 #include "FacadeIstream.hxx"
+#include "ThreadIstream.hxx"
 #include "pool/pool.hxx"
 #include "memory/fb_pool.hxx"
 #include "memory/SliceFifoBuffer.hxx"
@@ -26,9 +27,13 @@ class GzipIstream final : public FacadeIstream, DestructAnchor {
 
 	bool had_input, had_output;
 
+	const int level;
+
 public:
-	GzipIstream(struct pool &_pool, UnusedIstreamPtr _input) noexcept
-		:FacadeIstream(_pool, std::move(_input))
+	GzipIstream(struct pool &_pool, UnusedIstreamPtr _input,
+		    GzipParams params) noexcept
+		:FacadeIstream(_pool, std::move(_input)),
+		 level(params.level)
 	{
 	}
 
@@ -111,7 +116,7 @@ public:
 	void OnError(std::exception_ptr ep) noexcept override;
 
 private:
-	int GetWindowBits() const noexcept {
+	static constexpr int GetWindowBits() noexcept {
 		return MAX_WBITS + 16;
 	}
 };
@@ -141,7 +146,7 @@ GzipIstream::InitZlib() noexcept
 	z.zfree = z_free;
 	z.opaque = &GetPool();
 
-	int err = deflateInit2(&z, Z_DEFAULT_COMPRESSION,
+	int err = deflateInit2(&z, level,
 			       Z_DEFLATED, GetWindowBits(), 8,
 			       Z_DEFAULT_STRATEGY);
 	if (err != Z_OK) {
@@ -337,14 +342,144 @@ GzipIstream::OnError(std::exception_ptr ep) noexcept
 	DestroyError(ep);
 }
 
+/*
+ * threaded implementation
+ *
+ */
+
+class GzipFilter final : public ThreadIstreamFilter {
+	z_stream z;
+
+	SliceFifoBuffer input, output;
+
+	const int level;
+
+	bool z_initialized = false, z_stream_end = false;
+
+public:
+	explicit GzipFilter(GzipParams params) noexcept
+		:level(params.level) {}
+
+	~GzipFilter() noexcept override {
+		if (z_initialized)
+			deflateEnd(&z);
+	}
+
+protected:
+	void InitZlib();
+
+	/* virtual methods from class ThreadIstreamFilter */
+	void Run(ThreadIstreamInternal &i) override;
+	void PostRun(ThreadIstreamInternal &i) noexcept override;
+};
+
+inline void
+GzipFilter::InitZlib()
+{
+	assert(!z_initialized);
+
+	/* this runs in a worker thread, therefore we can't use
+	   z_alloc() (pools are not thread-safe); let zlib use
+	   malloc() */
+	z = {};
+
+	int err = deflateInit2(&z, level,
+			       Z_DEFLATED, MAX_WBITS + 16, 8,
+			       Z_DEFAULT_STRATEGY);
+	if (err != Z_OK)
+		throw MakeZlibError(err, "deflateInit2() failed");
+
+	z_initialized = true;
+}
+
+void
+GzipFilter::Run(ThreadIstreamInternal &i)
+{
+	using std::swap;
+
+	if (!z_initialized)
+		InitZlib();
+
+	bool has_more_input, finish;
+
+	{
+		const std::scoped_lock lock{i.mutex};
+		input.MoveFromAllowBothNull(i.input);
+
+		has_more_input = !i.input.empty();
+		finish = !i.has_input && i.input.empty();
+
+		if (!output.IsNull())
+			i.output.MoveFromAllowNull(output);
+		else if (i.output.empty())
+			swap(output, i.output);
+	}
+
+	if (!z_stream_end) {
+		const auto r = input.Read();
+		const auto w = output.Write();
+
+		z.next_in = (Bytef *)const_cast<std::byte *>(r.data());
+		z.avail_in = (uInt)r.size();
+
+		z.next_out = (Bytef *)w.data();
+		z.avail_out = (uInt)w.size();
+
+		/* like GzipIstream::ForceRead(), flush if there is
+		   currently no more input, so the client receives
+		   everything we have so far */
+		const int flush = finish
+			? Z_FINISH
+			: (has_more_input ? Z_NO_FLUSH : Z_SYNC_FLUSH);
+
+		int err = deflate(&z, flush);
+		if (err == Z_STREAM_END)
+			z_stream_end = true;
+		else if (err != Z_OK && err != Z_BUF_ERROR)
+			throw MakeZlibError(err, "deflate() failed");
+
+		const std::size_t input_consumed = r.size() - (std::size_t)z.avail_in;
+		input.Consume(input_consumed);
+		output.Append(w.size() - (std::size_t)z.avail_out);
+
+		if (z.avail_out == 0 || (input_consumed > 0 && has_more_input))
+			/* run again if our output buffer is full or
+			   if there is more input (see
+			   BrotliEncoderFilter::Run()) */
+			i.again = true;
+	}
+
+	{
+		const std::scoped_lock lock{i.mutex};
+		i.output.MoveFromAllowSrcNull(output);
+		i.drained = output.empty();
+	}
+}
+
+void
+GzipFilter::PostRun(ThreadIstreamInternal &) noexcept
+{
+	input.FreeIfEmpty();
+	output.FreeIfEmpty();
+}
+
 /*
  * constructor
  *
  */
 
 UnusedIstreamPtr
-NewGzipIstream(struct pool &pool, UnusedIstreamPtr input) noexcept
+NewGzipIstream(struct pool &pool, UnusedIstreamPtr input,
+	       GzipParams params) noexcept
 {
-	return NewIstreamPtr<GzipIstream>(pool, std::move(input));
+	return NewIstreamPtr<GzipIstream>(pool, std::move(input), params);
+}
 
+UnusedIstreamPtr
+NewThreadGzipIstream(struct pool &pool, ThreadQueue &queue,
+		     UnusedIstreamPtr input,
+		     GzipParams params) noexcept
+{
+	return NewThreadIstream(pool, queue, std::move(input),
+				std::make_unique<GzipFilter>(params));
 }
@@ -6,6 +6,30 @@
 
 struct pool;
 class UnusedIstreamPtr;
+class ThreadQueue;
 
+struct GzipParams {
+	/**
+	 * The zlib compression level (1..9).  The default is what
+	 * Z_DEFAULT_COMPRESSION selects.
+	 */
+	unsigned level = 6;
+};
+
+/**
+ * An #Istream filter which compresses data on-the-fly with gzip.
+ * deflate() runs in the calling thread.
+ */
+UnusedIstreamPtr
+NewGzipIstream(struct pool &pool, UnusedIstreamPtr input,
+	       GzipParams params={}) noexcept;
+
+/**
+ * Like NewGzipIstream(), but deflate() runs in a worker thread (see
+ * #ThreadIstream), so large responses don't block the event loop.
+ * This has more overhead and is only worth it for large inputs.
+ */
 UnusedIstreamPtr
-NewGzipIstream(struct pool &pool, UnusedIstreamPtr input) noexcept;
+NewThreadGzipIstream(struct pool &pool, ThreadQueue &queue,
+		     UnusedIstreamPtr input,
+		     GzipParams params={}) noexcept;
@@ -12,16 +12,35 @@
 #include "util/SpanCast.hxx"
 #include "util/StringSplit.hxx"
 
+#include <algorithm>
 #include <cassert>
 #include <utility> // for std::unreachable()
+#include <vector>
 
 #include <string.h>
 
 /* ternary search tree */
 struct SubstNode {
-	SubstNode *parent, *left, *right, *equals;
+	SubstNode *left, *right, *equals;
 	char ch;
 
+	/* the following attributes are only used by nodes which begin
+	   a level (the root and all "equals" children), i.e. by the
+	   states of the Aho-Corasick automaton; they are initialized
+	   by SubstTree::Compile() */
+
+	/** the state for the longest proper suffix of this state's
+	    prefix which is also the prefix of a word */
+	const SubstNode *fail;
+
+	/** the state of the longest word which is a suffix of this
+	    state's prefix (may be this state itself); nullptr if there
+	    is none */
+	const SubstNode *output;
+
+	/** the length of this state's prefix */
+	size_t depth;
+
 	struct {
 		const char *a;
 		size_t b_length;
@@ -58,7 +77,10 @@ class SubstIstream final : public FacadeIstream, DestructAnchor {
 
 public:
 	SubstIstream(struct pool &p, UnusedIstreamPtr &&_input, SubstTree &&_tree) noexcept
-		:FacadeIstream(p, std::move(_input)), tree(std::move(_tree)) {}
+		:FacadeIstream(p, std::move(_input)), tree(std::move(_tree))
+	{
+		tree.Compile();
+	}
 
 private:
 	/** find the first occurence of a "first character" in the buffer */
@@ -157,31 +179,6 @@ subst_find_leaf(const SubstNode *node) noexcept
 	return nullptr;
 }
 
-/**
- * Check whether the given input can possibly be a match.
- *
- * @param match the current match (usually found with memchr() by
- * SubstTree::FindFirstChar())
- * @param input the remaining input
- * @param true if the remaining input matches so far (but may not be
- * complete yet), false if the input cannot match
- */
-[[gnu::pure]]
-static bool
-CheckMatch(const SubstNode *match, std::string_view input) noexcept
-{
-	for (const char ch : input) {
-		if (subst_find_leaf(match) != nullptr)
-			return true;
-
-		match = subst_find_char(match, ch);
-		if (match == nullptr)
-			return false;
-	}
-
-	return true;
-}
-
 /** find any leaf which begins with the current partial match, used to
     find a buffer which is partially re-inserted into the data
     stream */
@@ -199,78 +196,80 @@ subst_find_any_leaf(const SubstNode *node) noexcept
 	}
 }
 
-/** iterates over the current depth */
-[[gnu::pure]]
-static const SubstNode *
-subst_next_non_leaf_node(const SubstNode *node, const SubstNode *root) noexcept
+inline const char *
+SubstTree::SkipToFirstChar(const char *p, const char *end) const noexcept
 {
-	/* dive into left wing first */
-	if (node->left != nullptr && node->left->ch != 0)
-		return node->left;
-
-	/* if left does not exist, go right */
-	if (node->right != nullptr && node->right->ch != 0)
-		return node->right;
-
-	/* this subtree is finished, go up */
-	while (true) {
-		/* don't go above our root */
-		if (node == root)
-			return nullptr;
-
-		assert(node->parent != nullptr);
+	if (first_char != 0) {
+		p = (const char *)memchr(p, first_char, end - p);
+		return p != nullptr ? p : end;
+	}
 
-		if (node->parent->left == node) {
-			node = node->parent;
+	while (p < end && !first_chars[(unsigned char)*p])
+		++p;
 
-			/* only go to parent->right if we came from
-			   parent->left */
-			if (node->right != nullptr && node->right->ch != 0)
-				return node;
-		} else {
-			node = node->parent;
-		}
-	}
+	return p;
 }
 
 inline std::pair<const SubstNode *, const char *>
 SubstTree::FindFirstChar(const char *data, size_t length) const noexcept
 {
+	if (root == nullptr)
+		return {};
+
 	const char *const end = data + length;
-	const SubstNode *n = root;
-	const SubstNode *match = nullptr;
-	const char *min = nullptr;
-
-	while (n != nullptr) {
-		assert(n->ch != 0);
-
-		/* loop to find all instances of this start character, until
-		   there is one where the rest also matches */
-		const char *p = data;
-		while (true) {
-			p = (const char *)memchr(p, n->ch, end - p);
-			if (p != nullptr && (min == nullptr || p < min)) {
-				if (!CheckMatch(n->equals, {p + 1, end})) {
-					/* late mismatch; continue the loop to check if
-					   there are more of the current start
-					   character */
-					++p;
-					continue;
-				}
+	const SubstNode *state = root;
+
+	/* the leftmost complete match found so far */
+	const char *match = nullptr;
+
+	const char *p = data;
+	for (; p < end; ++p) {
+		if (state == root) {
+			if (match != nullptr)
+				/* no other match can begin before this
+				   one */
+				break;
+
+			p = SkipToFirstChar(p, end);
+			if (p == end)
+				break;
+		}
 
-				assert(n->equals != nullptr);
-				match = n->equals;
-				min = p;
-			}
+		const SubstNode *next;
+		while ((next = subst_find_char(state, *p)) == nullptr &&
+		       state != root)
+			state = state->fail;
+
+		if (next != nullptr)
+			state = next;
 
+		if (match != nullptr && p + 1 - state->depth > match)
+			/* the current candidate begins after the
+			   match; it cannot get any better */
 			break;
+
+		if (state->output != nullptr) {
+			/* a word ends here; the output is the longest
+			   one, i.e. the one which begins first */
+			const char *begin = p + 1 - state->output->depth;
+			if (match == nullptr || begin < match)
+				match = begin;
 		}
+	}
 
-		/* check the next start character in the #SubstTree */
-		n = subst_next_non_leaf_node(n, root);
+	const char *first = match;
+	if (p == end && state != root) {
+		/* the end of the buffer may be the beginning of a
+		   word */
+		const char *partial = end - state->depth;
+		if (first == nullptr || partial < first)
+			first = partial;
 	}
 
-	return std::make_pair(match, min);
+	if (first == nullptr)
+		return {};
+
+	return {subst_find_char(root, *first), first};
 }
 
 inline const char *
@@ -860,7 +859,6 @@ istream_subst_new(struct pool *pool, UnusedIstreamPtr input,
 bool
 SubstTree::Add(struct pool &pool, const char *a0, std::string_view b) noexcept
 {
-	SubstNode *parent = nullptr;
 	const char *a = a0;
 
 	assert(a0 != nullptr);
@@ -873,25 +871,21 @@ SubstTree::Add(struct pool &pool, const char *a0, std::string_view b) noexcept
 			/* create new tree node */
 
 			p = (SubstNode *)p_malloc(&pool, sizeof(*p) - sizeof(p->leaf));
-			p->parent = parent;
 			p->left = nullptr;
 			p->right = nullptr;
 			p->equals = nullptr;
 			p->ch = *a++;
 
-			*pp = parent = p;
+			*pp = p;
 			pp = &p->equals;
 		} else if (*a < p->ch) {
 			pp = &p->left;
-			parent = p;
 		} else if (*a > p->ch) {
 			pp = &p->right;
-			parent = p;
 		} else {
 			/* tree node exists and matches, enter new level (next
 			   character) */
 			pp = &p->equals;
-			parent = p;
 			++a;
 		}
 	} while (*a);
@@ -904,7 +898,6 @@ SubstTree::Add(struct pool &pool, const char *a0, std::string_view b) noexcept
 
 	SubstNode *p = (SubstNode *)
 		p_malloc(&pool, sizeof(*p) + b.size() - sizeof(p->leaf.b));
-	p->parent = parent;
 	p->left = nullptr;
 	p->right = nullptr;
 	p->equals = nullptr;
@@ -924,3 +917,73 @@ SubstTree::Add(struct pool &pool, const char *a0, const char *b) noexcept
 	return Add(pool, a0,
 		   b != nullptr ? std::string_view{b} : std::string_view{});
 }
+
+/**
+ * Invoke the given function for each (non-leaf) node of the level
+ * beginning with the given node.
+ */
+static void
+ForEachChar(SubstNode *node, auto &&f) noexcept
+{
+	while (node != nullptr) {
+		ForEachChar(node->left, f);
+
+		if (node->ch != 0)
+			f(*node);
+
+		node = node->right;
+	}
+}
+
+void
+SubstTree::Compile() noexcept
+{
+	first_chars.fill(false);
+	first_char = 0;
+
+	if (root == nullptr)
+		return;
+
+	root->fail = nullptr;
+	root->output = nullptr;
+	root->depth = 0;
+
+	/* breadth-first traversal, so the failure state (which is
+	   shallower) is always complete before it gets used */
+	std::vector<SubstNode *> queue{root};
+
+	for (std::size_t i = 0; i < queue.size(); ++i) {
+		const SubstNode &state = *queue[i];
+
+		ForEachChar(queue[i], [this, &state, &queue](SubstNode &node){
+			assert(node.equals != nullptr);
+
+			SubstNode &child = *node.equals;
+			child.depth = state.depth + 1;
+
+			if (&state == root) {
+				child.fail = root;
+				first_chars[(unsigned char)node.ch] = true;
+			} else {
+				const SubstNode *fail = state.fail;
+				const SubstNode *next;
+				while ((next = subst_find_char(fail, node.ch)) == nullptr &&
+				       fail != root)
+					fail = fail->fail;
+
+				child.fail = next != nullptr ? next : root;
+			}
+
+			child.output = subst_find_leaf(&child) != nullptr
+				? &child
+				: child.fail->output;
+
+			queue.push_back(&child);
+		});
+	}
+
+	if (std::count(first_chars.begin(), first_chars.end(), true) == 1)
+		first_char = (char)std::distance(first_chars.begin(),
+						 std::find(first_chars.begin(),
+							   first_chars.end(), true));
+}
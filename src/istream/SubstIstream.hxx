@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <array>
 #include <string_view>
 #include <utility>
 
@@ -13,27 +14,67 @@ struct pool;
 class UnusedIstreamPtr;
 struct SubstNode;
 
+/**
+ * A set of words and their substitutions.  It is organized as a
+ * ternary search tree, and Compile() adds Aho-Corasick failure links
+ * to it, which allows searching all words in one pass over the input.
+ */
 class SubstTree {
 	SubstNode *root = nullptr;
 
+	/**
+	 * Which characters begin a word?  This allows skipping
+	 * quickly over input which cannot match.  Initialized by
+	 * Compile().
+	 */
+	std::array<bool, 256> first_chars{};
+
+	/**
+	 * If all words begin with the same character, then this is
+	 * it (and memchr() can be used to find it); otherwise 0.
+	 */
+	char first_char = 0;
+
 public:
 	SubstTree() = default;
 
 	SubstTree(SubstTree &&src) noexcept
-		:root(std::exchange(src.root, nullptr)) {}
+		:root(std::exchange(src.root, nullptr)),
+		 first_chars(src.first_chars),
+		 first_char(src.first_char) {}
 
 	SubstTree &operator=(SubstTree &&src) noexcept {
 		using std::swap;
 		swap(root, src.root);
+		swap(first_chars, src.first_chars);
+		swap(first_char, src.first_char);
 		return *this;
 	}
 
 	bool Add(struct pool &pool, const char *a0, std::string_view b) noexcept;
 	bool Add(struct pool &pool, const char *a0, const char *b) noexcept;
 
+	/**
+	 * Build the Aho-Corasick automaton.  This must be called
+	 * after the last Add() call and before FindFirstChar().
+	 */
+	void Compile() noexcept;
+
+	/**
+	 * Find the leftmost position where a word matches, or where
+	 * the rest of the buffer is the beginning of a word.
+	 *
+	 * @return the node following the first character of the match
+	 * and the position of the match; {nullptr, nullptr} if there
+	 * is none
+	 */
 	[[gnu::pure]]
 	std::pair<const SubstNode *, const char *> FindFirstChar(const char *data,
 								 size_t length) const noexcept;
+
+private:
+	[[gnu::pure]]
+	const char *SkipToFirstChar(const char *p, const char *end) const noexcept;
 };
 
 /**
@@ -15,6 +15,7 @@
 #include "cluster/StickyCache.hxx"
 #include "cluster/ConnectBalancer.hxx"
 #include "cluster/RoundRobinBalancer.cxx"
+#include "cluster/PickLoad.hxx"
 #include "stock/GetHandler.hxx"
 #include "http/Status.hxx"
 #include "system/Error.hxx"
@@ -46,6 +47,11 @@
  */
 using RendezvousHashAlgorithm = FNV1aAlgorithm<FNVTraits<uint32_t>>;
 
+/**
+ * The connect timeout for prewarmed connections.
+ */
+static constexpr Event::Duration WARM_CONNECT_TIMEOUT = std::chrono::seconds{10};
+
 [[gnu::pure]]
 static sticky_hash_t
 CalculateStickyHash(std::span<const std::byte> source) noexcept
@@ -58,7 +64,10 @@ CalculateStickyHash(std::span<const std::byte> source) noexcept
 #ifdef HAVE_AVAHI
 
 class LbCluster::StickyRing final
-	: public MemberHashRing<ZeroconfMemberMap::iterator> {};
+	: public MemberHashRing<ZeroconfMemberMap::iterator> {
+public:
+	using MemberHashRing::MemberHashRing;
+};
 
 LbCluster::ZeroconfMember::ZeroconfMember(std::string_view key,
 					  SocketAddress _address,
@@ -127,9 +136,13 @@ LbCluster::LbCluster(const LbClusterConfig &_config,
 			 nullptr);
 
 #ifdef HAVE_AVAHI
-	if (config.HasZeroConf())
+	if (config.HasZeroConf()) {
+		if (config.sticky_method == LbClusterConfig::StickyMethod::CONSISTENT_HASHING)
+			sticky_ring = std::make_unique<StickyRing>(config.hash_ring_replicas);
+
 		explorer = config.zeroconf.Create(context.GetAvahiClient(),
 						  *this, context.avahi_error_handler);
+	}
 #endif
 
 	static_members.reserve(config.members.size());
@@ -147,6 +160,20 @@ LbCluster::LbCluster(const LbClusterConfig &_config,
 		static_members.emplace_back(std::move(address), failure);
 	}
 
+	if (config.warm_connections > 0) {
+		assert(config.protocol == LbProtocol::HTTP);
+		assert(!config.transparent_source);
+
+		warm_targets.reserve(static_members.size());
+		for (const auto &member : static_members)
+			warm_targets.emplace_back(fs_stock.AddWarmTarget({},
+									 SocketAddress::Null(),
+									 member.address,
+									 WARM_CONNECT_TIMEOUT,
+									 socket_filter_params.get(),
+									 config.warm_connections));
+	}
+
 	if (monitors != nullptr)
 		/* create monitors for "static" members */
 		for (const auto &member : config.members)
@@ -276,11 +303,19 @@ struct LbCluster::ZeroconfListWrapper {
 		return active_members.end();
 	}
 
+	const_reference operator[](std::size_t i) const noexcept {
+		return *active_members[i];
+	}
+
 	[[gnu::pure]]
 	bool Check(const Expiry now, const_reference member,
 		   bool allow_fade) const noexcept {
 		return member.second.GetFailureInfo().Check(now, allow_fade);
 	}
+
+	const FailureInfo *GetFailureInfo(const_reference member) const noexcept {
+		return &member.second.GetFailureInfo();
+	}
 };
 
 LbCluster::ZeroconfMemberMap::const_reference
@@ -294,9 +329,16 @@ LbCluster::PickNextGoodZeroconf(const Expiry now) noexcept
 		   member without consulting RoundRobinBalancer */
 		return *active_zeroconf_members.front();
 
-	return round_robin_balancer.Get(now,
-					ZeroconfListWrapper{active_zeroconf_members},
-					false);
+	const ZeroconfListWrapper list{active_zeroconf_members};
+
+	if (config.sticky_mode == StickyMode::LEAST_REQUESTS)
+		return PickLeastRequests(now, list, round_robin_balancer);
+	else if (config.sticky_mode == StickyMode::PEAK_EWMA)
+		return PickPeakEwma(now, list, round_robin_balancer);
+	else if (config.sticky_mode == StickyMode::POWER_OF_TWO_CHOICES)
+		return PickPowerOfTwoChoices(now, list);
+	else
+		return round_robin_balancer.Get(now, list, false);
 }
 
 inline LbCluster::ZeroconfMemberMap::const_reference
@@ -428,24 +470,6 @@ LbCluster::FillActive() noexcept
 
 	for (auto i = zeroconf_members.begin(); i != zeroconf_members.end(); ++i)
 		active_zeroconf_members.push_back(i);
-
-	switch (config.sticky_method) {
-	case LbClusterConfig::StickyMethod::CONSISTENT_HASHING:
-		if (sticky_ring == nullptr)
-			/* lazy allocation */
-			sticky_ring = std::make_unique<StickyRing>();
-
-		BuildMemberHashRing(*sticky_ring, active_zeroconf_members,
-				    [](ZeroconfMemberMap::const_iterator member) noexcept {
-					    return member->second.GetAddress();
-				    });
-
-		break;
-
-	case LbClusterConfig::StickyMethod::RENDEZVOUS_HASHING:
-	case LbClusterConfig::StickyMethod::CACHE:
-		break;
-	}
 }
 
 class LbCluster::ZeroconfHttpConnect final : StockGetHandler, Lease, Cancellable {
@@ -663,10 +687,20 @@ LbCluster::OnAvahiNewObject(const std::string &key,
 							   failure_manager.Make(address),
 							   monitors);
 	if (!inserted) {
+		if (it->second.GetAddress() == address)
+			/* no change */
+			return;
+
 		/* update existing member */
 		it->second.SetAddress(address);
+
+		if (sticky_ring != nullptr)
+			sticky_ring->Remove(it);
 	}
 
+	if (sticky_ring != nullptr)
+		sticky_ring->Insert(it, address);
+
 	dirty = true;
 }
 
@@ -680,6 +714,9 @@ LbCluster::OnAvahiRemoveObject(const std::string &key) noexcept
 	/* TODO: purge entry from the "failure" map, because it
 	   will never be used again anyway */
 
+	if (sticky_ring != nullptr)
+		sticky_ring->Remove(i);
+
 	zeroconf_members.erase(i);
 	dirty = true;
 }
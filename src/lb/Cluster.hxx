@@ -6,6 +6,7 @@
 
 #include "cluster/StickyHash.hxx"
 #include "cluster/RoundRobinBalancer.hxx"
+#include "fs/Stock.hxx"
 #include "event/Chrono.hxx"
 #include "net/AllocatedSocketAddress.hxx"
 #include "net/FailureRef.hxx"
@@ -29,7 +30,6 @@ class LbMonitorStock;
 class LbMonitorRef;
 class FailureManager;
 class BalancerMap;
-class FilteredSocketStock;
 class FilteredSocketBalancer;
 class StickyCache;
 namespace Avahi { class ServiceExplorer; }
@@ -69,6 +69,12 @@ class LbCluster final
 
 	std::vector<StaticMember> static_members;
 
+	/**
+	 * Keeps idle connections to #static_members ready.  Only
+	 * used if LbClusterConfig::warm_connections is set.
+	 */
+	std::vector<std::unique_ptr<FilteredSocketStock::WarmTarget>> warm_targets;
+
 #ifdef HAVE_AVAHI
 	/**
 	 * This #AvahiServiceExplorer locates Zeroconf nodes.
@@ -78,7 +84,8 @@ class LbCluster final
 	class StickyRing;
 
 	/**
-	 * For consistent hashing.  It is populated by FillActive().
+	 * For consistent hashing.  It is updated incrementally by
+	 * OnAvahiNewObject() and OnAvahiRemoveObject().
 	 */
 	std::unique_ptr<StickyRing> sticky_ring;
 
@@ -317,7 +324,7 @@ private:
 
 private:
 	/**
-	 * Fill #active_members and #sticky_ring.
+	 * Fill #active_members.
 	 *
 	 * Zeroconf only.
 	 */
@@ -97,6 +97,14 @@ struct LbClusterConfig {
 
 	bool mangle_via = false;
 
+	/**
+	 * The minimum number of idle connections which shall be kept
+	 * ready to each static member.  Zero disables prewarming.
+	 *
+	 * @see FilteredSocketStock::AddWarmTarget()
+	 */
+	unsigned warm_connections = 0;
+
 #ifdef HAVE_AVAHI
 	enum class StickyMethod : uint_least8_t {
 		CONSISTENT_HASHING,
@@ -108,6 +116,13 @@ struct LbClusterConfig {
 		 */
 		CACHE,
 	} sticky_method = StickyMethod::CONSISTENT_HASHING;
+
+	/**
+	 * The number of points each Zeroconf member occupies on the
+	 * consistent hashing ring.  More points mean a more even
+	 * distribution, but more work when members come and go.
+	 */
+	unsigned hash_ring_replicas = 64;
 #endif
 
 	LbSimpleHttpResponse fallback;
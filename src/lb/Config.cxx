@@ -16,6 +16,10 @@ LbConfig::HandleSet(std::string_view name, const char *value)
 {
 	if (name == "tcp_stock_limit") {
 		tcp_stock_limit = ParseUnsignedLong(value);
+	} else if (name == "workers") {
+		workers = ParseUnsignedLong(value);
+		if (workers > MAX_WORKERS)
+			throw std::runtime_error("Too many workers");
 	} else
 		throw std::runtime_error("Unknown variable");
 }
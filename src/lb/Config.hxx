@@ -77,6 +77,15 @@ struct LbConfig {
 	unsigned tcp_stock_limit = 256;
 	static constexpr std::size_t tcp_stock_max_idle = 256;
 
+	/**
+	 * The number of worker processes.  Each one has its own
+	 * (SO_REUSEPORT) socket for each listener.  0 means
+	 * everything runs in the main process.
+	 */
+	unsigned workers = 0;
+
+	static constexpr unsigned MAX_WORKERS = 1024;
+
 	LbConfig() noexcept;
 	~LbConfig() noexcept;
 
@@ -16,6 +16,7 @@
 #include "uri/Verify.hxx"
 #include "util/StringAPI.hxx"
 #include "util/StringCompare.hxx"
+#include "util/StringParser.hxx"
 #include "util/CharUtil.hxx"
 
 #ifdef HAVE_AVAHI
@@ -500,6 +501,11 @@ validate_protocol_sticky(LbProtocol protocol, StickyMode sticky)
 		case StickyMode::SESSION_MODULO:
 		case StickyMode::COOKIE:
 		case StickyMode::JVM_ROUTE:
+		case StickyMode::LEAST_REQUESTS:
+		case StickyMode::PEAK_EWMA:
+		case StickyMode::POWER_OF_TWO_CHOICES:
+			/* requests are only tracked by the HTTP
+			   forwarder */
 			return false;
 		}
 	}
@@ -519,6 +525,9 @@ ValidateZeroconfSticky(StickyMode sticky) noexcept
 	case StickyMode::SOURCE_IP:
 	case StickyMode::HOST:
 	case StickyMode::XHOST:
+	case StickyMode::LEAST_REQUESTS:
+	case StickyMode::PEAK_EWMA:
+	case StickyMode::POWER_OF_TWO_CHOICES:
 		return true;
 
 	case StickyMode::SESSION_MODULO:
@@ -552,6 +561,12 @@ ParseStickyMode(const char *s)
 		return StickyMode::COOKIE;
 	else if (StringIsEqual(s, "jvm_route"))
 		return StickyMode::JVM_ROUTE;
+	else if (StringIsEqual(s, "least_requests"))
+		return StickyMode::LEAST_REQUESTS;
+	else if (StringIsEqual(s, "peak_ewma"))
+		return StickyMode::PEAK_EWMA;
+	else if (StringIsEqual(s, "p2c"))
+		return StickyMode::POWER_OF_TWO_CHOICES;
 	else
 		throw LineParser::Error("Unknown sticky mode");
 }
@@ -592,6 +607,18 @@ LbConfigParser::Cluster::ParseLine(FileLineParser &line)
 		config.sticky_method = ParseStickyMethod(line.ExpectValueAndEnd());
 #else
 		throw LineParser::Error("Zeroconf support is disabled at compile time");
+#endif
+	} else if (StringIsEqual(word, "warm_connections")) {
+		config.warm_connections = line.NextPositiveInteger();
+		line.ExpectEnd();
+	} else if (StringIsEqual(word, "hash_ring_replicas")) {
+#ifdef HAVE_AVAHI
+		config.hash_ring_replicas = line.NextPositiveInteger();
+		if (config.hash_ring_replicas > 4096)
+			throw LineParser::Error("Too many hash ring replicas");
+		line.ExpectEnd();
+#else
+		throw LineParser::Error("Zeroconf support is disabled at compile time");
 #endif
 	} else if (StringIsEqual(word, "sticky_cache")) {
 		// deprecated since 18.0.29, use "sticky_method" instead
@@ -757,6 +784,10 @@ LbConfigParser::Cluster::Finish()
 	if (config.protocol != LbProtocol::HTTP && config.ssl)
 		throw LineParser::Error{"SSL/TLS only available with HTTP"};
 
+	if (config.warm_connections > 0 &&
+	    (config.protocol != LbProtocol::HTTP || config.transparent_source))
+		throw LineParser::Error{"warm_connections only available with HTTP and without transparent_source"};
+
 #ifdef HAVE_AVAHI
 	if (config.HasZeroConf() &&
 	    !ValidateZeroconfSticky(config.sticky_mode))
@@ -1282,6 +1313,14 @@ LbConfigParser::Listener::ParseLine(FileLineParser &line)
 	} else if (StringIsEqual(word, "alpn_http2")) {
 #ifdef HAVE_NGHTTP2
 		config.alpn_http2 = line.NextBool();
+#endif
+	} else if (StringIsEqual(word, "http2_max_window")) {
+#ifdef HAVE_NGHTTP2
+		config.http2_max_window = ParseSize(line.ExpectValueAndEnd());
+		if (config.http2_max_window > 0x7fffffff)
+			throw LineParser::Error("Window too large");
+#else
+		throw LineParser::Error("HTTP/2 support is disabled at compile time");
 #endif
 	} else if (StringIsEqual(word, "ssl")) {
 		bool value = line.NextBool();
@@ -1373,6 +1412,12 @@ LbConfigParser::Listener::ParseLine(FileLineParser &line)
 			config.ssl_config.verify = SslVerify::OPTIONAL;
 		else
 			throw LineParser::Error("yes/no expected");
+	} else if (StringIsEqual(word, "ssl_ktls")) {
+		if (!config.ssl)
+			throw LineParser::Error("SSL is not enabled");
+
+		config.ssl_config.ktls = line.NextBool();
+		line.ExpectEnd();
 	} else if (StringIsEqual(word, "hsts")) {
 		const bool value = line.NextBool();
 		line.ExpectEnd();
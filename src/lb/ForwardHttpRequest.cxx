@@ -28,6 +28,8 @@
 #include "net/FailureManager.hxx"
 #include "net/FailureRef.hxx"
 #include "net/PToString.hxx"
+#include "istream/ForwardIstream.hxx"
+#include "istream/New.hxx"
 #include "istream/UnusedHoldPtr.hxx"
 #include "util/Cancellable.hxx"
 #include "util/LeakDetector.hxx"
@@ -38,6 +40,65 @@
 static constexpr Event::Duration LB_HTTP_CONNECT_TIMEOUT =
 	std::chrono::seconds{10};
 
+/**
+ * An #Istream proxy for the response body which keeps the request
+ * "in flight" (for StickyMode::LEAST_REQUESTS and
+ * StickyMode::PEAK_EWMA) until the body has been transferred
+ * completely.
+ */
+class LbResponseBodyIstream final : public ForwardIstream {
+	EventLoop &event_loop;
+
+	FailurePtr failure;
+
+	const std::chrono::steady_clock::time_point start_time;
+
+public:
+	LbResponseBodyIstream(struct pool &_pool, UnusedIstreamPtr _input,
+			      EventLoop &_event_loop, FailurePtr &&_failure,
+			      std::chrono::steady_clock::time_point _start_time) noexcept
+		:ForwardIstream(_pool, std::move(_input)),
+		 event_loop(_event_loop),
+		 failure(std::move(_failure)),
+		 start_time(_start_time) {}
+
+	~LbResponseBodyIstream() noexcept override {
+		/* closed prematurely or failed */
+		if (failure)
+			failure->FinishRequest();
+	}
+
+	/* virtual methods from class Istream */
+
+	ConsumeBucketResult _ConsumeBucketList(std::size_t nbytes) noexcept override {
+		const auto c = Consumed(input.ConsumeBucketList(nbytes));
+		if (c.eof)
+			FinishRequest();
+		return c;
+	}
+
+	/* virtual methods from class IstreamHandler */
+
+	void OnEof() noexcept override {
+		FinishRequest();
+		ForwardIstream::OnEof();
+	}
+
+private:
+	/**
+	 * The response body has been transferred completely; feed
+	 * the total latency into the moving average.
+	 */
+	void FinishRequest() noexcept {
+		if (!failure)
+			return;
+
+		const FailurePtr f{std::move(failure)};
+		const auto now = event_loop.SteadyNow();
+		f->FinishRequest(now, now - start_time);
+	}
+};
+
 class LbRequest final
 	: LeakDetector, Cancellable, FilteredSocketBalancerHandler, HttpResponseHandler {
 
@@ -58,6 +119,12 @@ class LbRequest final
 
 	FailurePtr failure;
 
+	/**
+	 * When was the request sent to the server?  Used to feed
+	 * FailureInfo::FinishRequest().
+	 */
+	std::chrono::steady_clock::time_point start_time;
+
 	unsigned new_cookie = 0;
 
 public:
@@ -86,6 +153,15 @@ private:
 		DeleteFromPool(pool, this);
 	}
 
+	/**
+	 * The server has failed or the request was canceled; it is no
+	 * longer in flight.
+	 */
+	void FinishRequest() noexcept {
+		if (failure)
+			failure->FinishRequest();
+	}
+
 	void SetForwardedTo() noexcept {
 		assert(failure);
 
@@ -119,6 +195,7 @@ private:
 	void Cancel() noexcept override {
 		connection.RecordAbuse();
 		cancel_ptr.Cancel();
+		FinishRequest();
 		Destroy();
 	}
 
@@ -211,6 +288,9 @@ LbRequest::GetStickyHash() noexcept
 	switch (cluster_config.sticky_mode) {
 	case StickyMode::NONE:
 	case StickyMode::FAILOVER:
+	case StickyMode::LEAST_REQUESTS:
+	case StickyMode::PEAK_EWMA:
+	case StickyMode::POWER_OF_TWO_CHOICES:
 		/* these modes require no preparation; they are handled
 		   completely by balancer_get() */
 		break;
@@ -251,6 +331,9 @@ LbRequest::GetStickySource() const noexcept
 	switch (cluster_config.sticky_mode) {
 	case StickyMode::NONE:
 	case StickyMode::FAILOVER:
+	case StickyMode::LEAST_REQUESTS:
+	case StickyMode::PEAK_EWMA:
+	case StickyMode::POWER_OF_TWO_CHOICES:
 		/* these modes require no preparation; they are handled
 		   completely by balancer_get() */
 		break;
@@ -295,6 +378,18 @@ LbRequest::OnHttpResponse(HttpStatus status, StringMap &&_headers,
 {
 	failure->UnsetProtocol();
 
+	if (response_body)
+		/* the request remains in flight until the response
+		   body has been transferred */
+		response_body = NewIstreamPtr<LbResponseBodyIstream>(pool, std::move(response_body),
+								     GetEventLoop(),
+								     std::move(failure),
+								     start_time);
+	else {
+		const auto now = GetEventLoop().SteadyNow();
+		failure->FinishRequest(now, now - start_time);
+	}
+
 	if (auto &rl = *(LbRequestLogger *)request.logger; rl.generator == nullptr)
 		/* if there is a GENERATOR header, include it in the
 		   access log */
@@ -336,6 +431,8 @@ LbRequest::OnHttpError(std::exception_ptr ep) noexcept
 		failure->SetProtocol(GetEventLoop().SteadyNow(),
 				     std::chrono::seconds(20));
 
+	FinishRequest();
+
 	connection.logger(2, ep);
 
 	auto &_connection = connection;
@@ -355,6 +452,8 @@ LbRequest::OnFilteredSocketReady(Lease &lease,
 				 ReferencedFailureInfo &_failure) noexcept
 {
 	failure = _failure;
+	failure->StartRequest();
+	start_time = GetEventLoop().SteadyNow();
 
 	SetForwardedTo();
 
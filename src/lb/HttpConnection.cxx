@@ -111,7 +111,8 @@ NewLbHttpConnection(LbInstance &instance,
 										   address,
 										   instance.request_slice_pool,
 										   *connection,
-										   *connection);
+										   *connection,
+										   listener.GetConfig().http2_max_window);
 	else
 #endif
 		connection->http = http_server_connection_new(connection->GetPool(),
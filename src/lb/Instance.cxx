@@ -118,7 +118,7 @@ LbInstance::ReloadState() noexcept
 		if (c.name.empty())
 			continue;
 
-		if (c.HasZeroconfPublisher()) {
+		if (c.HasZeroconfPublisher() && publish_zeroconf) {
 			const auto path = fmt::format("beng-lb/listener/{}/zeroconf", c.name);
 			i.SetZeroconfVisible(state_directories.GetBool(path.c_str(), true));
 		}
@@ -23,8 +23,10 @@
 #include <forward_list>
 #include <memory>
 #include <map>
+#include <vector>
 
 struct UidGid;
+class UniqueSocketDescriptor;
 class PipeStock;
 class BalancerMap;
 class FilteredSocketStock;
@@ -100,6 +102,12 @@ struct LbInstance final : PInstance, Avahi::ErrorHandler {
 
 	MultiAccessLogGlue access_log;
 
+	/**
+	 * Shall this process publish the listeners with Zeroconf?
+	 * With several worker processes, only the first one does.
+	 */
+	bool publish_zeroconf = true;
+
 	explicit LbInstance(const LbConfig &_config);
 	~LbInstance() noexcept;
 
@@ -113,7 +121,11 @@ struct LbInstance final : PInstance, Avahi::ErrorHandler {
 	 */
 	void InitWorker();
 
-	void InitAllListeners(const UidGid *logger_user);
+	/**
+	 * @param sockets the return value of CreateListenerSockets()
+	 */
+	void InitAllListeners(const UidGid *logger_user,
+			      std::vector<UniqueSocketDescriptor> &&sockets);
 	void DeinitAllListeners() noexcept;
 
 	void InitAllControls();
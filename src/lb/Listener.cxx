@@ -14,6 +14,7 @@
 #include "fs/FilteredSocket.hxx"
 #include "net/ClientAccounting.hxx"
 #include "net/SocketAddress.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
 #include "util/SpanCast.hxx"
 #include "lb_features.h"
 
@@ -24,7 +25,7 @@
 inline std::unique_ptr<Avahi::Service>
 LbListener::MakeAvahiService() const noexcept
 {
-	if (!config.HasZeroconfPublisher())
+	if (!config.HasZeroconfPublisher() || !instance.publish_zeroconf)
 		return {};
 
 	/* ask the kernel for the effective address via getsockname(),
@@ -145,7 +146,8 @@ LbListener::OnFilteredSocketError(std::exception_ptr ep) noexcept
 
 LbListener::LbListener(LbInstance &_instance,
 		       AccessLogGlue *_access_logger,
-		       const LbListenerConfig &_config)
+		       const LbListenerConfig &_config,
+		       UniqueSocketDescriptor &&socket)
 	:instance(_instance), config(_config),
 	 access_logger(_access_logger),
 	 listener(instance.root_pool, instance.event_loop,
@@ -153,7 +155,7 @@ LbListener::LbListener(LbInstance &_instance,
 #ifdef HAVE_URING
 		  nullptr, // TODO io_uring support
 #endif
-		  *this, config.Create(SOCK_STREAM)),
+		  *this, std::move(socket)),
 #ifdef HAVE_AVAHI
 	 avahi_service(MakeAvahiService()),
 #endif
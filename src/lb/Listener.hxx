@@ -12,12 +12,15 @@
 #include "net/StaticSocketAddress.hxx"
 
 #include <memory>
+#include <vector>
 
+struct LbConfig;
 struct LbListenerConfig;
 struct LbInstance;
 class LbGotoMap;
 class ClientAccountingMap;
 class AccessLogGlue;
+class UniqueSocketDescriptor;
 namespace Avahi { struct Service; }
 
 /**
@@ -47,9 +50,14 @@ class LbListener final : FilteredSocketListenerHandler {
 	std::unique_ptr<ClientAccountingMap> client_accounting;
 
 public:
+	/**
+	 * @param socket the listener socket created with
+	 * LbListenerConfig::Create()
+	 */
 	LbListener(LbInstance &_instance,
 		   AccessLogGlue *_access_logger,
-		   const LbListenerConfig &_config);
+		   const LbListenerConfig &_config,
+		   UniqueSocketDescriptor &&socket);
 
 	~LbListener() noexcept;
 
@@ -101,3 +109,10 @@ private:
 	void OnFilteredSocketError(std::exception_ptr e) noexcept override;
 
 };
+
+/**
+ * Create the sockets for all listeners, in the order of
+ * LbConfig::listeners.
+ */
+std::vector<UniqueSocketDescriptor>
+CreateListenerSockets(const LbConfig &config);
@@ -33,6 +33,14 @@ struct LbListenerConfig : SocketConfig {
 
 	SslConfig ssl_config;
 
+#ifdef HAVE_NGHTTP2
+	/**
+	 * The upper limit for the HTTP/2 flow control window which
+	 * is chosen automatically for request bodies.
+	 */
+	std::size_t http2_max_window = 16 * 1024 * 1024;
+#endif
+
 	/**
 	 * Enable or disable the access logger.
 	 */
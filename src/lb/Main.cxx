@@ -7,6 +7,8 @@
 #include "TcpConnection.hxx"
 #include "HttpConnection.hxx"
 #include "Config.hxx"
+#include "Listener.hxx"
+#include "Master.hxx"
 #include "lb_check.hxx"
 #include "fs/Stock.hxx"
 #include "fs/Balancer.hxx"
@@ -19,6 +21,8 @@
 #include "system/Isolate.hxx"
 #include "system/SetupProcess.hxx"
 #include "io/SpliceSupport.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/BindMethod.hxx"
 #include "util/PrintException.hxx"
 #include "config.h"
 
@@ -122,44 +126,21 @@ deinit_signals(LbInstance *instance)
 	instance->sighup_event.Disable();
 }
 
-int
-main(int argc, char **argv)
-try {
-	const ScopeFbPoolInit fb_pool_init;
-
-	/* configuration */
-
-	LbCmdLine cmdline;
-	LbConfig config;
-
-	ParseCommandLine(cmdline, config, argc, argv);
-
-	if (geteuid() == 0)
-		throw "Refusing to run as root";
-
-	LoadConfigFile(config, cmdline.config_path);
-
-	const ScopeSslGlobalInit ssl_init;
-
+/**
+ * Set up and run an #LbInstance until it is shut down.  This is the
+ * whole life of a worker process (or of the main process if there
+ * are no workers).
+ *
+ * @param listener_sockets the sockets for all listeners (see
+ * CreateListenerSockets())
+ */
+static void
+RunInstance(const LbConfig &config, const LbCmdLine &cmdline,
+	    std::vector<UniqueSocketDescriptor> &&listener_sockets,
+	    bool publish_zeroconf)
+{
 	LbInstance instance(config);
-
-	if (cmdline.check) {
-		lb_check(instance.event_loop, config);
-		return EXIT_SUCCESS;
-	}
-
-	/* initialize */
-
-	SetupProcess();
-
-	/* force line buffering so Lua "print" statements are flushed
-	   even if stdout is a pipe to systemd-journald */
-	setvbuf(stdout, nullptr, _IOLBF, 0);
-	setvbuf(stderr, nullptr, _IOLBF, 0);
-
-#ifdef HAVE_LIBCAP
-	capabilities_init();
-#endif // HAVE_LIBCAP
+	instance.publish_zeroconf = publish_zeroconf;
 
 #if defined(HAVE_LIBSYSTEMD) || defined(HAVE_AVAHI)
 	const ODBus::ScopeInit dbus_init;
@@ -167,17 +148,11 @@ try {
 					       false);
 #endif
 
-#ifdef ENABLE_CERTDB
-	/* prevent libpq from initializing libssl & libcrypto again */
-	PQinitOpenSSL(0, 0);
-#endif
-
-	direct_global_init();
-
 	init_signals(&instance);
 
 	instance.InitAllControls();
-	instance.InitAllListeners(&cmdline.logger_user);
+	instance.InitAllListeners(&cmdline.logger_user,
+				  std::move(listener_sockets));
 
 	/* daemonize II */
 
@@ -212,8 +187,10 @@ try {
 	instance.InitWorker();
 
 #ifdef HAVE_LIBSYSTEMD
-	/* tell systemd we're ready */
-	sd_notify(0, "READY=1");
+	/* tell systemd we're ready (in worker mode, the master does
+	   this) */
+	if (config.workers == 0)
+		sd_notify(0, "READY=1");
 #endif
 
 	instance.event_loop.Run();
@@ -224,6 +201,90 @@ try {
 	instance.DeinitAllControls();
 
 	thread_pool_deinit();
+}
+
+/**
+ * Runs an #LbInstance in a worker process forked by #LbMaster.
+ */
+struct LbWorkerLauncher {
+	const LbConfig &config;
+	const LbCmdLine &cmdline;
+
+	int Run(unsigned index,
+		std::vector<UniqueSocketDescriptor> &&sockets) {
+		/* all workers listen on the same ports; only the
+		   first one publishes them with Zeroconf */
+		RunInstance(config, cmdline, std::move(sockets), index == 0);
+		return EXIT_SUCCESS;
+	}
+};
+
+int
+main(int argc, char **argv)
+try {
+	const ScopeFbPoolInit fb_pool_init;
+
+	/* configuration */
+
+	LbCmdLine cmdline;
+	LbConfig config;
+
+	ParseCommandLine(cmdline, config, argc, argv);
+
+	if (geteuid() == 0)
+		throw "Refusing to run as root";
+
+	LoadConfigFile(config, cmdline.config_path);
+
+	const ScopeSslGlobalInit ssl_init;
+
+	if (cmdline.check) {
+		LbInstance instance(config);
+		lb_check(instance.event_loop, config);
+		return EXIT_SUCCESS;
+	}
+
+	/* initialize */
+
+	SetupProcess();
+
+	/* force line buffering so Lua "print" statements are flushed
+	   even if stdout is a pipe to systemd-journald */
+	setvbuf(stdout, nullptr, _IOLBF, 0);
+	setvbuf(stderr, nullptr, _IOLBF, 0);
+
+#ifdef HAVE_LIBCAP
+	capabilities_init();
+#endif // HAVE_LIBCAP
+
+#ifdef ENABLE_CERTDB
+	/* prevent libpq from initializing libssl & libcrypto again */
+	PQinitOpenSSL(0, 0);
+#endif
+
+	direct_global_init();
+
+	if (config.workers > 0) {
+		/* each worker gets its own socket for each listener
+		   and control channel; the kernel distributes
+		   incoming connections and datagrams among them */
+		for (auto &i : config.listeners)
+			i.reuse_port = true;
+		for (auto &i : config.controls)
+			i.reuse_port = true;
+
+		LbWorkerLauncher launcher{config, cmdline};
+		LbMaster master{config, BIND_METHOD(launcher, &LbWorkerLauncher::Run)};
+		master.Start();
+
+#ifdef HAVE_LIBSYSTEMD
+		/* tell systemd we're ready */
+		sd_notify(0, "READY=1");
+#endif
+
+		master.Run();
+	} else
+		RunInstance(config, cmdline, CreateListenerSockets(config), true);
 } catch (...) {
 	PrintException(std::current_exception());
 	return EXIT_FAILURE;
@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "Master.hxx"
+#include "Config.hxx"
+#include "Listener.hxx"
+#include "system/Error.hxx"
+#include "util/Exception.hxx"
+#include "util/PrintException.hxx"
+
+#include <cassert>
+
+#include <signal.h>
+#include <stdlib.h> // for EXIT_FAILURE
+#include <sys/wait.h>
+#include <unistd.h>
+
+static constexpr Event::Duration RESPAWN_DELAY = std::chrono::seconds{1};
+
+LbMaster::LbMaster(const LbConfig &config, WorkerFunction _worker_function)
+	:shutdown_listener(event_loop, BIND_THIS_METHOD(OnShutdown)),
+	 sighup_event(event_loop, SIGHUP, BIND_THIS_METHOD(OnReload)),
+	 sigchld_event(event_loop, SIGCHLD, BIND_THIS_METHOD(OnChildExited)),
+	 respawn_timer(event_loop, BIND_THIS_METHOD(OnRespawnTimer)),
+	 worker_function(_worker_function),
+	 workers(config.workers)
+{
+	assert(!workers.empty());
+
+	for (auto &worker : workers)
+		worker.sockets = CreateListenerSockets(config);
+}
+
+LbMaster::~LbMaster() noexcept = default;
+
+void
+LbMaster::Start()
+{
+	/* enable SIGCHLD before forking, so we don't miss workers
+	   which exit early */
+	shutdown_listener.Enable();
+	sighup_event.Enable();
+	sigchld_event.Enable();
+
+	for (unsigned i = 0; i < workers.size(); ++i)
+		SpawnWorker(i);
+}
+
+void
+LbMaster::SpawnWorker(unsigned index)
+{
+	auto &worker = workers[index];
+	assert(worker.pid < 0);
+
+	const pid_t pid = fork();
+	if (pid < 0)
+		throw MakeErrno("fork() failed");
+
+	if (pid == 0) {
+		/* this is the new worker process; it must not use
+		   our EventLoop (its epoll instance is shared with
+		   the parent) and must not run our destructors, so
+		   it never returns from here */
+
+		sigset_t mask;
+		sigemptyset(&mask);
+		sigprocmask(SIG_SETMASK, &mask, nullptr);
+
+		auto sockets = std::move(worker.sockets);
+
+		/* close the other workers' sockets */
+		for (auto &i : workers)
+			i.sockets.clear();
+
+		int status = EXIT_FAILURE;
+
+		try {
+			status = worker_function(index, std::move(sockets));
+		} catch (...) {
+			PrintException(std::current_exception());
+		}
+
+		_exit(status);
+	}
+
+	worker.pid = pid;
+
+	logger(4, "spawned worker ", index, " (pid=", (int)pid, ")");
+}
+
+bool
+LbMaster::HasWorkers() const noexcept
+{
+	for (const auto &worker : workers)
+		if (worker.pid >= 0)
+			return true;
+
+	return false;
+}
+
+void
+LbMaster::KillWorkers(int signo) noexcept
+{
+	for (const auto &worker : workers)
+		if (worker.pid >= 0)
+			kill(worker.pid, signo);
+}
+
+void
+LbMaster::OnShutdown() noexcept
+{
+	shutting_down = true;
+
+	shutdown_listener.Disable();
+	sighup_event.Disable();
+	respawn_timer.Cancel();
+
+	KillWorkers(SIGTERM);
+
+	if (!HasWorkers()) {
+		sigchld_event.Disable();
+		event_loop.Break();
+	}
+}
+
+void
+LbMaster::OnReload(int signo) noexcept
+{
+	/* let all workers flush their caches */
+	KillWorkers(signo);
+}
+
+void
+LbMaster::OnChildExited(int) noexcept
+{
+	while (true) {
+		int status;
+		const pid_t pid = waitpid(-1, &status, WNOHANG);
+		if (pid <= 0)
+			break;
+
+		for (auto &worker : workers) {
+			if (worker.pid == pid) {
+				worker.pid = -1;
+				break;
+			}
+		}
+
+		if (WIFSIGNALED(status))
+			logger(1, "worker ", (int)pid, " died from signal ",
+			       WTERMSIG(status));
+		else if (WEXITSTATUS(status) != 0)
+			logger(1, "worker ", (int)pid, " exited with status ",
+			       WEXITSTATUS(status));
+	}
+
+	if (shutting_down) {
+		if (!HasWorkers()) {
+			sigchld_event.Disable();
+			event_loop.Break();
+		}
+	} else if (!respawn_timer.IsPending())
+		respawn_timer.Schedule(RESPAWN_DELAY);
+}
+
+void
+LbMaster::OnRespawnTimer() noexcept
+{
+	for (unsigned i = 0; i < workers.size(); ++i) {
+		if (workers[i].pid >= 0)
+			continue;
+
+		try {
+			SpawnWorker(i);
+		} catch (...) {
+			logger(1, "Failed to spawn worker: ",
+			       GetFullMessage(std::current_exception()));
+			respawn_timer.Schedule(RESPAWN_DELAY);
+			return;
+		}
+	}
+}
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#pragma once
+
+#include "event/Loop.hxx"
+#include "event/CoarseTimerEvent.hxx"
+#include "event/ShutdownListener.hxx"
+#include "event/SignalEvent.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "io/Logger.hxx"
+#include "util/BindMethod.hxx"
+
+#include <vector>
+
+#include <sys/types.h> // for pid_t
+
+struct LbConfig;
+
+/**
+ * Manages the worker processes (see LbConfig::workers).
+ *
+ * This process creates one socket per listener and worker (all with
+ * SO_REUSEPORT, so the kernel distributes incoming connections among
+ * them) before forking, and it keeps them open.  A worker which has
+ * exited is replaced by a new one with the same sockets.  The
+ * configuration is loaded only once (by this process) and is shared
+ * with all workers.
+ */
+class LbMaster final {
+public:
+	/**
+	 * Runs a worker in the new child process.
+	 *
+	 * @param index the worker index (0 to LbConfig::workers-1)
+	 * @param sockets the listener sockets of this worker (see
+	 * CreateListenerSockets())
+	 * @return the exit status of the worker process
+	 */
+	using WorkerFunction = BoundMethod<int(unsigned index,
+					       std::vector<UniqueSocketDescriptor> &&sockets)>;
+
+private:
+	const LLogger logger{"master"};
+
+	EventLoop event_loop;
+
+	ShutdownListener shutdown_listener;
+	SignalEvent sighup_event, sigchld_event;
+
+	/**
+	 * Spawns workers which have exited.  The delay avoids a busy
+	 * loop if workers fail immediately.
+	 */
+	CoarseTimerEvent respawn_timer;
+
+	const WorkerFunction worker_function;
+
+	struct Worker {
+		std::vector<UniqueSocketDescriptor> sockets;
+
+		/**
+		 * The process id, or -1 if the worker is not
+		 * running.
+		 */
+		pid_t pid = -1;
+	};
+
+	std::vector<Worker> workers;
+
+	bool shutting_down = false;
+
+public:
+	/**
+	 * Create the sockets of all workers.  Throws on error.
+	 */
+	LbMaster(const LbConfig &config, WorkerFunction _worker_function);
+
+	~LbMaster() noexcept;
+
+	LbMaster(const LbMaster &) = delete;
+	LbMaster &operator=(const LbMaster &) = delete;
+
+	/**
+	 * Spawn all workers.
+	 */
+	void Start();
+
+	/**
+	 * Run the event loop until all workers have exited after
+	 * SIGTERM.
+	 */
+	void Run() noexcept {
+		event_loop.Run();
+	}
+
+private:
+	/**
+	 * Fork a new worker process.  This method returns only in the
+	 * parent process.
+	 */
+	void SpawnWorker(unsigned index);
+
+	[[gnu::pure]]
+	bool HasWorkers() const noexcept;
+
+	void KillWorkers(int signo) noexcept;
+
+	void OnShutdown() noexcept;
+	void OnReload(int signo) noexcept;
+	void OnChildExited(int signo) noexcept;
+	void OnRespawnTimer() noexcept;
+};
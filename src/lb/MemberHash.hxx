@@ -5,27 +5,163 @@
 #pragma once
 
 #include "cluster/StickyHash.hxx"
-#include "util/HashRing.hxx"
+#include "net/SocketAddress.hxx"
 
+#include <algorithm>
+#include <cassert>
 #include <concepts>
 #include <cstddef>
-
-class SocketAddress;
+#include <utility>
+#include <vector>
 
 [[gnu::pure]]
 sticky_hash_t
 MemberAddressHash(SocketAddress address, std::size_t replica) noexcept;
 
+/**
+ * A consistent hashing ring for cluster members.  Each member
+ * occupies a number of "replica" points on the ring, and a hash is
+ * assigned to the member owning the next point.
+ *
+ * Unlike a ring which is rebuilt from scratch, members can be added
+ * and removed individually; this calculates only the new member's
+ * hashes and leaves all other points alone.
+ */
 template<typename Node>
-using MemberHashRing = HashRing<Node, sticky_hash_t, 8192, 64>;
+class MemberHashRing {
+	struct Point {
+		sticky_hash_t hash;
+		Node node;
+
+		constexpr bool operator<(const Point &other) const noexcept {
+			return hash < other.hash;
+		}
+	};
+
+	using PointList = std::vector<Point>;
+
+	/**
+	 * All points, sorted by their hash.
+	 */
+	PointList points;
+
+	const std::size_t n_replicas;
+
+public:
+	static constexpr std::size_t DEFAULT_REPLICAS = 64;
+
+	explicit MemberHashRing(std::size_t _n_replicas=DEFAULT_REPLICAS) noexcept
+		:n_replicas(_n_replicas)
+	{
+		assert(n_replicas > 0);
+	}
+
+	bool empty() const noexcept {
+		return points.empty();
+	}
+
+	void clear() noexcept {
+		points.clear();
+	}
+
+	/**
+	 * Add all replicas of a new member.  The caller is
+	 * responsible for not adding the same #Node twice.
+	 */
+	void Insert(const Node &node, SocketAddress address) noexcept {
+		const auto old_size = points.size();
+		points.reserve(old_size + n_replicas);
+
+		for (std::size_t replica = 0; replica < n_replicas; ++replica)
+			points.push_back({MemberAddressHash(address, replica), node});
+
+		/* sort only the new points and merge them with the
+		   (already sorted) old ones */
+		const auto middle = std::next(points.begin(), old_size);
+		std::sort(middle, points.end());
+		std::inplace_merge(points.begin(), middle, points.end());
+	}
 
+	/**
+	 * Remove all replicas of the given member.
+	 */
+	void Remove(const Node &node) noexcept {
+		std::erase_if(points, [&node](const Point &point){
+			return point.node == node;
+		});
+	}
+
+	/**
+	 * Find the member which owns the given hash.  The ring must
+	 * not be empty.
+	 */
+	[[gnu::pure]]
+	const Node &Pick(sticky_hash_t hash) const noexcept {
+		return Find(hash)->node;
+	}
+
+	/**
+	 * Find the point following the one which owns the given hash,
+	 * skipping all other points of the same member.  The returned
+	 * hash can be passed to the next FindNext() call.
+	 */
+	[[gnu::pure]]
+	std::pair<sticky_hash_t, Node> FindNext(sticky_hash_t hash) const noexcept {
+		auto i = Find(hash);
+		const Node &current = i->node;
+
+		for (std::size_t n = points.size(); n > 1; --n) {
+			if (++i == points.end())
+				i = points.begin();
+
+			if (!(i->node == current))
+				break;
+		}
+
+		return {i->hash, i->node};
+	}
+
+	/**
+	 * Invoke the given function for each point with its member
+	 * and the size of the hash range it owns.  This is for
+	 * diagnostics.
+	 */
+	void VisitRanges(std::invocable<const Node &, sticky_hash_t> auto f) const {
+		sticky_hash_t previous = points.empty() ? 0 : points.back().hash;
+
+		for (const auto &i : points) {
+			f(i.node, static_cast<sticky_hash_t>(i.hash - previous));
+			previous = i.hash;
+		}
+	}
+
+private:
+	[[gnu::pure]]
+	typename PointList::const_iterator Find(sticky_hash_t hash) const noexcept {
+		assert(!points.empty());
+
+		auto i = std::lower_bound(points.begin(), points.end(), hash,
+					  [](const Point &point, sticky_hash_t h){
+						  return point.hash < h;
+					  });
+		if (i == points.end())
+			/* wrap around */
+			i = points.begin();
+
+		return i;
+	}
+};
+
+/**
+ * Replace the contents of the given ring with the given nodes.
+ */
 template<typename Node, typename C>
 void
 BuildMemberHashRing(MemberHashRing<Node> &ring, C &&nodes,
 		    std::invocable<const Node &> auto f) noexcept
 {
-	ring.Build(std::forward<C>(nodes),
-		   [&f](const Node &node, std::size_t replica) noexcept {
-			   return MemberAddressHash(f(node), replica);
-		   });
+	ring.clear();
+
+	for (const Node &node : nodes)
+		ring.Insert(node, f(node));
 }
@@ -26,6 +26,7 @@
 #include "istream/CatchIstream.hxx"
 #include "memory/istream_gb.hxx"
 #include "memory/GrowingBuffer.hxx"
+#include "thread/Pool.hxx"
 #include "stopwatch.hxx"
 
 using std::string_view_literals::operator""sv;
@@ -167,7 +168,15 @@ LbPrometheusExporter::HandleHttpRequest(IncomingHttpRequest &request,
 
 	if (http_client_accepts_encoding(request.headers, "gzip")) {
 		headers.Write("content-encoding", "gzip");
-		body = NewGzipIstream(pool, std::move(body));
+
+		/* the length of the body is unknown and it may be
+		   large (many listeners, many local exporters): move
+		   deflate() to a worker thread */
+		body = instance != nullptr
+			? NewThreadGzipIstream(pool,
+					       thread_pool_get_queue(instance->event_loop),
+					       std::move(body))
+			: NewGzipIstream(pool, std::move(body));
 	}
 
 	request.SendResponse(HttpStatus::OK, std::move(headers),
@@ -7,18 +7,44 @@
 #include "Listener.hxx"
 #include "Control.hxx"
 #include "lib/fmt/RuntimeError.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+
+#include <cassert>
+
+std::vector<UniqueSocketDescriptor>
+CreateListenerSockets(const LbConfig &config)
+{
+	std::vector<UniqueSocketDescriptor> sockets;
+	sockets.reserve(config.listeners.size());
+
+	for (const auto &i : config.listeners) {
+		try {
+			sockets.emplace_back(i.Create(SOCK_STREAM));
+		} catch (...) {
+			std::throw_with_nested(FmtRuntimeError("Failed to set up listener '{}'",
+							       i.name));
+		}
+	}
+
+	return sockets;
+}
 
 void
-LbInstance::InitAllListeners(const UidGid *logger_user)
+LbInstance::InitAllListeners(const UidGid *logger_user,
+			     std::vector<UniqueSocketDescriptor> &&sockets)
 {
+	auto socket = sockets.begin();
+
 	for (const auto &i : config.listeners) {
+		assert(socket != sockets.end());
+
 		try {
 			listeners.emplace_front(*this,
 						access_log.Make(event_loop,
 								config.access_log,
 								logger_user,
 								i.access_logger_name),
-						i);
+						i, std::move(*socket++));
 		} catch (...) {
 			std::throw_with_nested(FmtRuntimeError("Failed to set up listener '{}'",
 							       i.name));
@@ -25,6 +25,8 @@ LbInstance::GetStats() const noexcept
 	stats.outgoing_connections = tcp_stock_stats.busy +
 		tcp_stock_stats.idle +
 		tcp_connections.size();
+	stats.idle_outgoing_connections = tcp_stock_stats.idle;
+	stats.prewarmed_connections = fs_stock->GetPrewarmCount();
 	stats.http_requests = http_stats.n_requests;
 	stats.http_traffic_received = http_stats.traffic_received;
 	stats.http_traffic_sent = http_stats.traffic_sent;
@@ -16,11 +16,18 @@
 #include <cassert>
 #include <utility> // for std::unreachable()
 
+#include <fcntl.h> // for splice()
+
 static constexpr Event::Duration LB_TCP_CONNECT_TIMEOUT =
 	std::chrono::seconds(20);
 
 static constexpr auto write_timeout = std::chrono::seconds(30);
 
+/**
+ * The maximum number of bytes moved by one splice() call.
+ */
+static constexpr std::size_t SPLICE_MAX = 1024 * 1024;
+
 [[gnu::pure]]
 static std::span<const std::byte>
 GetStickySource(StickyMode sticky_mode,
@@ -29,6 +36,9 @@ GetStickySource(StickyMode sticky_mode,
 	switch (sticky_mode) {
 	case StickyMode::NONE:
 	case StickyMode::FAILOVER:
+	case StickyMode::LEAST_REQUESTS:
+	case StickyMode::PEAK_EWMA:
+	case StickyMode::POWER_OF_TWO_CHOICES:
 		break;
 
 	case StickyMode::SOURCE_IP:
@@ -46,6 +56,96 @@ GetStickySource(StickyMode sticky_mode,
 	return {};
 }
 
+/**
+ * Move data from the pipe to the destination socket.
+ *
+ * @return OK if the pipe is now empty, BLOCKING if the destination
+ * socket blocks or CLOSED if the connection has been destroyed
+ */
+template<typename D>
+static DirectResult
+FlushPipe(LbTcpConnection &tcp, LbTcpConnection::SplicePipe &pipe,
+	  D &dest) noexcept
+{
+	assert(!pipe.IsEmpty());
+
+	ssize_t nbytes = dest.WriteFrom(pipe.lease.GetReadFd(),
+					FdType::FD_PIPE, nullptr, pipe.size);
+	if (nbytes > 0) {
+		pipe.size -= nbytes;
+		dest.ScheduleWrite();
+		return pipe.IsEmpty()
+			? DirectResult::OK
+			: DirectResult::BLOCKING;
+	}
+
+	switch ((enum write_result)nbytes) {
+		int save_errno;
+
+	case WRITE_SOURCE_EOF:
+		std::unreachable();
+
+	case WRITE_ERRNO:
+		save_errno = errno;
+		tcp.OnTcpErrno("Send failed", save_errno);
+		return DirectResult::CLOSED;
+
+	case WRITE_BLOCKING:
+		return DirectResult::BLOCKING;
+
+	case WRITE_DESTROYED:
+		return DirectResult::CLOSED;
+
+	case WRITE_BROKEN:
+		tcp.OnTcpEnd();
+		return DirectResult::CLOSED;
+	}
+
+	std::unreachable();
+}
+
+/**
+ * Splice data from the source socket into the pipe and from there to
+ * the destination socket.  If the destination blocks, reading from
+ * the source socket is paused until the pipe has been flushed by
+ * the destination's OnBufferedWrite() method.
+ */
+template<typename D>
+static DirectResult
+SpliceForward(LbTcpConnection &tcp, LbTcpConnection::SplicePipe &pipe,
+	      SocketDescriptor src, D &dest) noexcept
+{
+	if (!pipe.IsEmpty())
+		/* flush leftovers first */
+		return FlushPipe(tcp, pipe, dest);
+
+	try {
+		pipe.lease.EnsureCreated();
+	} catch (...) {
+		tcp.OnTcpError("Pipe error", std::current_exception());
+		return DirectResult::CLOSED;
+	}
+
+	ssize_t nbytes = splice(src.Get(), nullptr,
+				pipe.lease.GetWriteFd().Get(), nullptr,
+				SPLICE_MAX, SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+	if (nbytes <= 0) {
+		if (nbytes == 0)
+			return DirectResult::END;
+
+		if (errno == EAGAIN)
+			/* the pipe is empty, therefore the source
+			   socket must be empty */
+			return DirectResult::EMPTY;
+
+		return DirectResult::ERRNO;
+	}
+
+	pipe.size = nbytes;
+
+	return FlushPipe(tcp, pipe, dest);
+}
+
 /*
  * inbound BufferedSocketHandler
  *
@@ -102,6 +202,27 @@ LbTcpConnection::Inbound::OnBufferedData()
 	std::unreachable();
 }
 
+DirectResult
+LbTcpConnection::Inbound::OnBufferedDirect(SocketDescriptor fd,
+					   [[maybe_unused]] FdType fd_type)
+{
+	auto &tcp = LbTcpConnection::FromInbound(*this);
+
+	/* direct mode is only enabled after the outbound connection
+	   has been established */
+	assert(!tcp.defer_connect.IsPending());
+	assert(!tcp.cancel_connect);
+
+	tcp.got_inbound_data = true;
+
+	if (!tcp.outbound.socket.IsValid()) {
+		tcp.OnTcpError("Send error", "Broken socket");
+		return DirectResult::CLOSED;
+	}
+
+	return SpliceForward(tcp, pipe, fd, tcp.outbound.socket);
+}
+
 bool
 LbTcpConnection::Inbound::OnBufferedHangup() noexcept
 {
@@ -125,6 +246,21 @@ LbTcpConnection::Inbound::OnBufferedWrite()
 {
 	auto &tcp = LbTcpConnection::FromInbound(*this);
 
+	if (!tcp.outbound.pipe.IsEmpty()) {
+		switch (FlushPipe(tcp, tcp.outbound.pipe, *socket)) {
+		case DirectResult::OK:
+			/* the pipe is empty; read more from the
+			   outbound socket */
+			break;
+
+		case DirectResult::BLOCKING:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
 	tcp.got_outbound_data = false;
 
 	switch (tcp.outbound.socket.Read()) {
@@ -222,6 +358,17 @@ LbTcpConnection::Outbound::OnBufferedData()
 	std::unreachable();
 }
 
+DirectResult
+LbTcpConnection::Outbound::OnBufferedDirect(SocketDescriptor fd,
+					    [[maybe_unused]] FdType fd_type)
+{
+	auto &tcp = LbTcpConnection::FromOutbound(*this);
+
+	tcp.got_outbound_data = true;
+
+	return SpliceForward(tcp, pipe, fd, *tcp.inbound.socket);
+}
+
 bool
 LbTcpConnection::Outbound::OnBufferedClosed() noexcept
 {
@@ -256,6 +403,21 @@ LbTcpConnection::Outbound::OnBufferedWrite()
 {
 	auto &tcp = LbTcpConnection::FromOutbound(*this);
 
+	if (!tcp.inbound.pipe.IsEmpty()) {
+		switch (FlushPipe(tcp, tcp.inbound.pipe, socket)) {
+		case DirectResult::OK:
+			/* the pipe is empty; read more from the
+			   inbound socket */
+			break;
+
+		case DirectResult::BLOCKING:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
 	tcp.got_inbound_data = false;
 
 	switch (tcp.inbound.socket->Read()) {
@@ -347,11 +509,12 @@ LbTcpConnection::OnSocketConnectSuccess(UniqueSocketDescriptor fd) noexcept
 	outbound.socket.Init(fd.Release(), FdType::FD_TCP,
 			     write_timeout, outbound);
 
-	/* TODO
-	   outbound.direct = pipe_stock != nullptr &&
-	   (ISTREAM_TO_TCP & FdType::FD_PIPE) != 0 &&
-	   (istream_direct_mask_to(inbound.base.base.fd_type) & FdType::FD_PIPE) != 0;
-	*/
+	if (!inbound.socket->HasFilter()) {
+		/* no SocketFilter (e.g. no TLS): forward the payload
+		   with splice(), without copying it to userspace */
+		inbound.socket->SetDirect(true);
+		outbound.socket.SetDirect(true);
+	}
 
 	switch (inbound.socket->Read()) {
 	case BufferedReadResult::OK:
@@ -396,16 +559,11 @@ LbTcpConnection::ConnectOutbound() noexcept
  */
 
 inline
-LbTcpConnection::Inbound::Inbound(UniquePoolPtr<FilteredSocket> &&_socket) noexcept
-	:socket(std::move(_socket))
+LbTcpConnection::Inbound::Inbound(UniquePoolPtr<FilteredSocket> &&_socket,
+				  PipeStock *pipe_stock) noexcept
+	:socket(std::move(_socket)), pipe(pipe_stock)
 {
 	socket->Reinit(write_timeout, *this);
-	/* TODO
-	   socket.base.direct = pipe_stock != nullptr &&
-	   (ISTREAM_TO_PIPE & fd_type) != 0 &&
-	   (ISTREAM_TO_TCP & FdType::FD_PIPE) != 0;
-	*/
-
 }
 
 inline
@@ -418,8 +576,8 @@ LbTcpConnection::LbTcpConnection(PoolPtr &&_pool, LbInstance &_instance,
 	 instance(_instance), listener(_listener), cluster(_cluster),
 	 client_address(_client_address),
 	 logger(*this),
-	 inbound(std::move(_socket)),
-	 outbound(instance.event_loop),
+	 inbound(std::move(_socket), instance.pipe_stock.get()),
+	 outbound(instance.event_loop, instance.pipe_stock.get()),
 	 defer_connect(instance.event_loop, BIND_THIS_METHOD(OnDeferredHandshake))
 {
 	if (cluster.GetConfig().transparent_source) {
@@ -12,6 +12,7 @@
 #include "io/Logger.hxx"
 #include "event/net/ConnectSocket.hxx"
 #include "net/StaticSocketAddress.hxx"
+#include "pipe/Lease.hxx"
 #include "util/Cancellable.hxx"
 #include "util/Cast.hxx"
 #include "util/IntrusiveList.hxx"
@@ -19,6 +20,7 @@
 #include <exception>
 
 class UniqueSocketDescriptor;
+class PipeStock;
 struct LbListenerConfig;
 class LbCluster;
 struct LbInstance;
@@ -37,15 +39,53 @@ class LbTcpConnection final
 	const LazyDomainLogger logger;
 
 public:
+	/**
+	 * A pipe which forwards data from one socket to the other
+	 * with splice(), bypassing the userspace buffers.  This is
+	 * only used if the inbound socket has no #SocketFilter.
+	 */
+	struct SplicePipe {
+		PipeLease lease;
+
+		/**
+		 * The number of bytes in the pipe which have not yet
+		 * been written to the destination socket.
+		 */
+		std::size_t size = 0;
+
+		explicit SplicePipe(PipeStock *stock) noexcept
+			:lease(stock) {}
+
+		~SplicePipe() noexcept {
+			lease.Release(IsEmpty()
+				      ? PutAction::REUSE
+				      : PutAction::DESTROY);
+		}
+
+		SplicePipe(const SplicePipe &) = delete;
+		SplicePipe &operator=(const SplicePipe &) = delete;
+
+		bool IsEmpty() const noexcept {
+			return size == 0;
+		}
+	};
+
 	struct Inbound final : BufferedSocketHandler {
 		UniquePoolPtr<FilteredSocket> socket;
 
-		explicit Inbound(UniquePoolPtr<FilteredSocket> &&_socket) noexcept;
+		/**
+		 * Data read from #socket which shall be sent to the
+		 * outbound socket.
+		 */
+		SplicePipe pipe;
+
+		Inbound(UniquePoolPtr<FilteredSocket> &&_socket,
+			PipeStock *pipe_stock) noexcept;
 
 	private:
 		/* virtual methods from class BufferedSocketHandler */
 		BufferedResult OnBufferedData() override;
-		// TODO: DirectResult OnBufferedDirect(SocketDescriptor fd, FdType fd_type) override;
+		DirectResult OnBufferedDirect(SocketDescriptor fd, FdType fd_type) override;
 		bool OnBufferedHangup() noexcept override;
 		bool OnBufferedClosed() noexcept override;
 		bool OnBufferedWrite() override;
@@ -61,13 +101,19 @@ public:
 	struct Outbound final : BufferedSocketHandler {
 		BufferedSocket socket;
 
-		explicit Outbound(EventLoop &event_loop) noexcept
-			:socket(event_loop) {}
+		/**
+		 * Data read from #socket which shall be sent to the
+		 * inbound socket.
+		 */
+		SplicePipe pipe;
+
+		Outbound(EventLoop &event_loop, PipeStock *pipe_stock) noexcept
+			:socket(event_loop), pipe(pipe_stock) {}
 
 	private:
 		/* virtual methods from class BufferedSocketHandler */
 		BufferedResult OnBufferedData() override;
-		// TODO: DirectResult OnBufferedDirect(SocketDescriptor fd, FdType fd_type) override;
+		DirectResult OnBufferedDirect(SocketDescriptor fd, FdType fd_type) override;
 		bool OnBufferedClosed() noexcept override;
 		bool OnBufferedEnd() override;
 		bool OnBufferedWrite() override;
@@ -851,6 +851,11 @@ Rubber::Remove(unsigned id) noexcept
 	const unsigned previous_id = o.previous;
 	const unsigned next_id = o.next;
 
+	if (id == compress_cursor)
+		/* CompressStep() continues after the previous
+		   object */
+		compress_cursor = previous_id;
+
 	std::size_t size = table->Remove(id);
 	assert(netto_size >= size);
 
@@ -893,6 +898,30 @@ Rubber::GetStats() const noexcept
 	return stats;
 }
 
+Rubber::HoleStats
+Rubber::GetHoleStats() const noexcept
+{
+	HoleStats stats;
+
+	for (const auto &list : holes) {
+		for (const auto &hole : list) {
+			++stats.n_holes;
+			stats.largest_hole = std::max(stats.largest_hole,
+						      hole.size);
+		}
+	}
+
+	return stats;
+}
+
+inline void
+Rubber::DiscardTail() noexcept
+{
+	const std::size_t allocated = AlignHugePageUp(table->GetTailOffset());
+	if (allocated < table.size())
+		DiscardPages(WriteAt(allocated), table.size() - allocated);
+}
+
 void
 Rubber::Compress() noexcept
 {
@@ -924,9 +953,77 @@ Rubber::Compress() noexcept
 	assert(offset == netto_size + table->GetSize());
 	assert(netto_size == GetBruttoSize());
 
-	/* tell the kernel that we won't need the data after our last
-	   allocation */
-	const std::size_t allocated = AlignHugePageUp(offset);
-	if (allocated < table.size())
-		DiscardPages(WriteAt(allocated), table.size() - allocated);
+	compress_cursor = 0;
+
+	DiscardTail();
+}
+
+inline bool
+Rubber::MoveDown(RubberObject &o) noexcept
+{
+	auto &previous = table->entries[o.previous];
+	auto *hole = FindHoleBetween(previous, o);
+	if (hole == nullptr)
+		return false;
+
+	const unsigned id = table->IdOf(o);
+	const std::size_t hole_size = hole->size;
+	assert(hole->previous_id == o.previous);
+	assert(hole->next_id == id);
+	assert(previous.GetEndOffset() + hole_size == o.offset);
+
+	/* unlink the hole before its memory gets overwritten */
+	RemoveHole(*hole);
+
+	MoveData(o, previous.GetEndOffset());
+
+	if (o.next != 0)
+		/* the hole is now after this object; this merges it
+		   with the hole which may follow */
+		AddHoleAfter(id, o.GetEndOffset(), hole_size);
+	/* else: this is the last object, and the space after it is
+	   not managed by holes */
+
+	return true;
+}
+
+bool
+Rubber::CompressStep(std::size_t max_bytes) noexcept
+{
+	assert(netto_size + GetTotalHoleSize() == GetBruttoSize());
+
+	if (GetBruttoSize() == netto_size) {
+		/* nothing to do */
+		compress_cursor = 0;
+		return false;
+	}
+
+	/* limit the number of objects visited, to bound the cost of
+	   a step even if there are no holes */
+	constexpr unsigned MAX_OBJECTS = 16384;
+
+	std::size_t moved = 0;
+	unsigned n_objects = 0;
+
+	RubberObject *o = &table->entries[compress_cursor];
+	assert(o->allocated);
+
+	while ((o = table->GetNext(o)) != nullptr) {
+		if (moved >= max_bytes || ++n_objects > MAX_OBJECTS)
+			/* continue here next time */
+			return true;
+
+		if (MoveDown(*o))
+			moved += o->size;
+
+		compress_cursor = table->IdOf(*o);
+	}
+
+	/* reached the end */
+	compress_cursor = 0;
+
+	assert(netto_size + GetTotalHoleSize() == GetBruttoSize());
+
+	DiscardTail();
+	return GetBruttoSize() > netto_size;
 }
@@ -72,6 +72,12 @@ class Rubber {
 	 */
 	std::array<HoleList, N_HOLE_THRESHOLDS> holes;
 
+	/**
+	 * The id of the object where CompressStep() will continue;
+	 * 0 means start at the beginning.
+	 */
+	unsigned compress_cursor = 0;
+
 public:
 	/**
 	 * Throws std::bad_alloc on error.
@@ -109,8 +115,45 @@ public:
 	[[gnu::pure]]
 	AllocatorStats GetStats() const noexcept;
 
+	struct HoleStats {
+		/**
+		 * The number of holes between allocations.
+		 */
+		std::size_t n_holes = 0;
+
+		/**
+		 * The size of the largest hole, i.e. the largest
+		 * allocation which can be satisfied without
+		 * compressing or growing.
+		 */
+		std::size_t largest_hole = 0;
+	};
+
+	/**
+	 * Obtain fragmentation metrics.  This iterates over all
+	 * holes.
+	 */
+	[[gnu::pure]]
+	HoleStats GetHoleStats() const noexcept;
+
+	/**
+	 * Move all allocations to the beginning of the buffer,
+	 * eliminating all holes.  This can take a while with a large
+	 * buffer; consider using CompressStep() instead.
+	 */
 	void Compress() noexcept;
 
+	/**
+	 * Do a part of Compress(): move allocations to eliminate the
+	 * holes before them, until the given number of bytes has
+	 * been moved.  The next call continues where this one has
+	 * stopped.
+	 *
+	 * @return true if there is more work to do, false if the
+	 * whole buffer has been compressed
+	 */
+	bool CompressStep(std::size_t max_bytes) noexcept;
+
 	/**
 	 * Add a new object with the specified size.  Use Write() to
 	 * actually copy data to the object.
@@ -220,6 +263,21 @@ private:
 	 */
 	bool MoveLast(std::size_t max_object_size) noexcept;
 
+	/**
+	 * If there is a hole before this object, move the object
+	 * into it, which moves the hole behind the object (merging
+	 * it with a hole which may already be there).
+	 *
+	 * @return true if the object has been moved
+	 */
+	bool MoveDown(RubberObject &o) noexcept;
+
+	/**
+	 * Tell the kernel that we won't need the memory after the
+	 * last allocation.
+	 */
+	void DiscardTail() noexcept;
+
 	[[gnu::pure]]
 	Hole *FindHoleBetween(RubberObject &a, RubberObject &b) noexcept;
 
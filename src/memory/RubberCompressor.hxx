@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#pragma once
+
+#include "Rubber.hxx"
+#include "event/DeferEvent.hxx"
+
+/**
+ * Compress a #Rubber allocator incrementally: each time the
+ * #EventLoop is idle, Rubber::CompressStep() moves a limited amount
+ * of data, so compressing a large buffer does not stall the event
+ * loop.
+ */
+class RubberCompressor {
+	/**
+	 * Move at most this number of bytes per event loop
+	 * iteration.
+	 */
+	static constexpr std::size_t STEP_SIZE = 1024 * 1024;
+
+	Rubber &rubber;
+
+	DeferEvent defer_step;
+
+public:
+	RubberCompressor(EventLoop &event_loop, Rubber &_rubber) noexcept
+		:rubber(_rubber),
+		 defer_step(event_loop, BIND_THIS_METHOD(OnDeferredStep)) {}
+
+	/**
+	 * Start compressing (unless already running).
+	 */
+	void Start() noexcept {
+		defer_step.ScheduleIdle();
+	}
+
+	void Cancel() noexcept {
+		defer_step.Cancel();
+	}
+
+private:
+	void OnDeferredStep() noexcept {
+		if (rubber.CompressStep(STEP_SIZE))
+			defer_step.ScheduleIdle();
+	}
+};
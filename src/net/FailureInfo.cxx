@@ -4,6 +4,13 @@
 
 #include "FailureInfo.hxx"
 
+#include <cmath> // for std::exp()
+
+/**
+ * The decay time constant of FailureInfo::latency_ewma.
+ */
+static constexpr std::chrono::duration<double> LATENCY_DECAY = std::chrono::seconds{10};
+
 void
 FailureInfo::Set(Expiry now,
 		 FailureStatus new_status,
@@ -56,3 +63,25 @@ FailureInfo::Unset(FailureStatus unset_status) noexcept
 		break;
 	}
 }
+
+void
+FailureInfo::FinishRequest(std::chrono::steady_clock::time_point now,
+			   std::chrono::steady_clock::duration _latency) noexcept
+{
+	FinishRequest();
+
+	const double latency = std::chrono::duration<double>(_latency).count();
+
+	if (latency >= latency_ewma) {
+		/* peak: adopt the new value immediately */
+		latency_ewma = latency;
+	} else {
+		/* decay depending on how much time has passed since
+		   the last update, not on the number of samples */
+		const std::chrono::duration<double> elapsed = now - latency_time;
+		const double w = std::exp(-elapsed / LATENCY_DECAY);
+		latency_ewma = latency_ewma * w + latency * (1 - w);
+	}
+
+	latency_time = now;
+}
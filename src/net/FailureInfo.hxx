@@ -7,6 +7,9 @@
 #include "FailureStatus.hxx"
 #include "time/Expiry.hxx"
 
+#include <cassert>
+#include <chrono>
+
 class FailureInfo {
 	Expiry fade_expires = Expiry::AlreadyExpired();
 
@@ -18,6 +21,25 @@ class FailureInfo {
 
 	bool monitor = false;
 
+	/**
+	 * The number of requests currently being handled by this
+	 * server.  Used by StickyMode::LEAST_REQUESTS and
+	 * StickyMode::PEAK_EWMA.
+	 */
+	unsigned n_requests = 0;
+
+	/**
+	 * Exponentially weighted moving average of the response
+	 * latency [seconds]; jumps up immediately to each new peak
+	 * and decays slowly.  Zero if there has been no response yet.
+	 */
+	double latency_ewma = 0;
+
+	/**
+	 * When was #latency_ewma last updated?
+	 */
+	std::chrono::steady_clock::time_point latency_time;
+
 public:
 	constexpr FailureStatus GetStatus(Expiry now) const noexcept {
 		if (!CheckMonitor())
@@ -104,6 +126,39 @@ public:
 		return !monitor;
 	}
 
+	void StartRequest() noexcept {
+		++n_requests;
+	}
+
+	void FinishRequest() noexcept {
+		assert(n_requests > 0);
+		--n_requests;
+	}
+
+	/**
+	 * Like FinishRequest(), but also feed the latency of a
+	 * successful response into the moving average.
+	 */
+	void FinishRequest(std::chrono::steady_clock::time_point now,
+			   std::chrono::steady_clock::duration latency) noexcept;
+
+	constexpr unsigned GetRequestCount() const noexcept {
+		return n_requests;
+	}
+
+	/**
+	 * Calculate the cost for StickyMode::PEAK_EWMA.  A server
+	 * which has requests in flight, but has never responded, gets
+	 * a huge penalty.
+	 */
+	[[gnu::pure]]
+	double GetPeakEwmaCost() const noexcept {
+		if (latency_ewma <= 0)
+			return n_requests > 0 ? 1e6 + n_requests : 0;
+
+		return latency_ewma * (n_requests + 1);
+	}
+
 	void UnsetAll() noexcept {
 		fade_expires = protocol_expires = connect_expires =
 			Expiry::AlreadyExpired();
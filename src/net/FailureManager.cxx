@@ -77,6 +77,18 @@ FailureManager::Make(SocketAddress address) noexcept
 	}
 }
 
+const FailureInfo *
+FailureManager::Find(SocketAddress address) const noexcept
+{
+	assert(!address.IsNull());
+
+	auto i = failures.find(address);
+	if (i == failures.end())
+		return nullptr;
+
+	return &*i;
+}
+
 SocketAddress
 FailureManager::GetAddress(const FailureInfo &info) noexcept
 {
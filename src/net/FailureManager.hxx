@@ -52,6 +52,15 @@ public:
 	[[gnu::pure]]
 	ReferencedFailureInfo &Make(SocketAddress address) noexcept;
 
+	/**
+	 * Look up an existing #FailureInfo instance.
+	 *
+	 * @return the instance or nullptr if there is none for this
+	 * address
+	 */
+	[[gnu::pure]]
+	const FailureInfo *Find(SocketAddress address) const noexcept;
+
 	[[gnu::pure]]
 	static SocketAddress GetAddress(const FailureInfo &info) noexcept;
 
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "BdpEstimator.hxx"
+
+#include <algorithm> // for std::min(), std::max()
+
+namespace NgHttp2 {
+
+bool
+BdpEstimator::OnData(std::size_t nbytes, Clock::time_point now) noexcept
+{
+	if (ping_pending) {
+		sample += nbytes;
+		return false;
+	}
+
+	if (window >= max_window || now < next_ping_time)
+		return false;
+
+	ping_pending = true;
+	ping_time = now;
+	sample = nbytes;
+	return true;
+}
+
+std::size_t
+BdpEstimator::OnPingAck(Clock::time_point now) noexcept
+{
+	if (!ping_pending)
+		/* not our PING (or a duplicate ACK) */
+		return 0;
+
+	ping_pending = false;
+
+	using FloatDuration = std::chrono::duration<double>;
+	const double rtt = std::max(FloatDuration{now - ping_time}.count(),
+				    1e-4);
+	const double bandwidth = sample / rtt;
+
+	if (sample * 3 >= window * 2 && bandwidth > max_bandwidth) {
+		/* the peer has (almost) exhausted the window within
+		   one round trip, and more window has helped (or
+		   this is the first sample): grow */
+		max_bandwidth = bandwidth;
+		window = std::min(sample * 2, max_window);
+		backoff = MIN_BACKOFF;
+		next_ping_time = now;
+		return window;
+	}
+
+	/* the window is large enough (for now); check again later */
+	next_ping_time = now + backoff;
+	backoff = std::min(backoff * 2, MAX_BACKOFF);
+	return 0;
+}
+
+} // namespace NgHttp2
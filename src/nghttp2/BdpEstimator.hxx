@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace NgHttp2 {
+
+/**
+ * Estimates the bandwidth-delay product of a connection to choose
+ * a flow control window which doesn't limit the throughput.
+ *
+ * When DATA arrives, a PING is sent, and all DATA received until its
+ * ACK is one sample.  If the sample is close to the current window
+ * (i.e. the peer was probably blocked by flow control) and the
+ * bandwidth has grown, the window is increased to twice the sample
+ * (up to the configured maximum).  If not, the next PING is delayed
+ * with exponential backoff to avoid flooding the peer with PINGs.
+ */
+class BdpEstimator {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	/**
+	 * The opaque data of our PING frames; it distinguishes them
+	 * from PINGs sent by the peer.
+	 */
+	static constexpr std::array<uint8_t, 8> PING_DATA{'b', 'd', 'p', 'p', 'i', 'n', 'g', 0};
+
+private:
+	static constexpr Clock::duration MIN_BACKOFF = std::chrono::milliseconds{100};
+	static constexpr Clock::duration MAX_BACKOFF = std::chrono::seconds{10};
+
+	Clock::time_point ping_time;
+
+	/**
+	 * Don't send another PING before this time.
+	 */
+	Clock::time_point next_ping_time{};
+
+	Clock::duration backoff = MIN_BACKOFF;
+
+	/**
+	 * The highest bandwidth seen so far [bytes per second].
+	 */
+	double max_bandwidth = 0;
+
+	std::size_t window;
+
+	const std::size_t max_window;
+
+	/**
+	 * The number of DATA payload bytes received since the PING
+	 * was sent.
+	 */
+	std::size_t sample;
+
+	bool ping_pending = false;
+
+public:
+	/**
+	 * @param _window the initial window size
+	 * @param _max_window the upper limit for the window size; if
+	 * it is not larger than the initial window, estimation is
+	 * disabled
+	 */
+	constexpr BdpEstimator(std::size_t _window,
+			       std::size_t _max_window) noexcept
+		:window(_window), max_window(_max_window) {}
+
+	std::size_t GetWindow() const noexcept {
+		return window;
+	}
+
+	/**
+	 * Account for received DATA payload.
+	 *
+	 * @return true if the caller shall send a PING with
+	 * #PING_DATA now
+	 */
+	bool OnData(std::size_t nbytes, Clock::time_point now) noexcept;
+
+	/**
+	 * The ACK for our PING has been received.
+	 *
+	 * @return the new window size if it has been increased, 0
+	 * otherwise
+	 */
+	std::size_t OnPingAck(Clock::time_point now) noexcept;
+};
+
+} // namespace NgHttp2
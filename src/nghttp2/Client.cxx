@@ -18,6 +18,7 @@
 #include "util/Cancellable.hxx"
 #include "util/StaticVector.hxx"
 #include "http/CommonHeaders.hxx"
+#include "http/HeaderToken.hxx"
 #include "http/Method.hxx"
 #include "http/ResponseHandler.hxx"
 #include "stopwatch.hxx"
@@ -26,6 +27,8 @@
 
 #include <nghttp2/nghttp2.h>
 
+#include <algorithm> // for std::equal(), std::min()
+
 #include <assert.h>
 
 using std::string_view_literals::operator""sv;
@@ -169,6 +172,8 @@ public:
 		c.unconsumed += len;
 #endif
 
+		c.OnDataReceived(len);
+
 		auto *request = (Request *)
 			nghttp2_session_get_stream_user_data(session, stream_id);
 		if (request == nullptr) {
@@ -244,6 +249,11 @@ private:
 		nghttp2_session_resume_data(connection.session.get(), id);
 		DeferWrite();
 	}
+
+	bool CanIstreamDataSourceNoCopy() const noexcept override {
+		return CanSendNoCopy(*connection.socket,
+				     connection.pending_output);
+	}
 };
 
 void
@@ -345,8 +355,15 @@ ClientConnection::Request::OnHeaderCallback(std::string_view name,
 		status = _status;
 	}
 
-	if (name.size() >= 2 && name.front() != ':')
-		response_headers.Add(alloc, alloc.DupZ(name), alloc.DupZ(value));
+	if (name.size() >= 2 && name.front() != ':') {
+		if (const auto token = LookupHeaderToken(name);
+		    token != HeaderToken::UNKNOWN)
+			response_headers.Add(alloc, GetHeaderTokenKey(token),
+					     alloc.DupZ(value));
+		else
+			response_headers.Add(alloc, alloc.DupZ(name),
+					     alloc.DupZ(value));
+	}
 
 	return 0;
 }
@@ -445,6 +462,8 @@ ClientConnection::ClientConnection(std::unique_ptr<FilteredSocket> _socket,
 
 	NgHttp2::SessionCallbacks callbacks;
 	nghttp2_session_callbacks_set_send_callback(callbacks.get(), SendCallback);
+	nghttp2_session_callbacks_set_send_data_callback(callbacks.get(),
+							 SendDataCallback);
 	nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks.get(),
 							     OnFrameRecvCallback);
 	nghttp2_session_callbacks_set_on_stream_close_callback(callbacks.get(),
@@ -525,7 +544,54 @@ ClientConnection::AbortAllRequests(std::exception_ptr e) noexcept
 ssize_t
 ClientConnection::SendCallback(std::span<const std::byte> src) noexcept
 {
-	return SendToBuffer(*socket, src);
+	return SendToBuffer(*socket, pending_output, src);
+}
+
+int
+ClientConnection::SendDataCallback(nghttp2_session *, nghttp2_frame *frame,
+				     const uint8_t *framehd, size_t length,
+				     nghttp2_data_source *source,
+				     void *user_data) noexcept
+{
+	auto &c = *(ClientConnection *)user_data;
+	auto &ids = *(IstreamDataSource *)source->ptr;
+
+	return SendDataFrame(*c.socket, c.pending_output,
+			     {(const std::byte *)framehd, NGHTTP2_FRAME_HDLEN},
+			     frame->data, length, ids);
+}
+
+void
+ClientConnection::OnDataReceived(std::size_t nbytes) noexcept
+{
+	if (bdp.OnData(nbytes, GetEventLoop().SteadyNow()))
+		nghttp2_submit_ping(session.get(), NGHTTP2_FLAG_NONE,
+				    BdpEstimator::PING_DATA.data());
+}
+
+inline void
+ClientConnection::OnPingAck(const nghttp2_ping &ping) noexcept
+{
+	if (!std::equal(BdpEstimator::PING_DATA.begin(),
+			BdpEstimator::PING_DATA.end(),
+			ping.opaque_data))
+		return;
+
+	const std::size_t window = bdp.OnPingAck(GetEventLoop().SteadyNow());
+	if (window == 0)
+		return;
+
+	/* this applies the new size to all open streams, too */
+	const nghttp2_settings_entry iv[] = {
+		{NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, uint32_t(window)},
+	};
+
+	nghttp2_submit_settings(session.get(), NGHTTP2_FLAG_NONE,
+				iv, std::size(iv));
+	nghttp2_session_set_local_window_size(session.get(),
+					      NGHTTP2_NV_FLAG_NONE,
+					      0, window);
+	DeferWrite();
 }
 
 int
@@ -564,6 +630,11 @@ ClientConnection::OnFrameRecvCallback(const nghttp2_frame &frame) noexcept
 									  MAX_CONCURRENT_STREAMS);
 		break;
 
+	case NGHTTP2_PING:
+		if (frame.hd.flags & NGHTTP2_FLAG_ACK)
+			OnPingAck(frame.ping);
+		break;
+
 	case NGHTTP2_GOAWAY:
 		handler.OnNgHttp2ConnectionGoAway();
 		break;
@@ -592,7 +663,7 @@ ClientConnection::OnBufferedClosed() noexcept
 bool
 ClientConnection::OnBufferedWrite()
 {
-	return OnSocketWrite(session.get(), *socket);
+	return OnSocketWrite(session.get(), *socket, pending_output);
 }
 
 void
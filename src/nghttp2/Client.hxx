@@ -4,7 +4,9 @@
 
 #pragma once
 
+#include "BdpEstimator.hxx"
 #include "Session.hxx"
+#include "SocketUtil.hxx"
 #include "event/net/BufferedSocket.hxx"
 #include "event/DeferEvent.hxx"
 #include "util/IntrusiveList.hxx"
@@ -34,12 +36,28 @@ public:
 class ClientConnection final : BufferedSocketHandler {
 	static constexpr size_t MAX_CONCURRENT_STREAMS = 256;
 
+	/**
+	 * The upper limit for the flow control window chosen by the
+	 * #BdpEstimator.
+	 */
+	static constexpr size_t MAX_WINDOW = 16 * 1024 * 1024;
+
 	const std::unique_ptr<FilteredSocket> socket;
 
+	/**
+	 * The unsent tail of a zero-copy DATA frame.
+	 */
+	PendingOutput pending_output;
+
 	ConnectionHandler &handler;
 
 	NgHttp2::Session session;
 
+	/**
+	 * Chooses the window size for response bodies.
+	 */
+	BdpEstimator bdp{NGHTTP2_INITIAL_WINDOW_SIZE, MAX_WINDOW};
+
 	class Request;
 	using RequestList = IntrusiveList<
 		Request,
@@ -90,6 +108,13 @@ public:
 private:
 	void DeferWrite() noexcept;
 
+	/**
+	 * Feed received DATA payload into the #BdpEstimator.
+	 */
+	void OnDataReceived(std::size_t nbytes) noexcept;
+
+	void OnPingAck(const nghttp2_ping &ping) noexcept;
+
 	void InvokeIdle() noexcept {
 		handler.OnNgHttp2ConnectionIdle();
 	}
@@ -107,6 +132,11 @@ private:
 		return c.SendCallback({(const std::byte *)data, length});
 	}
 
+	static int SendDataCallback(nghttp2_session *, nghttp2_frame *frame,
+				    const uint8_t *framehd, size_t length,
+				    nghttp2_data_source *source,
+				    void *user_data) noexcept;
+
 	int OnFrameRecvCallback(const nghttp2_frame &frame) noexcept;
 
 	static int OnFrameRecvCallback(nghttp2_session *,
@@ -44,6 +44,20 @@ IstreamDataSource::ReadCallback(uint8_t *buf, size_t length,
 	}
 
 	size_t nbytes = std::min(r.size(), length);
+
+	if (handler.CanIstreamDataSourceNoCopy()) {
+		/* the nghttp2_send_data_callback will write the data
+		   directly from our buffer and then call
+		   ConsumeNoCopy() */
+		data_flags |= NGHTTP2_DATA_FLAG_NO_COPY;
+		transmitted += nbytes;
+
+		if (eof && nbytes == r.size())
+			data_flags |= NGHTTP2_DATA_FLAG_EOF;
+
+		return nbytes;
+	}
+
 	memcpy(buf, r.data(), nbytes);
 	buffer.Consume(nbytes);
 	transmitted += nbytes;
@@ -9,12 +9,26 @@
 
 #include <nghttp2/nghttp2.h>
 
+#include <cassert>
+#include <cstddef>
+#include <span>
+
 namespace NgHttp2 {
 
 class IstreamDataSourceHandler {
 public:
 	virtual void OnIstreamDataSourceWaiting() noexcept {}
 	virtual void OnIstreamDataSourceReady() noexcept = 0;
+
+	/**
+	 * May the data be passed to libnghttp2 with
+	 * NGHTTP2_DATA_FLAG_NO_COPY?  If yes, the connection's
+	 * nghttp2_send_data_callback must call GetNoCopyData() and
+	 * ConsumeNoCopy().
+	 */
+	virtual bool CanIstreamDataSourceNoCopy() const noexcept {
+		return false;
+	}
 };
 
 /**
@@ -50,6 +64,26 @@ public:
 		return transmitted;
 	}
 
+	/**
+	 * Returns the payload of a DATA frame which was announced
+	 * with NGHTTP2_DATA_FLAG_NO_COPY by ReadCallback().
+	 */
+	std::span<const std::byte> GetNoCopyData(std::size_t length) noexcept {
+		auto r = sink.GetBuffer().Read();
+		assert(r.size() >= length);
+		return r.first(length);
+	}
+
+	/**
+	 * The payload returned by GetNoCopyData() has been sent.
+	 */
+	void ConsumeNoCopy(std::size_t length) noexcept {
+		auto &buffer = sink.GetBuffer();
+		buffer.Consume(length);
+		if (buffer.empty())
+			buffer.Free();
+	}
+
 private:
 	/* virtual methods from class FifoBufferSinkHandler */
 	bool OnFifoBufferSinkData() noexcept override {
@@ -17,6 +17,7 @@
 #include "http/IncomingRequest.hxx"
 #include "http/HeaderLimits.hxx"
 #include "http/Headers.hxx"
+#include "http/HeaderToken.hxx"
 #include "http/Logger.hxx"
 #include "http/Method.hxx"
 #include "http/Status.hxx"
@@ -32,7 +33,6 @@
 #include "net/log/ContentType.hxx"
 #include "util/Cancellable.hxx"
 #include "util/StaticVector.hxx"
-#include "util/StringAPI.hxx"
 #include "stopwatch.hxx"
 #include "product.h" // for BRIEF_PRODUCT_TOKEN
 
@@ -40,6 +40,8 @@
 
 #include <fmt/format.h>
 
+#include <algorithm> // for std::equal(), std::max()
+
 #include <assert.h>
 
 using std::string_view_literals::operator""sv;
@@ -231,6 +233,7 @@ public:
 		/* always update the connection-level window to keep
 		   it open for more data on other streams */
 		c.Consume(len);
+		c.OnDataReceived(len);
 
 		auto *request = (Request *)
 			nghttp2_session_get_stream_user_data(session, stream_id);
@@ -243,6 +246,16 @@ public:
 	int OnFrameRecvCallback(const nghttp2_frame &frame) noexcept;
 	int OnFrameSendCallback(const nghttp2_frame &frame) noexcept;
 
+	/**
+	 * The #BdpEstimator has chosen a larger window.
+	 */
+	void OnWindowGrown(std::size_t window) noexcept {
+		if (request_body_used && !request_body_eof)
+			nghttp2_session_set_local_window_size(connection.session.get(),
+							      NGHTTP2_NV_FLAG_NONE,
+							      id, window);
+	}
+
 private:
 	void SetError(HttpStatus _status, const char *_msg) noexcept {
 		if (error_status != HttpStatus::UNDEFINED)
@@ -271,6 +284,11 @@ private:
 	void OnIstreamDataSourceWaiting() noexcept override;
 	void OnIstreamDataSourceReady() noexcept override;
 
+	bool CanIstreamDataSourceNoCopy() const noexcept override {
+		return CanSendNoCopy(*connection.socket,
+				     connection.pending_output);
+	}
+
 	/* virtual methods from class IncomingHttpRequest */
 	void SendResponse(HttpStatus status,
 			  HttpHeaders &&response_headers,
@@ -324,7 +342,7 @@ ServerConnection::Request::OnHeaderCallback(std::string_view name,
 			return 0;
 		}
 
-		const char *allocated_name = alloc.DupZ(name);
+		const auto token = LookupHeaderToken(name);
 		const char *allocated_value;
 
 		/* the Cookie request header is special: multiple
@@ -338,7 +356,7 @@ ServerConnection::Request::OnHeaderCallback(std::string_view name,
 		   breaks PHP's session management; as a workaround,
 		   we concatenate all Cookie headers with a semicolon
 		   here before Apache does the wrong thing */
-		if (StringIsEqual(allocated_name, "cookie")) {
+		if (token == HeaderToken::COOKIE) {
 			const char *old_value = headers.Remove(cookie_header);
 			if (old_value != nullptr)
 				allocated_value = alloc.Concat(old_value, "; ",
@@ -348,7 +366,11 @@ ServerConnection::Request::OnHeaderCallback(std::string_view name,
 		} else
 			allocated_value = alloc.DupZ(value);
 
-		headers.Add(alloc, allocated_name, allocated_value);
+		if (token != HeaderToken::UNKNOWN)
+			headers.Add(alloc, GetHeaderTokenKey(token),
+				    allocated_value);
+		else
+			headers.Add(alloc, alloc.DupZ(name), allocated_value);
 	}
 
 	return 0;
@@ -361,11 +383,12 @@ ServerConnection::Request::OnFifoBufferIstreamConsumed(size_t nbytes) noexcept
 		request_body_used = true;
 
 		/* now that the first byte has been consumed, and the
-		   request body is really being used, revert to the
-		   default window size */
+		   request body is really being used, switch to the
+		   window size chosen by the BdpEstimator (at least
+		   the default) */
 		nghttp2_session_set_local_window_size(connection.session.get(),
 						      NGHTTP2_NV_FLAG_NONE,
-						      id, NGHTTP2_INITIAL_WINDOW_SIZE);
+						      id, connection.bdp.GetWindow());
 	}
 
 	Consume(nbytes);
@@ -606,7 +629,8 @@ ServerConnection::ServerConnection(struct pool &_pool,
 				   SocketAddress _remote_address,
 				   SlicePool &_request_slice_pool,
 				   HttpServerConnectionHandler &_handler,
-				   HttpServerRequestHandler &_request_handler)
+				   HttpServerRequestHandler &_request_handler,
+				   std::size_t max_window)
 	:pool(_pool), request_slice_pool(_request_slice_pool),
 	socket(std::move(_socket)),
 	 handler(_handler), request_handler(_request_handler),
@@ -614,6 +638,8 @@ ServerConnection::ServerConnection(struct pool &_pool,
 	 remote_address(DupAddress(pool, _remote_address)),
 	 local_host_and_port(address_to_string(pool, local_address)),
 	 remote_host(address_to_host_string(pool, remote_address)),
+	 bdp(NGHTTP2_INITIAL_WINDOW_SIZE,
+	     std::min<std::size_t>(max_window, NGHTTP2_MAX_WINDOW_SIZE)),
 	 idle_timer(socket->GetEventLoop(), BIND_THIS_METHOD(OnIdleTimeout))
 {
 	socket->Reinit(write_timeout, *this);
@@ -624,6 +650,8 @@ ServerConnection::ServerConnection(struct pool &_pool,
 
 	NgHttp2::SessionCallbacks callbacks;
 	nghttp2_session_callbacks_set_send_callback(callbacks.get(), SendCallback);
+	nghttp2_session_callbacks_set_send_data_callback(callbacks.get(),
+							 SendDataCallback);
 	nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks.get(),
 							     OnFrameRecvCallback);
 	nghttp2_session_callbacks_set_on_frame_send_callback(callbacks.get(),
@@ -647,7 +675,8 @@ ServerConnection::ServerConnection(struct pool &_pool,
 		/* until a request body is really being used, allow
 		   the client to upload only the first 4 kB to avoid
 		   congesting the connection-level window; this will
-		   be reverted to the 64 kB default later by
+		   be raised to the BdpEstimator's window (at least
+		   the 64 kB default) later by
 		   Request::OnFifoBufferIstreamConsumed() */
 		{NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, 4096},
 	};
@@ -657,12 +686,9 @@ ServerConnection::ServerConnection(struct pool &_pool,
 	if (rv != 0)
 		throw MakeError(rv, "nghttp2_submit_settings() failed");
 
-	/* allow the connection-level window size to be somewhat
-	   larger than the default 64 kB for better concurrent upload
-	   performance */
 	nghttp2_session_set_local_window_size(session.get(),
 					      NGHTTP2_NV_FLAG_NONE,
-					      0, 256 * 1024);
+					      0, connection_window);
 
 	idle_timer.Schedule(idle_timeout);
 
@@ -707,12 +733,30 @@ ServerConnection::DeferWrite() noexcept
 ssize_t
 ServerConnection::SendCallback(std::span<const std::byte> src) noexcept
 {
-	return SendToBuffer(*socket, src);
+	return SendToBuffer(*socket, pending_output, src);
+}
+
+int
+ServerConnection::SendDataCallback(nghttp2_session *, nghttp2_frame *frame,
+				     const uint8_t *framehd, size_t length,
+				     nghttp2_data_source *source,
+				     void *user_data) noexcept
+{
+	auto &c = *(ServerConnection *)user_data;
+	auto &ids = *(IstreamDataSource *)source->ptr;
+
+	return SendDataFrame(*c.socket, c.pending_output,
+			     {(const std::byte *)framehd, NGHTTP2_FRAME_HDLEN},
+			     frame->data, length, ids);
 }
 
 int
 ServerConnection::OnFrameRecvCallback(const nghttp2_frame &frame) noexcept
 {
+	if (frame.hd.type == NGHTTP2_PING &&
+	    (frame.hd.flags & NGHTTP2_FLAG_ACK) != 0)
+		OnPingAck(frame.ping);
+
 	if (frame.hd.stream_id != 0) {
 		Request *request = static_cast<Request *>(nghttp2_session_get_stream_user_data(session.get(),
 											       frame.hd.stream_id));
@@ -723,6 +767,38 @@ ServerConnection::OnFrameRecvCallback(const nghttp2_frame &frame) noexcept
 	return 0;
 }
 
+void
+ServerConnection::OnDataReceived(std::size_t nbytes) noexcept
+{
+	if (bdp.OnData(nbytes, GetEventLoop().SteadyNow()))
+		nghttp2_submit_ping(session.get(), NGHTTP2_FLAG_NONE,
+				    BdpEstimator::PING_DATA.data());
+}
+
+inline void
+ServerConnection::OnPingAck(const nghttp2_ping &ping) noexcept
+{
+	if (!std::equal(BdpEstimator::PING_DATA.begin(),
+			BdpEstimator::PING_DATA.end(),
+			ping.opaque_data))
+		return;
+
+	const std::size_t window = bdp.OnPingAck(GetEventLoop().SteadyNow());
+	if (window == 0)
+		return;
+
+	/* the connection-level window must not be smaller than the
+	   stream windows */
+	nghttp2_session_set_local_window_size(session.get(),
+					      NGHTTP2_NV_FLAG_NONE,
+					      0, std::max(window, connection_window));
+
+	for (auto &request : requests)
+		request.OnWindowGrown(window);
+
+	DeferWrite();
+}
+
 int
 ServerConnection::OnFrameSendCallback(const nghttp2_frame &frame) noexcept
 {
@@ -785,7 +861,7 @@ ServerConnection::OnBufferedClosed() noexcept
 bool
 ServerConnection::OnBufferedWrite()
 {
-	return OnSocketWrite(session.get(), *socket);
+	return OnSocketWrite(session.get(), *socket, pending_output);
 }
 
 void
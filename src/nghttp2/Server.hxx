@@ -4,7 +4,9 @@
 
 #pragma once
 
+#include "BdpEstimator.hxx"
 #include "Session.hxx"
+#include "SocketUtil.hxx"
 #include "pool/UniquePtr.hxx"
 #include "event/net/BufferedSocket.hxx"
 #include "net/SocketAddress.hxx"
@@ -25,6 +27,11 @@ class ServerConnection final : BufferedSocketHandler {
 
 	const UniquePoolPtr<FilteredSocket> socket;
 
+	/**
+	 * The unsent tail of a zero-copy DATA frame.
+	 */
+	PendingOutput pending_output;
+
 	HttpServerConnectionHandler &handler;
 	HttpServerRequestHandler &request_handler;
 
@@ -35,6 +42,11 @@ class ServerConnection final : BufferedSocketHandler {
 
 	NgHttp2::Session session;
 
+	/**
+	 * Chooses the window size for request bodies.
+	 */
+	BdpEstimator bdp;
+
 	class Request;
 	using RequestList = IntrusiveList<Request>;
 
@@ -50,13 +62,26 @@ class ServerConnection final : BufferedSocketHandler {
 
 	static constexpr Event::Duration idle_timeout = std::chrono::minutes{2};
 
+	/**
+	 * The minimum connection-level window size.  It is somewhat
+	 * larger than the default 64 kB for better concurrent upload
+	 * performance.
+	 */
+	static constexpr std::size_t connection_window = 256 * 1024;
+
 public:
+	/**
+	 * The default for the "max_window" parameter.
+	 */
+	static constexpr std::size_t DEFAULT_MAX_WINDOW = 16 * 1024 * 1024;
+
 	ServerConnection(struct pool &_pool,
 			 UniquePoolPtr<FilteredSocket> _socket,
 			 SocketAddress remote_address,
 			 SlicePool &_request_slice_pool,
 			 HttpServerConnectionHandler &_handler,
-			 HttpServerRequestHandler &request_handler);
+			 HttpServerRequestHandler &request_handler,
+			 std::size_t max_window=DEFAULT_MAX_WINDOW);
 
 	~ServerConnection() noexcept;
 
@@ -70,6 +95,11 @@ public:
 		DeferWrite();
 	}
 
+	/**
+	 * Feed received DATA payload into the #BdpEstimator.
+	 */
+	void OnDataReceived(std::size_t nbytes) noexcept;
+
 	void RemoveRequest(Request &request) noexcept;
 
 private:
@@ -84,6 +114,11 @@ private:
 		return c.SendCallback({(const std::byte *)data, length});
 	}
 
+	static int SendDataCallback(nghttp2_session *, nghttp2_frame *frame,
+				    const uint8_t *framehd, size_t length,
+				    nghttp2_data_source *source,
+				    void *user_data) noexcept;
+
 	int OnFrameRecvCallback(const nghttp2_frame &frame) noexcept;
 
 	static int OnFrameRecvCallback(nghttp2_session *,
@@ -122,6 +157,8 @@ private:
 		return c.OnInvalidFrameReceivedCallback(*frame, lib_error_code);
 	}
 
+	void OnPingAck(const nghttp2_ping &ping) noexcept;
+
 	void OnIdleTimeout() noexcept;
 
 	/* virtual methods from class BufferedSocketHandler */
@@ -3,13 +3,61 @@
 // author: Max Kellermann <mk@cm4all.com>
 
 #include "SocketUtil.hxx"
+#include "IstreamDataSource.hxx"
 #include "Error.hxx"
 #include "fs/FilteredSocket.hxx"
+#include "io/Iovec.hxx"
+#include "util/StaticVector.hxx"
 
 #include <nghttp2/nghttp2.h>
 
+#include <cassert>
+
 namespace NgHttp2 {
 
+void
+PendingOutput::Set(std::span<const struct iovec> v, std::size_t skip) noexcept
+{
+	assert(empty());
+
+	buffer.clear();
+	position = 0;
+
+	for (const auto &i : v) {
+		const auto src = ToSpan(i);
+		if (skip >= src.size()) {
+			skip -= src.size();
+			continue;
+		}
+
+		buffer.insert(buffer.end(), std::next(src.begin(), skip), src.end());
+		skip = 0;
+	}
+}
+
+int
+PendingOutput::Flush(FilteredSocket &socket) noexcept
+{
+	if (empty())
+		return 0;
+
+	const auto nbytes = socket.Write(std::span{buffer}.subspan(position));
+	if (nbytes < 0) {
+		if (nbytes == WRITE_BLOCKING)
+			return NGHTTP2_ERR_WOULDBLOCK;
+		else
+			return NGHTTP2_ERR_CALLBACK_FAILURE;
+	}
+
+	position += nbytes;
+	if (!empty())
+		return NGHTTP2_ERR_WOULDBLOCK;
+
+	buffer.clear();
+	position = 0;
+	return 0;
+}
+
 BufferedResult
 ReceiveFromSocketBuffer(nghttp2_session *session, FilteredSocket &socket)
 {
@@ -30,8 +78,12 @@ ReceiveFromSocketBuffer(nghttp2_session *session, FilteredSocket &socket)
 }
 
 ssize_t
-SendToBuffer(FilteredSocket &socket, std::span<const std::byte> src) noexcept
+SendToBuffer(FilteredSocket &socket, PendingOutput &pending,
+	     std::span<const std::byte> src) noexcept
 {
+	if (int result = pending.Flush(socket); result != 0)
+		return result;
+
 	const auto nbytes = socket.Write(src);
 	if (nbytes < 0) {
 		if (nbytes == WRITE_BLOCKING)
@@ -44,13 +96,77 @@ SendToBuffer(FilteredSocket &socket, std::span<const std::byte> src) noexcept
 }
 
 bool
-OnSocketWrite(nghttp2_session *session, FilteredSocket &socket)
+CanSendNoCopy(const FilteredSocket &socket,
+	      const PendingOutput &pending) noexcept
 {
+	/* writev() bypasses the filter, so this works only without
+	   one (or with kernel TLS) */
+	return pending.empty() && socket.IsOutputDirect();
+}
+
+int
+SendDataFrame(FilteredSocket &socket, PendingOutput &pending,
+	      std::span<const std::byte> header, const nghttp2_data &frame,
+	      std::size_t length, IstreamDataSource &source) noexcept
+{
+	/* IstreamDataSource::ReadCallback() has checked
+	   CanSendNoCopy(), and nothing can have been sent since */
+	assert(CanSendNoCopy(socket, pending));
+
+	static constexpr std::byte zero_padding[256]{};
+
+	/* "padlen" includes the "Pad Length" field */
+	const std::byte pad_length{static_cast<uint8_t>(frame.padlen > 0 ? frame.padlen - 1 : 0)};
+
+	StaticVector<struct iovec, 4> v;
+	v.push_back(MakeIovec(header));
+	if (frame.padlen > 0)
+		v.push_back(MakeIovec(std::span{&pad_length, 1}));
+	v.push_back(MakeIovec(source.GetNoCopyData(length)));
+	if (frame.padlen > 1)
+		v.push_back(MakeIovec(std::span{zero_padding}.first(frame.padlen - 1)));
+
+	auto nbytes = socket.WriteV(v);
+	if (nbytes < 0) {
+		if (nbytes != WRITE_BLOCKING)
+			return NGHTTP2_ERR_CALLBACK_FAILURE;
+
+		nbytes = 0;
+	}
+
+	/* libnghttp2 doesn't allow partial writes here, and
+	   returning NGHTTP2_ERR_WOULDBLOCK would make it call us
+	   again later, after the stream (and its IstreamDataSource)
+	   may have been closed; therefore, copy the rest */
+	pending.Set(v, nbytes);
+	source.ConsumeNoCopy(length);
+
+	if (!pending.empty())
+		socket.ScheduleWrite();
+
+	return 0;
+}
+
+bool
+OnSocketWrite(nghttp2_session *session, FilteredSocket &socket,
+	      PendingOutput &pending)
+{
+	switch (pending.Flush(socket)) {
+	case 0:
+		break;
+
+	case NGHTTP2_ERR_WOULDBLOCK:
+		return true;
+
+	default:
+		throw MakeError(NGHTTP2_ERR_CALLBACK_FAILURE, "Send failed");
+	}
+
 	const auto rv = nghttp2_session_send(session);
 	if (rv != 0)
 		throw MakeError(rv, "nghttp2_session_send() failed");
 
-	if (!nghttp2_session_want_write(session))
+	if (pending.empty() && !nghttp2_session_want_write(session))
 		socket.UnscheduleWrite();
 
 	return true;
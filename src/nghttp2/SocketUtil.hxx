@@ -6,18 +6,79 @@
 
 #include "event/net/BufferedSocket.hxx"
 
+#include <cstddef>
+#include <span>
+#include <vector>
+
+struct iovec;
 struct nghttp2_session;
+struct nghttp2_data;
 class FilteredSocket;
 
 namespace NgHttp2 {
 
+class IstreamDataSource;
+
+/**
+ * The unsent tail of a DATA frame which was written by
+ * SendDataFrame().  libnghttp2 assumes that the whole frame has been
+ * sent, so this must be flushed before anything else goes to the
+ * socket.
+ */
+class PendingOutput {
+	std::vector<std::byte> buffer;
+	std::size_t position = 0;
+
+public:
+	bool empty() const noexcept {
+		return position == buffer.size();
+	}
+
+	/**
+	 * Copy everything after the first #skip bytes of the given
+	 * vector.
+	 */
+	void Set(std::span<const struct iovec> v, std::size_t skip) noexcept;
+
+	/**
+	 * Attempt to write the pending data to the socket.
+	 *
+	 * @return 0 if everything has been written,
+	 * NGHTTP2_ERR_WOULDBLOCK if some data is still pending or
+	 * NGHTTP2_ERR_CALLBACK_FAILURE on error
+	 */
+	int Flush(FilteredSocket &socket) noexcept;
+};
+
 BufferedResult
 ReceiveFromSocketBuffer(nghttp2_session *session, FilteredSocket &socket);
 
 ssize_t
-SendToBuffer(FilteredSocket &socket, std::span<const std::byte> src) noexcept;
+SendToBuffer(FilteredSocket &socket, PendingOutput &pending,
+	     std::span<const std::byte> src) noexcept;
+
+/**
+ * May an #IstreamDataSource use NGHTTP2_DATA_FLAG_NO_COPY, i.e. can
+ * SendDataFrame() write to the socket right now?
+ */
+[[gnu::pure]]
+bool
+CanSendNoCopy(const FilteredSocket &socket,
+	      const PendingOutput &pending) noexcept;
+
+/**
+ * Implementation of nghttp2_send_data_callback: write the frame
+ * header and the payload from the #IstreamDataSource buffer with one
+ * writev() call.  If the socket doesn't accept everything, the rest
+ * is copied to #pending.
+ */
+int
+SendDataFrame(FilteredSocket &socket, PendingOutput &pending,
+	      std::span<const std::byte> header, const nghttp2_data &frame,
+	      std::size_t length, IstreamDataSource &source) noexcept;
 
 bool
-OnSocketWrite(nghttp2_session *session, FilteredSocket &socket);
+OnSocketWrite(nghttp2_session *session, FilteredSocket &socket,
+	      PendingOutput &pending);
 
 } // namespace NgHttp2
@@ -4,9 +4,12 @@
 
 #include "XmlParser.hxx"
 #include "HtmlSyntax.hxx"
+#include "XmlScan.hxx"
 #include "util/CharUtil.hxx"
 #include "util/Poison.hxx"
 
+#include <algorithm> // for std::transform()
+
 #include <string.h>
 
 XmlParser::XmlParser(struct pool &pool,
@@ -26,6 +29,18 @@ XmlParser::InvokeAttributeFinished() noexcept
 	PoisonUndefinedT(attr);
 }
 
+/**
+ * Copy a name and convert it to lower case.
+ *
+ * @return the end of the source
+ */
+static const char *
+CopyLower(char *dest, const char *src, std::size_t n) noexcept
+{
+	std::transform(src, src + n, dest, ToLowerASCII);
+	return src + n;
+}
+
 size_t
 XmlParser::Feed(const char *start, size_t length) noexcept
 {
@@ -97,13 +112,20 @@ XmlParser::Feed(const char *start, size_t length) noexcept
 			/* copy element name */
 			while (buffer < end) {
 				if (is_html_name_char(*buffer)) {
-					if (tag_name_length == sizeof(tag_name)) {
+					const std::size_t n = SkipHtmlName(buffer, end) - buffer;
+					const std::size_t room = sizeof(tag_name) - tag_name_length;
+					if (n > room) {
 						/* name buffer overflowing */
+						buffer = CopyLower(tag_name + tag_name_length,
+								   buffer, room);
+						tag_name_length = sizeof(tag_name);
 						state = State::NONE;
 						break;
 					}
 
-					tag_name[tag_name_length++] = ToLowerASCII(*buffer++);
+					buffer = CopyLower(tag_name + tag_name_length,
+							   buffer, n);
+					tag_name_length += n;
 				} else if (*buffer == '/' && tag_name_length == 0) {
 					tag.type = XmlParserTagType::CLOSE;
 					++buffer;
@@ -194,20 +216,25 @@ XmlParser::Feed(const char *start, size_t length) noexcept
 
 		case State::ATTR_NAME:
 			/* copy attribute name */
-			do {
-				if (is_html_name_char(*buffer)) {
-					if (attr_name_length == sizeof(attr_name)) {
-						/* name buffer overflowing */
-						state = State::ELEMENT_TAG;
-						break;
-					}
-
-					attr_name[attr_name_length++] = ToLowerASCII(*buffer++);
-				} else {
-					state = State::AFTER_ATTR_NAME;
+			{
+				const std::size_t n = SkipHtmlName(buffer, end) - buffer;
+				const std::size_t room = sizeof(attr_name) - attr_name_length;
+				if (n > room) {
+					/* name buffer overflowing */
+					buffer = CopyLower(attr_name + attr_name_length,
+							   buffer, room);
+					attr_name_length = sizeof(attr_name);
+					state = State::ELEMENT_TAG;
 					break;
 				}
-			} while (buffer < end);
+
+				buffer = CopyLower(attr_name + attr_name_length,
+						   buffer, n);
+				attr_name_length += n;
+
+				if (buffer < end)
+					state = State::AFTER_ATTR_NAME;
+			}
 
 			break;
 
@@ -281,22 +308,22 @@ XmlParser::Feed(const char *start, size_t length) noexcept
 
 		case State::ATTR_VALUE_COMPAT:
 			/* wait till the value is finished */
-			do {
-				if (!IsWhitespaceOrNull(*buffer) && *buffer != '>') {
-					if (!attr_value.Write({buffer, 1})) {
-						state = State::ELEMENT_TAG;
-						break;
-					}
-
-					++buffer;
-				} else {
-					attr.value_end = attr.end =
-						position + (off_t)(buffer - start);
-					InvokeAttributeFinished();
+			p = FindUnquotedValueEnd(buffer, end);
+			if (p > buffer) {
+				if (!attr_value.Write({buffer, p})) {
 					state = State::ELEMENT_TAG;
 					break;
 				}
-			} while (buffer < end);
+
+				buffer = p;
+			}
+
+			if (buffer < end) {
+				attr.value_end = attr.end =
+					position + (off_t)(buffer - start);
+				InvokeAttributeFinished();
+				state = State::ELEMENT_TAG;
+			}
 
 			break;
 
@@ -376,7 +403,6 @@ XmlParser::Feed(const char *start, size_t length) noexcept
 		case State::CDATA_SECTION:
 			/* copy CDATA section contents */
 
-			/* XXX this loop can be optimized with memchr() */
 			p = buffer;
 			while (buffer < end) {
 				if (*buffer == ']' && cdend_match < 2) {
@@ -425,7 +451,10 @@ XmlParser::Feed(const char *start, size_t length) noexcept
 						p = buffer;
 					}
 
-					++buffer;
+					/* skip to the next ']' */
+					const char *bracket = (const char *)
+						memchr(buffer + 1, ']', end - buffer - 1);
+					buffer = bracket != nullptr ? bracket : end;
 				}
 			}
 
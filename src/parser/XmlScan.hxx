@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+/*
+ * Bulk scanning functions for the XML/HTML parser.  They classify 16
+ * bytes at a time with SSE2 (which every x86-64 CPU supports) and
+ * fall back to a scalar loop on other architectures and for the
+ * tail.
+ */
+
+#pragma once
+
+#include "HtmlSyntax.hxx"
+#include "util/CharUtil.hxx"
+
+#include <bit>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __SSE2__
+
+/**
+ * Returns a mask of all bytes which are within the given (unsigned)
+ * range.
+ */
+static inline __m128i
+SimdRangeMask(__m128i x, unsigned char lo, unsigned char hi) noexcept
+{
+	const __m128i shifted = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+	return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(hi - lo)),
+			      shifted);
+}
+
+/**
+ * SIMD version of is_html_name_char().
+ */
+static inline __m128i
+SimdHtmlNameMask(__m128i x) noexcept
+{
+	/* setting bit 5 converts upper case to lower case and
+	   doesn't move any other character into 'a'..'z' */
+	const __m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+
+	return _mm_or_si128(_mm_or_si128(SimdRangeMask(lower, 'a', 'z'),
+					 /* digits and ':' */
+					 SimdRangeMask(x, '0', ':')),
+			    _mm_or_si128(SimdRangeMask(x, '-', '.'),
+					 _mm_cmpeq_epi8(x, _mm_set1_epi8('_'))));
+}
+
+/**
+ * Returns a bit mask with one bit per byte which is set if the byte
+ * does NOT match.
+ */
+static inline unsigned
+SimdMismatchBits(__m128i match) noexcept
+{
+	return ~static_cast<unsigned>(_mm_movemask_epi8(match)) & 0xffff;
+}
+
+#endif
+
+/**
+ * Returns a pointer to the first character which is not a valid
+ * HTML name character (see is_html_name_char()), or #end.
+ */
+[[gnu::pure]]
+static inline const char *
+SkipHtmlName(const char *p, const char *end) noexcept
+{
+#ifdef __SSE2__
+	while (end - p >= 16) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)p);
+		if (const unsigned bits = SimdMismatchBits(SimdHtmlNameMask(x));
+		    bits != 0)
+			return p + std::countr_zero(bits);
+
+		p += 16;
+	}
+#endif
+
+	while (p < end && is_html_name_char(*p))
+		++p;
+
+	return p;
+}
+
+/**
+ * Returns a pointer to the end of an unquoted attribute value, i.e.
+ * the first whitespace, null or '>' character, or #end.
+ */
+[[gnu::pure]]
+static inline const char *
+FindUnquotedValueEnd(const char *p, const char *end) noexcept
+{
+#ifdef __SSE2__
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i gt = _mm_set1_epi8('>');
+
+	while (end - p >= 16) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)p);
+
+		/* like IsWhitespaceOrNull(): everything up to ' ' */
+		const __m128i whitespace = _mm_cmpeq_epi8(_mm_min_epu8(x, space), x);
+		const __m128i delimiter = _mm_or_si128(whitespace,
+						       _mm_cmpeq_epi8(x, gt));
+
+		if (const unsigned bits = static_cast<unsigned>(_mm_movemask_epi8(delimiter));
+		    bits != 0)
+			return p + std::countr_zero(bits);
+
+		p += 16;
+	}
+#endif
+
+	while (p < end && !IsWhitespaceOrNull(*p) && *p != '>')
+		++p;
+
+	return p;
+}
@@ -13,43 +13,66 @@
 /**
  * A template similar to std::unique_ptr managing an instance
  * allocated from a pool.
+ *
+ * Alternatively, it may point to an object owned by somebody else
+ * (see Borrow()); such an object is not destructed and must not be
+ * modified.
  */
 template<typename T>
 class UniquePoolPtr : LeakDetector {
 	T *value = nullptr;
 
+	/**
+	 * If true, then #value is not owned by this object.
+	 */
+	bool borrowed = false;
+
+	struct BorrowTag {};
+
+	UniquePoolPtr(BorrowTag, const T &_value) noexcept
+		:value(const_cast<T *>(&_value)), borrowed(true) {}
+
 public:
 	UniquePoolPtr() = default;
 	UniquePoolPtr(std::nullptr_t) noexcept {}
 	explicit UniquePoolPtr(T *_value) noexcept:value(_value) {}
 
 	UniquePoolPtr(UniquePoolPtr &&src) noexcept
-		:value(std::exchange(src.value, nullptr)) {}
+		:value(std::exchange(src.value, nullptr)),
+		 borrowed(std::exchange(src.borrowed, false)) {}
 
 	~UniquePoolPtr() noexcept {
-		if (value != nullptr)
+		if (value != nullptr && !borrowed)
 			value->~T();
 	}
 
 	UniquePoolPtr &operator=(UniquePoolPtr &&src) noexcept {
 		using std::swap;
 		swap(value, src.value);
+		swap(borrowed, src.borrowed);
 		return *this;
 	}
 
 	UniquePoolPtr &operator=(std::nullptr_t n) noexcept {
-		if (value != nullptr)
-			value->~T();
+		reset();
 		value = n;
 		return *this;
 	}
 
 	void reset() noexcept {
 		auto *v = std::exchange(value, nullptr);
-		if (v != nullptr)
+		if (v != nullptr && !std::exchange(borrowed, false))
 			v->~T();
 	}
 
+	/**
+	 * Does this point to an object owned by somebody else (see
+	 * Borrow())?
+	 */
+	bool IsBorrowed() const noexcept {
+		return borrowed;
+	}
+
 	operator bool() const noexcept {
 		return value != nullptr;
 	}
@@ -70,4 +93,14 @@ public:
 	static UniquePoolPtr<T> Make(struct pool &p, Args&&... args) {
 		return UniquePoolPtr<T>(NewFromPool<T>(p, std::forward<Args>(args)...));
 	}
+
+	/**
+	 * Create an instance pointing to an object owned by somebody
+	 * else.  It will not be destructed by this class.  The caller
+	 * is responsible for keeping it alive, e.g. with
+	 * pool_attach_lease().
+	 */
+	static UniquePoolPtr<T> Borrow(const T &value) noexcept {
+		return UniquePoolPtr<T>(BorrowTag{}, value);
+	}
 };
@@ -9,8 +9,10 @@
 #include "memory/SlicePool.hxx"
 #include "memory/AllocatorStats.hxx"
 #include "io/Logger.hxx"
+#include "util/IntrusiveForwardList.hxx"
 #include "util/IntrusiveList.hxx"
 #include "util/Recycler.hxx"
+#include "util/SharedLease.hxx"
 #include "util/RoundPowerOfTwo.hxx"
 #include "util/Poison.hxx"
 
@@ -119,6 +121,17 @@ struct PoolRef {
 };
 #endif
 
+/**
+ * A #SharedLease attached to a pool with pool_attach_lease().  It is
+ * allocated from the pool it is attached to.
+ */
+struct PoolLease final : IntrusiveForwardListHook {
+	SharedLease lease;
+
+	explicit PoolLease(SharedLease &&_lease) noexcept
+		:lease(std::move(_lease)) {}
+};
+
 struct pool final
 	: IntrusiveListHook<IntrusiveHookMode::NORMAL>,
 	  LoggerDomainFactory {
@@ -171,6 +184,11 @@ struct pool final
 	IntrusiveList<PoolLeakDetector> leaks;
 #endif
 
+	/**
+	 * See pool_attach_lease().
+	 */
+	IntrusiveForwardList<PoolLease> leases;
+
 	SlicePool *slice_pool;
 
 	/**
@@ -760,11 +778,27 @@ pool_contains(const struct pool &pool, const void *ptr, size_t size) noexcept
 
 #endif
 
+static void
+pool_release_leases(struct pool &pool) noexcept
+{
+	while (!pool.leases.empty()) {
+		auto &l = pool.leases.front();
+		pool.leases.pop_front();
+
+		/* no p_free(): the memory is freed by pool_clear() */
+		l.~PoolLease();
+	}
+}
+
 void
 pool_clear(struct pool &pool) noexcept
 {
 	assert(pool.leaks.empty());
 
+	/* release the leases before freeing the memory which may
+	   still point to the data they protect */
+	pool_release_leases(pool);
+
 #ifdef DEBUG_POOL_ALLOC
 	pool.allocations.clear();
 #endif
@@ -968,6 +1002,15 @@ p_free(struct pool *pool, const void *cptr, size_t size) noexcept
 	pool->netto_size -= size;
 }
 
+void
+pool_attach_lease(struct pool &pool, SharedLease &&lease) noexcept
+{
+	/* dummy pools cannot allocate memory */
+	assert(pool.type != pool::Type::DUMMY);
+
+	pool.leases.push_front(*NewFromPool<PoolLease>(pool, std::move(lease)));
+}
+
 #ifndef NDEBUG
 
 void
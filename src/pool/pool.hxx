@@ -22,6 +22,7 @@ class SlicePool;
 struct AllocatorStats;
 class PoolPtr;
 class PoolLeakDetector;
+class SharedLease;
 
 void
 pool_recycler_clear() noexcept;
@@ -69,6 +70,16 @@ pool_ref(const PoolPtr &pool TRACE_ARGS_DEFAULT) noexcept;
 void
 pool_unref(const PoolPtr &pool TRACE_ARGS_DEFAULT) noexcept;
 
+/**
+ * Keep the given #SharedLease until this pool gets cleared or
+ * destroyed.  This allows objects allocated from this pool to point
+ * to data owned by somebody else (e.g. a cache item) instead of
+ * copying it.  The lease is allocated from the pool, which therefore
+ * must not be a dummy pool.
+ */
+void
+pool_attach_lease(struct pool &pool, SharedLease &&lease) noexcept;
+
 /**
  * Returns the total size of all allocations in this pool.
  */
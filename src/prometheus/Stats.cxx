@@ -35,11 +35,15 @@ beng_proxy_cache_skips{{process={:?},type={:?}}} {}
 beng_proxy_cache_misses{{process={:?},type={:?}}} {}
 beng_proxy_cache_stores{{process={:?},type={:?}}} {}
 beng_proxy_cache_hits{{process={:?},type={:?}}} {}
+beng_proxy_cache_holes{{process={:?},type={:?}}} {}
+beng_proxy_cache_largest_hole{{process={:?},type={:?}}} {}
 )",
 		   process, type, stats.skips,
 		   process, type, stats.misses,
 		   process, type, stats.stores,
-		   process, type, stats.hits);
+		   process, type, stats.hits,
+		   process, type, stats.holes,
+		   process, type, stats.largest_hole);
 }
 
 void
@@ -51,6 +55,12 @@ Write(GrowingBuffer &buffer, std::string_view process,
 # HELP beng_proxy_connections Number of connections
 # TYPE beng_proxy_connections gauge
 
+# HELP beng_proxy_idle_connections Number of idle outgoing connections
+# TYPE beng_proxy_idle_connections gauge
+
+# HELP beng_proxy_prewarmed_connections Number of outgoing connections established in advance
+# TYPE beng_proxy_prewarmed_connections counter
+
 # HELP beng_proxy_sessions Number of sessions
 # TYPE beng_proxy_sessions gauge
 
@@ -69,15 +79,25 @@ Write(GrowingBuffer &buffer, std::string_view process,
 # HELP beng_proxy_cache_hits Number of cache hits
 # TYPE beng_proxy_cache_hits counter
 
+# HELP beng_proxy_cache_holes Number of unused gaps in the cache memory
+# TYPE beng_proxy_cache_holes gauge
+
+# HELP beng_proxy_cache_largest_hole Size of the largest unused gap in the cache memory in bytes
+# TYPE beng_proxy_cache_largest_hole gauge
+
 # HELP beng_proxy_buffer_size Size of buffers in bytes
 # TYPE beng_proxy_buffer_size gauge
 
 beng_proxy_connections{{process={:?},direction="in"}} {}
 beng_proxy_connections{{process={:?},direction="out"}} {}
+beng_proxy_idle_connections{{process={:?}}} {}
+beng_proxy_prewarmed_connections{{process={:?}}} {}
 beng_proxy_sessions{{process={:?}}} {}
 )",
 	       process, stats.incoming_connections,
 	       process, stats.outgoing_connections,
+	       process, stats.idle_outgoing_connections,
+	       process, stats.prewarmed_connections,
 	       process, stats.sessions);
 
 	Write(buffer, process, "translation"sv, stats.translation_cache);
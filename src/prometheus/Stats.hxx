@@ -26,6 +26,17 @@ struct Stats {
 	 */
 	uint_least32_t outgoing_connections;
 
+	/**
+	 * How many of the #outgoing_connections are idle?
+	 */
+	uint_least32_t idle_outgoing_connections;
+
+	/**
+	 * Total number of outgoing connections which were
+	 * established in advance ("prewarming").
+	 */
+	uint_least64_t prewarmed_connections;
+
 	/**
 	 * Number of sessions.
 	 */
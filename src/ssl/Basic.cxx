@@ -128,4 +128,21 @@ ApplyServerConfig(SSL_CTX &ssl_ctx, const SslConfig &config)
 
 		SSL_CTX_set_verify(&ssl_ctx, mode, verify_callback);
 	}
+
+	if (config.ktls)
+		/* note that this requires session tickets to be
+		   disabled (see SetupBasicSslCtx()), because they
+		   would be sent after the handshake, when the kernel
+		   has already taken over */
+		EnableKtls(ssl_ctx);
+}
+
+void
+EnableKtls(SSL_CTX &ssl_ctx) noexcept
+{
+#ifdef SSL_OP_ENABLE_KTLS
+	SSL_CTX_set_options(&ssl_ctx, SSL_OP_ENABLE_KTLS);
+#else
+	(void)ssl_ctx;
+#endif
 }
@@ -18,3 +18,10 @@ CreateBasicSslCtx(bool server);
 
 void
 ApplyServerConfig(SSL_CTX &ssl_ctx, const SslConfig &config);
+
+/**
+ * Set #SSL_OP_ENABLE_KTLS, which makes #SslFilter hand over
+ * encryption to the kernel after the handshake (if possible).
+ */
+void
+EnableKtls(SSL_CTX &ssl_ctx) noexcept;
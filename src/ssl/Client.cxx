@@ -132,6 +132,9 @@ SslClientFactory::SslClientFactory(const SslClientConfig &config)
 		certs = std::make_unique<SslClientCerts>(config.cert_key);
 		SSL_CTX_set_client_cert_cb(ctx.get(), ClientCertCallback);
 	}
+
+	if (config.ktls)
+		EnableKtls(*ctx);
 }
 
 SslClientFactory::~SslClientFactory() noexcept = default;
@@ -34,6 +34,12 @@ struct SslConfig {
 	std::string ca_cert_file;
 
 	SslVerify verify = SslVerify::NO;
+
+	/**
+	 * Hand over encryption to the kernel (kTLS) after the
+	 * handshake?
+	 */
+	bool ktls = false;
 };
 
 struct NamedSslCertKeyConfig : SslCertKeyConfig {
@@ -48,6 +54,11 @@ struct NamedSslCertKeyConfig : SslCertKeyConfig {
 
 struct SslClientConfig {
 	std::vector<NamedSslCertKeyConfig> cert_key;
+
+	/**
+	 * @see SslConfig::ktls
+	 */
+	bool ktls = false;
 };
 
 #endif
@@ -3,6 +3,7 @@
 // author: Max Kellermann <mk@cm4all.com>
 
 #include "FifoBufferBio.hxx"
+#include "Ktls.hxx"
 #include "util/ForeignFifoBuffer.hxx"
 
 #include <openssl/bio.h>
@@ -14,6 +15,8 @@
 
 struct FifoBufferBio {
 	ForeignFifoBuffer<std::byte> &buffer;
+
+	KtlsCryptoInfo *const ktls;
 };
 
 static int
@@ -108,6 +111,19 @@ fb_ctrl(BIO *b, int cmd, [[maybe_unused]] long num,
 	case BIO_CTRL_FLUSH:
 		return 1;
 
+#ifdef BIO_CTRL_SET_KTLS
+	case BIO_CTRL_SET_KTLS:
+		/* OpenSSL wants to enable kTLS; capture the
+		   transmitter parameters, but return 0, because this
+		   BIO cannot take plain data; OpenSSL will continue
+		   to encrypt in userspace until the caller hands
+		   over the socket to the kernel (and stops using
+		   SSL_write()) */
+		if (fb.ktls != nullptr && num != 0 && !fb.ktls->IsDefined())
+			fb.ktls->Set(ptr);
+		return 0;
+#endif
+
 	default:
 		return 0;
 	}
@@ -150,13 +166,14 @@ InitFifoBufferBio() noexcept
 }
 
 BIO *
-NewFifoBufferBio(ForeignFifoBuffer<std::byte> &buffer) noexcept
+NewFifoBufferBio(ForeignFifoBuffer<std::byte> &buffer,
+		 KtlsCryptoInfo *ktls) noexcept
 {
 	if (fb_method == nullptr)
 		InitFifoBufferBio();
 
 	BIO *b = BIO_new(fb_method);
-	BIO_set_data(b, new FifoBufferBio{buffer});
+	BIO_set_data(b, new FifoBufferBio{buffer, ktls});
 	return b;
 }
 
@@ -8,12 +8,18 @@
 
 typedef struct bio_st BIO;
 template<typename T> class ForeignFifoBuffer;
+struct KtlsCryptoInfo;
 
 /**
  * Create an OpenSSL BIO wrapper for a #ForeignFifoBuffer.
+ *
+ * @param ktls if not nullptr, then the kernel TLS transmitter
+ * parameters offered by OpenSSL (with #SSL_OP_ENABLE_KTLS) are
+ * copied here
  */
 BIO *
-NewFifoBufferBio(ForeignFifoBuffer<std::byte> &buffer) noexcept;
+NewFifoBufferBio(ForeignFifoBuffer<std::byte> &buffer,
+		 KtlsCryptoInfo *ktls=nullptr) noexcept;
 
 /**
  * Global deinitialization.
@@ -4,13 +4,16 @@
 
 #include "Filter.hxx"
 #include "CompletionHandler.hxx"
+#include "Ktls.hxx"
 #include "lib/openssl/Error.hxx"
 #include "lib/openssl/Name.hxx"
 #include "lib/openssl/UniqueX509.hxx"
 #include "FifoBufferBio.hxx"
 #include "fs/ThreadSocketFilter.hxx"
+#include "io/Logger.hxx"
 #include "memory/fb_pool.hxx"
 #include "memory/SliceFifoBuffer.hxx"
+#include "net/SocketDescriptor.hxx"
 #include "util/AllocatedArray.hxx"
 #include "util/AllocatedString.hxx"
 
@@ -32,6 +35,20 @@ class SslFilter final : public ThreadSocketFilterHandler,
 
 	const UniqueSSL ssl;
 
+	/**
+	 * The kernel TLS transmitter parameters captured by the
+	 * #encrypted_output BIO.  After the handshake, they are
+	 * passed to the kernel in OffloadOutput().
+	 */
+	KtlsCryptoInfo ktls;
+
+	/**
+	 * Was #SSL_OP_ENABLE_KTLS set?  If yes, then #plain_output
+	 * is not consumed until we know whether the kernel takes
+	 * over.
+	 */
+	const bool want_ktls;
+
 	bool handshaking = true;
 
 	AllocatedArray<unsigned char> alpn_selected;
@@ -40,10 +57,12 @@ public:
 	AllocatedString peer_subject, peer_issuer_subject;
 
 	SslFilter(UniqueSSL &&_ssl)
-		:ssl(std::move(_ssl)) {
+		:ssl(std::move(_ssl)),
+		 want_ktls(IsKtlsEnabled(*ssl)) {
 		SSL_set_bio(ssl.get(),
 			    NewFifoBufferBio(encrypted_input),
-			    NewFifoBufferBio(encrypted_output));
+			    NewFifoBufferBio(encrypted_output,
+					     want_ktls ? &ktls : nullptr));
 
 		SetSslCompletionHandler(*ssl, *this);
 	}
@@ -53,6 +72,26 @@ public:
 	}
 
 private:
+	[[gnu::pure]]
+	static bool IsKtlsEnabled(const SSL &ssl) noexcept {
+#ifdef SSL_OP_ENABLE_KTLS
+		return (SSL_get_options(&ssl) & SSL_OP_ENABLE_KTLS) != 0;
+#else
+		(void)ssl;
+		return false;
+#endif
+	}
+
+	/**
+	 * May #plain_output be encrypted by OpenSSL?  Not while the
+	 * kernel may still take over, and not after it did.
+	 */
+	[[gnu::pure]]
+	bool CanEncrypt(const ThreadSocketFilterInternal &f) const noexcept {
+		return !f.output_offload_ready && !f.output_offloaded &&
+			!(handshaking && want_ktls);
+	}
+
 	/**
 	 * Called from inside Run() right after the handshake has
 	 * completed.  This is used to collect some data for our
@@ -67,6 +106,7 @@ private:
 	void Run(ThreadSocketFilterInternal &f) override;
 	void PostRun(ThreadSocketFilterInternal &f) noexcept override;
 	void CancelRun(ThreadSocketFilterInternal &f) noexcept override;
+	bool OffloadOutput(SocketDescriptor s) noexcept override;
 
 	/* virtual methods from class SslCompletionHandler */
 	void OnSslCompletion() noexcept override {
@@ -229,7 +269,7 @@ SslFilter::Run(ThreadSocketFilterInternal &f)
 {
 	/* copy input (and output to make room for more output) */
 
-	bool shutting_down;
+	bool shutting_down, output_offloaded;
 
 	{
 		const std::scoped_lock lock{f.mutex};
@@ -242,7 +282,8 @@ SslFilter::Run(ThreadSocketFilterInternal &f)
 
 		f.decrypted_input.MoveFromAllowNull(decrypted_input);
 
-		plain_output.MoveFromAllowNull(f.plain_output);
+		if (CanEncrypt(f))
+			plain_output.MoveFromAllowNull(f.plain_output);
 		encrypted_input.MoveFromAllowSrcNull(f.encrypted_input);
 
 		f.encrypted_output.MoveFromAllowNull(encrypted_output);
@@ -256,17 +297,27 @@ SslFilter::Run(ThreadSocketFilterInternal &f)
 		}
 
 		shutting_down = f.shutting_down && f.plain_output.empty();
+		output_offloaded = f.output_offloaded;
 	}
 
 	/* let OpenSSL work */
 
 	ERR_clear_error();
 
+	bool offload_ready = false;
+
 	if (handshaking) [[unlikely]] {
 		int result = SSL_do_handshake(ssl.get());
 		if (result == 1) {
 			handshaking = false;
 			PostHandshake();
+
+			/* if OpenSSL has offered kTLS parameters,
+			   nothing may be encrypted anymore; the main
+			   thread will hand over the socket to the
+			   kernel as soon as the handshake has been
+			   flushed */
+			offload_ready = ktls.IsDefined();
 		} else if (const int error = SSL_get_error(ssl.get(), result);
 			   IsSslError(error)) {
 			{
@@ -302,14 +353,25 @@ SslFilter::Run(ThreadSocketFilterInternal &f)
 		}
 	}
 
-	if (shutting_down && plain_output.empty())
+	if (shutting_down && plain_output.empty() && !output_offloaded)
+		/* (with kTLS, there is no "close notify"; OpenSSL
+		   would encrypt it with a stale sequence number) */
 		ssl_shutdown(*ssl);
 
+	if (output_offloaded)
+		/* anything OpenSSL has generated now (e.g. a
+		   KeyUpdate reply) cannot be sent anymore, because the
+		   kernel owns the record sequence */
+		encrypted_output.Clear();
+
 	/* copy output */
 
 	{
 		const std::scoped_lock lock{f.mutex};
 
+		if (offload_ready)
+			f.output_offload_ready = true;
+
 		f.decrypted_input.MoveFromAllowNull(decrypted_input);
 		f.encrypted_output.MoveFromAllowNull(encrypted_output);
 		f.drained = plain_output.empty() && encrypted_output.empty();
@@ -320,7 +382,8 @@ SslFilter::Run(ThreadSocketFilterInternal &f)
 			   so let's run again */
 			f.again = true;
 
-		if (!f.plain_output.empty() && !plain_output.IsDefinedAndFull() &&
+		if (!f.plain_output.empty() && CanEncrypt(f) &&
+		    !plain_output.IsDefinedAndFull() &&
 		    !encrypted_output.IsDefinedAndFull())
 			/* there's more data, and we're ready to handle it: try
 			   again */
@@ -348,6 +411,27 @@ SslFilter::CancelRun(ThreadSocketFilterInternal &) noexcept
 	SslCompletionHandler::CheckCancel();
 }
 
+bool
+SslFilter::OffloadOutput(SocketDescriptor s) noexcept
+{
+	assert(ktls.IsDefined());
+
+	bool success = true;
+
+	try {
+		ktls.Apply(s);
+	} catch (...) {
+		/* the kernel may lack kTLS support or the cipher;
+		   OpenSSL still has a valid state, so we can simply
+		   continue to encrypt in userspace */
+		LogConcat(3, "ssl", "Failed to enable kTLS: ",
+			  std::current_exception());
+		success = false;
+	}
+
+	return success;
+}
+
 /*
  * constructor
  *
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "Ktls.hxx"
+#include "net/SocketDescriptor.hxx"
+#include "net/SocketError.hxx"
+
+#include <cstring> // for std::memcpy()
+
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+[[gnu::pure]]
+static std::size_t
+GetCryptoInfoSize(unsigned cipher_type) noexcept
+{
+	switch (cipher_type) {
+	case TLS_CIPHER_AES_GCM_128:
+		return sizeof(tls12_crypto_info_aes_gcm_128);
+
+	case TLS_CIPHER_AES_GCM_256:
+		return sizeof(tls12_crypto_info_aes_gcm_256);
+
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+	case TLS_CIPHER_CHACHA20_POLY1305:
+		return sizeof(tls12_crypto_info_chacha20_poly1305);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+bool
+KtlsCryptoInfo::Set(const void *src) noexcept
+{
+	struct tls_crypto_info header;
+	std::memcpy(&header, src, sizeof(header));
+
+	if (header.version != TLS_1_3_VERSION)
+		return false;
+
+	const std::size_t _size = GetCryptoInfoSize(header.cipher_type);
+	if (_size == 0)
+		return false;
+
+	std::memcpy(&info, src, _size);
+	size = _size;
+	return true;
+}
+
+void
+KtlsCryptoInfo::Apply(SocketDescriptor s) const
+{
+	static constexpr char ulp[] = "tls";
+	if (!s.SetOption(SOL_TCP, TCP_ULP, ulp, sizeof(ulp)))
+		throw MakeSocketError("Failed to set TCP_ULP");
+
+	if (!s.SetOption(SOL_TLS, TLS_TX, &info, size))
+		throw MakeSocketError("Failed to set TLS_TX");
+}
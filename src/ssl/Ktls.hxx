@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+/*
+ * Kernel TLS (kTLS) support.
+ */
+
+#pragma once
+
+#include <linux/tls.h>
+
+#include <cstddef>
+
+class SocketDescriptor;
+
+/**
+ * The parameters for the Linux kernel TLS transmitter, captured from
+ * OpenSSL's attempt to enable kTLS on a BIO (BIO_CTRL_SET_KTLS).
+ */
+struct KtlsCryptoInfo {
+	union {
+		struct tls_crypto_info info;
+		struct tls12_crypto_info_aes_gcm_128 aes_gcm_128;
+		struct tls12_crypto_info_aes_gcm_256 aes_gcm_256;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+		struct tls12_crypto_info_chacha20_poly1305 chacha20_poly1305;
+#endif
+	};
+
+	/**
+	 * The size of the actual structure within the union; zero
+	 * if nothing has been captured yet.
+	 */
+	std::size_t size = 0;
+
+	bool IsDefined() const noexcept {
+		return size > 0;
+	}
+
+	/**
+	 * Copy the parameters from the structure passed by OpenSSL
+	 * (which begins with a struct tls_crypto_info, followed by
+	 * the cipher specific fields).  Only TLS 1.3 is supported,
+	 * because with TLS 1.2, OpenSSL has already encrypted the
+	 * "Finished" message with the new key at this point.
+	 *
+	 * @return false if the parameters are not supported
+	 */
+	bool Set(const void *src) noexcept;
+
+	/**
+	 * Enable the "tls" upper layer protocol on the given TCP
+	 * socket and configure the transmitter.  All data written
+	 * to the socket after this call will be encrypted by the
+	 * kernel.
+	 *
+	 * Throws on error.
+	 */
+	void Apply(SocketDescriptor s) const;
+};
@@ -6,6 +6,7 @@
 
 #include "memory/AllocatorStats.hxx"
 
+#include <algorithm> // for std::max()
 #include <cstdint>
 
 struct CacheStats {
@@ -13,8 +14,16 @@ struct CacheStats {
 
 	uint_least64_t skips, misses, stores, hits;
 
+	/**
+	 * Fragmentation of the #Rubber allocator (if any): the number
+	 * of holes and the size of the largest one.
+	 */
+	uint_least64_t holes = 0, largest_hole = 0;
+
 	constexpr CacheStats &operator+=(const CacheStats &other) noexcept {
 		allocator += other.allocator;
+		holes += other.holes;
+		largest_hole = std::max(largest_hole, other.largest_hole);
 		skips += other.skips;
 		misses += other.misses;
 		stores += other.stores;
@@ -50,9 +50,11 @@ TranslationStockBuilder::Get(SocketAddress address,
 
 TranslationCacheBuilder::TranslationCacheBuilder(TranslationStockBuilder &_builder,
 						 struct pool &_pool,
-						 unsigned _max_size) noexcept
+						 unsigned _max_size,
+						 InotifyManager *_inotify_manager) noexcept
 	:builder(_builder),
-	 pool(_pool), max_size(_max_size)
+	 pool(_pool), max_size(_max_size),
+	 inotify_manager(_inotify_manager)
 {
 }
 
@@ -102,7 +104,7 @@ TranslationCacheBuilder::Get(SocketAddress address,
 			(pool, event_loop,
 			 // TODO: refactor to std::shared_ptr?
 			 *builder.Get(address, event_loop),
-			 max_size, false);
+			 max_size, inotify_manager, false);
 
 	return e.first->second;
 }
@@ -11,6 +11,7 @@
 
 struct CacheStats;
 class EventLoop;
+class InotifyManager;
 class SocketAddress;
 class TranslationGlue;
 class TranslationCache;
@@ -49,13 +50,19 @@ class TranslationCacheBuilder final : public TranslationServiceBuilder {
 
 	const unsigned max_size;
 
+	InotifyManager *const inotify_manager;
+
 	std::map<SocketAddress, std::shared_ptr<TranslationCache>,
 		 SocketAddressCompare> m;
 
 public:
+	/**
+	 * @param _inotify_manager see #TranslationCache
+	 */
 	TranslationCacheBuilder(TranslationStockBuilder &_builder,
 				struct pool &_pool,
-				unsigned _max_size) noexcept;
+				unsigned _max_size,
+				InotifyManager *_inotify_manager=nullptr) noexcept;
 	~TranslationCacheBuilder() noexcept;
 
 	void ForkCow(bool inherit) noexcept;
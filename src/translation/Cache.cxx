@@ -28,6 +28,9 @@
 #include "lib/fmt/Unsafe.hxx"
 #include "lib/pcre/UniqueRegex.hxx"
 #include "io/Logger.hxx"
+#include "event/InotifyManager.hxx"
+#include "stopwatch.hxx"
+#include "util/Cancellable.hxx"
 #include "util/djb_hash.hxx"
 #include "util/IntrusiveHashSet.hxx"
 #include "util/IntrusiveList.hxx"
@@ -35,11 +38,13 @@
 #include "util/StringSplit.hxx"
 
 #include <cassert>
+#include <string>
 
 #include <time.h>
 #include <string.h>
 #include <stdlib.h>
 #include <fcntl.h> // for AT_*
+#include <sys/inotify.h>
 #include <sys/stat.h>
 #include <errno.h>
 
@@ -56,9 +61,24 @@ static constexpr std::size_t MAX_FILE_NOT_FOUND = 256;
 static constexpr std::size_t MAX_DIRECTORY_INDEX = 256;
 static constexpr std::size_t MAX_READ_FILE = 256;
 
+struct TranslateCacheStamp;
+struct TranslateCacheDirectory;
+
 struct TranslateCacheItem final : PoolHolder, CacheItem {
 	IntrusiveHashSetHook<IntrusiveHookMode::AUTO_UNLINK> per_host_siblings, per_site_siblings;
 
+	/**
+	 * Hook for TranslateCacheStamp::items.
+	 */
+	IntrusiveListHook<IntrusiveHookMode::NORMAL> stamp_siblings;
+
+	/**
+	 * If this is set, then the VALIDATE_MTIME file is being
+	 * watched with inotify, and Validate() does not need to call
+	 * statx().
+	 */
+	TranslateCacheStamp *stamp = nullptr;
+
 	struct {
 		const char *param;
 		std::span<const std::byte> session;
@@ -142,6 +162,14 @@ struct TranslateCacheItem final : PoolHolder, CacheItem {
 			InvalidateMatch(vary, other_request);
 	}
 
+	/**
+	 * Obtain a lease which keeps this item alive.  This does not
+	 * modify the cached data, only the reference counter.
+	 */
+	SharedLease Lease() const noexcept {
+		return SharedLease{const_cast<TranslateCacheItem &>(*this)};
+	}
+
 	/* virtual methods from class CacheItem */
 	bool Validate() const noexcept override;
 	void Destroy() noexcept override;
@@ -172,6 +200,302 @@ struct TranslateCacheItem final : PoolHolder, CacheItem {
 	};
 };
 
+/**
+ * An inotify watch on a VALIDATE_MTIME file, shared by all
+ * #TranslateCacheItem instances referring to it.  As long as the
+ * watch (and the one on its #TranslateCacheDirectory) is registered,
+ * the file is known to be unmodified, and
+ * TranslateCacheItem::Validate() does not need to call statx().  As
+ * soon as the kernel reports a modification, all items are removed
+ * from the cache.
+ */
+struct TranslateCacheStamp final : InotifyWatch {
+	IntrusiveHashSetHook<IntrusiveHookMode::AUTO_UNLINK> set_hook;
+
+	/**
+	 * Hook for TranslateCacheDirectory::stamps.
+	 */
+	IntrusiveListHook<IntrusiveHookMode::NORMAL> directory_siblings;
+
+	struct tcache &tcache;
+
+	const std::string path;
+
+	/**
+	 * The watch on the parent directory.
+	 */
+	TranslateCacheDirectory *directory = nullptr;
+
+	IntrusiveList<TranslateCacheItem,
+		      IntrusiveListMemberHookTraits<&TranslateCacheItem::stamp_siblings>> items;
+
+	/**
+	 * Is the file itself being watched?  If false, then the file
+	 * did not exist, and only the directory is watched.
+	 */
+	const bool watch_file;
+
+	TranslateCacheStamp(struct tcache &_tcache, InotifyManager &manager,
+			    const char *_path, bool _watch_file) noexcept
+		:InotifyWatch(manager), tcache(_tcache), path(_path),
+		 watch_file(_watch_file) {}
+
+	~TranslateCacheStamp() noexcept;
+
+	TranslateCacheStamp(const TranslateCacheStamp &) = delete;
+
+	/**
+	 * Returns the last segment of the path, i.e. the name of the
+	 * directory entry.
+	 */
+	[[gnu::pure]]
+	std::string_view GetName() const noexcept {
+		return std::string_view{path}.substr(path.rfind('/') + 1);
+	}
+
+	void AddItem(TranslateCacheItem &item) noexcept {
+		assert(item.stamp == nullptr);
+
+		items.push_back(item);
+		item.stamp = this;
+	}
+
+	/**
+	 * Remove an item from this stamp.  If it was the last one,
+	 * this object is deleted.
+	 */
+	void RemoveItem(TranslateCacheItem &item) noexcept {
+		assert(item.stamp == this);
+
+		items.erase(items.iterator_to(item));
+		item.stamp = nullptr;
+
+		if (items.empty())
+			delete this;
+	}
+
+	/**
+	 * Are all watches still registered, i.e. has the file not
+	 * been modified?
+	 */
+	[[gnu::pure]]
+	bool IsValid() const noexcept;
+
+	/**
+	 * The file has been modified or replaced: remove all items
+	 * from the cache and delete this object.
+	 */
+	void Invalidate() noexcept;
+
+	struct GetPath {
+		[[gnu::pure]]
+		std::string_view operator()(const TranslateCacheStamp &stamp) const noexcept {
+			return stamp.path;
+		}
+	};
+
+protected:
+	/* virtual methods from class InotifyWatch */
+	void OnInotify(unsigned mask, const char *name) noexcept override;
+};
+
+/**
+ * An inotify watch on the parent directory of VALIDATE_MTIME files,
+ * shared by all #TranslateCacheStamp instances in that directory.
+ * The watch on the file's inode does not notice when another file is
+ * renamed over it (e.g. by an atomic "write to temporary file and
+ * rename" update); this one does.  Renaming or replacing a directory
+ * further up the path is not detected.
+ */
+struct TranslateCacheDirectory final : InotifyWatch {
+	IntrusiveHashSetHook<IntrusiveHookMode::AUTO_UNLINK> set_hook;
+
+	const std::string path;
+
+	IntrusiveList<TranslateCacheStamp,
+		      IntrusiveListMemberHookTraits<&TranslateCacheStamp::directory_siblings>> stamps;
+
+	TranslateCacheDirectory(InotifyManager &manager,
+				std::string_view _path) noexcept
+		:InotifyWatch(manager), path(_path) {}
+
+	TranslateCacheDirectory(const TranslateCacheDirectory &) = delete;
+
+	void AddStamp(TranslateCacheStamp &stamp) noexcept {
+		assert(stamp.directory == nullptr);
+
+		stamps.push_back(stamp);
+		stamp.directory = this;
+	}
+
+	/**
+	 * Remove a stamp from this directory.  If it was the last
+	 * one, this object is deleted.
+	 */
+	void RemoveStamp(TranslateCacheStamp &stamp) noexcept {
+		assert(stamp.directory == this);
+
+		stamps.erase(stamps.iterator_to(stamp));
+		stamp.directory = nullptr;
+
+		if (stamps.empty())
+			delete this;
+	}
+
+	struct GetPath {
+		[[gnu::pure]]
+		std::string_view operator()(const TranslateCacheDirectory &directory) const noexcept {
+			return directory.path;
+		}
+	};
+
+protected:
+	/* virtual methods from class InotifyWatch */
+	void OnInotify(unsigned mask, const char *name) noexcept override;
+};
+
+struct TranslateCacheRequest;
+
+/**
+ * A request which has the same cache key as a pending
+ * #TranslateCacheRequest.  Instead of querying the translation server
+ * again, it waits for the pending request to complete and then
+ * repeats the cache lookup.
+ */
+struct TranslateCacheWaiter final
+	: IntrusiveListHook<IntrusiveHookMode::NORMAL>, Cancellable
+{
+	const AllocatorPtr alloc;
+
+	const TranslateRequest &request;
+
+	const StringWithHash key;
+
+	TranslateHandler &handler;
+
+	CancellablePointer &cancel_ptr;
+
+	TranslateCacheWaiter(AllocatorPtr _alloc,
+			     const TranslateRequest &_request, StringWithHash _key,
+			     TranslateHandler &_handler,
+			     CancellablePointer &_cancel_ptr) noexcept
+		:alloc(_alloc), request(_request), key(_key),
+		 handler(_handler), cancel_ptr(_cancel_ptr)
+	{
+		cancel_ptr = *this;
+	}
+
+	TranslateCacheWaiter(const TranslateCacheWaiter &) = delete;
+
+	void Destroy() noexcept {
+		this->~TranslateCacheWaiter();
+	}
+
+	/**
+	 * The pending request has received a response (which may
+	 * have been stored in the cache).  Look up the cache again and
+	 * query the translation server if there was no matching item.
+	 */
+	void OnLeaderResponse(struct tcache &tcache) noexcept;
+
+	/**
+	 * Destroy this object and send a request to the next
+	 * #TranslationService.
+	 *
+	 * @param coalesce if true, then this request may become the
+	 * new pending request others wait for, or wait for another
+	 * pending request
+	 */
+	void Dispatch(struct tcache &tcache, bool coalesce) noexcept;
+
+	void OnLeaderError(std::exception_ptr error) noexcept;
+
+	/* virtual methods from class Cancellable */
+	void Cancel() noexcept override;
+};
+
+struct TranslateCacheRequest final : TranslateHandler, Cancellable {
+	/**
+	 * Hook for tcache::pending.  Only linked while this request
+	 * is in flight and other requests may wait for it.
+	 */
+	IntrusiveHashSetHook<IntrusiveHookMode::AUTO_UNLINK> pending_hook;
+
+	const AllocatorPtr alloc;
+
+	struct tcache *tcache;
+
+	const TranslateRequest &request;
+
+	const bool cacheable;
+
+	/** are we looking for a "BASE" cache entry? */
+	const bool find_base;
+
+	const StringWithHash key;
+
+	TranslateHandler *handler;
+
+	/**
+	 * Requests with the same cache key which wait for this one to
+	 * complete.
+	 */
+	IntrusiveList<TranslateCacheWaiter> waiters;
+
+	/**
+	 * Cancels the request to the next #TranslationService.  Only
+	 * used if this request is registered in tcache::pending; else
+	 * the caller's #CancellablePointer is passed to the next
+	 * service directly.
+	 */
+	CancellablePointer cancel_ptr;
+
+	TranslateCacheRequest(AllocatorPtr _alloc, struct tcache &_tcache,
+			      const TranslateRequest &_request, StringWithHash _key,
+			      bool _cacheable,
+			      TranslateHandler &_handler) noexcept
+		:alloc(_alloc), tcache(&_tcache), request(_request),
+		 cacheable(_cacheable),
+		 find_base(false), key(_key),
+		 handler(&_handler) {}
+
+	TranslateCacheRequest(TranslateCacheRequest &) = delete;
+
+	bool IsPending() const noexcept {
+		return pending_hook.is_linked();
+	}
+
+	void RemovePending() noexcept {
+		if (IsPending())
+			pending_hook.unlink();
+	}
+
+	void AddWaiter(TranslateCacheWaiter &waiter) noexcept {
+		assert(IsPending());
+
+		waiters.push_back(waiter);
+	}
+
+	/**
+	 * Let all waiters repeat their cache lookup.
+	 */
+	void ResumeWaiters() noexcept;
+
+	struct GetKey {
+		[[gnu::pure]]
+		StringWithHash operator()(const TranslateCacheRequest &tcr) const noexcept {
+			return tcr.key;
+		}
+	};
+
+	/* virtual methods from TranslateHandler */
+	void OnTranslateResponse(UniquePoolPtr<TranslateResponse> response) noexcept override;
+	void OnTranslateError(std::exception_ptr error) noexcept override;
+
+	/* virtual methods from class Cancellable */
+	void Cancel() noexcept override;
+};
+
 struct tcache final : private CacheHandler {
 	const PoolPtr pool;
 	SlicePool slice_pool;
@@ -208,6 +532,54 @@ struct tcache final : private CacheHandler {
 				 IntrusiveHashSetMemberHookTraits<&TranslateCacheItem::per_site_siblings>>;
 	PerSiteSet per_site;
 
+	/**
+	 * All requests to the next #TranslationService which are
+	 * currently in flight, indexed by their cache key.  Concurrent
+	 * cache misses with the same key wait for the pending request
+	 * instead of sending another one.
+	 */
+	using PendingSet =
+		IntrusiveHashSet<TranslateCacheRequest, 4096,
+				 IntrusiveHashSetOperators<TranslateCacheRequest,
+							   TranslateCacheRequest::GetKey,
+							   std::hash<StringWithHash>,
+							   std::equal_to<StringWithHash>>,
+				 IntrusiveHashSetMemberHookTraits<&TranslateCacheRequest::pending_hook>>;
+	PendingSet pending;
+
+	/**
+	 * If set, then VALIDATE_MTIME files are watched with inotify
+	 * instead of calling statx() on each cache hit.
+	 */
+	InotifyManager *const inotify_manager;
+
+	/**
+	 * Maps the parent directories of VALIDATE_MTIME paths to
+	 * #TranslateCacheDirectory instances.  Only used if
+	 * #inotify_manager is set.
+	 */
+	using DirectorySet =
+		IntrusiveHashSet<TranslateCacheDirectory, 256,
+				 IntrusiveHashSetOperators<TranslateCacheDirectory,
+							   TranslateCacheDirectory::GetPath,
+							   TranslateCacheItem::StringViewHash,
+							   std::equal_to<std::string_view>>,
+				 IntrusiveHashSetMemberHookTraits<&TranslateCacheDirectory::set_hook>>;
+	DirectorySet directories;
+
+	/**
+	 * Maps VALIDATE_MTIME paths to #TranslateCacheStamp instances.
+	 * Only used if #inotify_manager is set.
+	 */
+	using StampSet =
+		IntrusiveHashSet<TranslateCacheStamp, 1024,
+				 IntrusiveHashSetOperators<TranslateCacheStamp,
+							   TranslateCacheStamp::GetPath,
+							   TranslateCacheItem::StringViewHash,
+							   std::equal_to<std::string_view>>,
+				 IntrusiveHashSetMemberHookTraits<&TranslateCacheStamp::set_hook>>;
+	StampSet stamps;
+
 	Cache cache;
 
 	CacheStats stats{};
@@ -223,6 +595,7 @@ struct tcache final : private CacheHandler {
 
 	tcache(struct pool &_pool, EventLoop &event_loop,
 	       TranslationService &_next, unsigned max_size,
+	       InotifyManager *_inotify_manager,
 	       bool handshake_cacheable);
 	tcache(struct tcache &) = delete;
 
@@ -239,7 +612,30 @@ struct tcache final : private CacheHandler {
 			std::span<const TranslationCommand> vary,
 			const char *site) noexcept;
 
+	/**
+	 * Watch the item's VALIDATE_MTIME file with inotify (if
+	 * enabled), so future hits can skip the statx() call.
+	 */
+	void WatchValidateMtime(TranslateCacheItem &item) noexcept;
+
 private:
+	/**
+	 * Find or create a #TranslateCacheStamp for the given path.
+	 *
+	 * @param exists if false, then the file is expected to be
+	 * absent, and only its directory is watched
+	 * @return nullptr if the file cannot be watched
+	 */
+	TranslateCacheStamp *MakeStamp(const char *path, bool exists) noexcept;
+
+	/**
+	 * Find or create a #TranslateCacheDirectory for the given
+	 * path.
+	 *
+	 * @return nullptr if the directory cannot be watched
+	 */
+	TranslateCacheDirectory *MakeDirectory(std::string_view path) noexcept;
+
 	/* virtual methods from CacheHandler */
 	void OnCacheItemAdded(const CacheItem &_item) noexcept override {
 		const auto &item = (const TranslateCacheItem &)_item;
@@ -252,38 +648,6 @@ private:
 	}
 };
 
-struct TranslateCacheRequest final : TranslateHandler {
-	const AllocatorPtr alloc;
-
-	struct tcache *tcache;
-
-	const TranslateRequest &request;
-
-	const bool cacheable;
-
-	/** are we looking for a "BASE" cache entry? */
-	const bool find_base;
-
-	const StringWithHash key;
-
-	TranslateHandler *handler;
-
-	TranslateCacheRequest(AllocatorPtr _alloc, struct tcache &_tcache,
-			      const TranslateRequest &_request, StringWithHash _key,
-			      bool _cacheable,
-			      TranslateHandler &_handler) noexcept
-		:alloc(_alloc), tcache(&_tcache), request(_request),
-		 cacheable(_cacheable),
-		 find_base(false), key(_key),
-		 handler(&_handler) {}
-
-	TranslateCacheRequest(TranslateCacheRequest &) = delete;
-
-	/* virtual methods from TranslateHandler */
-	void OnTranslateResponse(UniquePoolPtr<TranslateResponse> response) noexcept override;
-	void OnTranslateError(std::exception_ptr error) noexcept override;
-};
-
 static StringWithHash
 tcache_uri_key(AllocatorPtr alloc, const char *uri, const char *host,
 	       HttpStatus status,
@@ -1027,6 +1391,8 @@ tcache_store(TranslateCacheRequest &tcr, const TranslateResponse &response)
 
 	item->stats = pool_stats(item->GetPool());
 
+	tcr.tcache->WatchValidateMtime(*item);
+
 	if (response.VaryContains(TranslationCommand::HOST))
 		tcr.tcache->per_host.insert(*item);
 
@@ -1065,11 +1431,23 @@ UriWithoutQueryString(AllocatorPtr alloc, const char *uri) noexcept
  *
  */
 
+void
+TranslateCacheRequest::ResumeWaiters() noexcept
+{
+	while (!waiters.empty()) {
+		auto &waiter = waiters.front();
+		waiters.pop_front();
+		waiter.OnLeaderResponse(*tcache);
+	}
+}
+
 void
 TranslateCacheRequest::OnTranslateResponse(UniquePoolPtr<TranslateResponse> _response) noexcept
 try {
 	tcache->active = true;
 
+	RemovePending();
+
 	auto &response = *_response;
 
 	if (!response.invalidate.empty())
@@ -1085,6 +1463,11 @@ try {
 		LogConcat(4, "TranslationCache", "nocache ", key.value);
 	}
 
+	/* the response is now in the cache (if it was cacheable);
+	   let the waiters look it up before our handler gets a chance
+	   to destroy this object's pool */
+	ResumeWaiters();
+
 	if (request.uri != nullptr && response.IsExpandable()) {
 		const char *uri = UriWithoutQueryString(alloc, request.uri);
 		tcache_expand_response(alloc, response,
@@ -1108,6 +1491,10 @@ try {
 } catch (...) {
 	_response.reset();
 
+	/* if tcache_store() has failed, the waiters are still
+	   here; they will send their own requests */
+	ResumeWaiters();
+
 	handler->OnTranslateError(std::current_exception());
 }
 
@@ -1116,9 +1503,47 @@ TranslateCacheRequest::OnTranslateError(std::exception_ptr ep) noexcept
 {
 	LogConcat(4, "TranslationCache", "error ", key.value);
 
+	RemovePending();
+
+	while (!waiters.empty()) {
+		auto &waiter = waiters.front();
+		waiters.pop_front();
+		waiter.OnLeaderError(ep);
+	}
+
 	handler->OnTranslateError(ep);
 }
 
+void
+TranslateCacheRequest::Cancel() noexcept
+{
+	assert(IsPending());
+
+	pending_hook.unlink();
+	cancel_ptr.Cancel();
+
+	/* the waiters still need a response: the first one sends
+	   its own request and the others wait for it */
+	while (!waiters.empty()) {
+		auto &waiter = waiters.front();
+		waiters.pop_front();
+		waiter.Dispatch(*tcache, true);
+	}
+}
+
+/**
+ * Can the cached response be passed to the handler as-is, without
+ * copying it to the request's pool?  This is only possible if no
+ * request-specific modifications (BASE suffix, regex expansion) are
+ * necessary.
+ */
+[[gnu::pure]]
+static bool
+tcache_can_borrow(const TranslateResponse &response) noexcept
+{
+	return response.base == nullptr && !response.IsExpandable();
+}
+
 static void
 tcache_hit(AllocatorPtr alloc,
 	   const char *uri, const char *host, const char *user,
@@ -1126,10 +1551,20 @@ tcache_hit(AllocatorPtr alloc,
 	   const TranslateCacheItem &item,
 	   TranslateHandler &handler) noexcept
 {
-	auto response = UniquePoolPtr<TranslateResponse>::Make(alloc.GetPool());
-
 	LogConcat(4, "TranslationCache", "hit ", key.value);
 
+	if (tcache_can_borrow(item.response)) {
+		/* zero-copy: the handler borrows the cached response;
+		   the lease attached to the caller's pool keeps the
+		   cache item alive as long as a copy would have
+		   lived */
+		pool_attach_lease(alloc.GetPool(), item.Lease());
+		handler.OnTranslateResponse(UniquePoolPtr<TranslateResponse>::Borrow(item.response));
+		return;
+	}
+
+	auto response = UniquePoolPtr<TranslateResponse>::Make(alloc.GetPool());
+
 	try {
 		response->CacheLoad(alloc, item.response, uri);
 	} catch (...) {
@@ -1153,11 +1588,26 @@ tcache_hit(AllocatorPtr alloc,
 static void
 tcache_miss(AllocatorPtr alloc, struct tcache &tcache,
 	    const TranslateRequest &request, StringWithHash key,
-	    bool cacheable,
+	    bool cacheable, bool coalesce,
 	    const StopwatchPtr &parent_stopwatch,
 	    TranslateHandler &handler,
 	    CancellablePointer &cancel_ptr) noexcept
 {
+	/* only cacheable requests are coalesced, because only their
+	   waiters have a chance to find the response in the cache */
+	coalesce = coalesce && cacheable;
+
+	if (coalesce) {
+		if (auto i = tcache.pending.find(key); i != tcache.pending.end()) {
+			LogConcat(4, "TranslationCache", "wait ", key.value);
+
+			auto waiter = alloc.New<TranslateCacheWaiter>(alloc, request, key,
+								      handler, cancel_ptr);
+			i->AddWaiter(*waiter);
+			return;
+		}
+	}
+
 	auto tcr = alloc.New<TranslateCacheRequest>(alloc, tcache,
 						    request, key,
 						    cacheable,
@@ -1166,8 +1616,70 @@ tcache_miss(AllocatorPtr alloc, struct tcache &tcache,
 	if (cacheable)
 		LogConcat(4, "TranslationCache", "miss ", key.value);
 
-	tcache.next.SendRequest(alloc, request, parent_stopwatch,
-				*tcr, cancel_ptr);
+	if (coalesce) {
+		tcache.pending.insert(*tcr);
+		cancel_ptr = *tcr;
+
+		tcache.next.SendRequest(alloc, request, parent_stopwatch,
+					*tcr, tcr->cancel_ptr);
+	} else
+		tcache.next.SendRequest(alloc, request, parent_stopwatch,
+					*tcr, cancel_ptr);
+}
+
+void
+TranslateCacheWaiter::Dispatch(struct tcache &tcache, bool coalesce) noexcept
+{
+	/* copy everything to the stack because this object will be
+	   destroyed */
+	const auto _alloc = alloc;
+	const auto &_request = request;
+	const auto _key = key;
+	auto &_handler = handler;
+	auto &_cancel_ptr = cancel_ptr;
+
+	Destroy();
+
+	tcache_miss(_alloc, tcache, _request, _key, true, coalesce,
+		    nullptr, _handler, _cancel_ptr);
+}
+
+void
+TranslateCacheWaiter::OnLeaderResponse(struct tcache &tcache) noexcept
+{
+	const TranslateCacheItem *item = tcache_lookup(tcache, request, key);
+	if (item == nullptr) {
+		/* the response was not cacheable or does not match
+		   this request's VARY parameters; don't coalesce
+		   again, or all waiters would be serialized */
+		Dispatch(tcache, false);
+		return;
+	}
+
+	const auto _alloc = alloc;
+	const auto &_request = request;
+	const auto _key = key;
+	auto &_handler = handler;
+
+	Destroy();
+
+	tcache_hit(_alloc, _request.uri, _request.host, _request.user, _key,
+		   *item, _handler);
+}
+
+void
+TranslateCacheWaiter::OnLeaderError(std::exception_ptr error) noexcept
+{
+	auto &_handler = handler;
+	Destroy();
+	_handler.OnTranslateError(std::move(error));
+}
+
+void
+TranslateCacheWaiter::Cancel() noexcept
+{
+	unlink();
+	Destroy();
 }
 
 [[gnu::pure]]
@@ -1230,16 +1742,179 @@ tcache_validate_mtime(const TranslateResponse &response,
 bool
 TranslateCacheItem::Validate() const noexcept
 {
+	if (stamp != nullptr && stamp->IsValid())
+		/* inotify has not reported a modification yet */
+		return true;
+
 	return tcache_validate_mtime(response, GetKey());
 }
 
 void
 TranslateCacheItem::Destroy() noexcept
 {
+	if (stamp != nullptr)
+		stamp->RemoveItem(*this);
+
 	pool_trash(pool);
 	this->~TranslateCacheItem();
 }
 
+TranslateCacheStamp::~TranslateCacheStamp() noexcept
+{
+	if (directory != nullptr)
+		directory->RemoveStamp(*this);
+}
+
+bool
+TranslateCacheStamp::IsValid() const noexcept
+{
+	return directory != nullptr && directory->IsWatching() &&
+		(!watch_file || IsWatching());
+}
+
+void
+TranslateCacheStamp::Invalidate() noexcept
+{
+	LogConcat(5, "TranslationCache", "modified ", path);
+
+	/* detach all items first, because Cache::Remove() may not
+	   destroy them immediately */
+	items.clear_and_dispose([this](TranslateCacheItem *item){
+		item->stamp = nullptr;
+		tcache.cache.Remove(*item);
+	});
+
+	delete this;
+}
+
+void
+TranslateCacheStamp::OnInotify([[maybe_unused]] unsigned mask,
+			       [[maybe_unused]] const char *name) noexcept
+{
+	Invalidate();
+}
+
+void
+TranslateCacheDirectory::OnInotify(unsigned mask, const char *name) noexcept
+{
+	const auto invalidate = [](TranslateCacheStamp *stamp){
+		stamp->directory = nullptr;
+		stamp->Invalidate();
+	};
+
+	if (name == nullptr ||
+	    (mask & (IN_DELETE_SELF|IN_MOVE_SELF|IN_IGNORED)) != 0) {
+		/* the directory itself is gone */
+		stamps.clear_and_dispose(invalidate);
+		delete this;
+		return;
+	}
+
+	/* a directory entry was created, deleted or renamed */
+	stamps.remove_and_dispose_if([name](const TranslateCacheStamp &stamp){
+		return stamp.GetName() == name;
+	}, invalidate);
+
+	if (stamps.empty())
+		delete this;
+}
+
+inline TranslateCacheDirectory *
+tcache::MakeDirectory(std::string_view path) noexcept
+{
+	assert(inotify_manager != nullptr);
+
+	auto [it, inserted] = directories.insert_check(path);
+	if (!inserted)
+		return &*it;
+
+	auto *directory = new TranslateCacheDirectory(*inotify_manager, path);
+
+	/* IN_MASK_CREATE: see MakeStamp() */
+	if (!directory->TryAddWatch(directory->path.c_str(),
+				    IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|
+				    IN_DELETE_SELF|IN_MOVE_SELF|
+				    IN_ONLYDIR|IN_MASK_CREATE)) {
+		delete directory;
+		return nullptr;
+	}
+
+	directories.insert_commit(it, *directory);
+	return directory;
+}
+
+inline TranslateCacheStamp *
+tcache::MakeStamp(const char *path, bool exists) noexcept
+{
+	assert(inotify_manager != nullptr);
+
+	auto [it, inserted] = stamps.insert_check(std::string_view{path});
+	if (!inserted)
+		return &*it;
+
+	if (inotify_manager->IsShuttingDown())
+		return nullptr;
+
+	const std::string_view path_view{path};
+	const auto slash = path_view.rfind('/');
+	if (slash == path_view.npos)
+		return nullptr;
+
+	/* watch the parent directory first, so a rename() does
+	   not get lost */
+	auto *directory = MakeDirectory(slash > 0
+					? path_view.substr(0, slash)
+					: "/"sv);
+	if (directory == nullptr)
+		return nullptr;
+
+	auto *stamp = new TranslateCacheStamp(*this, *inotify_manager, path,
+					      exists);
+	directory->AddStamp(*stamp);
+
+	/* IN_ATTRIB covers utimes() and unlink(), IN_MODIFY covers
+	   writes; IN_MASK_CREATE fails if this inode is already
+	   watched (e.g. through a hard link), because one inode can
+	   have only one InotifyWatch */
+	if (exists &&
+	    !stamp->TryAddWatch(path,
+				IN_ATTRIB|IN_MODIFY|IN_MOVE_SELF|IN_DELETE_SELF|
+				IN_DONT_FOLLOW|IN_ONESHOT|IN_MASK_CREATE)) {
+		delete stamp;
+		return nullptr;
+	}
+
+	stamps.insert_commit(it, *stamp);
+	return stamp;
+}
+
+void
+tcache::WatchValidateMtime(TranslateCacheItem &item) noexcept
+{
+	const auto &validate_mtime = item.response.validate_mtime;
+
+	if (inotify_manager == nullptr ||
+	    validate_mtime.path == nullptr)
+		return;
+
+	/* mtime=0 means the file must not exist; its creation is
+	   reported by the directory watch */
+	auto *stamp = MakeStamp(validate_mtime.path,
+				validate_mtime.mtime != 0);
+	if (stamp == nullptr)
+		return;
+
+	/* check the file only after the watch has been registered,
+	   to avoid missing a modification in between */
+	if (!tcache_validate_mtime(item.response, item.GetKey())) {
+		if (stamp->items.empty())
+			delete stamp;
+		return;
+	}
+
+	stamp->AddItem(item);
+}
+
 /*
  * constructor
  *
@@ -1248,9 +1923,11 @@ TranslateCacheItem::Destroy() noexcept
 inline
 tcache::tcache(struct pool &_pool, EventLoop &event_loop,
 	       TranslationService &_next, unsigned max_size,
+	       InotifyManager *_inotify_manager,
 	       bool handshake_cacheable)
 	:pool(pool_new_dummy(&_pool, "translate_cache")),
 	 slice_pool(4096, 32768, "translate_cache"),
+	 inotify_manager(_inotify_manager),
 	 cache(event_loop, max_size, this),
 	 next(_next), active(handshake_cacheable)
 {
@@ -1260,9 +1937,10 @@ tcache::tcache(struct pool &_pool, EventLoop &event_loop,
 TranslationCache::TranslationCache(struct pool &pool, EventLoop &event_loop,
 				   TranslationService &next,
 				   unsigned max_size,
+				   InotifyManager *inotify_manager,
 				   bool handshake_cacheable)
 	:cache(new tcache(pool, event_loop, next, max_size,
-			  handshake_cacheable))
+			  inotify_manager, handshake_cacheable))
 {
 }
 
@@ -1311,7 +1989,7 @@ TranslationCache::SendRequest(AllocatorPtr alloc,
 			   *item, handler);
 	} else {
 		++cache->stats.misses;
-		tcache_miss(alloc, *cache, request, key, cacheable,
+		tcache_miss(alloc, *cache, request, key, cacheable, true,
 			    parent_stopwatch,
 			    handler, cancel_ptr);
 	}
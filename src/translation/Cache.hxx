@@ -11,6 +11,7 @@
 
 enum class TranslationCommand : uint16_t;
 class EventLoop;
+class InotifyManager;
 struct CacheStats;
 
 struct tcache;
@@ -23,12 +24,17 @@ class TranslationCache final : public TranslationService {
 
 public:
 	/**
+	 * @param inotify_manager if not nullptr, then VALIDATE_MTIME
+	 * files are watched with inotify instead of calling statx()
+	 * on each cache hit
 	 * @param handshake_cacheable if false, then all requests are
 	 * deemed uncacheable until the first response is received
 	 */
 	TranslationCache(struct pool &pool, EventLoop &event_loop,
 			 TranslationService &next,
-			 unsigned max_size, bool handshake_cacheable=true);
+			 unsigned max_size,
+			 InotifyManager *inotify_manager=nullptr,
+			 bool handshake_cacheable=true);
 
 	~TranslationCache() noexcept override;
 
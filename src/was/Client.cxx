@@ -23,6 +23,7 @@
 #include "event/FineTimerEvent.hxx"
 #include "http/HeaderLimits.hxx"
 #include "http/HeaderName.hxx"
+#include "http/HeaderToken.hxx"
 #include "http/Method.hxx"
 #include "util/Cancellable.hxx"
 #include "util/CharUtil.hxx"
@@ -526,7 +527,11 @@ ParseHeaderPacket(AllocatorPtr alloc, StringMap &headers,
 	    !IsValidHeaderValue(value))
 		throw SocketProtocolError{"Malformed WAS HEADER packet"};
 
-	headers.Add(alloc, alloc.DupToLower(name), alloc.DupZ(value));
+	if (const auto token = LookupHeaderToken(name);
+	    token != HeaderToken::UNKNOWN)
+		headers.Add(alloc, GetHeaderTokenKey(token), alloc.DupZ(value));
+	else
+		headers.Add(alloc, alloc.DupToLower(name), alloc.DupZ(value));
 }
 
 static bool
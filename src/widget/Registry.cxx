@@ -82,7 +82,7 @@ WidgetRegistryLookup::OnTranslateResponse(UniquePoolPtr<TranslateResponse> _resp
 		cls->untrusted_host = response.host;
 	cls->cookie_host = response.cookie_host;
 	cls->group = response.widget_group;
-	cls->container_groups = std::move(response.container_groups);
+	cls->container_groups.CopyFrom(widget_pool, response.container_groups);
 	cls->direct_addressing = response.direct_addressing;
 	cls->stateful = response.stateful;
 	cls->require_csrf_token = response.require_csrf_token;
@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+/*
+ * Measure the throughput of #XmlParser.  Feeds the given file (or a
+ * synthetic HTML document) to the parser in small chunks, many times.
+ */
+
+#include "TestInstance.hxx"
+#include "parser/XmlParser.hxx"
+#include "pool/pool.hxx"
+#include "pool/Ptr.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "lib/fmt/SystemError.hxx"
+#include "util/PrintException.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <span>
+#include <string>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+class BenchXmlParserHandler final : public XmlParserHandler {
+public:
+	std::size_t n_tags = 0, n_attributes = 0, n_cdata = 0;
+
+	/* virtual methods from class XmlParserHandler */
+	bool OnXmlTagStart(const XmlParserTag &) noexcept override {
+		/* we want to see the attributes */
+		return true;
+	}
+
+	bool OnXmlTagFinished(const XmlParserTag &) noexcept override {
+		++n_tags;
+		return true;
+	}
+
+	void OnXmlAttributeFinished(const XmlParserAttribute &) noexcept override {
+		++n_attributes;
+	}
+
+	size_t OnXmlCdata(std::string_view text, [[maybe_unused]] bool escaped,
+			  [[maybe_unused]] off_t start) noexcept override {
+		n_cdata += text.size();
+		return text.size();
+	}
+};
+
+static std::string
+LoadFile(const char *path)
+{
+	UniqueFileDescriptor fd;
+	if (!fd.Open(path, O_RDONLY))
+		throw FmtErrno("Failed to open {}", path);
+
+	std::string result;
+	char buffer[65536];
+	ssize_t nbytes;
+	while ((nbytes = fd.Read(std::as_writable_bytes(std::span{buffer}))) > 0)
+		result.append(buffer, nbytes);
+
+	if (nbytes < 0)
+		throw FmtErrno("Failed to read {}", path);
+
+	return result;
+}
+
+/**
+ * Generate a HTML document with a typical mix of markup and text.
+ */
+static std::string
+GenerateHtml()
+{
+	std::string result = "<!DOCTYPE html>\n<html><head><title>Benchmark</title></head>\n<body>\n";
+
+	for (unsigned i = 0; i < 2000; ++i) {
+		result += "<div class=\"item-container\" id=item";
+		result += std::to_string(i);
+		result += " data-widget-attribute='some value'>\n"
+			"  <!-- a comment which is skipped by the parser -->\n"
+			"  <a href=\"/path/to/some/resource?query=string&amp;foo=bar\" target=_blank>"
+			"Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod "
+			"tempor incididunt ut labore et dolore magna aliqua.</a>\n"
+			"  <img src=/images/picture.png width=640 height=480 alt=\"A picture\"/>\n"
+			"  <script><![CDATA[ if (a < b && c > d) { x = y; } ]]></script>\n"
+			"  <c:widget id=\"w\" type=\"example\"><c:path-info value=\"/foo\"/></c:widget>\n"
+			"</div>\n";
+	}
+
+	result += "</body></html>\n";
+	return result;
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc > 2) {
+		fprintf(stderr, "Usage: %s [FILE]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const std::string input = argc > 1 ? LoadFile(argv[1]) : GenerateHtml();
+
+	static constexpr std::size_t CHUNK_SIZE = 4096;
+	static constexpr unsigned N_ITERATIONS = 200;
+
+	TestInstance instance;
+
+	BenchXmlParserHandler handler;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (unsigned i = 0; i < N_ITERATIONS; ++i) {
+		const auto pool = pool_new_linear(instance.root_pool, "bench", 8192);
+		XmlParser parser(pool, handler);
+
+		const char *p = input.data(), *const end = p + input.size();
+		while (p < end) {
+			const std::size_t length = std::min<std::size_t>(end - p, CHUNK_SIZE);
+			const std::size_t nbytes = parser.Feed(p, length);
+			if (nbytes == 0) {
+				fprintf(stderr, "Parser stalled\n");
+				return EXIT_FAILURE;
+			}
+
+			p += nbytes;
+		}
+	}
+
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	const double total = double(input.size()) * N_ITERATIONS;
+	printf("%zu bytes x %u in %.3f s: %.1f MB/s\n",
+	       input.size(), N_ITERATIONS, duration.count(),
+	       total / duration.count() / (1024 * 1024));
+	printf("tags=%zu attributes=%zu cdata=%zu\n",
+	       handler.n_tags, handler.n_attributes, handler.n_cdata);
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
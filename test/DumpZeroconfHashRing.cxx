@@ -3,20 +3,6 @@
 // author: Max Kellermann <mk@cm4all.com>
 
 #include "TestInstance.hxx"
-
-#include <algorithm>
-#include <array>
-
-#include "util/Compiler.h"
-#if CLANG_VERSION >= GCC_MAKE_VERSION(10,0,0)
-#pragma GCC diagnostic ignored "-Wkeyword-macro"
-#endif
-
-/* horrible kludge which allows us to access private members */
-#define class struct
-#include "util/HashRing.hxx"
-#undef class
-
 #include "lb/MemberHash.hxx"
 #include "lib/avahi/Check.hxx"
 #include "lib/avahi/Client.hxx"
@@ -90,18 +76,18 @@ struct Context final : TestInstance, Avahi::ServiceExplorerListener,
 void
 Context::Dump() noexcept
 {
-	MemberHashRing<MemberMap::value_type> ring;
+	MemberHashRing<MemberMap::const_pointer> ring;
 
-	BuildMemberHashRing(ring, members,
-			    [](MemberMap::const_reference member) noexcept {
-				    return member.second;
-			    });
+	for (const auto &i : members)
+		ring.Insert(&i, i.second);
 
 	std::map<MemberMap::const_pointer, std::size_t> counts;
-	for (const auto &i : ring.buckets)
-		++counts[i];
+	ring.VisitRanges([&counts](MemberMap::const_pointer member,
+				   sticky_hash_t size){
+		counts[member] += size;
+	});
 
-	std::map<std::size_t, MemberMap::const_reference> sorted;
+	std::multimap<std::size_t, MemberMap::const_reference> sorted;
 	for (const auto &i : counts)
 		sorted.emplace(i.second, *i.first);
 
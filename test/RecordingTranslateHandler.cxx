@@ -25,6 +25,7 @@ RecordingTranslateHandler::OnTranslateResponse(UniquePoolPtr<TranslateResponse>
 	response = UniquePoolPtr<TranslateResponse>::Make(pool);
 	response->CopyFrom(alloc, *_response);
 	response->address.CopyFrom(alloc, _response->address);
+	borrowed = _response.IsBorrowed();
 	finished = true;
 }
 
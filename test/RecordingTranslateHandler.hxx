@@ -14,6 +14,11 @@ struct RecordingTranslateHandler final : TranslateHandler {
 
 	std::exception_ptr error;
 
+	/**
+	 * Was the response borrowed (see UniquePoolPtr::Borrow())?
+	 */
+	bool borrowed = false;
+
 	bool finished = false;
 
 	explicit RecordingTranslateHandler(struct pool &parent_pool) noexcept;
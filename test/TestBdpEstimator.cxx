@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "nghttp2/BdpEstimator.hxx"
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+using NgHttp2::BdpEstimator;
+
+static constexpr std::size_t INITIAL_WINDOW = 65535;
+
+TEST(BdpEstimator, Disabled)
+{
+	const BdpEstimator::Clock::time_point now{};
+
+	BdpEstimator bdp{INITIAL_WINDOW, INITIAL_WINDOW};
+	EXPECT_FALSE(bdp.OnData(1000, now));
+	EXPECT_EQ(bdp.OnPingAck(now + 10ms), 0U);
+	EXPECT_EQ(bdp.GetWindow(), INITIAL_WINDOW);
+}
+
+TEST(BdpEstimator, UnsolicitedAck)
+{
+	const BdpEstimator::Clock::time_point now{};
+
+	BdpEstimator bdp{INITIAL_WINDOW, 1024 * 1024};
+	EXPECT_EQ(bdp.OnPingAck(now), 0U);
+	EXPECT_EQ(bdp.GetWindow(), INITIAL_WINDOW);
+
+	/* a duplicate ACK is ignored as well */
+	EXPECT_TRUE(bdp.OnData(1000, now));
+	EXPECT_EQ(bdp.OnPingAck(now + 10ms), 0U);
+	EXPECT_EQ(bdp.OnPingAck(now + 20ms), 0U);
+}
+
+TEST(BdpEstimator, Grow)
+{
+	BdpEstimator::Clock::time_point now{};
+
+	BdpEstimator bdp{INITIAL_WINDOW, 1024 * 1024};
+
+	/* the first DATA frame triggers a PING */
+	EXPECT_TRUE(bdp.OnData(16384, now));
+
+	/* no second PING while the first one is pending */
+	EXPECT_FALSE(bdp.OnData(16384, now + 1ms));
+	EXPECT_FALSE(bdp.OnData(16384, now + 2ms));
+	EXPECT_FALSE(bdp.OnData(16383, now + 3ms));
+
+	/* the whole window was used within one round trip:
+	   double the sample */
+	now += 10ms;
+	EXPECT_EQ(bdp.OnPingAck(now), 2U * INITIAL_WINDOW);
+	EXPECT_EQ(bdp.GetWindow(), 2U * INITIAL_WINDOW);
+
+	/* after growing, the next sample may start immediately */
+	EXPECT_TRUE(bdp.OnData(100000, now));
+	now += 10ms;
+	EXPECT_EQ(bdp.OnPingAck(now), 200000U);
+	EXPECT_EQ(bdp.GetWindow(), 200000U);
+
+	/* the same amount of data takes longer: the bandwidth did
+	   not grow, so the window stays */
+	EXPECT_TRUE(bdp.OnData(200000, now));
+	now += 100ms;
+	EXPECT_EQ(bdp.OnPingAck(now), 0U);
+	EXPECT_EQ(bdp.GetWindow(), 200000U);
+}
+
+TEST(BdpEstimator, MaxWindow)
+{
+	BdpEstimator::Clock::time_point now{};
+
+	BdpEstimator bdp{INITIAL_WINDOW, 100000};
+
+	EXPECT_TRUE(bdp.OnData(INITIAL_WINDOW, now));
+	now += 10ms;
+	EXPECT_EQ(bdp.OnPingAck(now), 100000U);
+	EXPECT_EQ(bdp.GetWindow(), 100000U);
+
+	/* the maximum has been reached: no more PINGs */
+	EXPECT_FALSE(bdp.OnData(100000, now));
+	EXPECT_FALSE(bdp.OnData(100000, now + 1h));
+}
+
+TEST(BdpEstimator, Backoff)
+{
+	BdpEstimator::Clock::time_point now{};
+
+	BdpEstimator bdp{INITIAL_WINDOW, 1024 * 1024};
+
+	/* the sample is much smaller than the window: don't grow */
+	EXPECT_TRUE(bdp.OnData(1000, now));
+	now += 10ms;
+	EXPECT_EQ(bdp.OnPingAck(now), 0U);
+	EXPECT_EQ(bdp.GetWindow(), INITIAL_WINDOW);
+
+	/* the next PING is delayed by 100ms */
+	EXPECT_FALSE(bdp.OnData(1000, now + 99ms));
+	now += 100ms;
+	EXPECT_TRUE(bdp.OnData(1000, now));
+	now += 10ms;
+	EXPECT_EQ(bdp.OnPingAck(now), 0U);
+
+	/* ... and then by 200ms */
+	EXPECT_FALSE(bdp.OnData(1000, now + 199ms));
+	now += 200ms;
+	EXPECT_TRUE(bdp.OnData(1000, now));
+
+	/* growing resets the backoff */
+	EXPECT_FALSE(bdp.OnData(INITIAL_WINDOW, now + 1ms));
+	now += 10ms;
+	EXPECT_EQ(bdp.OnPingAck(now), 2U * (INITIAL_WINDOW + 1000));
+	EXPECT_TRUE(bdp.OnData(1000, now));
+	now += 10ms;
+	EXPECT_EQ(bdp.OnPingAck(now), 0U);
+	EXPECT_FALSE(bdp.OnData(1000, now + 99ms));
+	EXPECT_TRUE(bdp.OnData(1000, now + 100ms));
+}
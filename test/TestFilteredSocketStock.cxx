@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "TestInstance.hxx"
+#include "fs/Stock.hxx"
+#include "fs/FilteredSocket.hxx"
+#include "stock/Stats.hxx"
+#include "event/FineTimerEvent.hxx"
+#include "net/SocketAddress.hxx"
+#include "net/SocketPair.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "io/FdType.hxx"
+#include "util/BindMethod.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+using namespace std::chrono_literals;
+
+static const StockKey KEY{"test"};
+
+[[gnu::pure]]
+static std::size_t
+GetIdleCount(const FilteredSocketStock &stock) noexcept
+{
+	StockStats stats{};
+	stock.AddStats(stats);
+	return stats.idle;
+}
+
+/**
+ * Run the #EventLoop for the given duration.
+ */
+static void
+RunFor(EventLoop &event_loop, Event::Duration duration) noexcept
+{
+	class Breaker {
+		FineTimerEvent timer;
+
+	public:
+		Breaker(EventLoop &_event_loop,
+			Event::Duration _duration) noexcept
+			:timer(_event_loop, BIND_THIS_METHOD(OnTimer))
+		{
+			timer.Schedule(_duration);
+		}
+
+	private:
+		void OnTimer() noexcept {
+			timer.GetEventLoop().Break();
+		}
+	};
+
+	Breaker breaker{event_loop, duration};
+	event_loop.Run();
+}
+
+static std::unique_ptr<FilteredSocket>
+NewFilteredSocket(EventLoop &event_loop, UniqueSocketDescriptor &&fd)
+{
+	fd.SetNonBlocking();
+	return std::make_unique<FilteredSocket>(event_loop, std::move(fd),
+						FdType::FD_SOCKET);
+}
+
+TEST(FilteredSocketStock, Add)
+{
+	TestInstance instance;
+	FilteredSocketStock stock{instance.event_loop, 16, 16};
+
+	auto [a, b] = CreateStreamSocketPair();
+
+	ASSERT_TRUE(stock.Add(KEY, nullptr,
+			      NewFilteredSocket(instance.event_loop, std::move(a))));
+	EXPECT_EQ(GetIdleCount(stock), 1U);
+
+	RunFor(instance.event_loop, 10ms);
+	EXPECT_EQ(GetIdleCount(stock), 1U);
+
+	/* the peer closes the idle connection */
+	b.Close();
+	RunFor(instance.event_loop, 10ms);
+	EXPECT_EQ(GetIdleCount(stock), 0U);
+}
+
+TEST(FilteredSocketStock, AddClosed)
+{
+	TestInstance instance;
+	FilteredSocketStock stock{instance.event_loop, 16, 16};
+
+	auto [a, b] = CreateStreamSocketPair();
+
+	auto socket = NewFilteredSocket(instance.event_loop, std::move(a));
+	socket->Close();
+
+	/* the stock refuses (and destroys) a socket which is
+	   already closed */
+	EXPECT_FALSE(stock.Add(KEY, nullptr, std::move(socket)));
+	EXPECT_EQ(GetIdleCount(stock), 0U);
+}
+
+TEST(FilteredSocketStock, IdleTimeout)
+{
+	TestInstance instance;
+	FilteredSocketStock stock{instance.event_loop, 16, 16};
+
+	auto [a, b] = CreateStreamSocketPair();
+	auto [c, d] = CreateStreamSocketPair();
+
+	ASSERT_TRUE(stock.Add(KEY, nullptr,
+			      NewFilteredSocket(instance.event_loop, std::move(a)),
+			      1ms));
+	ASSERT_TRUE(stock.Add(KEY, nullptr,
+			      NewFilteredSocket(instance.event_loop, std::move(c))));
+	EXPECT_EQ(GetIdleCount(stock), 2U);
+
+	/* only the connection with the short idle timeout has been
+	   closed (the idle timer has a resolution of about one
+	   second) */
+	RunFor(instance.event_loop, 3s);
+	EXPECT_EQ(GetIdleCount(stock), 1U);
+}
@@ -0,0 +1,302 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "TestInstance.hxx"
+#include "http/cache/Disk.hxx"
+#include "http/cache/Info.hxx"
+#include "http/Status.hxx"
+#include "istream/UnusedPtr.hxx"
+#include "event/FineTimerEvent.hxx"
+#include "pool/pool.hxx"
+#include "thread/Pool.hxx"
+#include "strmap.hxx"
+#include "util/BindMethod.hxx"
+#include "util/StringWithHash.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/**
+ * A temporary directory which is deleted (including all files in
+ * it) at the end of the test.
+ */
+class TempDirectory {
+	char path[64] = "/tmp/t_http_cache_disk.XXXXXX";
+
+public:
+	TempDirectory() {
+		if (mkdtemp(path) == nullptr)
+			throw std::runtime_error{"mkdtemp() failed"};
+	}
+
+	~TempDirectory() noexcept {
+		if (DIR *dir = opendir(path)) {
+			while (const auto *e = readdir(dir))
+				if (e->d_name[0] != '.')
+					unlinkat(dirfd(dir), e->d_name, 0);
+			closedir(dir);
+		}
+
+		rmdir(path);
+	}
+
+	const char *c_str() const noexcept {
+		return path;
+	}
+
+	/**
+	 * Count the segment files.
+	 */
+	unsigned CountSegments() const noexcept {
+		unsigned n = 0;
+		if (DIR *dir = opendir(path)) {
+			while (const auto *e = readdir(dir))
+				if (strstr(e->d_name, ".seg") != nullptr)
+					++n;
+			closedir(dir);
+		}
+
+		return n;
+	}
+};
+
+struct Instance final : TestInstance {
+	TempDirectory directory;
+
+	~Instance() noexcept {
+		// invoke all pending ThreadJob::Done() calls
+		event_loop.Run();
+
+		thread_pool_stop();
+		thread_pool_join();
+		thread_pool_deinit();
+	}
+
+	std::unique_ptr<HttpCacheDisk> OpenDisk() {
+		thread_pool_set_volatile();
+		return std::make_unique<HttpCacheDisk>(root_pool, event_loop,
+						       directory.c_str(),
+						       64 * 1024 * 1024);
+	}
+
+	/**
+	 * Run the #EventLoop until the worker thread has written
+	 * all records.
+	 */
+	void WaitWrites(const HttpCacheDisk &disk) noexcept {
+		class Waiter {
+			const HttpCacheDisk &disk;
+			FineTimerEvent timer;
+
+		public:
+			Waiter(EventLoop &event_loop,
+			       const HttpCacheDisk &_disk) noexcept
+				:disk(_disk),
+				 timer(event_loop, BIND_THIS_METHOD(OnTimer)) {
+				timer.Schedule(1ms);
+			}
+
+		private:
+			void OnTimer() noexcept {
+				if (disk.HasPendingWrites())
+					timer.Schedule(1ms);
+				else
+					timer.GetEventLoop().Break();
+			}
+		};
+
+		if (!disk.HasPendingWrites())
+			return;
+
+		Waiter waiter{event_loop, disk};
+		event_loop.Run();
+	}
+
+	/**
+	 * Create an item in the memory tier (without a body) and
+	 * move it to the disk tier.
+	 */
+	void Demote(HttpCacheDisk &disk, StringWithHash key,
+		    const char *tag=nullptr) noexcept {
+		HttpCacheResponseInfo info;
+		info.expires = std::chrono::system_clock::now() + 1h;
+		info.stale_while_revalidate = info.stale_if_error = {};
+		info.last_modified = info.etag = info.vary = nullptr;
+
+		auto *item = NewFromPool<HttpCacheItem>(pool_new_linear(root_pool, "item", 1024),
+							key,
+							event_loop.SteadyNow(),
+							event_loop.SystemNow(),
+							tag, info, StringMap{},
+							HttpStatus::OK, StringMap{},
+							0, RubberAllocation{});
+		disk.Demote(*item);
+		item->Destroy();
+	}
+};
+
+static constexpr StringWithHash KEY_A{"a", 0x61};
+static constexpr StringWithHash KEY_B{"b", 0x62};
+
+} // anonymous namespace
+
+TEST(HttpCacheDisk, Demote)
+{
+	Instance instance;
+
+	{
+		auto disk = instance.OpenDisk();
+		StringMap request_headers;
+
+		instance.Demote(*disk, KEY_A);
+
+		/* not available before it has been written */
+		ASSERT_TRUE(disk->HasPendingWrites());
+		ASSERT_EQ(disk->Get(KEY_A, request_headers), nullptr);
+
+		instance.WaitWrites(*disk);
+		ASSERT_NE(disk->Get(KEY_A, request_headers), nullptr);
+	}
+
+	/* restart */
+	auto disk = instance.OpenDisk();
+	StringMap request_headers;
+	ASSERT_NE(disk->Get(KEY_A, request_headers), nullptr);
+	ASSERT_EQ(disk->Get(KEY_B, request_headers), nullptr);
+}
+
+TEST(HttpCacheDisk, Tombstone)
+{
+	Instance instance;
+
+	{
+		auto disk = instance.OpenDisk();
+		StringMap request_headers;
+
+		/* nothing on disk: no tombstone */
+		disk->Remove(KEY_A, request_headers);
+		disk->FlushTag("foo");
+		ASSERT_FALSE(disk->HasPendingWrites());
+		ASSERT_EQ(instance.directory.CountSegments(), 0U);
+
+		instance.Demote(*disk, KEY_A);
+		instance.Demote(*disk, KEY_B, "foo");
+		instance.WaitWrites(*disk);
+		ASSERT_NE(disk->Get(KEY_A, request_headers), nullptr);
+		ASSERT_NE(disk->Get(KEY_B, request_headers), nullptr);
+
+		disk->Remove(KEY_A, request_headers);
+		disk->FlushTag("foo");
+		ASSERT_TRUE(disk->HasPendingWrites());
+		ASSERT_EQ(disk->Get(KEY_A, request_headers), nullptr);
+		ASSERT_EQ(disk->Get(KEY_B, request_headers), nullptr);
+
+		instance.WaitWrites(*disk);
+	}
+
+	/* the tombstones survive a restart */
+	auto disk = instance.OpenDisk();
+	StringMap request_headers;
+	ASSERT_EQ(disk->Get(KEY_A, request_headers), nullptr);
+	ASSERT_EQ(disk->Get(KEY_B, request_headers), nullptr);
+}
+
+TEST(HttpCacheDisk, RemovePending)
+{
+	Instance instance;
+
+	{
+		auto disk = instance.OpenDisk();
+		StringMap request_headers;
+
+		/* invalidate the item while it is still being
+		   written */
+		instance.Demote(*disk, KEY_A);
+		disk->Remove(KEY_A, request_headers);
+
+		instance.WaitWrites(*disk);
+		ASSERT_EQ(disk->Get(KEY_A, request_headers), nullptr);
+	}
+
+	auto disk = instance.OpenDisk();
+	StringMap request_headers;
+	ASSERT_EQ(disk->Get(KEY_A, request_headers), nullptr);
+}
+
+TEST(HttpCacheDisk, DestroyWhileReading)
+{
+	Instance instance;
+
+	auto disk = instance.OpenDisk();
+	StringMap request_headers;
+
+	instance.Demote(*disk, KEY_A);
+	instance.WaitWrites(*disk);
+
+	auto *item = disk->Get(KEY_A, request_headers);
+	ASSERT_NE(item, nullptr);
+
+	auto pool = pool_new_linear(instance.root_pool, "stream", 1024);
+	auto stream = disk->OpenStream(instance.event_loop, pool, *item);
+	ASSERT_TRUE(stream);
+
+	/* the istream keeps the segment alive after its
+	   HttpCacheDisk has been destroyed */
+	disk.reset();
+	stream.Clear();
+}
+
+/**
+ * A tombstone in one shard invalidates an older item in another
+ * shard, even though that shard is loaded later.
+ */
+TEST(HttpCacheDisk, CrossShardTombstone)
+{
+	Instance instance;
+
+	{
+		/* two instances sharing the directory claim two
+		   different shards */
+		auto disk0 = instance.OpenDisk();
+		auto disk1 = instance.OpenDisk();
+		StringMap request_headers;
+
+		instance.Demote(*disk0, KEY_A);
+		instance.Demote(*disk0, KEY_B);
+		instance.WaitWrites(*disk0);
+
+		/* B: the tombstone in shard 0 is older than the
+		   item in shard 1 */
+		disk0->Remove(KEY_B, request_headers);
+		instance.WaitWrites(*disk0);
+		instance.Demote(*disk1, KEY_B);
+		instance.WaitWrites(*disk1);
+
+		/* A: the tombstone in shard 0 is newer than the item
+		   in shard 1 */
+		instance.Demote(*disk1, KEY_A);
+		instance.WaitWrites(*disk1);
+		disk0->Remove(KEY_A, request_headers);
+		instance.WaitWrites(*disk0);
+	}
+
+	ASSERT_EQ(instance.directory.CountSegments(), 2U);
+
+	/* restart; shard 0 is loaded first */
+	auto disk = instance.OpenDisk();
+	StringMap request_headers;
+	ASSERT_EQ(disk->Get(KEY_A, request_headers), nullptr);
+	ASSERT_NE(disk->Get(KEY_B, request_headers), nullptr);
+}
@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "lb/MemberHash.hxx"
+#include "net/IPv4Address.hxx"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <utility>
+#include <vector>
+
+static constexpr std::size_t N_MEMBERS = 8;
+
+static const std::array<IPv4Address, N_MEMBERS + 1> addresses{
+	IPv4Address{10, 0, 0, 1, 80},
+	IPv4Address{10, 0, 0, 2, 80},
+	IPv4Address{10, 0, 0, 3, 80},
+	IPv4Address{10, 0, 0, 4, 80},
+	IPv4Address{10, 0, 0, 5, 80},
+	IPv4Address{10, 0, 0, 6, 80},
+	IPv4Address{10, 0, 0, 7, 80},
+	IPv4Address{10, 0, 0, 8, 80},
+	IPv4Address{10, 0, 0, 9, 8080},
+};
+
+static SocketAddress
+GetAddress(unsigned member) noexcept
+{
+	return addresses[member];
+}
+
+using Ring = MemberHashRing<unsigned>;
+
+/**
+ * Generate a number of hashes which are spread over the whole
+ * hash space.
+ */
+static std::vector<sticky_hash_t>
+MakeHashes() noexcept
+{
+	std::vector<sticky_hash_t> hashes;
+	for (sticky_hash_t i = 0; i < 10000; ++i)
+		hashes.push_back(i * 2654435761U);
+	return hashes;
+}
+
+static std::vector<unsigned>
+PickAll(const Ring &ring, const std::vector<sticky_hash_t> &hashes) noexcept
+{
+	std::vector<unsigned> result;
+	result.reserve(hashes.size());
+	for (const auto hash : hashes)
+		result.push_back(ring.Pick(hash));
+	return result;
+}
+
+static std::vector<std::pair<unsigned, sticky_hash_t>>
+GetRanges(const Ring &ring) noexcept
+{
+	std::vector<std::pair<unsigned, sticky_hash_t>> result;
+	ring.VisitRanges([&result](unsigned member, sticky_hash_t size){
+		result.emplace_back(member, size);
+	});
+	return result;
+}
+
+/**
+ * Adding and removing members one by one results in the same ring
+ * as building it from scratch.
+ */
+TEST(MemberHashRing, IncrementalEqualsRebuild)
+{
+	Ring incremental;
+	for (unsigned i = 0; i < N_MEMBERS; ++i)
+		incremental.Insert(i, GetAddress(i));
+
+	incremental.Remove(3);
+	incremental.Remove(5);
+	incremental.Insert(8, GetAddress(8));
+	incremental.Insert(3, GetAddress(3));
+
+	Ring rebuilt;
+	BuildMemberHashRing(rebuilt,
+			    std::array<unsigned, 8>{0, 1, 2, 3, 4, 6, 7, 8},
+			    GetAddress);
+
+	EXPECT_EQ(GetRanges(incremental), GetRanges(rebuilt));
+
+	const auto hashes = MakeHashes();
+	EXPECT_EQ(PickAll(incremental, hashes), PickAll(rebuilt, hashes));
+
+	/* removing all members leaves an empty ring */
+	for (unsigned i : {0, 1, 2, 3, 4, 6, 7, 8})
+		incremental.Remove(i);
+	EXPECT_TRUE(incremental.empty());
+}
+
+/**
+ * Removing a member only moves the keys which were assigned to it;
+ * adding it again moves them back.
+ */
+TEST(MemberHashRing, RemoveMovesOnlyItsKeys)
+{
+	Ring ring;
+	for (unsigned i = 0; i < N_MEMBERS; ++i)
+		ring.Insert(i, GetAddress(i));
+
+	const auto hashes = MakeHashes();
+	const auto before = PickAll(ring, hashes);
+
+	constexpr unsigned removed = 5;
+	ring.Remove(removed);
+
+	const auto after = PickAll(ring, hashes);
+
+	std::size_t n_moved = 0;
+	for (std::size_t i = 0; i < hashes.size(); ++i) {
+		if (before[i] == removed) {
+			EXPECT_NE(after[i], removed);
+			++n_moved;
+		} else
+			EXPECT_EQ(after[i], before[i]);
+	}
+
+	/* the removed member owned some of the keys */
+	EXPECT_GT(n_moved, 0U);
+
+	ring.Insert(removed, GetAddress(removed));
+	EXPECT_EQ(PickAll(ring, hashes), before);
+}
+
+/**
+ * FindNext() skips all other points of the current member.
+ */
+TEST(MemberHashRing, FindNext)
+{
+	Ring ring;
+	ring.Insert(0, GetAddress(0));
+	ring.Insert(1, GetAddress(1));
+
+	for (const auto hash : MakeHashes()) {
+		const auto [next_hash, next] = ring.FindNext(hash);
+		EXPECT_NE(next, ring.Pick(hash));
+		EXPECT_EQ(ring.Pick(next_hash), next);
+	}
+
+	/* with only one member, FindNext() returns that member */
+	ring.Remove(1);
+	EXPECT_EQ(ring.FindNext(42).second, 0U);
+}
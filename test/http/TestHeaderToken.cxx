@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "http/HeaderToken.hxx"
+#include "strmap.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string_view>
+
+using std::string_view_literals::operator""sv;
+
+TEST(HttpUtil, HeaderToken)
+{
+	EXPECT_EQ(LookupHeaderToken("accept"sv), HeaderToken::ACCEPT);
+	EXPECT_EQ(LookupHeaderToken("Accept"sv), HeaderToken::ACCEPT);
+	EXPECT_EQ(LookupHeaderToken("CONTENT-TYPE"sv), HeaderToken::CONTENT_TYPE);
+	EXPECT_EQ(LookupHeaderToken("x-frame-options"sv), HeaderToken::X_FRAME_OPTIONS);
+	EXPECT_EQ(LookupHeaderToken("X-CM4all-BENG-Peer-Issuer-Subject"sv),
+		  HeaderToken::X_CM4ALL_BENG_PEER_ISSUER_SUBJECT);
+
+	EXPECT_EQ(LookupHeaderToken(""sv), HeaderToken::UNKNOWN);
+	EXPECT_EQ(LookupHeaderToken("x"sv), HeaderToken::UNKNOWN);
+	EXPECT_EQ(LookupHeaderToken("accep"sv), HeaderToken::UNKNOWN);
+	EXPECT_EQ(LookupHeaderToken("accepts"sv), HeaderToken::UNKNOWN);
+	EXPECT_EQ(LookupHeaderToken("x-foo"sv), HeaderToken::UNKNOWN);
+	EXPECT_EQ(LookupHeaderToken("cookie3"sv), HeaderToken::UNKNOWN);
+
+	/* all tokens can be found by their own name */
+	for (unsigned i = 1; i < unsigned(HeaderToken::COUNT); ++i) {
+		const auto token = static_cast<HeaderToken>(i);
+		const StringMapKey key = GetHeaderTokenKey(token);
+		EXPECT_EQ(LookupHeaderToken(key.string), token);
+		EXPECT_EQ(key.hash, StringMapKey{key.string}.hash);
+	}
+}
@@ -5,6 +5,7 @@
 #include "event/FineTimerEvent.hxx"
 #include "event/Loop.hxx"
 #include "io/FdCache.hxx"
+#include "io/FileMetadata.hxx"
 #include "io/Open.hxx"
 #include "io/Temp.hxx"
 #include "io/RecursiveDelete.hxx"
@@ -23,6 +24,7 @@
 #include <fcntl.h>
 #include <linux/openat2.h> // for RESOLVE_*
 #include <sys/stat.h> // for mkdirat()
+#include <unistd.h> // for close()
 
 using std::string_view_literals::operator""sv;
 
@@ -31,6 +33,11 @@ static constexpr struct open_how open_directory_path{
 	.resolve = RESOLVE_NO_MAGICLINKS,
 };
 
+static constexpr struct open_how open_read_only{
+	.flags = O_RDONLY|O_NOFOLLOW|O_CLOEXEC,
+	.resolve = RESOLVE_NO_MAGICLINKS,
+};
+
 class Request {
 	FdCache &fd_cache;
 
@@ -40,6 +47,8 @@ class Request {
 
 	FileDescriptor fd;
 
+	FileMetadata *metadata = nullptr;
+
 	int error = -1;
 
 	const bool discard;
@@ -77,6 +86,13 @@ public:
 		return fd;
 	}
 
+	FileMetadata &GetMetadata() const noexcept {
+		assert(error == 0);
+		assert(lease);
+
+		return *metadata;
+	}
+
 	void DiscardLease() noexcept {
 		lease = {};
 	}
@@ -98,12 +114,13 @@ public:
 
 	void Start(FileDescriptor directory,
 		   std::string_view path,
-		   const struct open_how &how) noexcept {
+		   const struct open_how &how,
+		   unsigned stx_mask=0) noexcept {
 		assert(!IsPending());
 		error = -1;
 		DiscardLease();
 
-		fd_cache.Get(directory, "/tmp/"sv, path, how, 0,
+		fd_cache.Get(directory, "/tmp/"sv, path, how, stx_mask,
 			     BIND_THIS_METHOD(OnSuccess), BIND_THIS_METHOD(OnError),
 			     cancel_ptr);
 	}
@@ -118,7 +135,8 @@ public:
 	}
 
 private:
-	void OnSuccess(FileDescriptor _fd, const struct statx &, SharedLease &&_lease) noexcept {
+	void OnSuccess(FileDescriptor _fd, const struct statx &,
+		       FileMetadata &_metadata, SharedLease &&_lease) noexcept {
 		assert(!lease);
 
 		cancel_ptr = {};
@@ -127,6 +145,7 @@ private:
 
 		if (!discard) {
 			fd = _fd;
+			metadata = &_metadata;
 			lease = std::move(_lease);
 		}
 
@@ -333,6 +352,9 @@ TEST(TestFdCache, Inotify)
 	EXPECT_TRUE(r1.GetFileDescriptor().IsDefined());
 	EXPECT_TRUE(r1.GetFileDescriptor().IsValid());
 
+	r1.GetMetadata().etag = "\"x\"";
+	r1.GetMetadata().no_gzip_sibling = true;
+
 	/* rename the directory, triggering an inotify event */
 	if (renameat(instance.dir.Get(), "dir",
 		     instance.dir.Get(), "renamed") < 0)
@@ -353,6 +375,11 @@ TEST(TestFdCache, Inotify)
 	EXPECT_TRUE(r2.GetFileDescriptor().IsValid());
 	EXPECT_NE(r2.GetFileDescriptor(), r1.GetFileDescriptor());
 
+	/* the metadata was discarded together with the old item */
+	EXPECT_NE(&r2.GetMetadata(), &r1.GetMetadata());
+	EXPECT_FALSE(r2.GetMetadata().etag);
+	EXPECT_FALSE(r2.GetMetadata().no_gzip_sibling);
+
 	/* discard the expired lease: FD must become invalid */
 	EXPECT_TRUE(r1.GetFileDescriptor().IsValid());
 	EXPECT_TRUE(r2.GetFileDescriptor().IsValid());
@@ -365,3 +392,105 @@ TEST(TestFdCache, Inotify)
 	EXPECT_FALSE(fd1.IsValid());
 	EXPECT_TRUE(r2.GetFileDescriptor().IsValid());
 }
+
+/**
+ * The #FileMetadata is shared by all users of a cached file
+ * descriptor and is discarded together with it.
+ */
+TEST(TestFdCache, Metadata)
+{
+	TestFdCacheInstance instance;
+
+	if (mkdirat(instance.dir.Get(), "dir", 0700) < 0)
+		throw MakeErrno("mkdirat() failed");
+
+	Request r1{instance.fd_cache, false};
+	r1.Start(instance.dir, "/tmp/dir"sv, open_directory_path);
+	r1.Wait();
+	ASSERT_EQ(r1.GetError(), 0);
+
+	/* a new item starts with empty metadata */
+	EXPECT_FALSE(r1.GetMetadata().etag);
+	EXPECT_FALSE(r1.GetMetadata().content_type);
+	EXPECT_FALSE(r1.GetMetadata().max_age);
+	EXPECT_FALSE(r1.GetMetadata().no_brotli_sibling);
+	EXPECT_FALSE(r1.GetMetadata().no_gzip_sibling);
+
+	r1.GetMetadata().etag = "\"x\"";
+	r1.GetMetadata().content_type = "text/plain";
+	r1.GetMetadata().max_age = std::chrono::seconds{60};
+	r1.GetMetadata().no_brotli_sibling = true;
+
+	/* a cache hit sees the metadata of the first request, even
+	   after its lease has been released */
+	r1.DiscardLease();
+
+	Request r2{instance.fd_cache, false};
+	r2.Start(instance.dir, "/tmp/dir"sv, open_directory_path);
+	EXPECT_FALSE(r2.IsPending());
+	ASSERT_EQ(r2.GetError(), 0);
+	EXPECT_EQ(r2.GetMetadata().etag, "\"x\"");
+	EXPECT_EQ(r2.GetMetadata().content_type, "text/plain");
+	EXPECT_EQ(r2.GetMetadata().max_age, std::chrono::seconds{60});
+	EXPECT_TRUE(r2.GetMetadata().no_brotli_sibling);
+	EXPECT_FALSE(r2.GetMetadata().no_gzip_sibling);
+
+	/* after a flush, the new item has empty metadata; the old
+	   lease still sees the old one */
+	instance.fd_cache.Flush();
+
+	Request r3{instance.fd_cache, false};
+	r3.Start(instance.dir, "/tmp/dir"sv, open_directory_path);
+	r3.Wait();
+	ASSERT_EQ(r3.GetError(), 0);
+	EXPECT_NE(r3.GetFileDescriptor(), r2.GetFileDescriptor());
+	EXPECT_FALSE(r3.GetMetadata().etag);
+	EXPECT_FALSE(r3.GetMetadata().content_type);
+	EXPECT_FALSE(r3.GetMetadata().max_age);
+	EXPECT_FALSE(r3.GetMetadata().no_brotli_sibling);
+	EXPECT_EQ(r2.GetMetadata().etag, "\"x\"");
+}
+
+/**
+ * Regular files have no inotify watch; their metadata is discarded
+ * when the item expires.  This test takes about 10 seconds.
+ */
+TEST(TestFdCache, MetadataExpire)
+{
+	TestFdCacheInstance instance;
+
+	const int fd = openat(instance.dir.Get(), "file",
+			      O_CREAT|O_WRONLY|O_CLOEXEC, 0600);
+	if (fd < 0)
+		throw MakeErrno("openat() failed");
+	close(fd);
+
+	Request r1{instance.fd_cache, false};
+	r1.Start(instance.dir, "/tmp/file"sv, open_read_only, STATX_SIZE);
+	r1.Wait();
+	ASSERT_EQ(r1.GetError(), 0);
+
+	r1.GetMetadata().etag = "\"x\"";
+	r1.GetMetadata().no_gzip_sibling = true;
+
+	Request r2{instance.fd_cache, false};
+	r2.Start(instance.dir, "/tmp/file"sv, open_read_only, STATX_SIZE);
+	EXPECT_FALSE(r2.IsPending());
+	ASSERT_EQ(r2.GetError(), 0);
+	EXPECT_EQ(r2.GetFileDescriptor(), r1.GetFileDescriptor());
+	EXPECT_EQ(&r2.GetMetadata(), &r1.GetMetadata());
+	EXPECT_EQ(r2.GetMetadata().etag, "\"x\"");
+	EXPECT_TRUE(r2.GetMetadata().no_gzip_sibling);
+
+	/* wait until the item has expired */
+	instance.RunFor(std::chrono::seconds{11});
+
+	Request r3{instance.fd_cache, false};
+	r3.Start(instance.dir, "/tmp/file"sv, open_read_only, STATX_SIZE);
+	r3.Wait();
+	ASSERT_EQ(r3.GetError(), 0);
+	EXPECT_NE(r3.GetFileDescriptor(), r1.GetFileDescriptor());
+	EXPECT_NE(&r3.GetMetadata(), &r1.GetMetadata());
+	EXPECT_FALSE(r3.GetMetadata().etag);
+	EXPECT_FALSE(r3.GetMetadata().no_gzip_sibling);
+}
@@ -6,6 +6,7 @@
 #include "istream/GzipIstream.hxx"
 #include "istream/istream_string.hxx"
 #include "istream/UnusedPtr.hxx"
+#include "thread/Pool.hxx"
 #include "lib/zlib/Error.hxx"
 #include "util/ScopeExit.hxx"
 
@@ -59,3 +60,41 @@ public:
 
 INSTANTIATE_TYPED_TEST_SUITE_P(Gzip, IstreamFilterTest,
 			       GzipIstreamTestTraits);
+
+class ThreadGzipIstreamTestTraits {
+	mutable EventLoop *event_loop_ = nullptr;
+
+public:
+	static constexpr IstreamFilterTestOptions options{
+		.expected_result = "foobar",
+		.transform_result = GunzipString,
+		.enable_buckets = false,
+		.late_finish = true,
+	};
+
+	~ThreadGzipIstreamTestTraits() noexcept {
+		// invoke all pending ThreadJob::Done() calls
+		if (event_loop_ != nullptr)
+			event_loop_->Run();
+
+		thread_pool_stop();
+		thread_pool_join();
+		thread_pool_deinit();
+	}
+
+	UnusedIstreamPtr CreateInput(struct pool &pool) const noexcept {
+		return istream_string_new(pool, "foobar");
+	}
+
+	UnusedIstreamPtr CreateTest(EventLoop &event_loop, struct pool &pool,
+				    UnusedIstreamPtr input) const noexcept {
+		event_loop_ = &event_loop;
+
+		thread_pool_set_volatile();
+		return NewThreadGzipIstream(pool, thread_pool_get_queue(event_loop),
+					    std::move(input), {.level = 9});
+	}
+};
+
+INSTANTIATE_TYPED_TEST_SUITE_P(ThreadGzip, IstreamFilterTest,
+			       ThreadGzipIstreamTestTraits);
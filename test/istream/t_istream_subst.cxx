@@ -31,3 +31,61 @@ public:
 
 INSTANTIATE_TYPED_TEST_SUITE_P(Subst, IstreamFilterTest,
 			       IstreamSubstTestTraits);
+
+/**
+ * Overlapping words with different first characters, which need the
+ * Aho-Corasick failure links.
+ */
+class IstreamSubstOverlapTestTraits {
+public:
+	static constexpr IstreamFilterTestOptions options{
+		.expected_result = "ab3 1 a2 ab",
+		.enable_buckets = false,
+	};
+
+	UnusedIstreamPtr CreateInput(struct pool &pool) const noexcept {
+		return istream_string_new(pool, "abcy abcd abcx ab");
+	}
+
+	UnusedIstreamPtr CreateTest(EventLoop &, struct pool &pool,
+				    UnusedIstreamPtr input) const noexcept {
+		SubstTree tree;
+		tree.Add(pool, "abcd", "1");
+		tree.Add(pool, "bcx", "2");
+		tree.Add(pool, "cy", "3");
+
+		return UnusedIstreamPtr(istream_subst_new(&pool, std::move(input), std::move(tree)));
+	}
+};
+
+INSTANTIATE_TYPED_TEST_SUITE_P(SubstOverlap, IstreamFilterTest,
+			       IstreamSubstOverlapTestTraits);
+
+/**
+ * Words with distinct first characters, adjacent matches and a match
+ * at the very end; this fails if the automaton has not been compiled.
+ */
+class IstreamSubstFirstCharsTestTraits {
+public:
+	static constexpr IstreamFilterTestOptions options{
+		.expected_result = "z1y2x3w123",
+		.enable_buckets = false,
+	};
+
+	UnusedIstreamPtr CreateInput(struct pool &pool) const noexcept {
+		return istream_string_new(pool, "zabycdxefgwabcdefg");
+	}
+
+	UnusedIstreamPtr CreateTest(EventLoop &, struct pool &pool,
+				    UnusedIstreamPtr input) const noexcept {
+		SubstTree tree;
+		tree.Add(pool, "ab", "1");
+		tree.Add(pool, "cd", "2");
+		tree.Add(pool, "efg", "3");
+
+		return UnusedIstreamPtr(istream_subst_new(&pool, std::move(input), std::move(tree)));
+	}
+};
+
+INSTANTIATE_TYPED_TEST_SUITE_P(SubstFirstChars, IstreamFilterTest,
+			       IstreamSubstFirstCharsTestTraits);
@@ -223,6 +223,61 @@ TEST(RubberTest, Shrink)
 	r.Remove(c);
 }
 
+/**
+ * Verify that CompressStep() eventually closes all holes, moving no
+ * more than the given number of bytes per step.
+ */
+TEST(RubberTest, CompressStep)
+{
+	constexpr size_t size = 64 * 1024;
+	constexpr unsigned n = 8;
+
+	Rubber r{4 * 1024 * 1024, "rubber"};
+
+	unsigned ids[n];
+	for (auto &id : ids) {
+		id = AddFillRubber(r, size);
+		ASSERT_GT(id, 0u);
+	}
+
+	/* punch holes by removing every other allocation */
+
+	for (unsigned i = 0; i < n; i += 2)
+		r.Remove(ids[i]);
+
+	ASSERT_EQ(r.GetNettoSize(), size * n / 2);
+	ASSERT_EQ(r.GetBruttoSize(), size * n);
+
+	auto hole_stats = r.GetHoleStats();
+	ASSERT_EQ(hole_stats.n_holes, n / 2);
+	ASSERT_EQ(hole_stats.largest_hole, size);
+
+	/* each step moves at most one allocation */
+
+	unsigned steps = 1;
+	while (r.CompressStep(size))
+		++steps;
+
+	ASSERT_EQ(steps, n / 2);
+
+	ASSERT_EQ(r.GetNettoSize(), size * n / 2);
+	ASSERT_EQ(r.GetBruttoSize(), size * n / 2);
+
+	hole_stats = r.GetHoleStats();
+	ASSERT_EQ(hole_stats.n_holes, 0u);
+	ASSERT_EQ(hole_stats.largest_hole, 0u);
+
+	for (unsigned i = 1; i < n; i += 2)
+		ASSERT_TRUE(CheckRubber(r, ids[i], size));
+
+	/* nothing left to do */
+
+	ASSERT_FALSE(r.CompressStep(size));
+
+	for (unsigned i = 1; i < n; i += 2)
+		r.Remove(ids[i]);
+}
+
 /**
  * Fill the allocation table, see if the allocator fails
  * eventually even though there's memory available.
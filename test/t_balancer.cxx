@@ -422,3 +422,151 @@ TEST(BalancerTest, StickyCookie)
 	ASSERT_NE(result, nullptr);
 	ASSERT_EQ(Find(al, result), 2);
 }
+
+TEST(BalancerTest, LeastRequests)
+{
+	FailureManager fm;
+	EventLoop event_loop;
+	MyBalancer balancer(fm);
+
+	TestPool pool;
+	const AllocatorPtr alloc{pool};
+
+	AddressListBuilder b;
+	b.SetStickyMode(StickyMode::LEAST_REQUESTS);
+	b.Add(alloc, ParseSocketAddress("192.168.0.1", 80, false));
+	b.Add(alloc, ParseSocketAddress("192.168.0.2", 80, false));
+	b.Add(alloc, ParseSocketAddress("192.168.0.3", 80, false));
+	const auto al = b.Finish(alloc);
+
+	/* without load: round-robin */
+
+	SocketAddress result = balancer.Get(al);
+	ASSERT_EQ(Find(al, result), 0);
+
+	result = balancer.Get(al);
+	ASSERT_EQ(Find(al, result), 1);
+
+	/* the least loaded node wins */
+
+	auto &f1 = fm.Make(ParseSocketAddress("192.168.0.1", 80, false));
+	auto &f3 = fm.Make(ParseSocketAddress("192.168.0.3", 80, false));
+	f1.StartRequest();
+	f3.StartRequest();
+	f3.StartRequest();
+
+	result = balancer.Get(al);
+	ASSERT_EQ(Find(al, result), 1);
+
+	result = balancer.Get(al);
+	ASSERT_EQ(Find(al, result), 1);
+
+	/* .. unless it has failed */
+
+	FailureAdd(fm, "192.168.0.2");
+
+	result = balancer.Get(al);
+	ASSERT_EQ(Find(al, result), 0);
+
+	f1.StartRequest();
+	f1.StartRequest();
+
+	result = balancer.Get(al);
+	ASSERT_EQ(Find(al, result), 2);
+
+	f1.FinishRequest();
+	f1.FinishRequest();
+	f1.FinishRequest();
+	f3.FinishRequest();
+	f3.FinishRequest();
+}
+
+TEST(BalancerTest, PeakEwma)
+{
+	FailureManager fm;
+	EventLoop event_loop;
+	MyBalancer balancer(fm);
+
+	TestPool pool;
+	const AllocatorPtr alloc{pool};
+
+	AddressListBuilder b;
+	b.SetStickyMode(StickyMode::PEAK_EWMA);
+	b.Add(alloc, ParseSocketAddress("192.168.0.1", 80, false));
+	b.Add(alloc, ParseSocketAddress("192.168.0.2", 80, false));
+	const auto al = b.Finish(alloc);
+
+	const auto now = std::chrono::steady_clock::now();
+
+	auto &f1 = fm.Make(ParseSocketAddress("192.168.0.1", 80, false));
+	auto &f2 = fm.Make(ParseSocketAddress("192.168.0.2", 80, false));
+
+	/* the first node is slow */
+
+	f1.StartRequest();
+	f1.FinishRequest(now, std::chrono::seconds{2});
+	f2.StartRequest();
+	f2.FinishRequest(now, std::chrono::milliseconds{100});
+
+	for (unsigned i = 0; i < 4; ++i) {
+		SocketAddress result = balancer.Get(al);
+		ASSERT_EQ(Find(al, result), 1);
+	}
+
+	/* the fast node becomes expensive if it has many requests
+	   in flight */
+
+	for (unsigned i = 0; i < 20; ++i)
+		f2.StartRequest();
+
+	SocketAddress result = balancer.Get(al);
+	ASSERT_EQ(Find(al, result), 0);
+
+	for (unsigned i = 0; i < 20; ++i)
+		f2.FinishRequest();
+
+	/* a peak is adopted immediately */
+
+	f2.StartRequest();
+	f2.FinishRequest(now, std::chrono::seconds{5});
+
+	result = balancer.Get(al);
+	ASSERT_EQ(Find(al, result), 0);
+}
+
+TEST(BalancerTest, PowerOfTwoChoices)
+{
+	FailureManager fm;
+	EventLoop event_loop;
+	MyBalancer balancer(fm);
+
+	TestPool pool;
+	const AllocatorPtr alloc{pool};
+
+	/* with only two nodes, both are always sampled */
+
+	AddressListBuilder b;
+	b.SetStickyMode(StickyMode::POWER_OF_TWO_CHOICES);
+	b.Add(alloc, ParseSocketAddress("192.168.0.1", 80, false));
+	b.Add(alloc, ParseSocketAddress("192.168.0.2", 80, false));
+	const auto al = b.Finish(alloc);
+
+	auto &f1 = fm.Make(ParseSocketAddress("192.168.0.1", 80, false));
+	f1.StartRequest();
+
+	for (unsigned i = 0; i < 8; ++i) {
+		SocketAddress result = balancer.Get(al);
+		ASSERT_EQ(Find(al, result), 1);
+	}
+
+	/* a failed node is never picked */
+
+	FailureAdd(fm, "192.168.0.2");
+
+	for (unsigned i = 0; i < 8; ++i) {
+		SocketAddress result = balancer.Get(al);
+		ASSERT_EQ(Find(al, result), 0);
+	}
+
+	f1.FinishRequest();
+}
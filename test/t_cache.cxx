@@ -10,6 +10,9 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
+#include <vector>
+
 #include <time.h>
 
 static void *
@@ -142,3 +145,100 @@ TEST(TranslationCache, Basic)
 	ASSERT_EQ(i->match, 2);
 	ASSERT_EQ(i->value, 4);
 }
+
+static std::vector<std::string>
+MakeKeys(const char *prefix, unsigned n)
+{
+	std::vector<std::string> keys;
+	keys.reserve(n);
+	for (unsigned i = 0; i < n; ++i)
+		keys.emplace_back(std::string{prefix} + std::to_string(i));
+	return keys;
+}
+
+/**
+ * Look up all keys; add the missing ones.
+ */
+static void
+Access(struct pool *pool, Cache &cache, const std::vector<std::string> &keys)
+{
+	for (const auto &i : keys) {
+		const StringWithHash key{i};
+		if (cache.Get(key) == nullptr)
+			cache.Put(*my_cache_item_new(pool, key, 0, 0));
+	}
+}
+
+static unsigned
+CountPresent(Cache &cache, const std::vector<std::string> &keys)
+{
+	unsigned n = 0;
+	for (const auto &i : keys)
+		if (cache.Get(StringWithHash{i}) != nullptr)
+			++n;
+	return n;
+}
+
+/**
+ * A scan over many keys which are requested only once must not
+ * evict the frequently used ones.
+ */
+TEST(Cache, TinyLFU)
+{
+	PInstance instance;
+
+	const auto hot = MakeKeys("hot", 50);
+	const auto cold = MakeKeys("cold", 1000);
+
+	{
+		Cache cache(instance.event_loop, 100);
+
+		for (unsigned i = 0; i < 4; ++i)
+			Access(instance.root_pool, cache, hot);
+
+		Access(instance.root_pool, cache, cold);
+
+		/* LRU has forgotten all hot keys */
+		EXPECT_EQ(CountPresent(cache, hot), 0U);
+	}
+
+	{
+		Cache cache(instance.event_loop, 100, nullptr,
+			    CachePolicy::TINY_LFU);
+
+		for (unsigned i = 0; i < 4; ++i)
+			Access(instance.root_pool, cache, hot);
+
+		Access(instance.root_pool, cache, cold);
+
+		EXPECT_EQ(CountPresent(cache, hot), hot.size());
+
+		/* the most recent cold key is still in the window */
+		EXPECT_NE(cache.Get(StringWithHash{cold.back()}), nullptr);
+	}
+}
+
+/**
+ * The frequency sketch grows with the number of items; this must not
+ * lose the popularity of the hot keys, or a scan would evict them
+ * right after the growth.
+ */
+TEST(Cache, TinyLFUGrow)
+{
+	PInstance instance;
+
+	const auto hot = MakeKeys("hot", 50);
+	const auto cold = MakeKeys("cold", 3000);
+
+	Cache cache(instance.event_loop, 2000, nullptr,
+		    CachePolicy::TINY_LFU);
+
+	for (unsigned i = 0; i < 4; ++i)
+		Access(instance.root_pool, cache, hot);
+
+	/* this grows the sketch (beyond its initial 1024 counters
+	   per row) before the cache is full */
+	Access(instance.root_pool, cache, cold);
+
+	EXPECT_EQ(CountPresent(cache, hot), hot.size());
+}
@@ -4,6 +4,7 @@
 
 #include "t_client.hxx"
 #include "fcgi/Client.hxx"
+#include "fcgi/MuxConnection.hxx"
 #include "system/SetupProcess.hxx"
 #include "io/Pipe.hxx"
 #include "io/UniqueFileDescriptor.hxx"
@@ -14,6 +15,7 @@
 #include "net/SocketPair.hxx"
 #include "net/UniqueSocketDescriptor.hxx"
 #include "util/ByteOrder.hxx"
+#include "util/Cancellable.hxx"
 #include "util/PrintException.hxx"
 #include "util/SpanCast.hxx"
 #include "fcgi_server.hxx"
@@ -697,3 +699,187 @@ TEST_P(FcgiClientB, BlockingStderr)
 INSTANTIATE_TEST_SUITE_P(FcgiClient,
                          FcgiClientB,
                          testing::Values(false, true));
+
+namespace {
+
+class NullFcgiMuxConnectionHandler final : public FcgiMuxConnectionHandler {
+public:
+	/* virtual methods from class FcgiMuxConnectionHandler */
+	void OnFcgiMuxReady() noexcept override {}
+	void OnFcgiMuxUnsupported() noexcept override {}
+	void OnFcgiMuxError(std::exception_ptr) noexcept override {}
+};
+
+/**
+ * Receives the response of one request on a #FcgiMuxConnection.
+ */
+struct MuxContext final : Lease, HttpResponseHandler, IstreamSink {
+	EventLoop &event_loop;
+
+	CancellablePointer cancel_ptr;
+
+	HttpStatus status{};
+	std::exception_ptr error;
+
+	std::size_t body_size = 0;
+
+	/**
+	 * Refuse all response body data?
+	 */
+	bool block_body = false;
+
+	bool body_eof = false, released = false;
+
+	explicit MuxContext(EventLoop &_event_loop) noexcept
+		:event_loop(_event_loop) {}
+
+	bool IsDone() const noexcept {
+		return released && (body_eof || error);
+	}
+
+	void Unblock() noexcept {
+		block_body = false;
+		input.Read();
+	}
+
+	/* virtual methods from class Lease */
+	PutAction ReleaseLease(PutAction action) noexcept override {
+		released = true;
+		return action;
+	}
+
+	/* virtual methods from class HttpResponseHandler */
+	void OnHttpResponse(HttpStatus _status, StringMap &&,
+			    UnusedIstreamPtr body) noexcept override {
+		status = _status;
+		SetInput(std::move(body));
+	}
+
+	void OnHttpError(std::exception_ptr ep) noexcept override {
+		error = ep;
+		event_loop.Break();
+	}
+
+	/* virtual methods from class IstreamHandler */
+	std::size_t OnData(std::span<const std::byte> src) noexcept override {
+		if (block_body)
+			return 0;
+
+		body_size += src.size();
+		return src.size();
+	}
+
+	void OnEof() noexcept override {
+		ClearInput();
+		body_eof = true;
+		event_loop.Break();
+	}
+
+	void OnError(std::exception_ptr ep) noexcept override {
+		ClearInput();
+		error = ep;
+		event_loop.Break();
+	}
+};
+
+} // anonymous namespace
+
+/**
+ * Two requests on one multiplexed connection; the response body of
+ * the first one is not consumed, which must not delay the second
+ * one.
+ */
+TEST(FcgiMuxConnection, SlowResponseBody)
+{
+	static constexpr std::size_t a_length = 256 * 1024;
+
+	Instance instance;
+
+	auto [server_socket, client_socket] = CreateStreamSocketPair();
+
+	std::thread thread{[](UniqueSocketDescriptor s){
+		auto pool = pool_new_libc(nullptr, "f");
+		FcgiServer server{std::move(s)};
+
+		try {
+			const auto a = server.ReadRequest(*pool);
+			server.DiscardRequestBody(a);
+			const auto b = server.ReadRequest(*pool);
+			server.DiscardRequestBody(b);
+
+			server.WriteStdout(a, "content-length: 262144\n\n"sv);
+
+			char buffer[23456];
+			memset(buffer, 0xab, sizeof(buffer));
+
+			for (std::size_t remaining = a_length; remaining > 0;) {
+				const std::size_t nbytes = std::min(remaining, sizeof(buffer));
+				server.WriteStdout(a, {buffer, nbytes});
+				remaining -= nbytes;
+			}
+
+			server.WriteStdout(b, "content-length: 5\n\nhello"sv);
+			server.EndResponse(b);
+			server.EndResponse(a);
+			server.FlushOutput();
+
+			/* wait until the client closes the connection */
+			std::byte dummy;
+			(void)server.ReadRaw({&dummy, 1});
+		} catch (...) {
+			PrintException(std::current_exception());
+		}
+
+		server.Shutdown();
+		pool.reset();
+	}, std::move(server_socket)};
+
+	client_socket.SetNonBlocking();
+
+	NullFcgiMuxConnectionHandler mux_handler;
+	auto connection = std::make_unique<FcgiMuxConnection>(instance.event_loop,
+							      std::move(client_socket),
+							      true, mux_handler);
+
+	auto pool = pool_new_linear(instance.root_pool, "mux", 8192);
+	const StringMap headers;
+
+	MuxContext a{instance.event_loop}, b{instance.event_loop};
+	a.block_body = true;
+
+	connection->SendRequest(*pool, nullptr, a,
+				HttpMethod::GET, "/a", "/a", nullptr, nullptr,
+				nullptr, nullptr, "192.168.1.100",
+				headers, nullptr, {}, {},
+				a, a.cancel_ptr);
+	connection->SendRequest(*pool, nullptr, b,
+				HttpMethod::GET, "/b", "/b", nullptr, nullptr,
+				nullptr, nullptr, "192.168.1.100",
+				headers, nullptr, {}, {},
+				b, b.cancel_ptr);
+
+	while (!b.IsDone())
+		instance.event_loop.Run();
+
+	EXPECT_FALSE(b.error);
+	EXPECT_EQ(b.status, HttpStatus::OK);
+	EXPECT_EQ(b.body_size, 5U);
+	EXPECT_TRUE(b.body_eof);
+
+	/* the first response has been buffered completely */
+	EXPECT_FALSE(a.error);
+	EXPECT_EQ(a.status, HttpStatus::OK);
+	EXPECT_EQ(a.body_size, 0U);
+	EXPECT_FALSE(a.body_eof);
+
+	a.Unblock();
+	while (!a.IsDone())
+		instance.event_loop.Run();
+
+	EXPECT_FALSE(a.error);
+	EXPECT_EQ(a.body_size, a_length);
+	EXPECT_TRUE(a.body_eof);
+
+	connection.reset();
+	thread.join();
+}
@@ -24,6 +24,8 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
+
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <stdio.h>
@@ -116,6 +118,12 @@ public:
 	bool got_request;
 	bool validated;
 
+	/**
+	 * The conditional headers of the most recent request (empty
+	 * if there was none).
+	 */
+	std::string if_modified_since, if_none_match;
+
 	/* virtual methods from class ResourceLoader */
 	void SendRequest(struct pool &pool,
 			 const StopwatchPtr &parent_stopwatch,
@@ -149,6 +157,11 @@ MyResourceLoader::SendRequest(struct pool &pool,
 
 	validated = headers.Get("if-modified-since") != nullptr;
 
+	const char *ims = headers.Get("if-modified-since");
+	if_modified_since = ims != nullptr ? ims : "";
+	const char *inm = headers.Get("if-none-match");
+	if_none_match = inm != nullptr ? inm : "";
+
 	auto *expected_rh = parse_request_headers(pool, *request);
 	if (expected_rh != NULL) {
 		for (const auto &i : headers) {
@@ -193,8 +206,14 @@ struct Instance final : TestInstance {
 	}
 };
 
+/**
+ * @param origin if not nullptr, then the response is expected to come
+ * from the cache, but a request to the origin server (which is
+ * answered with this) is expected nonetheless (revalidation)
+ */
 static void
-run_cache_test(Instance &instance, const Request &request, bool cached)
+run_cache_test(Instance &instance, const Request &request, bool cached,
+	       const Request *origin=nullptr)
 {
 	auto pool = pool_new_linear(instance.root_pool, "t_http_cache", 8192);
 	const AllocatorPtr alloc{pool};
@@ -203,7 +222,9 @@ run_cache_test(Instance &instance, const Request &request, bool cached)
 
 	CancellablePointer cancel_ptr;
 
-	instance.resource_loader.current_request = cached ? nullptr : &request;
+	instance.resource_loader.current_request = origin != nullptr
+		? origin
+		: (cached ? nullptr : &request);
 
 	StringMap headers;
 	if (request.request_headers != NULL) {
@@ -234,7 +255,8 @@ run_cache_test(Instance &instance, const Request &request, bool cached)
 	if (handler.IsAlive())
 		instance.event_loop.Run();
 
-	ASSERT_NE(instance.resource_loader.got_request, cached);
+	ASSERT_EQ(instance.resource_loader.got_request,
+		  !cached || origin != nullptr);
 	ASSERT_FALSE(handler.IsAlive());
 	ASSERT_EQ(handler.error, nullptr);
 
@@ -532,3 +554,72 @@ TEST(HttpCache, Tag)
 	run_cache_test(instance, request, false);
 	run_cache_test(instance, request, true);
 }
+
+TEST(HttpCache, StaleWhileRevalidate)
+{
+	Instance instance;
+
+	/* already expired, but may be served stale for another day */
+	static constexpr Request stale{
+		.uri = "/stale-while-revalidate",
+		.response_headers = "date: " DATE "\n"
+		"last-modified: " STAMP1 "\n"
+		"expires: " STAMP1 "\n"
+		"cache-control: stale-while-revalidate=86400\n",
+		.response_body = "foo",
+	};
+
+	static constexpr Request fresh{
+		.uri = "/stale-while-revalidate",
+		.response_headers = "date: " DATE "\n"
+		"last-modified: " STAMP1 "\n"
+		"expires: " EXPIRES "\n",
+		.response_body = "bar",
+	};
+
+	run_cache_test(instance, stale, false);
+
+	/* the stale document is served immediately, and the
+	   revalidation request runs in the background; the
+	   client's conditional headers are not forwarded */
+	auto conditional = stale;
+	conditional.request_headers = "if-none-match: \"abc\"\n"
+		"if-modified-since: " STAMP2 "\n";
+	run_cache_test(instance, conditional, true, &fresh);
+	ASSERT_EQ(instance.resource_loader.if_modified_since, STAMP1);
+	ASSERT_EQ(instance.resource_loader.if_none_match, "");
+
+	/* the background revalidation has updated the cache */
+	run_cache_test(instance, fresh, true);
+}
+
+TEST(HttpCache, StaleIfError)
+{
+	Instance instance;
+
+	/* already expired, but may be served stale for another day
+	   if the server fails */
+	static constexpr Request stale{
+		.uri = "/stale-if-error",
+		.response_headers = "date: " DATE "\n"
+		"last-modified: " STAMP1 "\n"
+		"expires: " STAMP1 "\n"
+		"cache-control: stale-if-error=86400\n",
+		.response_body = "foo",
+	};
+
+	static constexpr Request error{
+		.uri = "/stale-if-error",
+		.status = HttpStatus::SERVICE_UNAVAILABLE,
+		.response_headers = "",
+		.response_body = "error",
+	};
+
+	run_cache_test(instance, stale, false);
+
+	/* revalidation fails; the stale document is served
+	   instead */
+	run_cache_test(instance, stale, true, &error);
+	ASSERT_TRUE(instance.resource_loader.validated);
+	run_cache_test(instance, stale, true, &error);
+}
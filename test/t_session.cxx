@@ -5,11 +5,19 @@
 #include "bp/session/Lease.hxx"
 #include "bp/session/Session.hxx"
 #include "bp/session/Manager.hxx"
+#include "bp/session/Snapshot.hxx"
+#include "bp/session/Write.hxx"
 #include "event/Loop.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "io/FdOutputStream.hxx"
+#include "io/UniqueFileDescriptor.hxx"
 
 #include <gtest/gtest.h>
 
+#include <vector>
+
 #include <unistd.h>
+#include <sys/mman.h> // for memfd_create()
 #include <sys/types.h>
 #include <sys/wait.h>
 
@@ -35,3 +43,135 @@ TEST(SessionTest, Basic)
 	widget = realm->GetWidget("a_widget_name", true);
 	ASSERT_NE(widget, nullptr);
 }
+
+TEST(SessionTest, Cleanup)
+{
+	EventLoop event_loop;
+
+	/* with an idle timeout of zero, sessions expire as soon as
+	   they are used */
+	SessionManager session_manager(event_loop, std::chrono::seconds{},
+				       0, 0);
+
+	const auto a = session_manager.CreateSession()->id;
+	const auto b = session_manager.CreateSession()->id;
+	ASSERT_EQ(session_manager.Count(), 2U);
+
+	ASSERT_TRUE(SessionLease(session_manager, a));
+
+	session_manager.Cleanup();
+	ASSERT_EQ(session_manager.Count(), 1U);
+	ASSERT_FALSE(SessionLease(session_manager, a));
+
+	/* new sessions have their own time to live and are not
+	   affected by the idle timeout */
+	ASSERT_TRUE(SessionLease(session_manager, b));
+}
+
+TEST(SessionTest, Snapshot)
+{
+	EventLoop event_loop;
+
+	UniqueFileDescriptor fd{memfd_create("sessions", MFD_CLOEXEC)};
+	ASSERT_TRUE(fd.IsDefined());
+
+	SessionId id;
+
+	{
+		SessionManager session_manager(event_loop,
+					       std::chrono::minutes(30),
+					       0, 0);
+
+		auto session = session_manager.CreateSession();
+		id = session->id;
+
+		auto *realm = session->GetRealm("a_realm_name");
+		ASSERT_NE(realm, nullptr);
+		realm->SetUser("a_user", std::chrono::seconds(-1));
+
+		FdOutputStream fos{fd};
+		WithBufferedOutputStream(fos, [&session](BufferedOutputStream &bos){
+			std::vector<std::byte> buffer;
+			session_write_file_header(bos);
+			session_write(bos, *session, buffer);
+			session_write_file_tail(bos);
+		});
+	}
+
+	SessionManager session_manager(event_loop, std::chrono::minutes(30),
+				       0, 0);
+	ASSERT_TRUE(session_manager.LoadSnapshot(std::make_unique<SessionSnapshot>(fd)));
+	ASSERT_EQ(session_manager.Count(), 1U);
+
+	/* not yet materialized */
+	const Session *peek = session_manager.Peek(id);
+	ASSERT_NE(peek, nullptr);
+	ASSERT_TRUE(peek->realms.empty());
+
+	SessionLease session{session_manager, id};
+	ASSERT_TRUE(session);
+	ASSERT_EQ(session.get(), peek);
+	ASSERT_TRUE(session->HasUser());
+
+	const auto *realm = session->GetRealm("a_realm_name");
+	ASSERT_NE(realm, nullptr);
+	ASSERT_STREQ(realm->user.c_str(), "a_user");
+}
+
+TEST(SessionTest, PurgeSnapshot)
+{
+	EventLoop event_loop;
+
+	UniqueFileDescriptor fd{memfd_create("sessions", MFD_CLOEXEC)};
+	ASSERT_TRUE(fd.IsDefined());
+
+	SessionId with_user, without_user;
+
+	{
+		SessionManager session_manager(event_loop,
+					       std::chrono::minutes(30),
+					       0, 0);
+
+		auto a = session_manager.CreateSession();
+		with_user = a->id;
+		a->cookie_received = true;
+
+		auto *realm = a->GetRealm("a_realm_name");
+		ASSERT_NE(realm, nullptr);
+		realm->SetUser("a_user", std::chrono::seconds(-1));
+
+		auto b = session_manager.CreateSession();
+		without_user = b->id;
+		b->cookie_received = true;
+		ASSERT_NE(b->GetRealm("a_realm_name"), nullptr);
+
+		FdOutputStream fos{fd};
+		WithBufferedOutputStream(fos, [&a, &b](BufferedOutputStream &bos){
+			std::vector<std::byte> buffer;
+			session_write_file_header(bos);
+			session_write(bos, *a, buffer);
+			session_write(bos, *b, buffer);
+			session_write_file_tail(bos);
+		});
+	}
+
+	SessionManager session_manager(event_loop, std::chrono::minutes(30),
+				       0, 0);
+	ASSERT_TRUE(session_manager.LoadSnapshot(std::make_unique<SessionSnapshot>(fd)));
+	ASSERT_EQ(session_manager.Count(), 2U);
+
+	/* the session without a user has the higher score and gets
+	   purged; neither session gets materialized */
+	ASSERT_TRUE(session_manager.Purge());
+	ASSERT_EQ(session_manager.Count(), 1U);
+	ASSERT_EQ(session_manager.Peek(without_user), nullptr);
+
+	const Session *peek = session_manager.Peek(with_user);
+	ASSERT_NE(peek, nullptr);
+	ASSERT_NE(peek->pending_payload.data(), nullptr);
+	ASSERT_TRUE(peek->realms.empty());
+
+	SessionLease session{session_manager, with_user};
+	ASSERT_TRUE(session);
+	ASSERT_TRUE(session->HasUser());
+}
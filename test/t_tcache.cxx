@@ -21,12 +21,29 @@
 #include "spawn/NamespaceOptions.hxx"
 #include "pool/pool.hxx"
 #include "PInstance.hxx"
+#include "event/FineTimerEvent.hxx"
+#include "event/InotifyManager.hxx"
+#include "io/FdCache.hxx"
+#include "io/FileDescriptor.hxx"
+#include "util/BindMethod.hxx"
 #include "util/Cancellable.hxx"
 #include "util/StringAPI.hxx"
 #include "stopwatch.hxx"
 
 #include <gtest/gtest.h>
 
+#include <list>
+#include <optional>
+#include <string>
+
+#include <dirent.h>
+#include <fcntl.h> // for AT_FDCWD
+#include <linux/openat2.h> // for struct open_how
+#include <stdio.h> // for rename()
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using std::string_view_literals::operator""sv;
 
 class MyTranslationService final : public TranslationService {
@@ -47,6 +64,65 @@ struct Instance : PInstance {
 		:cache(root_pool, event_loop, ts, 1024) {}
 };
 
+/**
+ * A temporary directory which is deleted (including all files in
+ * it) at the end of the test.
+ */
+class TempDirectory {
+	char path[64] = "/tmp/t_tcache.XXXXXX";
+
+public:
+	TempDirectory() {
+		if (mkdtemp(path) == nullptr)
+			throw std::runtime_error{"mkdtemp() failed"};
+	}
+
+	~TempDirectory() noexcept {
+		if (DIR *dir = opendir(path)) {
+			while (const auto *e = readdir(dir))
+				if (e->d_name[0] != '.')
+					unlinkat(dirfd(dir), e->d_name,
+						 e->d_type == DT_DIR ? AT_REMOVEDIR : 0);
+			closedir(dir);
+		}
+
+		rmdir(path);
+	}
+
+	std::string GetPath(const char *name) const noexcept {
+		return std::string{path} + "/" + name;
+	}
+};
+
+/**
+ * An #Instance whose #TranslationCache watches VALIDATE_MTIME files
+ * with inotify.
+ */
+struct InotifyInstance : PInstance {
+	TempDirectory directory;
+
+	MyTranslationService ts;
+
+	InotifyManager inotify_manager{event_loop};
+
+	TranslationCache cache{root_pool, event_loop, ts, 1024, &inotify_manager};
+
+	FineTimerEvent break_timer{event_loop, BIND_THIS_METHOD(Break)};
+
+	void Break() noexcept {
+		event_loop.Break();
+	}
+
+	/**
+	 * Run the #EventLoop for a while to receive pending inotify
+	 * events.
+	 */
+	void RunFor(Event::Duration duration) noexcept {
+		break_timer.Schedule(duration);
+		event_loop.Run();
+	}
+};
+
 const TranslateResponse *next_response;
 
 void
@@ -1165,3 +1241,479 @@ TEST(TranslationCache, ExpandBindMount)
 		    .BindMount("/home/bar", "/mnt")
 		    .BindMount("/etc", "/etc")));
 }
+
+static void
+WriteFile(const std::string &path, const char *contents)
+{
+	FILE *file = fopen(path.c_str(), "w");
+	if (file == nullptr)
+		throw std::runtime_error{"fopen() failed"};
+
+	fputs(contents, file);
+	fclose(file);
+}
+
+static uint_least64_t
+GetMtime(const std::string &path)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) < 0)
+		throw std::runtime_error{"stat() failed"};
+
+	return st.st_mtime;
+}
+
+static void
+SetMtime(const std::string &path, uint_least64_t mtime)
+{
+	const struct timespec times[2]{
+		{.tv_sec = (time_t)mtime, .tv_nsec = 0},
+		{.tv_sec = (time_t)mtime, .tv_nsec = 0},
+	};
+
+	if (utimensat(AT_FDCWD, path.c_str(), times, 0) < 0)
+		throw std::runtime_error{"utimensat() failed"};
+}
+
+/**
+ * Replacing a VALIDATE_MTIME file with rename() invalidates the cache
+ * item, even if the new file has the same modification time (which
+ * statx() would not notice).
+ */
+TEST(TranslationCache, InotifyRename)
+{
+	InotifyInstance instance;
+	struct pool &pool = instance.root_pool;
+	auto &cache = instance.cache;
+
+	const auto path = instance.directory.GetPath("a");
+	const auto tmp_path = instance.directory.GetPath("a.tmp");
+	WriteFile(path, "foo");
+	const auto mtime = GetMtime(path);
+
+	const auto response = MakeResponse(pool).File("/var/www/a.html")
+		.ValidateMtime(mtime, path.c_str());
+
+	Feed(pool, cache, MakeRequest("/a"), response);
+	Cached(pool, cache, MakeRequest("/a"), response);
+
+	/* other files in the same directory don't matter */
+	WriteFile(instance.directory.GetPath("b"), "bar");
+	instance.RunFor(std::chrono::milliseconds{1});
+	Cached(pool, cache, MakeRequest("/a"), response);
+
+	WriteFile(tmp_path, "bar");
+	SetMtime(tmp_path, mtime);
+	ASSERT_EQ(rename(tmp_path.c_str(), path.c_str()), 0);
+
+	instance.RunFor(std::chrono::milliseconds{1});
+	CachedError(pool, cache, MakeRequest("/a"));
+}
+
+/**
+ * VALIDATE_MTIME with mtime=0 (the file must not exist) is watched
+ * through the directory; creating the file invalidates the cache
+ * item, even if it is deleted again before the next lookup (which
+ * statx() would not notice).
+ */
+TEST(TranslationCache, InotifyCreate)
+{
+	InotifyInstance instance;
+	struct pool &pool = instance.root_pool;
+	auto &cache = instance.cache;
+
+	const auto path = instance.directory.GetPath("a");
+
+	const auto response = MakeResponse(pool).File("/var/www/a.html")
+		.ValidateMtime(0, path.c_str());
+
+	Feed(pool, cache, MakeRequest("/a"), response);
+	Cached(pool, cache, MakeRequest("/a"), response);
+
+	WriteFile(path, "foo");
+	ASSERT_EQ(unlink(path.c_str()), 0);
+
+	instance.RunFor(std::chrono::milliseconds{1});
+	CachedError(pool, cache, MakeRequest("/a"));
+}
+
+/**
+ * An #InotifyInstance which also has a #FdCache, which uses its own
+ * #InotifyManager (like #BpInstance).
+ */
+struct FdCacheInotifyInstance : InotifyInstance {
+	FdCache fd_cache{
+		event_loop,
+#ifdef HAVE_URING
+		nullptr,
+#endif
+	};
+
+	~FdCacheInotifyInstance() noexcept {
+		fd_cache.BeginShutdown();
+	}
+};
+
+/**
+ * Opens a directory with #FdCache and holds a lease on it.  Without
+ * io_uring, FdCache::Get() finishes synchronously.
+ */
+class FdCacheDirectory {
+	CancellablePointer cancel_ptr;
+
+	SharedLease lease;
+
+	FileDescriptor fd = FileDescriptor::Undefined();
+
+public:
+	FdCacheDirectory(FdCache &fd_cache, const std::string &path) noexcept {
+		static constexpr struct open_how how{
+			.flags = O_PATH|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC,
+		};
+
+		fd_cache.Get(FileDescriptor{AT_FDCWD}, {}, path, how, 0,
+			     BIND_THIS_METHOD(OnSuccess), BIND_THIS_METHOD(OnError),
+			     cancel_ptr);
+	}
+
+	FileDescriptor GetFileDescriptor() const noexcept {
+		return fd;
+	}
+
+private:
+	void OnSuccess(FileDescriptor _fd, const struct statx &,
+		       FileMetadata &, SharedLease &&_lease) noexcept {
+		fd = _fd;
+		lease = std::move(_lease);
+	}
+
+	void OnError(int) noexcept {}
+};
+
+static void
+TestSharedDirectory(FdCacheInotifyInstance &instance, const char *name,
+		    bool fd_cache_first)
+{
+	struct pool &pool = instance.root_pool;
+	auto &cache = instance.cache;
+
+	const auto dir_path = instance.directory.GetPath(name);
+	ASSERT_EQ(mkdir(dir_path.c_str(), 0700), 0);
+
+	const auto path = dir_path + "/a";
+	const auto uri = std::string{"/"} + name;
+
+	const auto response = MakeResponse(pool).File("/var/www/a.html")
+		.ValidateMtime(0, path.c_str());
+
+	std::optional<FdCacheDirectory> old_directory;
+
+	if (fd_cache_first)
+		old_directory.emplace(instance.fd_cache, dir_path);
+
+	Feed(pool, cache, MakeRequest(uri.c_str()), response);
+	Cached(pool, cache, MakeRequest(uri.c_str()), response);
+
+	if (!fd_cache_first)
+		old_directory.emplace(instance.fd_cache, dir_path);
+
+	ASSERT_TRUE(old_directory->GetFileDescriptor().IsDefined());
+
+	/* only the translation cache's directory watch notices
+	   this; statx() would not */
+	WriteFile(path, "foo");
+	ASSERT_EQ(unlink(path.c_str()), 0);
+
+	instance.RunFor(std::chrono::milliseconds{1});
+	CachedError(pool, cache, MakeRequest(uri.c_str()));
+
+	/* replace the directory; only the FdCache's watch notices
+	   this */
+	ASSERT_EQ(rename(dir_path.c_str(), (dir_path + ".old").c_str()), 0);
+	ASSERT_EQ(mkdir(dir_path.c_str(), 0700), 0);
+
+	instance.RunFor(std::chrono::milliseconds{1});
+
+	FdCacheDirectory new_directory{instance.fd_cache, dir_path};
+	ASSERT_TRUE(new_directory.GetFileDescriptor().IsDefined());
+	EXPECT_NE(new_directory.GetFileDescriptor(),
+		  old_directory->GetFileDescriptor());
+}
+
+/**
+ * The #FdCache and the #TranslationCache watch the same directory
+ * with IN_MASK_CREATE; this must work in both orders, i.e. they must
+ * not share an inotify instance.
+ */
+TEST(TranslationCache, InotifySharedDirectory)
+{
+	FdCacheInotifyInstance instance;
+
+	TestSharedDirectory(instance, "fd_cache_first", true);
+	TestSharedDirectory(instance, "tcache_first", false);
+}
+
+/**
+ * A hit on a response without BASE/regex borrows the cached response;
+ * the lease attached to the caller's pool keeps the item alive even
+ * after it has been flushed from the cache.
+ */
+TEST(TranslationCache, Borrow)
+{
+	Instance instance;
+	struct pool &pool = instance.root_pool;
+	auto &cache = instance.cache;
+
+	const auto response1 = MakeResponse(pool).File("/var/www/index.html");
+	Feed(pool, cache, MakeRequest("/"), response1);
+
+	{
+		RecordingTranslateHandler handler(pool);
+		CancellablePointer cancel_ptr;
+
+		next_response = nullptr;
+		cache.SendRequest(AllocatorPtr{handler.pool},
+				  MakeRequest("/"), nullptr,
+				  handler, cancel_ptr);
+		ExpectResponse(handler, response1);
+		EXPECT_TRUE(handler.borrowed);
+
+		/* the item stays alive until the handler's pool is
+		   destroyed */
+		cache.Flush();
+		CachedError(pool, cache, MakeRequest("/"));
+	}
+
+	/* BASE requires a modified copy */
+	Feed(pool, cache, MakeRequest("/foo/bar.html"),
+	     MakeResponse(pool).Base("/foo/")
+	     .File("bar.html", "/srv/foo/"));
+
+	RecordingTranslateHandler handler(pool);
+	CancellablePointer cancel_ptr;
+
+	next_response = nullptr;
+	cache.SendRequest(AllocatorPtr{handler.pool},
+			  MakeRequest("/foo/index.html"), nullptr,
+			  handler, cancel_ptr);
+	ExpectResponse(handler, MakeResponse(pool).Base("/foo/")
+		       .File("index.html", "/srv/foo/"));
+	EXPECT_FALSE(handler.borrowed);
+}
+
+/**
+ * A #TranslationService which holds all requests until Finish() is
+ * called.
+ */
+class DeferredTranslationService final : public TranslationService {
+	struct Pending final : Cancellable {
+		const AllocatorPtr alloc;
+
+		TranslateHandler *handler;
+
+		Pending(AllocatorPtr _alloc, TranslateHandler &_handler,
+			CancellablePointer &cancel_ptr) noexcept
+			:alloc(_alloc), handler(&_handler)
+		{
+			cancel_ptr = *this;
+		}
+
+		/* virtual methods from class Cancellable */
+		void Cancel() noexcept override {
+			handler = nullptr;
+		}
+	};
+
+	std::list<Pending> pending;
+
+public:
+	/**
+	 * The total number of requests received so far.
+	 */
+	unsigned n_requests = 0;
+
+	/**
+	 * Finish the oldest request which has not been canceled; a
+	 * nullptr response fails it.
+	 */
+	void Finish(const TranslateResponse *response) noexcept {
+		while (pending.front().handler == nullptr)
+			pending.pop_front();
+
+		const auto alloc = pending.front().alloc;
+		auto &handler = *pending.front().handler;
+		pending.pop_front();
+
+		if (response != nullptr) {
+			auto r = UniquePoolPtr<TranslateResponse>::Make(alloc.GetPool());
+			r->FullCopyFrom(alloc, *response);
+			handler.OnTranslateResponse(std::move(r));
+		} else
+			handler.OnTranslateError(std::make_exception_ptr(std::runtime_error("Error")));
+	}
+
+	/* virtual methods from class TranslationService */
+	void SendRequest(AllocatorPtr alloc,
+			 const TranslateRequest &,
+			 const StopwatchPtr &,
+			 TranslateHandler &handler,
+			 CancellablePointer &cancel_ptr) noexcept override {
+		++n_requests;
+		pending.emplace_back(alloc, handler, cancel_ptr);
+	}
+};
+
+struct DeferredInstance : PInstance {
+	DeferredTranslationService ts;
+	TranslationCache cache;
+
+	DeferredInstance()
+		:cache(root_pool, event_loop, ts, 1024) {}
+};
+
+/**
+ * Concurrent misses with the same key send only one request to the
+ * translation server; all of them receive its response.
+ */
+TEST(TranslationCache, Coalesce)
+{
+	DeferredInstance instance;
+	struct pool &pool = instance.root_pool;
+	auto &cache = instance.cache;
+
+	RecordingTranslateHandler h1(pool), h2(pool), h3(pool), h4(pool);
+	CancellablePointer c1, c2, c3, c4;
+
+	cache.SendRequest(AllocatorPtr{h1.pool}, MakeRequest("/"), nullptr,
+			  h1, c1);
+	cache.SendRequest(AllocatorPtr{h2.pool}, MakeRequest("/"), nullptr,
+			  h2, c2);
+	cache.SendRequest(AllocatorPtr{h3.pool}, MakeRequest("/"), nullptr,
+			  h3, c3);
+
+	/* a different key is not coalesced */
+	cache.SendRequest(AllocatorPtr{h4.pool}, MakeRequest("/other"), nullptr,
+			  h4, c4);
+
+	EXPECT_EQ(instance.ts.n_requests, 2U);
+	EXPECT_FALSE(h1.finished);
+	EXPECT_FALSE(h2.finished);
+	EXPECT_FALSE(h3.finished);
+
+	const auto response = MakeResponse(pool).File("/var/www/index.html");
+	instance.ts.Finish(&response);
+
+	ExpectResponse(h1, response);
+	ExpectResponse(h2, response);
+	ExpectResponse(h3, response);
+	EXPECT_FALSE(h4.finished);
+	EXPECT_EQ(instance.ts.n_requests, 2U);
+
+	const auto response4 = MakeResponse(pool).File("/var/www/other.html");
+	instance.ts.Finish(&response4);
+	ExpectResponse(h4, response4);
+
+	Cached(pool, cache, MakeRequest("/"), response);
+	EXPECT_EQ(instance.ts.n_requests, 2U);
+}
+
+/**
+ * An error is forwarded to all waiters.
+ */
+TEST(TranslationCache, CoalesceError)
+{
+	DeferredInstance instance;
+	struct pool &pool = instance.root_pool;
+	auto &cache = instance.cache;
+
+	RecordingTranslateHandler h1(pool), h2(pool);
+	CancellablePointer c1, c2;
+
+	cache.SendRequest(AllocatorPtr{h1.pool}, MakeRequest("/"), nullptr,
+			  h1, c1);
+	cache.SendRequest(AllocatorPtr{h2.pool}, MakeRequest("/"), nullptr,
+			  h2, c2);
+	EXPECT_EQ(instance.ts.n_requests, 1U);
+
+	instance.ts.Finish(nullptr);
+
+	ExpectError(h1);
+	ExpectError(h2);
+	EXPECT_EQ(instance.ts.n_requests, 1U);
+}
+
+/**
+ * If the response is not cacheable, each waiter sends its own
+ * request.
+ */
+TEST(TranslationCache, CoalesceNotCacheable)
+{
+	DeferredInstance instance;
+	struct pool &pool = instance.root_pool;
+	auto &cache = instance.cache;
+
+	RecordingTranslateHandler h1(pool), h2(pool), h3(pool);
+	CancellablePointer c1, c2, c3;
+
+	cache.SendRequest(AllocatorPtr{h1.pool}, MakeRequest("/"), nullptr,
+			  h1, c1);
+	cache.SendRequest(AllocatorPtr{h2.pool}, MakeRequest("/"), nullptr,
+			  h2, c2);
+	cache.SendRequest(AllocatorPtr{h3.pool}, MakeRequest("/"), nullptr,
+			  h3, c3);
+	EXPECT_EQ(instance.ts.n_requests, 1U);
+
+	auto response = MakeResponse(pool).File("/var/www/index.html");
+	response.max_age = std::chrono::seconds::zero();
+	instance.ts.Finish(&response);
+
+	ExpectResponse(h1, response);
+	EXPECT_FALSE(h2.finished);
+	EXPECT_FALSE(h3.finished);
+
+	/* the waiters were not serialized */
+	EXPECT_EQ(instance.ts.n_requests, 3U);
+
+	instance.ts.Finish(&response);
+	instance.ts.Finish(&response);
+	ExpectResponse(h2, response);
+	ExpectResponse(h3, response);
+}
+
+/**
+ * Canceling the pending request lets the first waiter send a new
+ * one, which the other waiters wait for; canceling a waiter does not
+ * affect the others.
+ */
+TEST(TranslationCache, CoalesceCancel)
+{
+	DeferredInstance instance;
+	struct pool &pool = instance.root_pool;
+	auto &cache = instance.cache;
+
+	RecordingTranslateHandler h1(pool), h2(pool), h3(pool), h4(pool);
+	CancellablePointer c1, c2, c3, c4;
+
+	cache.SendRequest(AllocatorPtr{h1.pool}, MakeRequest("/"), nullptr,
+			  h1, c1);
+	cache.SendRequest(AllocatorPtr{h2.pool}, MakeRequest("/"), nullptr,
+			  h2, c2);
+	cache.SendRequest(AllocatorPtr{h3.pool}, MakeRequest("/"), nullptr,
+			  h3, c3);
+	cache.SendRequest(AllocatorPtr{h4.pool}, MakeRequest("/"), nullptr,
+			  h4, c4);
+	EXPECT_EQ(instance.ts.n_requests, 1U);
+
+	c3.Cancel();
+	c1.Cancel();
+	EXPECT_EQ(instance.ts.n_requests, 2U);
+
+	const auto response = MakeResponse(pool).File("/var/www/index.html");
+	instance.ts.Finish(&response);
+
+	EXPECT_FALSE(h1.finished);
+	ExpectResponse(h2, response);
+	EXPECT_FALSE(h3.finished);
+	ExpectResponse(h4, response);
+	EXPECT_EQ(instance.ts.n_requests, 2U);
+}
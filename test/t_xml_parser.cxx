@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "TestPool.hxx"
+#include "parser/XmlParser.hxx"
+#include "parser/XmlScan.hxx"
+#include "parser/HtmlSyntax.hxx"
+#include "util/CharUtil.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <string_view>
+
+using std::string_view_literals::operator""sv;
+
+namespace {
+
+/**
+ * Records all parser events in a string which can be compared
+ * with an expected value.
+ */
+class RecordingXmlParserHandler final : public XmlParserHandler {
+	const std::string_view input;
+
+public:
+	std::string result;
+
+	explicit RecordingXmlParserHandler(std::string_view _input) noexcept
+		:input(_input) {}
+
+	/* virtual methods from class XmlParserHandler */
+	bool OnXmlTagStart(const XmlParserTag &tag) noexcept override {
+		result += tag.type == XmlParserTagType::CLOSE ? "</" : "<";
+		result += tag.name;
+		return true;
+	}
+
+	bool OnXmlTagFinished(const XmlParserTag &tag) noexcept override {
+		result += tag.type == XmlParserTagType::SHORT ? "/>" : ">";
+		return true;
+	}
+
+	void OnXmlAttributeFinished(const XmlParserAttribute &attr) noexcept override {
+		/* the offsets must match the value */
+		EXPECT_EQ(input.substr(attr.value_start,
+				       attr.value_end - attr.value_start),
+			  attr.value);
+
+		result += ' ';
+		result += attr.name;
+		result += "=[";
+		result += attr.value;
+		result += ']';
+	}
+
+	size_t OnXmlCdata(std::string_view text, [[maybe_unused]] bool escaped,
+			  [[maybe_unused]] off_t start) noexcept override {
+		result += text;
+		return text.size();
+	}
+};
+
+} // anonymous namespace
+
+/**
+ * Feed the input to a new #XmlParser in chunks of the given size and
+ * return the recorded events.
+ */
+static std::string
+Parse(std::string_view input, std::size_t chunk_size)
+{
+	TestPool pool;
+	RecordingXmlParserHandler handler{input};
+	XmlParser parser{pool, handler};
+
+	while (!input.empty()) {
+		const auto chunk = input.substr(0, chunk_size);
+		const std::size_t nbytes = parser.Feed(chunk.data(), chunk.size());
+		EXPECT_EQ(nbytes, chunk.size());
+		input.remove_prefix(nbytes);
+	}
+
+	return std::move(handler.result);
+}
+
+/**
+ * Parse the input in one piece and in all chunk sizes smaller than
+ * that; all must produce the expected result.
+ */
+static void
+ExpectParse(std::string_view input, std::string_view expected)
+{
+	for (std::size_t chunk_size = input.size(); chunk_size > 0; --chunk_size)
+		EXPECT_EQ(Parse(input, chunk_size), expected)
+			<< "chunk_size=" << chunk_size;
+}
+
+TEST(XmlParser, Basic)
+{
+	ExpectParse("foo<a href=\"x\" id='y' class=z>bar</a><br/>"sv,
+		    "foo<a href=[x] id=[y] class=[z]>bar</a><br/>"sv);
+}
+
+/**
+ * Names and unquoted values longer than one SIMD block (16 bytes),
+ * also split across Feed() calls.
+ */
+TEST(XmlParser, Long)
+{
+	ExpectParse("<Very-Long_Element.Name:With0123456789Digits "
+		    "Data-Very-Long-Attribute-Name=Unquoted-Value-Longer-Than-16-Bytes "
+		    "Second-Long-Attribute-Name-Here=\"quoted value\">"
+		    "text</Very-Long_Element.Name:With0123456789Digits>"sv,
+		    "<very-long_element.name:with0123456789digits"
+		    " data-very-long-attribute-name=[Unquoted-Value-Longer-Than-16-Bytes]"
+		    " second-long-attribute-name-here=[quoted value]>"
+		    "text</very-long_element.name:with0123456789digits>"sv);
+}
+
+/**
+ * An unquoted value terminated by the end of the element or by
+ * whitespace other than a space.
+ */
+TEST(XmlParser, UnquotedValueEnd)
+{
+	ExpectParse("<a b=0123456789abcdefghij>"
+		    "<a b=0123456789abcdefghij\tc=0123456789ABCDEFGHIJ\n/>"sv,
+		    "<a b=[0123456789abcdefghij]>"
+		    "<a b=[0123456789abcdefghij] c=[0123456789ABCDEFGHIJ]/>"sv);
+}
+
+/**
+ * An element name which exactly fills the name buffer is accepted;
+ * one more character drops the element.
+ */
+TEST(XmlParser, ElementNameTruncation)
+{
+	const std::string name(64, 'e');
+	ExpectParse("<" + name + " a=b>x",
+		    "<" + name + " a=[b]>x");
+
+	/* the element is not reported; the rest of it is treated as
+	   text */
+	ExpectParse("<" + name + "f a=b>x",
+		    "f a=b>x");
+}
+
+/**
+ * An attribute name which exactly fills the name buffer is
+ * accepted; one more character drops the attribute, and the
+ * overflowing rest begins a new attribute.
+ */
+TEST(XmlParser, AttributeNameTruncation)
+{
+	const std::string name(64, 'a');
+	ExpectParse("<p " + name + "=x c=d>",
+		    "<p " + name + "=[x] c=[d]>");
+
+	ExpectParse("<p " + name + "bc=x c=d>",
+		    "<p bc=[x] c=[d]>");
+}
+
+/**
+ * Bytes with the most significant bit set (e.g. UTF-8) are neither
+ * name characters nor delimiters of unquoted values.
+ */
+TEST(XmlParser, HighBytes)
+{
+	/* UTF-8 in unquoted values, longer than 16 bytes */
+	ExpectParse("<p title=caf\xc3\xa9-caf\xc3\xa9-caf\xc3\xa9-caf\xc3\xa9 x=\xff>"
+		    "\xc3\xa4\xc3\xb6\xc3\xbc</p>"sv,
+		    "<p title=[caf\xc3\xa9-caf\xc3\xa9-caf\xc3\xa9-caf\xc3\xa9] x=[\xff]>"
+		    "\xc3\xa4\xc3\xb6\xc3\xbc</p>"sv);
+
+	/* not a valid element name; the element is not reported,
+	   and the rest of it is treated as text */
+	ExpectParse("<abcdefghijklmnopq\xc3\xa9>"sv,
+		    "\xc3\xa9>"sv);
+
+	/* the attribute name ends before the invalid character,
+	   which also ends the element */
+	ExpectParse("<p abcdefghijklmnopq\xc3\xa9=x>text"sv,
+		    "<p abcdefghijklmnopq=[]>\xc3\xa9=x>text"sv);
+}
+
+/**
+ * Compare the bulk scanning functions with their scalar definitions
+ * for every byte value at every position of a buffer which is longer
+ * than two SIMD blocks.
+ */
+TEST(XmlScan, AllBytes)
+{
+	constexpr std::size_t size = 40;
+
+	for (unsigned i = 0; i < 256; ++i) {
+		const char ch = static_cast<char>(i);
+
+		const bool name_char = is_html_name_char(ch);
+		const bool value_end = IsWhitespaceOrNull(ch) || ch == '>';
+
+		for (std::size_t position = 0; position < size; ++position) {
+			std::string buffer(size, 'a');
+			buffer[position] = ch;
+
+			const char *begin = buffer.data(), *end = begin + size;
+
+			EXPECT_EQ(SkipHtmlName(begin, end),
+				  name_char ? end : begin + position)
+				<< "byte=" << i << " position=" << position;
+
+			EXPECT_EQ(FindUnquotedValueEnd(begin, end),
+				  value_end ? begin + position : end)
+				<< "byte=" << i << " position=" << position;
+		}
+	}
+}
@@ -239,6 +239,12 @@ struct MakeResponse : TranslateResponse {
 		want_full_uri = {(const std::byte *)value, strlen(value)};
 		return std::move(*this);
 	}
+
+	MakeResponse &&ValidateMtime(uint64_t mtime, const char *path) {
+		validate_mtime.mtime = mtime;
+		validate_mtime.path = alloc.Dup(path);
+		return std::move(*this);
+	}
 };
 
 struct MakeFileAddress : FileAddress {